@@ -59,8 +59,18 @@ struct s2n_config;
 struct s2n_connection;
 
 extern unsigned long s2n_get_openssl_version(void);
+
 extern int s2n_init(void);
 extern int s2n_cleanup(void);
+
+struct s2n_mem_stats {
+    uint64_t bytes_in_use;
+    uint64_t slab_bytes_reserved;
+    uint64_t slab_bytes_in_use;
+    uint64_t mlock_failures;
+};
+extern int s2n_mem_get_stats(struct s2n_mem_stats *stats);
+
 extern struct s2n_config *s2n_config_new(void);
 extern int s2n_config_free(struct s2n_config *config);
 extern int s2n_config_free_dhparams(struct s2n_config *config);
@@ -73,6 +83,7 @@ typedef int (*s2n_cache_delete_callback) (struct s2n_connection *conn,  void *,
 
 extern int s2n_config_set_wall_clock(struct s2n_config *config, s2n_clock_time_nanoseconds clock_fn, void *ctx);
 extern int s2n_config_set_monotonic_clock(struct s2n_config *config, s2n_clock_time_nanoseconds clock_fn, void *ctx);
+extern int s2n_config_set_perf_counters(struct s2n_config *config, uint8_t enabled);
 
 extern const char *s2n_strerror(int error, const char *lang);
 extern const char *s2n_strerror_debug(int error, const char *lang);
@@ -113,6 +124,8 @@ typedef enum {
 struct s2n_cert_chain_and_key;
 extern struct s2n_cert_chain_and_key *s2n_cert_chain_and_key_new(void);
 extern int s2n_cert_chain_and_key_load_pem(struct s2n_cert_chain_and_key *chain_and_key, const char *chain_pem, const char *private_key_pem);
+extern int s2n_cert_chain_and_key_load_pem_bulk(struct s2n_cert_chain_and_key **chain_and_keys, const char *const *chain_pems,
+                                                const char *const *private_key_pems, uint32_t count, uint32_t thread_count);
 extern int s2n_cert_chain_and_key_free(struct s2n_cert_chain_and_key *cert_and_key);
 extern int s2n_cert_chain_and_key_set_ctx(struct s2n_cert_chain_and_key *cert_and_key, void *ctx);
 extern void *s2n_cert_chain_and_key_get_ctx(struct s2n_cert_chain_and_key *cert_and_key);
@@ -122,6 +135,8 @@ extern int s2n_config_set_cert_tiebreak_callback(struct s2n_config *config, s2n_
 
 extern int s2n_config_add_cert_chain_and_key(struct s2n_config *config, const char *cert_chain_pem, const char *private_key_pem);
 extern int s2n_config_add_cert_chain_and_key_to_store(struct s2n_config *config, struct s2n_cert_chain_and_key *cert_key_pair);
+extern int s2n_config_add_cert_chains_and_keys_to_store(struct s2n_config *config, struct s2n_cert_chain_and_key **cert_key_pairs,
+                                                       uint32_t num_cert_key_pairs);
 extern int s2n_config_set_cert_chain_and_key_defaults(struct s2n_config *config,
                                                       struct s2n_cert_chain_and_key **cert_key_pairs,
                                                       uint32_t num_cert_key_pairs);
@@ -159,6 +174,10 @@ extern int s2n_config_add_ticket_crypto_key(struct s2n_config *config,
                                             const uint8_t *name, uint32_t name_len,
                                             uint8_t *key, uint32_t key_len,
                                             uint64_t intro_time_in_seconds_from_epoch);
+extern int s2n_config_set_max_early_data_size(struct s2n_config *config, uint32_t max_early_data_size);
+extern int s2n_config_set_early_data_replay_window(struct s2n_config *config, uint32_t window_in_secs, uint32_t max_client_hellos);
+typedef int (*s2n_early_data_replay_callback) (struct s2n_connection *conn, void *, uint64_t ttl_in_seconds, const void *key, uint64_t key_size);
+extern int s2n_config_set_early_data_replay_callback(struct s2n_config *config, s2n_early_data_replay_callback replay_callback, void *data);
 
 typedef enum { S2N_SERVER, S2N_CLIENT } s2n_mode;
 extern struct s2n_connection *s2n_connection_new(s2n_mode mode);
@@ -170,6 +189,24 @@ extern void *s2n_connection_get_ctx(struct s2n_connection *conn);
 typedef int s2n_client_hello_fn(struct s2n_connection *conn, void *ctx);
 extern int s2n_config_set_client_hello_cb(struct s2n_config *config, s2n_client_hello_fn client_hello_callback, void *ctx);
 
+struct s2n_async_pkey_op;
+typedef enum { S2N_ASYNC_DECRYPT, S2N_ASYNC_SIGN } s2n_async_pkey_op_type;
+typedef int (*s2n_async_pkey_fn)(struct s2n_connection *conn, struct s2n_async_pkey_op *op);
+extern int s2n_config_set_async_pkey_callback(struct s2n_config *config, s2n_async_pkey_fn fn);
+extern int s2n_async_pkey_op_get_op_type(struct s2n_async_pkey_op *op, s2n_async_pkey_op_type *type);
+extern int s2n_async_pkey_op_perform(struct s2n_async_pkey_op *op);
+extern int s2n_async_pkey_op_apply(struct s2n_async_pkey_op *op, struct s2n_connection *conn);
+extern int s2n_async_pkey_op_free(struct s2n_async_pkey_op *op);
+
+struct s2n_sign_engine;
+extern struct s2n_sign_engine *s2n_sign_engine_new(uint32_t max_batch_size, uint32_t max_batch_latency_in_us);
+extern int s2n_sign_engine_free(struct s2n_sign_engine *engine);
+extern int s2n_sign_engine_add_cert_chain_and_key(struct s2n_sign_engine *engine, struct s2n_cert_chain_and_key *chain_and_key,
+                                                  uint32_t ecdsa_nonces);
+extern int s2n_sign_engine_get_fd(struct s2n_sign_engine *engine);
+extern int s2n_sign_engine_poll(struct s2n_sign_engine *engine, struct s2n_connection **conns, uint32_t max_conns, uint32_t *conn_count);
+extern int s2n_config_set_sign_engine(struct s2n_config *config, struct s2n_sign_engine *engine);
+
 struct s2n_client_hello;
 extern struct s2n_client_hello *s2n_connection_get_client_hello(struct s2n_connection *conn);
 extern ssize_t s2n_client_hello_get_raw_message_length(struct s2n_client_hello *ch);
@@ -185,6 +222,9 @@ extern int s2n_connection_set_fd(struct s2n_connection *conn, int fd);
 extern int s2n_connection_set_read_fd(struct s2n_connection *conn, int readfd);
 extern int s2n_connection_set_write_fd(struct s2n_connection *conn, int writefd);
 extern int s2n_connection_use_corked_io(struct s2n_connection *conn);
+extern int s2n_connection_enable_ktls(struct s2n_connection *conn);
+extern int s2n_connection_is_ktls_send_enabled(struct s2n_connection *conn);
+extern int s2n_connection_is_ktls_recv_enabled(struct s2n_connection *conn);
 
 typedef int s2n_recv_fn(void *io_context, uint8_t *buf, uint32_t len);
 typedef int s2n_send_fn(void *io_context, const uint8_t *buf, uint32_t len);
@@ -196,6 +236,8 @@ extern int s2n_connection_set_send_cb(struct s2n_connection *conn, s2n_send_fn s
 extern int s2n_connection_prefer_throughput(struct s2n_connection *conn);
 extern int s2n_connection_prefer_low_latency(struct s2n_connection *conn);
 extern int s2n_connection_set_dynamic_record_threshold(struct s2n_connection *conn, uint32_t resize_threshold, uint16_t timeout_threshold);
+extern int s2n_connection_set_read_ahead(struct s2n_connection *conn, uint32_t max_bytes);
+extern int s2n_connection_set_dynamic_buffers(struct s2n_connection *conn, uint8_t enabled);
 
 /* If you don't want to use the configuration wide callback, you can set this per connection and it will be honored. */
 extern int s2n_connection_set_verify_host_callback(struct s2n_connection *config, s2n_verify_host_fn host_fn, void *data);
@@ -217,13 +259,49 @@ extern int s2n_negotiate(struct s2n_connection *conn, s2n_blocked_status *blocke
 extern ssize_t s2n_send(struct s2n_connection *conn, const void *buf, ssize_t size, s2n_blocked_status *blocked);
 extern ssize_t s2n_sendv(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, s2n_blocked_status *blocked);
 extern ssize_t s2n_sendv_with_offset(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, ssize_t offs, s2n_blocked_status *blocked);
+extern ssize_t s2n_sendfile(struct s2n_connection *conn, int fd, off_t offset, size_t count, s2n_blocked_status *blocked);
+extern int s2n_send_reserve(struct s2n_connection *conn, uint8_t **buf, uint32_t *size, s2n_blocked_status *blocked);
+extern ssize_t s2n_send_commit(struct s2n_connection *conn, uint32_t size, s2n_blocked_status *blocked);
 extern ssize_t s2n_recv(struct s2n_connection *conn,  void *buf, ssize_t size, s2n_blocked_status *blocked);
+extern ssize_t s2n_send_early_data(struct s2n_connection *conn, const void *buf, ssize_t size, s2n_blocked_status *blocked);
+extern ssize_t s2n_recv_early_data(struct s2n_connection *conn, void *buf, ssize_t size, s2n_blocked_status *blocked);
 extern uint32_t s2n_peek(struct s2n_connection *conn);
+extern uint32_t s2n_peek_buffered(struct s2n_connection *conn);
 
 extern int s2n_connection_free_handshake(struct s2n_connection *conn);
 extern int s2n_connection_release_buffers(struct s2n_connection *conn);
 extern int s2n_connection_wipe(struct s2n_connection *conn);
 extern int s2n_connection_free(struct s2n_connection *conn);
+
+struct s2n_connection_pool_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t releases;
+    uint64_t frees;
+    uint32_t idle;
+};
+extern int s2n_connection_pool_set_watermarks(uint32_t low, uint32_t high);
+extern int s2n_connection_pool_prefill(void);
+extern struct s2n_connection *s2n_connection_pool_acquire(s2n_mode mode);
+extern int s2n_connection_pool_release(struct s2n_connection *conn);
+extern int s2n_connection_pool_get_stats(struct s2n_connection_pool_stats *stats);
+
+struct s2n_ephemeral_key_pool_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint32_t idle;
+};
+extern int s2n_ephemeral_key_pool_set_depth(uint32_t depth);
+extern int s2n_ephemeral_key_pool_prefill(struct s2n_config *config);
+extern int s2n_ephemeral_key_pool_get_stats(struct s2n_ephemeral_key_pool_stats *stats);
+
+struct s2n_buffer_pool_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t returns;
+    uint32_t idle;
+};
+extern int s2n_buffer_pool_get_stats(struct s2n_buffer_pool_stats *stats);
 extern int s2n_shutdown(struct s2n_connection *conn, s2n_blocked_status *blocked);
 
 typedef enum { S2N_CERT_AUTH_NONE, S2N_CERT_AUTH_REQUIRED, S2N_CERT_AUTH_OPTIONAL } s2n_cert_auth_type;
@@ -241,6 +319,7 @@ extern int s2n_connection_get_session_length(struct s2n_connection *conn);
 extern int s2n_connection_get_session_id_length(struct s2n_connection *conn);
 extern int s2n_connection_get_session_id(struct s2n_connection *conn, uint8_t *session_id, size_t max_length);
 extern int s2n_connection_is_session_resumed(struct s2n_connection *conn);
+extern int s2n_connection_is_early_data_accepted(struct s2n_connection *conn);
 extern int s2n_connection_is_ocsp_stapled(struct s2n_connection *conn);
 
 extern struct s2n_cert_chain_and_key *s2n_connection_get_selected_cert(struct s2n_connection *conn);
@@ -270,6 +349,34 @@ extern int s2n_cert_public_key_set_rsa_from_openssl(s2n_cert_public_key *cert_pu
 
 extern uint64_t s2n_connection_get_wire_bytes_in(struct s2n_connection *conn);
 extern uint64_t s2n_connection_get_wire_bytes_out(struct s2n_connection *conn);
+
+struct s2n_perf_counters {
+    uint64_t handshakes;
+    uint64_t handshake_ns;
+    uint64_t handshake_handler_ns;
+    uint64_t record_crypto_ns;
+    uint64_t io_ns;
+    uint64_t io_calls;
+    uint64_t io_blocked;
+    uint64_t records_in;
+    uint64_t records_out;
+    uint64_t bytes_decrypted;
+    uint64_t bytes_encrypted;
+};
+
+#define S2N_PERF_MAX_HANDSHAKE_MESSAGES 32
+struct s2n_handshake_message_timing {
+    const char *message;
+    uint64_t elapsed_ns;
+};
+struct s2n_connection_perf_stats {
+    struct s2n_perf_counters counters;
+    uint32_t handshake_message_count;
+    struct s2n_handshake_message_timing handshake_messages[S2N_PERF_MAX_HANDSHAKE_MESSAGES];
+};
+extern int s2n_connection_get_perf_stats(struct s2n_connection *conn, struct s2n_connection_perf_stats *stats);
+extern int s2n_perf_get_stats(struct s2n_perf_counters *counters);
+extern int s2n_perf_get_cipher_suite_stats(const char *cipher_suite, struct s2n_perf_counters *counters);
 extern int s2n_connection_get_client_protocol_version(struct s2n_connection *conn);
 extern int s2n_connection_get_server_protocol_version(struct s2n_connection *conn);
 extern int s2n_connection_get_actual_protocol_version(struct s2n_connection *conn);
@@ -20,14 +20,38 @@
 #include <s2n.h>
 #include <openssl/x509v3.h>
 #include <openssl/pem.h>
+#include <pthread.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/param.h>
 
 #include "crypto/s2n_certificate.h"
 #include "utils/s2n_array.h"
 #include "utils/s2n_safety.h"
 #include "utils/s2n_mem.h"
 
+#define S2N_CERT_BULK_LOAD_MAX_THREADS 64
+
+/* Shared by the threads of one s2n_cert_chain_and_key_load_pem_bulk() call */
+struct s2n_cert_chain_and_key_bulk_load {
+    pthread_mutex_t lock;
+
+    struct s2n_cert_chain_and_key **chain_and_keys;
+    const char *const *chain_pems;
+    const char *const *private_key_pems;
+    uint32_t count;
+
+    /* The next pair to be loaded by whichever thread gets to it first */
+    uint32_t next;
+
+    /* Where the first load that failed went wrong. s2n_errno is per thread, so it is
+     * carried back to the calling thread from here.
+     */
+    int error;
+    const char *debug_str;
+    unsigned failed:1;
+};
+
 static const s2n_authentication_method cert_type_to_auth_method[] = {
     [S2N_CERT_TYPE_RSA_SIGN] = S2N_AUTHENTICATION_RSA,
     [S2N_CERT_TYPE_ECDSA_SIGN] = S2N_AUTHENTICATION_ECDSA,
@@ -339,6 +363,80 @@ int s2n_cert_chain_and_key_load_pem(struct s2n_cert_chain_and_key *chain_and_key
     return 0;
 }
 
+static void s2n_cert_chain_and_key_bulk_load_work(struct s2n_cert_chain_and_key_bulk_load *load)
+{
+    pthread_mutex_lock(&load->lock);
+    while (!load->failed && load->next < load->count) {
+        uint32_t i = load->next++;
+
+        pthread_mutex_unlock(&load->lock);
+        int result = s2n_cert_chain_and_key_load_pem(load->chain_and_keys[i], load->chain_pems[i], load->private_key_pems[i]);
+        pthread_mutex_lock(&load->lock);
+
+        if (result < 0 && !load->failed) {
+            load->failed = 1;
+            load->error = s2n_errno;
+            load->debug_str = s2n_debug_str;
+        }
+    }
+    pthread_mutex_unlock(&load->lock);
+}
+
+static void *s2n_cert_chain_and_key_bulk_load_worker(void *arg)
+{
+    s2n_cert_chain_and_key_bulk_load_work(arg);
+    s2n_cleanup();
+
+    return NULL;
+}
+
+int s2n_cert_chain_and_key_load_pem_bulk(struct s2n_cert_chain_and_key **chain_and_keys, const char *const *chain_pems,
+                                          const char *const *private_key_pems, uint32_t count, uint32_t thread_count)
+{
+    notnull_check(chain_and_keys);
+    notnull_check(chain_pems);
+    notnull_check(private_key_pems);
+    for (uint32_t i = 0; i < count; i++) {
+        notnull_check(chain_and_keys[i]);
+    }
+
+    struct s2n_cert_chain_and_key_bulk_load load = {
+        .chain_and_keys = chain_and_keys,
+        .chain_pems = chain_pems,
+        .private_key_pems = private_key_pems,
+        .count = count,
+    };
+    S2N_ERROR_IF(pthread_mutex_init(&load.lock, NULL) != 0, S2N_ERR_LOCK);
+
+    /* The calling thread loads certificates too, so it is one of the thread_count */
+    uint32_t workers = MIN(MIN(thread_count, count), S2N_CERT_BULK_LOAD_MAX_THREADS);
+    workers = workers > 0 ? workers - 1 : 0;
+
+    pthread_t threads[S2N_CERT_BULK_LOAD_MAX_THREADS];
+    uint32_t started = 0;
+    for (; started < workers; started++) {
+        /* Fewer threads only make loading slower, so carry on with the ones we have */
+        if (pthread_create(&threads[started], NULL, s2n_cert_chain_and_key_bulk_load_worker, &load) != 0) {
+            break;
+        }
+    }
+
+    s2n_cert_chain_and_key_bulk_load_work(&load);
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&load.lock);
+
+    if (load.failed) {
+        s2n_errno = load.error;
+        s2n_debug_str = load.debug_str;
+        S2N_ERROR_PRESERVE_ERRNO();
+    }
+
+    return 0;
+}
+
 int s2n_cert_chain_and_key_free(struct s2n_cert_chain_and_key *cert_and_key)
 {
     if (cert_and_key == NULL) {
@@ -391,17 +489,28 @@ int s2n_cert_chain_and_key_free(struct s2n_cert_chain_and_key *cert_and_key)
     return 0;
 }
 
-int s2n_send_cert_chain(struct s2n_stuffer *out, struct s2n_cert_chain *chain)
+int s2n_send_cert_chain(struct s2n_stuffer *out, struct s2n_cert_chain *chain, uint8_t actual_protocol_version)
 {
     notnull_check(out);
     notnull_check(chain);
-    GUARD(s2n_stuffer_write_uint24(out, chain->chain_size));
+
+    uint32_t chain_size = chain->chain_size;
+    if (actual_protocol_version >= S2N_TLS13) {
+        /* Each TLS1.3 CertificateEntry ends with its (empty) extensions */
+        for (struct s2n_cert *cur_cert = chain->head; cur_cert != NULL; cur_cert = cur_cert->next) {
+            chain_size += 2;
+        }
+    }
+    GUARD(s2n_stuffer_write_uint24(out, chain_size));
 
     struct s2n_cert *cur_cert = chain->head;
     while (cur_cert) {
         notnull_check(cur_cert);
         GUARD(s2n_stuffer_write_uint24(out, cur_cert->raw.size));
         GUARD(s2n_stuffer_write_bytes(out, cur_cert->raw.data, cur_cert->raw.size));
+        if (actual_protocol_version >= S2N_TLS13) {
+            GUARD(s2n_stuffer_write_uint16(out, 0));
+        }
         cur_cert = cur_cert->next;
     }
 
@@ -76,7 +76,7 @@ int s2n_cert_chain_and_key_matches_dns_name(const struct s2n_cert_chain_and_key
 
 int s2n_cert_public_key_set_rsa_from_openssl(s2n_cert_public_key *cert_pub_key, RSA *rsa);
 int s2n_cert_set_cert_type(struct s2n_cert *cert, s2n_cert_type cert_type);
-int s2n_send_cert_chain(struct s2n_stuffer *out, struct s2n_cert_chain *chain);
+int s2n_send_cert_chain(struct s2n_stuffer *out, struct s2n_cert_chain *chain, uint8_t actual_protocol_version);
 int s2n_send_empty_cert_chain(struct s2n_stuffer *out);
 int s2n_create_cert_chain_from_stuffer(struct s2n_cert_chain *cert_chain_out, struct s2n_stuffer *chain_in_stuffer);
 
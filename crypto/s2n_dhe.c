@@ -299,6 +299,18 @@ int s2n_dh_params_copy(struct s2n_dh_params *from, struct s2n_dh_params *to)
     return 0;
 }
 
+int s2n_dh_params_match_group(struct s2n_dh_params *a, struct s2n_dh_params *b, uint8_t *match)
+{
+    GUARD(s2n_check_p_g_dh_params(a));
+    GUARD(s2n_check_p_g_dh_params(b));
+    notnull_check(match);
+
+    *match = BN_cmp(s2n_get_p_dh_param(a), s2n_get_p_dh_param(b)) == 0
+          && BN_cmp(s2n_get_g_dh_param(a), s2n_get_g_dh_param(b)) == 0;
+
+    return 0;
+}
+
 int s2n_dh_generate_ephemeral_key(struct s2n_dh_params *dh_params)
 {
     GUARD(s2n_check_p_g_dh_params(dh_params));
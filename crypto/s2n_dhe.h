@@ -32,5 +32,6 @@ extern int s2n_dh_compute_shared_secret_as_server(struct s2n_dh_params *server_d
 extern int s2n_dh_compute_shared_secret_as_client(struct s2n_dh_params *server_dh_params, struct s2n_stuffer *Yc_out, struct s2n_blob *shared_key);
 extern int s2n_dh_params_copy(struct s2n_dh_params *from, struct s2n_dh_params *to);
 extern int s2n_dh_params_check(struct s2n_dh_params *params);
+extern int s2n_dh_params_match_group(struct s2n_dh_params *a, struct s2n_dh_params *b, uint8_t *match);
 extern int s2n_dh_generate_ephemeral_key(struct s2n_dh_params *dh_params);
 extern int s2n_dh_params_free(struct s2n_dh_params *dh_params);
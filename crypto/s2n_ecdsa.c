@@ -13,6 +13,9 @@
  * permissions and limitations under the License.
  */
 
+#include <pthread.h>
+#include <unistd.h>
+#include <openssl/bn.h>
 #include <openssl/ec.h>
 #include <openssl/ecdsa.h>
 #include <openssl/x509.h>
@@ -25,11 +28,180 @@
 #include "utils/s2n_random.h"
 #include "utils/s2n_safety.h"
 
+#include "crypto/s2n_ecc.h"
 #include "crypto/s2n_ecdsa.h"
 #include "crypto/s2n_hash.h"
 #include "crypto/s2n_openssl.h"
 #include "crypto/s2n_pkey.h"
 
+/* Most of the cost of an ECDSA signature is computing k^-1 and r = (k * G).x,
+ * and neither depends on the message. A private key can keep a stock of these
+ * pairs, filled ahead of time by s2n_ecdsa_nonces_precompute(), so that signing
+ * only has to do the cheap part. Each pair is taken out of the stock under the
+ * lock and used for exactly one signature. A forked child shares the stock with
+ * its parent, and two signatures with the same k give the private key away, so
+ * the stock is only ever used by the process that filled it.
+ */
+struct s2n_ecdsa_nonce {
+    BIGNUM *kinv;
+    BIGNUM *r;
+};
+
+struct s2n_ecdsa_nonces {
+    pthread_mutex_t lock;
+    /* The process the pairs were computed in */
+    pid_t pid;
+    uint32_t count;
+    uint32_t capacity;
+    struct s2n_ecdsa_nonce nonce[];
+};
+
+static uint32_t s2n_ecdsa_nonces_size(uint32_t capacity)
+{
+    return sizeof(struct s2n_ecdsa_nonces) + capacity * sizeof(struct s2n_ecdsa_nonce);
+}
+
+static void s2n_ecdsa_nonce_free(struct s2n_ecdsa_nonce *nonce)
+{
+    BN_clear_free(nonce->kinv);
+    BN_clear_free(nonce->r);
+    *nonce = (struct s2n_ecdsa_nonce) {0};
+}
+
+/* Called with the lock held. Pairs computed before a fork are freed without being used. */
+static void s2n_ecdsa_nonces_check_fork(struct s2n_ecdsa_nonces *nonces)
+{
+    pid_t pid = getpid();
+
+    if (nonces->pid != pid) {
+        while (nonces->count > 0) {
+            s2n_ecdsa_nonce_free(&nonces->nonce[--nonces->count]);
+        }
+        nonces->pid = pid;
+    }
+}
+
+/* Leaves nonce empty when there is nothing in stock */
+static int s2n_ecdsa_nonces_take(struct s2n_ecdsa_nonces *nonces, struct s2n_ecdsa_nonce *nonce)
+{
+    *nonce = (struct s2n_ecdsa_nonce) {0};
+
+    if (nonces == NULL) {
+        return 0;
+    }
+
+    S2N_ERROR_IF(pthread_mutex_lock(&nonces->lock) != 0, S2N_ERR_LOCK);
+    s2n_ecdsa_nonces_check_fork(nonces);
+    if (nonces->count > 0) {
+        nonces->count--;
+        *nonce = nonces->nonce[nonces->count];
+        nonces->nonce[nonces->count] = (struct s2n_ecdsa_nonce) {0};
+    }
+    S2N_ERROR_IF(pthread_mutex_unlock(&nonces->lock) != 0, S2N_ERR_LOCK);
+
+    return 0;
+}
+
+int s2n_ecdsa_nonces_init(struct s2n_pkey *priv, uint32_t capacity)
+{
+    notnull_check(priv);
+    struct s2n_ecdsa_key *key = &priv->key.ecdsa_key;
+    notnull_check(key->ec_key);
+
+    /* A key that already keeps a stock carries on with the one it has */
+    if (key->nonces != NULL) {
+        return 0;
+    }
+
+#if S2N_LIBCRYPTO_SUPPORTS_ECDSA_SIGN_SETUP
+    struct s2n_blob mem = {0};
+    GUARD(s2n_alloc(&mem, s2n_ecdsa_nonces_size(capacity)));
+    GUARD(s2n_blob_zero(&mem));
+
+    struct s2n_ecdsa_nonces *nonces = (struct s2n_ecdsa_nonces *)(void *) mem.data;
+    if (pthread_mutex_init(&nonces->lock, NULL) != 0) {
+        GUARD(s2n_free(&mem));
+        S2N_ERROR(S2N_ERR_LOCK);
+    }
+    nonces->pid = getpid();
+    nonces->capacity = capacity;
+    key->nonces = nonces;
+#endif
+
+    return 0;
+}
+
+int s2n_ecdsa_nonces_missing(const struct s2n_pkey *priv, uint32_t *missing)
+{
+    notnull_check(priv);
+    notnull_check(missing);
+    struct s2n_ecdsa_nonces *nonces = priv->key.ecdsa_key.nonces;
+
+    *missing = 0;
+    if (nonces == NULL) {
+        return 0;
+    }
+
+    S2N_ERROR_IF(pthread_mutex_lock(&nonces->lock) != 0, S2N_ERR_LOCK);
+    s2n_ecdsa_nonces_check_fork(nonces);
+    *missing = nonces->capacity - nonces->count;
+    S2N_ERROR_IF(pthread_mutex_unlock(&nonces->lock) != 0, S2N_ERR_LOCK);
+
+    return 0;
+}
+
+int s2n_ecdsa_nonces_precompute(const struct s2n_pkey *priv, uint32_t count)
+{
+    notnull_check(priv);
+    const struct s2n_ecdsa_key *key = &priv->key.ecdsa_key;
+    notnull_check(key->ec_key);
+
+    if (key->nonces == NULL) {
+        return 0;
+    }
+
+#if S2N_LIBCRYPTO_SUPPORTS_ECDSA_SIGN_SETUP
+    for (uint32_t i = 0; i < count; i++) {
+        struct s2n_ecdsa_nonce nonce = {0};
+
+        /* The expensive part is done without the lock, so that signing isn't held up */
+        GUARD_OSSL(ECDSA_sign_setup(key->ec_key, NULL, &nonce.kinv, &nonce.r), S2N_ERR_SIGN);
+
+        S2N_ERROR_IF(pthread_mutex_lock(&key->nonces->lock) != 0, S2N_ERR_LOCK);
+        s2n_ecdsa_nonces_check_fork(key->nonces);
+        int full = key->nonces->count == key->nonces->capacity;
+        if (!full) {
+            key->nonces->nonce[key->nonces->count++] = nonce;
+        }
+        S2N_ERROR_IF(pthread_mutex_unlock(&key->nonces->lock) != 0, S2N_ERR_LOCK);
+
+        if (full) {
+            s2n_ecdsa_nonce_free(&nonce);
+            break;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+static int s2n_ecdsa_nonces_free(struct s2n_ecdsa_key *key)
+{
+    struct s2n_ecdsa_nonces *nonces = key->nonces;
+    if (nonces == NULL) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < nonces->count; i++) {
+        s2n_ecdsa_nonce_free(&nonces->nonce[i]);
+    }
+    pthread_mutex_destroy(&nonces->lock);
+
+    GUARD(s2n_free_object((uint8_t **) &key->nonces, s2n_ecdsa_nonces_size(nonces->capacity)));
+
+    return 0;
+}
+
 int s2n_ecdsa_der_signature_size(const struct s2n_pkey *pkey)
 {
     const struct s2n_ecdsa_key *ecdsa_key = &pkey->key.ecdsa_key;
@@ -51,7 +223,19 @@ static int s2n_ecdsa_sign(const struct s2n_pkey *priv, struct s2n_hash_state *di
     GUARD(s2n_hash_digest(digest, digest_out, digest_length));
 
     unsigned int signature_size = signature->size;
-    GUARD_OSSL(ECDSA_sign(0, digest_out, digest_length, signature->data, &signature_size, key->ec_key), S2N_ERR_SIGN);
+    struct s2n_ecdsa_nonce nonce = {0};
+    GUARD(s2n_ecdsa_nonces_take(key->nonces, &nonce));
+
+#if S2N_LIBCRYPTO_SUPPORTS_ECDSA_SIGN_SETUP
+    if (nonce.kinv != NULL) {
+        int result = ECDSA_sign_ex(0, digest_out, digest_length, signature->data, &signature_size, nonce.kinv, nonce.r, key->ec_key);
+        s2n_ecdsa_nonce_free(&nonce);
+        GUARD_OSSL(result, S2N_ERR_SIGN);
+    } else
+#endif
+    {
+        GUARD_OSSL(ECDSA_sign(0, digest_out, digest_length, signature->data, &signature_size, key->ec_key), S2N_ERR_SIGN);
+    }
     S2N_ERROR_IF(signature_size > signature->size, S2N_ERR_SIZE_MISMATCH);
     signature->size = signature_size;
 
@@ -110,7 +294,8 @@ static int s2n_ecdsa_key_free(struct s2n_pkey *pkey)
     if (ecdsa_key->ec_key == NULL) {
         return 0;
     }
-    
+
+    GUARD(s2n_ecdsa_nonces_free(ecdsa_key));
     EC_KEY_free(ecdsa_key->ec_key);
     ecdsa_key->ec_key = NULL;
 
@@ -130,6 +315,7 @@ int s2n_evp_pkey_to_ecdsa_private_key(s2n_ecdsa_private_key *ecdsa_key, EVP_PKEY
     S2N_ERROR_IF(ec_key == NULL, S2N_ERR_DECODE_PRIVATE_KEY);
     
     ecdsa_key->ec_key = ec_key;
+    ecdsa_key->nonces = NULL;
     return 0;
 }
 
@@ -139,9 +325,26 @@ int s2n_evp_pkey_to_ecdsa_public_key(s2n_ecdsa_public_key *ecdsa_key, EVP_PKEY *
     S2N_ERROR_IF(ec_key == NULL, S2N_ERR_DECODE_CERTIFICATE);
     
     ecdsa_key->ec_key = ec_key;
+    ecdsa_key->nonces = NULL;
     return 0;
 }
 
+int s2n_ecdsa_pkey_matches_curve(const struct s2n_pkey *pkey, const struct s2n_ecc_named_curve *curve)
+{
+    notnull_check(curve);
+    if (pkey->sign != &s2n_ecdsa_sign) {
+        return 0;
+    }
+
+    const struct s2n_ecdsa_key *ecdsa_key = &pkey->key.ecdsa_key;
+    notnull_check(ecdsa_key->ec_key);
+
+    const EC_GROUP *group = EC_KEY_get0_group(ecdsa_key->ec_key);
+    notnull_check(group);
+
+    return EC_GROUP_get_curve_name(group) == curve->libcrypto_nid;
+}
+
 int s2n_ecdsa_pkey_init(struct s2n_pkey *pkey) {
     pkey->size = &s2n_ecdsa_der_signature_size;
     pkey->sign = &s2n_ecdsa_sign;
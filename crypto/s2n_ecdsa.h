@@ -27,15 +27,24 @@
 
 /* Forward declaration to avoid the circular dependency with s2n_pkey.h */
 struct s2n_pkey;
+struct s2n_ecdsa_nonces;
+struct s2n_ecc_named_curve;
 
 struct s2n_ecdsa_key {
     EC_KEY *ec_key;
+    /* Precomputed signing nonces, only ever set up for private keys */
+    struct s2n_ecdsa_nonces *nonces;
 };
 
 typedef struct s2n_ecdsa_key s2n_ecdsa_public_key;
 typedef struct s2n_ecdsa_key s2n_ecdsa_private_key;
 
 extern int s2n_ecdsa_pkey_init(struct s2n_pkey *pkey);
+extern int s2n_ecdsa_pkey_matches_curve(const struct s2n_pkey *pkey, const struct s2n_ecc_named_curve *curve);
 
 extern int s2n_evp_pkey_to_ecdsa_public_key(s2n_ecdsa_public_key *ecdsa_key, EVP_PKEY *pkey);
 extern int s2n_evp_pkey_to_ecdsa_private_key(s2n_ecdsa_private_key *ecdsa_key, EVP_PKEY *pkey);
+
+extern int s2n_ecdsa_nonces_init(struct s2n_pkey *priv, uint32_t capacity);
+extern int s2n_ecdsa_nonces_missing(const struct s2n_pkey *priv, uint32_t *missing);
+extern int s2n_ecdsa_nonces_precompute(const struct s2n_pkey *priv, uint32_t count);
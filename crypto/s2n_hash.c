@@ -492,6 +492,18 @@ int s2n_hash_new(struct s2n_hash_state *state)
     return state->hash_impl->new(state);
 }
 
+int s2n_hash_is_allocated(struct s2n_hash_state *state)
+{
+    GUARD(s2n_hash_set_impl(state));
+
+    /* Only EVP hash states have memory of their own to allocate */
+    if (state->hash_impl == &s2n_evp_hash) {
+        return state->digest.high_level.evp.ctx != NULL;
+    }
+
+    return 1;
+}
+
 int s2n_hash_allow_md5_for_fips(struct s2n_hash_state *state)
 {
     /* Ensure that hash_impl is set, as it may have been reset for s2n_hash_state on s2n_connection_wipe.
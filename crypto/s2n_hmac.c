@@ -278,6 +278,24 @@ int s2n_hmac_digest_two_compression_rounds(struct s2n_hmac_state *state, void *o
     return s2n_hash_update(&state->inner, state->xor_pad, state->hash_block_size);
 }
 
+int s2n_hmac_digest_balance(struct s2n_hmac_state *state, uint32_t currently_in_hash_block, const void *in, uint32_t size)
+{
+    /* Once the digest has been taken the inner hash can be reused. Hash the extra data into it as
+     * though it followed currently_in_hash_block bytes of a hash block, so that it causes exactly the
+     * compression rounds it would have caused had it been appended to the message. The outer hash is
+     * rebuilt from outer_just_key on every digest, so it takes the rest of the filler; in total
+     * hash_block_size - 1 filler bytes are always hashed, and none of them complete a block.
+     */
+    lt_check(currently_in_hash_block, state->hash_block_size);
+
+    GUARD(s2n_hash_reset(&state->inner));
+    GUARD(s2n_hash_reset(&state->outer));
+    GUARD(s2n_hash_update(&state->inner, state->xor_pad, currently_in_hash_block));
+    GUARD(s2n_hash_update(&state->outer, state->xor_pad, state->hash_block_size - currently_in_hash_block - 1));
+
+    return s2n_hash_update(&state->inner, in, size);
+}
+
 int s2n_hmac_free(struct s2n_hmac_state *state)
 {
     GUARD(s2n_hash_free(&state->inner));
@@ -46,3 +46,9 @@
 #else
 #define S2N_LIBCRYPTO_SUPPORTS_CUSTOM_RAND 0
 #endif
+
+#if !defined(OPENSSL_IS_BORINGSSL) && !defined(LIBRESSL_VERSION_NUMBER)
+#define S2N_LIBCRYPTO_SUPPORTS_ECDSA_SIGN_SETUP 1
+#else
+#define S2N_LIBCRYPTO_SUPPORTS_ECDSA_SIGN_SETUP 0
+#endif
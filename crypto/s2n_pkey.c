@@ -80,6 +80,28 @@ int s2n_pkey_verify(const struct s2n_pkey *pkey, struct s2n_hash_state *digest,
     return pkey->verify(pkey, digest, signature);
 }
 
+int s2n_pkey_sign_with_sig_alg(const struct s2n_pkey *pkey, s2n_signature_algorithm sig_alg, struct s2n_hash_state *digest, struct s2n_blob *signature)
+{
+    switch (sig_alg) {
+    case S2N_SIGNATURE_RSA_PSS_RSAE:
+        return s2n_rsa_pss_sign(pkey, digest, signature);
+    default:
+        return s2n_pkey_sign(pkey, digest, signature);
+    }
+}
+
+int s2n_pkey_verify_with_sig_alg(const struct s2n_pkey *pkey, s2n_signature_algorithm sig_alg, struct s2n_hash_state *digest, struct s2n_blob *signature)
+{
+    notnull_check(pkey);
+
+    switch (sig_alg) {
+    case S2N_SIGNATURE_RSA_PSS_RSAE:
+        return s2n_rsa_pss_verify(pkey, digest, signature);
+    default:
+        return s2n_pkey_verify(pkey, digest, signature);
+    }
+}
+
 int s2n_pkey_encrypt(const struct s2n_pkey *pkey, struct s2n_blob *in, struct s2n_blob *out)
 {
     notnull_check(pkey->encrypt);
@@ -18,6 +18,7 @@
 #include "crypto/s2n_ecdsa.h"
 #include "crypto/s2n_hash.h"
 #include "crypto/s2n_rsa.h"
+#include "crypto/s2n_signature.h"
 
 #include "utils/s2n_blob.h"
 
@@ -45,6 +46,8 @@ extern int s2n_pkey_check_key_exists(const struct s2n_pkey *pkey);
 extern int s2n_pkey_size(const struct s2n_pkey *pkey);
 extern int s2n_pkey_sign(const struct s2n_pkey *pkey, struct s2n_hash_state *digest, struct s2n_blob *signature);
 extern int s2n_pkey_verify(const struct s2n_pkey *pkey, struct s2n_hash_state *digest, struct s2n_blob *signature);
+extern int s2n_pkey_sign_with_sig_alg(const struct s2n_pkey *pkey, s2n_signature_algorithm sig_alg, struct s2n_hash_state *digest, struct s2n_blob *signature);
+extern int s2n_pkey_verify_with_sig_alg(const struct s2n_pkey *pkey, s2n_signature_algorithm sig_alg, struct s2n_hash_state *digest, struct s2n_blob *signature);
 extern int s2n_pkey_encrypt(const struct s2n_pkey *pkey, struct s2n_blob *in, struct s2n_blob *out);
 extern int s2n_pkey_decrypt(const struct s2n_pkey *pkey, struct s2n_blob *in, struct s2n_blob *out);
 extern int s2n_pkey_match(const struct s2n_pkey *pub_key, const struct s2n_pkey *priv_key);
@@ -116,6 +116,72 @@ static int s2n_rsa_verify(const struct s2n_pkey *pub, struct s2n_hash_state *dig
     return 0;
 }
 
+/* RSASSA-PSS with the RSAE encoding: the key is a plain rsaEncryption key, the MGF1 hash is the message hash and the
+ * salt is as long as the digest, see https://tools.ietf.org/html/rfc8446#section-4.2.3
+ */
+int s2n_rsa_pss_sign(const struct s2n_pkey *priv, struct s2n_hash_state *digest, struct s2n_blob *signature)
+{
+    S2N_ERROR_IF(priv->sign != &s2n_rsa_sign, S2N_ERR_INVALID_SIGNATURE_ALGORITHM);
+
+    uint8_t digest_length;
+    int NID_type;
+    GUARD(s2n_hash_digest_size(digest->alg, &digest_length));
+    GUARD(s2n_hash_NID_type(digest->alg, &NID_type));
+    lte_check(digest_length, S2N_MAX_DIGEST_LEN);
+
+    const EVP_MD *md = EVP_get_digestbynid(NID_type);
+    notnull_check(md);
+
+    const s2n_rsa_private_key *key = &priv->key.rsa_key;
+    const int rsa_size = s2n_rsa_encrypted_size(priv);
+    GUARD(rsa_size);
+
+    uint8_t encoded[4096];
+    S2N_ERROR_IF(rsa_size > sizeof(encoded), S2N_ERR_NOMEM);
+    S2N_ERROR_IF(rsa_size > signature->size, S2N_ERR_SIZE_MISMATCH);
+
+    uint8_t digest_out[S2N_MAX_DIGEST_LEN];
+    GUARD(s2n_hash_digest(digest, digest_out, digest_length));
+
+    GUARD_OSSL(RSA_padding_add_PKCS1_PSS_mgf1(key->rsa, encoded, digest_out, md, md, digest_length), S2N_ERR_SIGN);
+    int r = RSA_private_encrypt(rsa_size, encoded, signature->data, key->rsa, RSA_NO_PADDING);
+    S2N_ERROR_IF(r != rsa_size, S2N_ERR_SIGN);
+    signature->size = r;
+
+    return 0;
+}
+
+int s2n_rsa_pss_verify(const struct s2n_pkey *pub, struct s2n_hash_state *digest, struct s2n_blob *signature)
+{
+    S2N_ERROR_IF(pub->verify != &s2n_rsa_verify, S2N_ERR_INVALID_SIGNATURE_ALGORITHM);
+
+    uint8_t digest_length;
+    int NID_type;
+    GUARD(s2n_hash_digest_size(digest->alg, &digest_length));
+    GUARD(s2n_hash_NID_type(digest->alg, &NID_type));
+    lte_check(digest_length, S2N_MAX_DIGEST_LEN);
+
+    const EVP_MD *md = EVP_get_digestbynid(NID_type);
+    notnull_check(md);
+
+    const s2n_rsa_public_key *key = &pub->key.rsa_key;
+    const int rsa_size = s2n_rsa_encrypted_size(pub);
+    GUARD(rsa_size);
+
+    uint8_t encoded[4096];
+    S2N_ERROR_IF(rsa_size > sizeof(encoded), S2N_ERR_NOMEM);
+    S2N_ERROR_IF(signature->size != rsa_size, S2N_ERR_VERIFY_SIGNATURE);
+
+    uint8_t digest_out[S2N_MAX_DIGEST_LEN];
+    GUARD(s2n_hash_digest(digest, digest_out, digest_length));
+
+    int r = RSA_public_decrypt(signature->size, signature->data, encoded, key->rsa, RSA_NO_PADDING);
+    S2N_ERROR_IF(r != rsa_size, S2N_ERR_VERIFY_SIGNATURE);
+    GUARD_OSSL(RSA_verify_PKCS1_PSS_mgf1(key->rsa, digest_out, md, md, encoded, digest_length), S2N_ERR_VERIFY_SIGNATURE);
+
+    return 0;
+}
+
 static int s2n_rsa_encrypt(const struct s2n_pkey *pub, struct s2n_blob *in, struct s2n_blob *out)
 {
     S2N_ERROR_IF(out->size < s2n_rsa_encrypted_size(pub), S2N_ERR_NOMEM);
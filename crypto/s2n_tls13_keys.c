@@ -33,15 +33,15 @@
  * We currently support the following, more will be supported
  * when the relevant TLS 1.3 features are worked on.
  *
- * [ ] binder_key
- * [ ] client_early_traffic_secret
+ * [x] binder_key
+ * [x] client_early_traffic_secret
  * [ ] early_exporter_master_secret
  * [x] client_handshake_traffic_secret
  * [x] server_handshake_traffic_secret
  * [x] client_application_traffic_secret_0
  * [x] server_application_traffic_secret_0
  * [ ] exporter_master_secret
- * [ ] resumption_master_secret
+ * [x] resumption_master_secret
  *
  * The TLS 1.3 key generation can be divided into 3 phases
  * 1. early secrets
@@ -75,6 +75,12 @@ S2N_BLOB_LABEL(s2n_tls13_label_server_application_traffic_secret, "s ap traffic"
 S2N_BLOB_LABEL(s2n_tls13_label_exporter_master_secret, "exp master")
 S2N_BLOB_LABEL(s2n_tls13_label_resumption_master_secret, "res master")
 
+/*
+ * PSK derived from the resumption master secret and a NewSessionTicket nonce
+ * https://tools.ietf.org/html/rfc8446#section-4.6.1
+ */
+S2N_BLOB_LABEL(s2n_tls13_label_resumption, "resumption")
+
 /*
  * Traffic secret labels
  */
@@ -134,13 +140,17 @@ int s2n_tls13_keys_free(struct s2n_tls13_keys *keys) {
 }
 
 /*
- * Derives early secrets
+ * Derives early secrets. The psk may be NULL for a handshake without a pre-shared key.
  */
-int s2n_tls13_derive_early_secrets(struct s2n_tls13_keys *keys)
+int s2n_tls13_derive_early_secrets(struct s2n_tls13_keys *keys, const struct s2n_blob *psk)
 {
     notnull_check(keys);
 
     s2n_tls13_key_blob(psk_ikm, keys->size); /* in 1-RTT, PSK is 0-filled of key length */
+    if (psk != NULL && psk->size > 0) {
+        eq_check(psk->size, keys->size);
+        memcpy_check(psk_ikm.data, psk->data, psk->size);
+    }
 
     /* Early Secret */
     GUARD(s2n_hkdf_extract(&keys->hmac, keys->hmac_algorithm, &zero_length_blob, &psk_ikm, &keys->extract_secret));
@@ -156,6 +166,50 @@ int s2n_tls13_derive_early_secrets(struct s2n_tls13_keys *keys)
     return 0;
 }
 
+/*
+ * Derives the binder key for a resumption PSK from the early secret.
+ * Must be called after s2n_tls13_derive_early_secrets()
+ */
+int s2n_tls13_derive_binder_key(struct s2n_tls13_keys *keys, struct s2n_blob *binder_key)
+{
+    notnull_check(keys);
+    notnull_check(binder_key);
+
+    s2n_tls13_key_blob(message_digest, keys->size);
+    GUARD(s2n_tls13_transcript_message_hash(keys, &zero_length_blob, &message_digest));
+    GUARD(s2n_hkdf_expand_label(&keys->hmac, keys->hmac_algorithm, &keys->extract_secret,
+        &s2n_tls13_label_resumption_psk_binder_key, &message_digest, binder_key));
+
+    return 0;
+}
+
+/*
+ * Derives the client early traffic secret for 0-RTT data from the early secret
+ * and the transcript hash of the ClientHello.
+ * Must be called after s2n_tls13_derive_early_secrets()
+ */
+int s2n_tls13_derive_client_early_traffic_secret(struct s2n_tls13_keys *keys, struct s2n_hash_state *client_hello_hash, struct s2n_blob *secret)
+{
+    notnull_check(keys);
+    notnull_check(client_hello_hash);
+    notnull_check(secret);
+
+    s2n_tls13_key_blob(message_digest, keys->size);
+
+    /* copy the hash */
+    struct s2n_hash_state hkdf_hash_copy;
+    GUARD(s2n_hash_new(&hkdf_hash_copy));
+    GUARD(s2n_hash_copy(&hkdf_hash_copy, client_hello_hash));
+    GUARD(s2n_hash_digest(&hkdf_hash_copy, message_digest.data, message_digest.size));
+
+    GUARD(s2n_hash_free(&hkdf_hash_copy));
+
+    GUARD(s2n_hkdf_expand_label(&keys->hmac, keys->hmac_algorithm, &keys->extract_secret,
+        &s2n_tls13_label_client_early_traffic_secret, &message_digest, secret));
+
+    return 0;
+}
+
 /*
  * Derives handshake secrets
  */
@@ -226,7 +280,52 @@ int s2n_tls13_derive_application_secrets(struct s2n_tls13_keys *keys, struct s2n
     GUARD(s2n_hkdf_expand_label(&keys->hmac, keys->hmac_algorithm, &keys->extract_secret,
         &s2n_tls13_label_server_application_traffic_secret, &message_digest, server_secret));
 
-    /* exporter and resumption master secrets can be derived here */
+    /* exporter master secret can be derived here */
+
+    return 0;
+}
+
+/*
+ * Derives the resumption master secret from the master secret and the
+ * transcript up to the client Finished.
+ * Must be called after s2n_tls13_derive_application_secrets()
+ */
+int s2n_tls13_derive_resumption_master_secret(struct s2n_tls13_keys *keys, struct s2n_hash_state *hashes, struct s2n_blob *secret)
+{
+    notnull_check(keys);
+    notnull_check(hashes);
+    notnull_check(secret);
+
+    s2n_tls13_key_blob(message_digest, keys->size);
+
+    /* copy the hash */
+    struct s2n_hash_state hkdf_hash_copy;
+    GUARD(s2n_hash_new(&hkdf_hash_copy));
+    GUARD(s2n_hash_copy(&hkdf_hash_copy, hashes));
+    GUARD(s2n_hash_digest(&hkdf_hash_copy, message_digest.data, message_digest.size));
+
+    GUARD(s2n_hash_free(&hkdf_hash_copy));
+
+    GUARD(s2n_hkdf_expand_label(&keys->hmac, keys->hmac_algorithm, &keys->extract_secret,
+        &s2n_tls13_label_resumption_master_secret, &message_digest, secret));
+
+    return 0;
+}
+
+/*
+ * Derives the PSK of a session ticket from the resumption master secret and the ticket nonce
+ * https://tools.ietf.org/html/rfc8446#section-4.6.1
+ */
+int s2n_tls13_derive_resumption_psk(struct s2n_tls13_keys *keys, struct s2n_blob *resumption_master_secret,
+        struct s2n_blob *ticket_nonce, struct s2n_blob *psk)
+{
+    notnull_check(keys);
+    notnull_check(resumption_master_secret);
+    notnull_check(ticket_nonce);
+    notnull_check(psk);
+
+    GUARD(s2n_hkdf_expand_label(&keys->hmac, keys->hmac_algorithm, resumption_master_secret,
+        &s2n_tls13_label_resumption, ticket_nonce, psk));
 
     return 0;
 }
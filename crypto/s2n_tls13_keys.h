@@ -62,6 +62,7 @@ extern const struct s2n_blob s2n_tls13_label_server_application_traffic_secret;
 
 extern const struct s2n_blob s2n_tls13_label_exporter_master_secret;
 extern const struct s2n_blob s2n_tls13_label_resumption_master_secret;
+extern const struct s2n_blob s2n_tls13_label_resumption;
 
 /* Traffic secret labels */
 
@@ -73,13 +74,18 @@ extern const struct s2n_blob s2n_tls13_label_traffic_secret_iv;
 
 int s2n_tls13_keys_init(struct s2n_tls13_keys *handshake, s2n_hmac_algorithm alg);
 int s2n_tls13_keys_free(struct s2n_tls13_keys *keys);
-int s2n_tls13_derive_early_secrets(struct s2n_tls13_keys *handshake);
+int s2n_tls13_derive_early_secrets(struct s2n_tls13_keys *handshake, const struct s2n_blob *psk);
+int s2n_tls13_derive_binder_key(struct s2n_tls13_keys *handshake, struct s2n_blob *binder_key);
+int s2n_tls13_derive_client_early_traffic_secret(struct s2n_tls13_keys *handshake, struct s2n_hash_state *client_hello_hash, struct s2n_blob *secret);
 int s2n_tls13_derive_handshake_secrets(struct s2n_tls13_keys *handshake,
                                         const struct s2n_blob *ecdhe,
                                         struct s2n_hash_state *client_server_hello_hash,
                                         struct s2n_blob *client_secret,
                                         struct s2n_blob *server_secret);
 int s2n_tls13_derive_application_secrets(struct s2n_tls13_keys *handshake, struct s2n_hash_state *hashes, struct s2n_blob *client_secret, struct s2n_blob *server_secret);
+int s2n_tls13_derive_resumption_master_secret(struct s2n_tls13_keys *handshake, struct s2n_hash_state *hashes, struct s2n_blob *secret);
+int s2n_tls13_derive_resumption_psk(struct s2n_tls13_keys *handshake, struct s2n_blob *resumption_master_secret,
+        struct s2n_blob *ticket_nonce, struct s2n_blob *psk);
 
 int s2n_tls13_derive_traffic_keys(struct s2n_tls13_keys *handshake, struct s2n_blob *secret, struct s2n_blob *key, struct s2n_blob *iv);
 int s2n_tls13_derive_finished_key(struct s2n_tls13_keys *keys, struct s2n_blob *secret_key, struct s2n_blob *output_finish_key);
@@ -40,6 +40,7 @@ static const char *no_such_error = "Internal s2n error";
     ERR_ENTRY(S2N_ERR_IO, "underlying I/O operation failed, check system errno") \
     ERR_ENTRY(S2N_ERR_CLOSED, "connection is closed") \
     ERR_ENTRY(S2N_ERR_BLOCKED, "underlying I/O operation would block") \
+    ERR_ENTRY(S2N_ERR_ASYNC_BLOCKED, "Waiting on an asynchronous private key operation") \
     ERR_ENTRY(S2N_ERR_ALERT, "TLS alert received") \
     ERR_ENTRY(S2N_ERR_ENCRYPT, "error encrypting data") \
     ERR_ENTRY(S2N_ERR_DECRYPT, "error decrypting data") \
@@ -54,6 +55,7 @@ static const char *no_such_error = "Internal s2n error";
     ERR_ENTRY(S2N_ERR_CIPHER_NOT_SUPPORTED, "Cipher is not supported") \
     ERR_ENTRY(S2N_ERR_NO_APPLICATION_PROTOCOL, "No supported application protocol to negotiate") \
     ERR_ENTRY(S2N_ERR_FALLBACK_DETECTED, "TLS fallback detected") \
+    ERR_ENTRY(S2N_ERR_PROTOCOL_DOWNGRADE_DETECTED, "Protocol downgrade detected by client") \
     ERR_ENTRY(S2N_ERR_HASH_DIGEST_FAILED, "failed to create hash digest") \
     ERR_ENTRY(S2N_ERR_HASH_INIT_FAILED, "error initializing hash") \
     ERR_ENTRY(S2N_ERR_HASH_UPDATE_FAILED, "error updating hash") \
@@ -86,6 +88,8 @@ static const char *no_such_error = "Internal s2n error";
     ERR_ENTRY(S2N_ERR_PROTOCOL_VERSION_UNSUPPORTED, "TLS protocol version is not supported by selected cipher suite") \
     ERR_ENTRY(S2N_ERR_BAD_KEY_SHARE, "Bad key share received") \
     ERR_ENTRY(S2N_ERR_CANCELLED, "handshake was cancelled") \
+    ERR_ENTRY(S2N_ERR_ASYNC_FAILED, "Asynchronous private key operation failed") \
+    ERR_ENTRY(S2N_ERR_MAX_EARLY_DATA_SIZE, "Too much early data") \
     ERR_ENTRY(S2N_ERR_MADVISE, "error calling madvise") \
     ERR_ENTRY(S2N_ERR_ALLOC, "error allocating memory") \
     ERR_ENTRY(S2N_ERR_MLOCK, "error calling mlock (Did you run prlimit?)") \
@@ -152,9 +156,11 @@ static const char *no_such_error = "Internal s2n error";
     ERR_ENTRY(S2N_ERR_ARRAY_INDEX_OOB, "Array index out of bounds") \
     ERR_ENTRY(S2N_ERR_FREE_STATIC_BLOB, "Cannot free a static blob") \
     ERR_ENTRY(S2N_ERR_RESIZE_STATIC_BLOB, "Cannot resize a static blob") \
+    ERR_ENTRY(S2N_ERR_LOCK, "error acquiring or releasing a lock") \
     ERR_ENTRY(S2N_ERR_NO_ALERT, "No Alert present") \
     ERR_ENTRY(S2N_ERR_CLIENT_MODE, "operation not allowed in client mode") \
     ERR_ENTRY(S2N_ERR_CLIENT_MODE_DISABLED, "client connections not allowed") \
+    ERR_ENTRY(S2N_ERR_SERVER_MODE, "operation not allowed in server mode") \
     ERR_ENTRY(S2N_ERR_TOO_MANY_CERTIFICATES, "only 1 certificate is supported in client mode") \
     ERR_ENTRY(S2N_ERR_TOO_MANY_SIGNATURE_SCHEMES, "Max supported length of SignatureAlgorithms/SignatureSchemes list is 32") \
     ERR_ENTRY(S2N_ERR_CLIENT_AUTH_NOT_SUPPORTED_IN_FIPS_MODE, "Client Auth is not supported when in FIPS mode") \
@@ -198,6 +204,14 @@ static const char *no_such_error = "Internal s2n error";
     ERR_ENTRY(S2N_ERR_CONNECTION_CACHING_DISALLOWED, "This connection is not allowed to be cached") \
     ERR_ENTRY(S2N_ERR_SESSION_TICKET_NOT_SUPPORTED, "Session ticket not supported for this connection") \
     ERR_ENTRY(S2N_ERR_OCSP_NOT_SUPPORTED, "OCSP stapling was requested, but is not supported") \
+    ERR_ENTRY(S2N_ERR_SEND_RESERVE, "Invalid s2n_send_reserve()/s2n_send_commit() sequence") \
+    ERR_ENTRY(S2N_ERR_KTLS_HANDSHAKE_FREED, "kTLS can't be enabled after s2n_connection_free_handshake()") \
+    ERR_ENTRY(S2N_ERR_ASYNC_CALLBACK_FAILED, "Asynchronous private key callback failed") \
+    ERR_ENTRY(S2N_ERR_ASYNC_NOT_PERFORMED, "Asynchronous private key operation has not been performed") \
+    ERR_ENTRY(S2N_ERR_ASYNC_ALREADY_PERFORMED, "Asynchronous private key operation has already been performed") \
+    ERR_ENTRY(S2N_ERR_ASYNC_ALREADY_APPLIED, "Asynchronous private key operation has already been applied") \
+    ERR_ENTRY(S2N_ERR_ASYNC_WRONG_CONNECTION, "Asynchronous private key operation does not belong to this connection") \
+    ERR_ENTRY(S2N_ERR_INVALID_READ_AHEAD_SIZE, "Read-ahead size is larger than four maximum-size records") \
 
 #define ERR_STR_CASE(ERR, str) case ERR: return str;
 #define ERR_NAME_CASE(ERR, str) case ERR: return #ERR;
@@ -54,6 +54,7 @@ typedef enum {
 
     /* S2N_ERR_T_BLOCKED */
     S2N_ERR_BLOCKED = S2N_ERR_T_BLOCKED_START,
+    S2N_ERR_ASYNC_BLOCKED,
     S2N_ERR_T_BLOCKED_END,
 
     /* S2N_ERR_T_ALERT */
@@ -74,6 +75,7 @@ typedef enum {
     S2N_ERR_CIPHER_NOT_SUPPORTED,
     S2N_ERR_NO_APPLICATION_PROTOCOL,
     S2N_ERR_FALLBACK_DETECTED,
+    S2N_ERR_PROTOCOL_DOWNGRADE_DETECTED,
     S2N_ERR_HASH_DIGEST_FAILED,
     S2N_ERR_HASH_INIT_FAILED,
     S2N_ERR_HASH_UPDATE_FAILED,
@@ -106,6 +108,8 @@ typedef enum {
     S2N_ERR_PROTOCOL_VERSION_UNSUPPORTED,
     S2N_ERR_BAD_KEY_SHARE,
     S2N_ERR_CANCELLED,
+    S2N_ERR_ASYNC_FAILED,
+    S2N_ERR_MAX_EARLY_DATA_SIZE,
     S2N_ERR_T_PROTO_END,
 
     /* S2N_ERR_T_INTERNAL */
@@ -175,12 +179,14 @@ typedef enum {
     S2N_ERR_ARRAY_INDEX_OOB,
     S2N_ERR_FREE_STATIC_BLOB,
     S2N_ERR_RESIZE_STATIC_BLOB,
+    S2N_ERR_LOCK,
     S2N_ERR_T_INTERNAL_END,
 
     /* S2N_ERR_T_USAGE */
     S2N_ERR_NO_ALERT = S2N_ERR_T_USAGE_START,
     S2N_ERR_CLIENT_MODE,
     S2N_ERR_CLIENT_MODE_DISABLED,
+    S2N_ERR_SERVER_MODE,
     S2N_ERR_TOO_MANY_CERTIFICATES,
     S2N_ERR_TOO_MANY_SIGNATURE_SCHEMES,
     S2N_ERR_CLIENT_AUTH_NOT_SUPPORTED_IN_FIPS_MODE,
@@ -224,6 +230,14 @@ typedef enum {
     S2N_ERR_CONNECTION_CACHING_DISALLOWED,
     S2N_ERR_SESSION_TICKET_NOT_SUPPORTED,
     S2N_ERR_OCSP_NOT_SUPPORTED,
+    S2N_ERR_SEND_RESERVE,
+    S2N_ERR_KTLS_HANDSHAKE_FREED,
+    S2N_ERR_ASYNC_CALLBACK_FAILED,
+    S2N_ERR_ASYNC_NOT_PERFORMED,
+    S2N_ERR_ASYNC_ALREADY_PERFORMED,
+    S2N_ERR_ASYNC_ALREADY_APPLIED,
+    S2N_ERR_ASYNC_WRONG_CONNECTION,
+    S2N_ERR_INVALID_READ_AHEAD_SIZE,
     S2N_ERR_T_USAGE_END,
 } s2n_error;
 
@@ -238,6 +252,10 @@ extern __thread const char *s2n_debug_str;
 #define _S2N_ERROR( x )     do { s2n_debug_str = _S2N_DEBUG_LINE; s2n_errno = ( x ); s2n_calculate_stacktrace(); } while (0)
 #define S2N_ERROR( x )      do { _S2N_ERROR( ( x ) ); return -1; } while (0)
 #define S2N_ERROR_PRESERVE_ERRNO() do { return -1; } while (0)
+/* Blocking is the normal state of a non-blocking connection rather than a
+ * failure, so it skips the stack trace and goes straight back to the caller.
+ */
+#define S2N_ERROR_BLOCKED( x ) do { s2n_debug_str = _S2N_DEBUG_LINE; s2n_errno = ( x ); return -1; } while (0)
 #define S2N_ERROR_PTR( x )  do { _S2N_ERROR( ( x ) ); return NULL; } while (0)
 #define S2N_ERROR_IF( cond , x ) do { if ( cond ) { S2N_ERROR( x ); }} while (0)
 #define S2N_ERROR_IF_PTR( cond , x ) do { if ( cond ) { S2N_ERROR_PTR( x ); }} while (0)
@@ -13,6 +13,7 @@
  * permissions and limitations under the License.
  */
 
+#include <sys/param.h>
 #include <string.h>
 
 #include "error/s2n_errno.h"
@@ -67,6 +68,56 @@ int s2n_is_base64_char(char c)
     return (b64_inverse[(uint8_t) c] != 255);
 }
 
+/* Decodes up to groups 4-character groups from in to out, stopping at the first group that
+ * contains padding or a character that isn't base64. Both '=' (64) and invalid characters (255)
+ * have one of the top two bits set in b64_inverse, so a single test on the OR of the four
+ * values is enough to catch either. Returns the number of groups decoded.
+ */
+static uint32_t s2n_base64_decode_groups(const uint8_t *in, uint32_t groups, uint8_t *out)
+{
+    uint32_t i;
+    for (i = 0; i < groups; i++, in += 4, out += 3) {
+        uint8_t value1 = b64_inverse[in[0]];
+        uint8_t value2 = b64_inverse[in[1]];
+        uint8_t value3 = b64_inverse[in[2]];
+        uint8_t value4 = b64_inverse[in[3]];
+
+        if ((value1 | value2 | value3 | value4) & 0xc0) {
+            break;
+        }
+
+        out[0] = ((value1 << 2) & 0xfc) | ((value2 >> 4) & 0x03);
+        out[1] = ((value2 << 4) & 0xf0) | ((value3 >> 2) & 0x0f);
+        out[2] = ((value3 << 6) & 0xc0) | (value4 & 0x3f);
+    }
+
+    return i;
+}
+
+/* Decodes the run of unpadded groups at the start of stuffer straight into out, without
+ * going through the stuffer for every group.
+ */
+static int s2n_stuffer_read_base64_groups(struct s2n_stuffer *stuffer, struct s2n_stuffer *out)
+{
+    uint32_t groups = s2n_stuffer_data_available(stuffer) / 4;
+    if (!out->growable) {
+        groups = MIN(groups, s2n_stuffer_space_remaining(out) / 3);
+    }
+
+    if (groups == 0) {
+        return 0;
+    }
+
+    GUARD(s2n_stuffer_skip_write(out, groups * 3));
+    uint8_t *decoded = out->blob.data + out->write_cursor - groups * 3;
+
+    uint32_t decoded_groups = s2n_base64_decode_groups(stuffer->blob.data + stuffer->read_cursor, groups, decoded);
+    GUARD(s2n_stuffer_skip_read(stuffer, decoded_groups * 4));
+    GUARD(s2n_stuffer_wipe_n(out, (groups - decoded_groups) * 3));
+
+    return 0;
+}
+
 /**
  * NOTE:
  * In general, shift before masking. This avoids needing to worry about how the
@@ -79,6 +130,11 @@ int s2n_stuffer_read_base64(struct s2n_stuffer *stuffer, struct s2n_stuffer *out
     struct s2n_blob o = {.data = pad,.size = sizeof(pad) };
 
     do {
+        /* Most of the input is whole groups, so decode those in bulk and only
+         * fall through to the checks below for the final or malformed group.
+         */
+        GUARD(s2n_stuffer_read_base64_groups(stuffer, out));
+
         if (s2n_stuffer_data_available(stuffer) < 4) {
             break;
         }
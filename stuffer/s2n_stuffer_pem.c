@@ -13,6 +13,7 @@
  * permissions and limitations under the License.
  */
 
+#include <sys/param.h>
 #include <string.h>
 #include "error/s2n_errno.h"
 
@@ -25,6 +26,8 @@
 #define S2N_PEM_DELIMITER_MAX_COUNT         64
 #define S2N_PEM_BEGIN_TOKEN                 "BEGIN "
 #define S2N_PEM_END_TOKEN                   "END "
+/* Must be a multiple of 4 so that flushes never split a base64 group */
+#define S2N_PEM_BASE64_BUFFER_SIZE          1024
 
 #define S2N_PEM_PKCS1_RSA_PRIVATE_KEY       "RSA PRIVATE KEY"
 #define S2N_PEM_PKCS1_EC_PRIVATE_KEY        "EC PRIVATE KEY"
@@ -74,37 +77,46 @@ static int s2n_stuffer_pem_read_end(struct s2n_stuffer *pem, const char *keyword
 
 static int s2n_stuffer_pem_read_contents(struct s2n_stuffer *pem, struct s2n_stuffer *asn1)
 {
-    uint8_t base64_buf[64] = { 0 };
+    uint8_t base64_buf[S2N_PEM_BASE64_BUFFER_SIZE] = { 0 };
     struct s2n_blob base64__blob = { .data = base64_buf, .size = sizeof(base64_buf) };
     struct s2n_stuffer base64_stuffer = {0};
     GUARD(s2n_stuffer_init(&base64_stuffer, &base64__blob));
 
-    while (1) {
-        char c;
-        /* Peek to see if the next char is a dash, meaning end of pem_contents */
-        GUARD(s2n_stuffer_peek_char(pem, &c));
-        if (c == '-') {
-            break;
-        } else {
-            /* Else, move read pointer forward by 1 byte since we will be consuming it. */
-             GUARD(s2n_stuffer_skip_read(pem, 1));
-        }
-
-         /* Skip non-base64 characters */
-        if (!s2n_is_base64_char(c)) {
+    /* The contents run up to the next dash. Without one, we'd run out of data before the end line. */
+    S2N_ERROR_IF(s2n_stuffer_data_available(pem) == 0, S2N_ERR_STUFFER_OUT_OF_DATA);
+    const uint8_t *contents = pem->blob.data + pem->read_cursor;
+    const uint8_t *contents_end = memchr(contents, S2N_PEM_DELIMTER_CHAR, s2n_stuffer_data_available(pem));
+    S2N_ERROR_IF(contents_end == NULL, S2N_ERR_STUFFER_OUT_OF_DATA);
+    const uint32_t contents_size = contents_end - contents;
+
+    uint32_t i = 0;
+    while (i < contents_size) {
+        /* Skip non-base64 characters */
+        if (!s2n_is_base64_char(contents[i])) {
+            i++;
             continue;
         }
 
-        /* Flush base64_stuffer to asn1 stuffer if we're out of space, and reset base64_stuffer read/write pointers */
-        if (s2n_stuffer_space_remaining(&base64_stuffer) == 0) {
-            GUARD(s2n_stuffer_read_base64(&base64_stuffer, asn1));
-            GUARD(s2n_stuffer_rewrite(&base64_stuffer));
+        /* Copy the whole run of base64 characters up to the next newline or other separator */
+        uint32_t run_end = i + 1;
+        while (run_end < contents_size && s2n_is_base64_char(contents[run_end])) {
+            run_end++;
         }
 
-        /* Copy next char to base64_stuffer */
-        GUARD(s2n_stuffer_write_bytes(&base64_stuffer, (uint8_t *) &c, 1));
+        while (i < run_end) {
+            /* Flush base64_stuffer to asn1 stuffer if we're out of space, and reset base64_stuffer read/write pointers */
+            if (s2n_stuffer_space_remaining(&base64_stuffer) == 0) {
+                GUARD(s2n_stuffer_read_base64(&base64_stuffer, asn1));
+                GUARD(s2n_stuffer_rewrite(&base64_stuffer));
+            }
+
+            uint32_t n = MIN(run_end - i, s2n_stuffer_space_remaining(&base64_stuffer));
+            GUARD(s2n_stuffer_write_bytes(&base64_stuffer, contents + i, n));
+            i += n;
+        }
+    }
 
-    };
+    GUARD(s2n_stuffer_skip_read(pem, contents_size));
 
     /* Flush any remaining bytes to asn1 */
     GUARD(s2n_stuffer_read_base64(&base64_stuffer, asn1));
@@ -95,16 +95,16 @@ int s2n_stuffer_skip_read_until(struct s2n_stuffer *stuffer, const char *target)
 /* Skips the stuffer until the first instance of the target character or until there is no more data. */
 int s2n_stuffer_skip_to_char(struct s2n_stuffer *stuffer, const char target)
 {
-    while (s2n_stuffer_data_available(stuffer) > 0) {
-        char c;
-        GUARD(s2n_stuffer_peek_char(stuffer, &c));
-        if (c == target) {
-            break;
-        }
-
-        GUARD(s2n_stuffer_skip_read(stuffer, 1));
+    if (s2n_stuffer_data_available(stuffer) == 0) {
+        return 0;
     }
 
+    uint8_t *start = stuffer->blob.data + stuffer->read_cursor;
+    uint8_t *found = memchr(start, target, s2n_stuffer_data_available(stuffer));
+    uint32_t skipped = found ? found - start : s2n_stuffer_data_available(stuffer);
+
+    GUARD(s2n_stuffer_skip_read(stuffer, skipped));
+
     return 0;
 }
 
@@ -144,12 +144,10 @@ int s2n_stuffer_read_token(struct s2n_stuffer *stuffer, struct s2n_stuffer *toke
 {
     int token_size = 0;
 
-    while ((stuffer->read_cursor + token_size) < stuffer->write_cursor) {
-        if (stuffer->blob.data[stuffer->read_cursor + token_size] == delim) {
-            break;
-        }
-
-        token_size++;
+    if (s2n_stuffer_data_available(stuffer) > 0) {
+        uint8_t *start = stuffer->blob.data + stuffer->read_cursor;
+        uint8_t *found = memchr(start, delim, s2n_stuffer_data_available(stuffer));
+        token_size = found ? found - start : s2n_stuffer_data_available(stuffer);
     }
 
     GUARD(s2n_stuffer_copy(stuffer, token, token_size));
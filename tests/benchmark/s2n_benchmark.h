@@ -0,0 +1,75 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <s2n.h>
+
+#include "testlib/s2n_testlib.h"
+
+/* Benchmarks report numbers rather than pass or fail, but stop at the first error so nothing is reported for a
+ * code path that didn't run
+ */
+#define BENCHMARK_GUARD( x ) do { \
+        if ((x) < 0) { \
+            fprintf(stderr, "%s:%d: %s failed: %s\n", __FILE__, __LINE__, #x, s2n_strerror(s2n_errno, "EN")); \
+            exit(1); \
+        } \
+    } while (0)
+#define BENCHMARK_NOT_NULL( x ) BENCHMARK_GUARD((x) == NULL ? -1 : 0)
+
+static inline uint64_t benchmark_now_ns(void)
+{
+    struct timespec now;
+    BENCHMARK_GUARD(clock_gettime(CLOCK_MONOTONIC, &now));
+
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int benchmark_compare_samples(const void *a, const void *b)
+{
+    uint64_t left = *(const uint64_t *) a;
+    uint64_t right = *(const uint64_t *) b;
+
+    return (left > right) - (left < right);
+}
+
+/* Sorts the samples in place */
+static inline uint64_t benchmark_percentile(uint64_t *samples, size_t count, unsigned int percentile)
+{
+    qsort(samples, count, sizeof(uint64_t), benchmark_compare_samples);
+
+    size_t index = (count * percentile + 99) / 100;
+    return samples[index > 0 ? index - 1 : 0];
+}
+
+static inline struct s2n_cert_chain_and_key *benchmark_load_chain_and_key(const char *cert_chain_file, const char *private_key_file)
+{
+    static char cert_chain_pem[S2N_MAX_TEST_PEM_SIZE];
+    static char private_key_pem[S2N_MAX_TEST_PEM_SIZE];
+    struct s2n_cert_chain_and_key *chain_and_key;
+
+    BENCHMARK_GUARD(s2n_read_test_pem(cert_chain_file, cert_chain_pem, sizeof(cert_chain_pem)));
+    BENCHMARK_GUARD(s2n_read_test_pem(private_key_file, private_key_pem, sizeof(private_key_pem)));
+    BENCHMARK_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    BENCHMARK_GUARD(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    return chain_and_key;
+}
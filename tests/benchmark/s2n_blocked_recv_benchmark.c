@@ -0,0 +1,129 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Times a blocked s2n_recv() on an established connection, the call a non-blocking server makes every time a socket
+ * has no data yet, with stack traces turned on. A blocked call raises S2N_ERR_BLOCKED with S2N_ERROR_BLOCKED, which
+ * skips the trace S2N_ERROR would capture. Raising the same error both ways shows what that saves on every call.
+ */
+
+#include "s2n_benchmark.h"
+
+#include <errno.h>
+
+#include <s2n.h>
+
+#include "error/s2n_errno.h"
+#include "stuffer/s2n_stuffer.h"
+#include "tls/s2n_connection.h"
+
+#define ITERATIONS 100000
+/* Capturing a trace is slow enough that fewer calls give a stable number */
+#define TRACE_ITERATIONS 1000
+
+static int would_block(void *io_context, uint8_t *buf, uint32_t len)
+{
+    errno = EAGAIN;
+    return -1;
+}
+
+/* Kept out of line, so that each one is raised from a stack like the one in s2n_recv() */
+static __attribute__((noinline)) int raise_with_trace(void)
+{
+    S2N_ERROR(S2N_ERR_BLOCKED);
+}
+
+static __attribute__((noinline)) int raise_blocked(void)
+{
+    S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
+}
+
+static uint64_t time_raise(int (*raise)(void), int iterations)
+{
+    uint64_t start = benchmark_now_ns();
+    for (int i = 0; i < iterations; i++) {
+        if (raise() != -1 || s2n_errno != S2N_ERR_BLOCKED) {
+            fprintf(stderr, "the error wasn't raised\n");
+            exit(1);
+        }
+    }
+
+    return (benchmark_now_ns() - start) / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_config *server_config, *client_config;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    s2n_blocked_status blocked;
+    uint8_t buf[100];
+
+    /* Stack traces are what makes S2N_ERROR expensive, and they are turned on the way an application would */
+    setenv("S2N_PRINT_STACKTRACE", "1", 1);
+    BENCHMARK_GUARD(s2n_init());
+    BENCHMARK_GUARD(s2n_stack_traces_enabled() ? 0 : -1);
+
+    BENCHMARK_NOT_NULL(chain_and_key = benchmark_load_chain_and_key(S2N_DEFAULT_TEST_CERT_CHAIN, S2N_DEFAULT_TEST_PRIVATE_KEY));
+    BENCHMARK_NOT_NULL(server_config = s2n_config_new());
+    BENCHMARK_GUARD(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    BENCHMARK_NOT_NULL(client_config = s2n_config_new());
+    BENCHMARK_GUARD(s2n_config_disable_x509_verification(client_config));
+
+    BENCHMARK_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+    BENCHMARK_GUARD(s2n_connection_set_config(server_conn, server_config));
+    BENCHMARK_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+    BENCHMARK_GUARD(s2n_connection_set_config(client_conn, client_config));
+
+    BENCHMARK_GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    BENCHMARK_GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    BENCHMARK_GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    BENCHMARK_GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+    BENCHMARK_GUARD(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+
+    /* From here on the server's socket never has anything to read */
+    BENCHMARK_GUARD(s2n_connection_set_recv_cb(server_conn, would_block));
+
+    uint64_t start = benchmark_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (s2n_recv(server_conn, buf, sizeof(buf), &blocked) != -1 || s2n_errno != S2N_ERR_BLOCKED) {
+            fprintf(stderr, "s2n_recv() didn't block\n");
+            exit(1);
+        }
+    }
+    uint64_t recv_ns = (benchmark_now_ns() - start) / ITERATIONS;
+
+    uint64_t trace_ns = time_raise(raise_with_trace, TRACE_ITERATIONS);
+    uint64_t blocked_ns = time_raise(raise_blocked, ITERATIONS);
+
+    printf("blocked s2n_recv() with stack traces enabled, %d iterations (%d for S2N_ERROR)\n", ITERATIONS, TRACE_ITERATIONS);
+    printf("  S2N_ERROR_BLOCKED:              %8lu ns/call\n", (unsigned long) blocked_ns);
+    printf("  S2N_ERROR:                      %8lu ns/call\n", (unsigned long) trace_ns);
+    printf("  s2n_recv(), S2N_ERROR_BLOCKED:  %8lu ns/call\n", (unsigned long) recv_ns);
+    /* s2n_recv() itself can only be timed the way it raises the error now */
+    uint64_t trace_cost_ns = trace_ns > blocked_ns ? trace_ns - blocked_ns : 0;
+    printf("  s2n_recv(), S2N_ERROR:          %8lu ns/call (estimated)\n", (unsigned long) (recv_ns + trace_cost_ns));
+
+    BENCHMARK_GUARD(s2n_connection_free(server_conn));
+    BENCHMARK_GUARD(s2n_connection_free(client_conn));
+    BENCHMARK_GUARD(s2n_stuffer_free(&client_to_server));
+    BENCHMARK_GUARD(s2n_stuffer_free(&server_to_client));
+    BENCHMARK_GUARD(s2n_config_free(server_config));
+    BENCHMARK_GUARD(s2n_config_free(client_config));
+    BENCHMARK_GUARD(s2n_cert_chain_and_key_free(chain_and_key));
+    BENCHMARK_GUARD(s2n_cleanup());
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Times how long a server takes to answer a ClientHello with its first flight, ServerHello through
+ * ServerHelloDone, with and without an ephemeral key pool. Without one, the ServerKeyExchange key is generated
+ * while the client waits. With one, the pool is refilled between handshakes, the way a server would refill it
+ * when idle.
+ */
+
+#include "s2n_benchmark.h"
+
+#include <string.h>
+
+#include <s2n.h>
+
+#include "error/s2n_errno.h"
+#include "stuffer/s2n_stuffer.h"
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_ephemeral_key_pool.h"
+
+#define HANDSHAKES 300
+#define POOL_DEPTH 4
+
+static uint64_t samples[HANDSHAKES];
+
+static void time_first_flights(struct s2n_config *server_config, struct s2n_config *client_config,
+                               struct s2n_cipher_suite *cipher_suite, uint32_t depth)
+{
+    struct s2n_cipher_preferences server_cipher_preferences;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    struct s2n_ephemeral_key_pool_stats before, after;
+    uint64_t hits = 0, misses = 0;
+    s2n_blocked_status blocked;
+
+    /* Only offer the one cipher suite, to pick between ECDHE and DHE */
+    memcpy(&server_cipher_preferences, server_config->cipher_preferences, sizeof(server_cipher_preferences));
+    server_cipher_preferences.count = 1;
+    server_cipher_preferences.suites = &cipher_suite;
+
+    BENCHMARK_GUARD(s2n_ephemeral_key_pool_set_depth(depth));
+
+    BENCHMARK_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+    BENCHMARK_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+    BENCHMARK_GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    BENCHMARK_GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+
+    for (int i = 0; i < HANDSHAKES; i++) {
+        BENCHMARK_GUARD(s2n_connection_wipe(server_conn));
+        BENCHMARK_GUARD(s2n_connection_wipe(client_conn));
+        BENCHMARK_GUARD(s2n_stuffer_wipe(&client_to_server));
+        BENCHMARK_GUARD(s2n_stuffer_wipe(&server_to_client));
+        BENCHMARK_GUARD(s2n_connection_set_config(server_conn, server_config));
+        BENCHMARK_GUARD(s2n_connection_set_config(client_conn, client_config));
+        server_conn->cipher_pref_override = &server_cipher_preferences;
+        BENCHMARK_GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        BENCHMARK_GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        /* The ClientHello is waiting for the server */
+        BENCHMARK_GUARD(s2n_negotiate(client_conn, &blocked) == -1 && blocked == S2N_BLOCKED_ON_READ ? 0 : -1);
+
+        /* Idle time, before the next connection arrives */
+        if (depth > 0) {
+            BENCHMARK_GUARD(s2n_ephemeral_key_pool_prefill(server_config));
+        }
+
+        /* The client's key shares come from the same thread's pool, so only count the server's flight */
+        BENCHMARK_GUARD(s2n_ephemeral_key_pool_get_stats(&before));
+        uint64_t start = benchmark_now_ns();
+        BENCHMARK_GUARD(s2n_negotiate(server_conn, &blocked) == -1 && blocked == S2N_BLOCKED_ON_READ ? 0 : -1);
+        samples[i] = benchmark_now_ns() - start;
+        BENCHMARK_GUARD(s2n_ephemeral_key_pool_get_stats(&after));
+        hits += after.hits - before.hits;
+        misses += after.misses - before.misses;
+
+        /* Finish the handshake, so that only flights that work are counted */
+        BENCHMARK_GUARD(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+        BENCHMARK_GUARD(server_conn->secure.cipher_suite == cipher_suite ? 0 : -1);
+    }
+
+    uint64_t p50 = benchmark_percentile(samples, HANDSHAKES, 50);
+    uint64_t p99 = benchmark_percentile(samples, HANDSHAKES, 99);
+    printf("  %-40s depth %u: p50 %6lu us, p99 %6lu us (%lu pool hits, %lu misses)\n", cipher_suite->name, depth,
+            (unsigned long) (p50 / 1000), (unsigned long) (p99 / 1000),
+            (unsigned long) hits, (unsigned long) misses);
+
+    BENCHMARK_GUARD(s2n_connection_free(server_conn));
+    BENCHMARK_GUARD(s2n_connection_free(client_conn));
+    BENCHMARK_GUARD(s2n_stuffer_free(&client_to_server));
+    BENCHMARK_GUARD(s2n_stuffer_free(&server_to_client));
+    BENCHMARK_GUARD(s2n_ephemeral_key_pool_cleanup_thread());
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_config *server_config, *client_config;
+    static char dhparams_pem[S2N_MAX_TEST_PEM_SIZE];
+
+    BENCHMARK_GUARD(s2n_init());
+
+    BENCHMARK_NOT_NULL(chain_and_key = benchmark_load_chain_and_key(S2N_DEFAULT_TEST_CERT_CHAIN, S2N_DEFAULT_TEST_PRIVATE_KEY));
+    BENCHMARK_GUARD(s2n_read_test_pem(S2N_DEFAULT_TEST_DHPARAMS, dhparams_pem, sizeof(dhparams_pem)));
+
+    BENCHMARK_NOT_NULL(server_config = s2n_config_new());
+    BENCHMARK_GUARD(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    BENCHMARK_GUARD(s2n_config_add_dhparams(server_config, dhparams_pem));
+
+    BENCHMARK_NOT_NULL(client_config = s2n_config_new());
+    BENCHMARK_GUARD(s2n_config_disable_x509_verification(client_config));
+    BENCHMARK_GUARD(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    printf("server first flight latency, %d handshakes each\n", HANDSHAKES);
+
+    struct s2n_cipher_suite *cipher_suites[] = {
+        &s2n_ecdhe_rsa_with_aes_128_gcm_sha256,
+        &s2n_dhe_rsa_with_aes_128_gcm_sha256,
+    };
+    for (int i = 0; i < sizeof(cipher_suites) / sizeof(cipher_suites[0]); i++) {
+        time_first_flights(server_config, client_config, cipher_suites[i], 0);
+        time_first_flights(server_config, client_config, cipher_suites[i], POOL_DEPTH);
+    }
+
+    BENCHMARK_GUARD(s2n_config_free(server_config));
+    BENCHMARK_GUARD(s2n_config_free(client_config));
+    BENCHMARK_GUARD(s2n_cert_chain_and_key_free(chain_and_key));
+    BENCHMARK_GUARD(s2n_cleanup());
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/* Times decoding a large bundle of PEM certificates to DER, the way a config with many certificates is loaded,
+ * and decoding the same amount of bare base64.
+ */
+
+#include "s2n_benchmark.h"
+
+#include <string.h>
+
+#include <s2n.h>
+
+#include "stuffer/s2n_stuffer.h"
+
+#define BUNDLE_COPIES 500
+#define ROUNDS 50
+
+static uint64_t samples[ROUNDS];
+
+static void report(const char *name, uint32_t input_size)
+{
+    uint64_t p50 = benchmark_percentile(samples, ROUNDS, 50);
+    uint64_t p99 = benchmark_percentile(samples, ROUNDS, 99);
+
+    printf("  %-24s %8u bytes: p50 %7.3f ms, p99 %7.3f ms, %7.1f MB/s\n", name, input_size, p50 / 1e6, p99 / 1e6,
+            input_size / (p50 / 1e9) / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    static char cert_chain_pem[S2N_MAX_TEST_PEM_SIZE];
+    struct s2n_stuffer chain_pem, bundle_pem, base64, der;
+    int certs_in_chain = 0;
+
+    BENCHMARK_GUARD(s2n_init());
+
+    BENCHMARK_GUARD(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, sizeof(cert_chain_pem)));
+    BENCHMARK_GUARD(s2n_stuffer_alloc_ro_from_string(&chain_pem, cert_chain_pem));
+    BENCHMARK_GUARD(s2n_stuffer_growable_alloc(&der, 0));
+    while (s2n_stuffer_certificate_from_pem(&chain_pem, &der) == 0) {
+        certs_in_chain++;
+    }
+    BENCHMARK_GUARD(certs_in_chain > 0 ? 0 : -1);
+
+    BENCHMARK_GUARD(s2n_stuffer_growable_alloc(&bundle_pem, 0));
+    for (int i = 0; i < BUNDLE_COPIES; i++) {
+        BENCHMARK_GUARD(s2n_stuffer_write_bytes(&bundle_pem, (uint8_t *) cert_chain_pem, strlen(cert_chain_pem)));
+    }
+    uint32_t bundle_size = s2n_stuffer_data_available(&bundle_pem);
+
+    /* The DER of the whole bundle, re-encoded without line breaks, for the bare base64 case */
+    BENCHMARK_GUARD(s2n_stuffer_wipe(&der));
+    while (s2n_stuffer_certificate_from_pem(&bundle_pem, &der) == 0) {
+    }
+    BENCHMARK_GUARD(s2n_stuffer_growable_alloc(&base64, 0));
+    BENCHMARK_GUARD(s2n_stuffer_write_base64(&base64, &der));
+    uint32_t base64_size = s2n_stuffer_data_available(&base64);
+
+    printf("%d copies of %s, %d rounds\n", BUNDLE_COPIES, S2N_DEFAULT_TEST_CERT_CHAIN, ROUNDS);
+
+    for (int i = 0; i < ROUNDS; i++) {
+        int certs_in_bundle = 0;
+        BENCHMARK_GUARD(s2n_stuffer_reread(&bundle_pem));
+        BENCHMARK_GUARD(s2n_stuffer_wipe(&der));
+
+        uint64_t start = benchmark_now_ns();
+        while (s2n_stuffer_certificate_from_pem(&bundle_pem, &der) == 0) {
+            certs_in_bundle++;
+        }
+        samples[i] = benchmark_now_ns() - start;
+
+        BENCHMARK_GUARD(certs_in_bundle == certs_in_chain * BUNDLE_COPIES ? 0 : -1);
+    }
+    report("PEM bundle to DER", bundle_size);
+
+    for (int i = 0; i < ROUNDS; i++) {
+        BENCHMARK_GUARD(s2n_stuffer_reread(&base64));
+        BENCHMARK_GUARD(s2n_stuffer_wipe(&der));
+
+        uint64_t start = benchmark_now_ns();
+        BENCHMARK_GUARD(s2n_stuffer_read_base64(&base64, &der));
+        samples[i] = benchmark_now_ns() - start;
+    }
+    report("base64 to DER", base64_size);
+
+    BENCHMARK_GUARD(s2n_stuffer_free(&chain_pem));
+    BENCHMARK_GUARD(s2n_stuffer_free(&bundle_pem));
+    BENCHMARK_GUARD(s2n_stuffer_free(&base64));
+    BENCHMARK_GUARD(s2n_stuffer_free(&der));
+    BENCHMARK_GUARD(s2n_cleanup());
+
+    return 0;
+}
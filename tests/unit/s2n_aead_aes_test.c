@@ -33,17 +33,17 @@
 
 static int destroy_server_keys(struct s2n_connection *server_conn)
 {
-    GUARD(server_conn->initial.cipher_suite->record_alg->cipher->destroy_key(&server_conn->initial.server_key));
-    GUARD(server_conn->initial.cipher_suite->record_alg->cipher->destroy_key(&server_conn->initial.client_key));
+    GUARD(server_conn->initial->cipher_suite->record_alg->cipher->destroy_key(&server_conn->initial->server_key));
+    GUARD(server_conn->initial->cipher_suite->record_alg->cipher->destroy_key(&server_conn->initial->client_key));
     return 0;
 }
 
 static int setup_server_keys(struct s2n_connection *server_conn, struct s2n_blob *key)
 {
-    GUARD(server_conn->initial.cipher_suite->record_alg->cipher->init(&server_conn->initial.server_key));
-    GUARD(server_conn->initial.cipher_suite->record_alg->cipher->init(&server_conn->initial.client_key));
-    GUARD(server_conn->initial.cipher_suite->record_alg->cipher->set_encryption_key(&server_conn->initial.server_key, key));
-    GUARD(server_conn->initial.cipher_suite->record_alg->cipher->set_decryption_key(&server_conn->initial.client_key, key));
+    GUARD(server_conn->initial->cipher_suite->record_alg->cipher->init(&server_conn->initial->server_key));
+    GUARD(server_conn->initial->cipher_suite->record_alg->cipher->init(&server_conn->initial->client_key));
+    GUARD(server_conn->initial->cipher_suite->record_alg->cipher->set_encryption_key(&server_conn->initial->server_key, key));
+    GUARD(server_conn->initial->cipher_suite->record_alg->cipher->set_decryption_key(&server_conn->initial->client_key, key));
 
     return 0;
 }
@@ -64,11 +64,11 @@ int main(int argc, char **argv)
     EXPECT_SUCCESS(s2n_get_urandom_data(&r));
 
     /* Peer and we are in sync */
-    conn->server = &conn->initial;
-    conn->client = &conn->initial;
+    conn->server = conn->initial;
+    conn->client = conn->initial;
 
     /* test the AES128 cipher */
-    conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
+    conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
     EXPECT_SUCCESS(setup_server_keys(conn, &aes128));
 
     int max_fragment = S2N_SMALL_FRAGMENT_LENGTH;
@@ -82,9 +82,9 @@ int main(int argc, char **argv)
         conn->server_protocol_version = S2N_TLS12;
         conn->client_protocol_version = S2N_TLS12;
         conn->actual_protocol_version = S2N_TLS12;
-        conn->server = &conn->initial;
-        conn->client = &conn->initial;
-        conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
+        conn->server = conn->initial;
+        conn->client = conn->initial;
+        conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
         EXPECT_SUCCESS(destroy_server_keys(conn));
         EXPECT_SUCCESS(setup_server_keys(conn, &aes128));
         EXPECT_SUCCESS(bytes_written = s2n_record_write(conn, TLS_APPLICATION_DATA, &in));
@@ -98,8 +98,8 @@ int main(int argc, char **argv)
         }
 
         uint16_t predicted_length = bytes_written;
-        predicted_length += conn->initial.cipher_suite->record_alg->cipher->io.aead.record_iv_size;
-        predicted_length += conn->initial.cipher_suite->record_alg->cipher->io.aead.tag_size;
+        predicted_length += conn->initial->cipher_suite->record_alg->cipher->io.aead.record_iv_size;
+        predicted_length += conn->initial->cipher_suite->record_alg->cipher->io.aead.tag_size;
 
         EXPECT_EQUAL(conn->out.blob.data[0], TLS_APPLICATION_DATA);
         EXPECT_EQUAL(conn->out.blob.data[1], 3);
@@ -135,7 +135,7 @@ int main(int argc, char **argv)
         conn->server_protocol_version = S2N_TLS12;
         conn->client_protocol_version = S2N_TLS12;
         conn->actual_protocol_version = S2N_TLS12;
-        conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
+        conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
         EXPECT_SUCCESS(destroy_server_keys(conn));
         EXPECT_SUCCESS(setup_server_keys(conn, &aes128));
         EXPECT_SUCCESS(s2n_record_write(conn, TLS_APPLICATION_DATA, &in));
@@ -175,7 +175,7 @@ int main(int argc, char **argv)
             conn->server_protocol_version = S2N_TLS12;
             conn->client_protocol_version = S2N_TLS12;
             conn->actual_protocol_version = S2N_TLS12;
-            conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
+            conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
             EXPECT_SUCCESS(destroy_server_keys(conn));
             EXPECT_SUCCESS(setup_server_keys(conn, &aes128));
             EXPECT_SUCCESS(s2n_record_write(conn, TLS_APPLICATION_DATA, &in));
@@ -201,7 +201,7 @@ int main(int argc, char **argv)
             conn->server_protocol_version = S2N_TLS12;
             conn->client_protocol_version = S2N_TLS12;
             conn->actual_protocol_version = S2N_TLS12;
-            conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
+            conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
             EXPECT_SUCCESS(destroy_server_keys(conn));
             EXPECT_SUCCESS(setup_server_keys(conn, &aes128));
             EXPECT_SUCCESS(s2n_record_write(conn, TLS_APPLICATION_DATA, &in));
@@ -227,7 +227,7 @@ int main(int argc, char **argv)
             conn->server_protocol_version = S2N_TLS12;
             conn->client_protocol_version = S2N_TLS12;
             conn->actual_protocol_version = S2N_TLS12;
-            conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
+            conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes128_gcm;
             EXPECT_SUCCESS(destroy_server_keys(conn));
             EXPECT_SUCCESS(setup_server_keys(conn, &aes128));
             EXPECT_SUCCESS(s2n_record_write(conn, TLS_APPLICATION_DATA, &in));
@@ -251,7 +251,7 @@ int main(int argc, char **argv)
 
     /* test the AES256 cipher */
     EXPECT_NOT_NULL(conn = s2n_connection_new(S2N_SERVER));
-    conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
+    conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
     EXPECT_SUCCESS(setup_server_keys(conn, &aes256));
     conn->actual_protocol_version = S2N_TLS12;
 
@@ -266,7 +266,7 @@ int main(int argc, char **argv)
         conn->server_protocol_version = S2N_TLS12;
         conn->client_protocol_version = S2N_TLS12;
         conn->actual_protocol_version = S2N_TLS12;
-        conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
+        conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
         EXPECT_SUCCESS(destroy_server_keys(conn));
         EXPECT_SUCCESS(setup_server_keys(conn, &aes256));
         conn->actual_protocol_version = S2N_TLS12;
@@ -281,8 +281,8 @@ int main(int argc, char **argv)
         }
 
         uint16_t predicted_length = bytes_written;
-        predicted_length += conn->initial.cipher_suite->record_alg->cipher->io.aead.record_iv_size;
-        predicted_length += conn->initial.cipher_suite->record_alg->cipher->io.aead.tag_size;
+        predicted_length += conn->initial->cipher_suite->record_alg->cipher->io.aead.record_iv_size;
+        predicted_length += conn->initial->cipher_suite->record_alg->cipher->io.aead.tag_size;
 
         EXPECT_EQUAL(conn->out.blob.data[0], TLS_APPLICATION_DATA);
         EXPECT_EQUAL(conn->out.blob.data[1], 3);
@@ -316,7 +316,7 @@ int main(int argc, char **argv)
         conn->server_protocol_version = S2N_TLS12;
         conn->client_protocol_version = S2N_TLS12;
         conn->actual_protocol_version = S2N_TLS12;
-        conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
+        conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
         EXPECT_SUCCESS(destroy_server_keys(conn));
         EXPECT_SUCCESS(setup_server_keys(conn, &aes256));
         conn->actual_protocol_version = S2N_TLS12;
@@ -345,7 +345,7 @@ int main(int argc, char **argv)
             conn->server_protocol_version = S2N_TLS12;
             conn->client_protocol_version = S2N_TLS12;
             conn->actual_protocol_version = S2N_TLS12;
-            conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
+            conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
             EXPECT_SUCCESS(destroy_server_keys(conn));
             EXPECT_SUCCESS(setup_server_keys(conn, &aes256));
             conn->actual_protocol_version = S2N_TLS12;
@@ -372,7 +372,7 @@ int main(int argc, char **argv)
             conn->server_protocol_version = S2N_TLS12;
             conn->client_protocol_version = S2N_TLS12;
             conn->actual_protocol_version = S2N_TLS12;
-            conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
+            conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
             EXPECT_SUCCESS(destroy_server_keys(conn));
             EXPECT_SUCCESS(setup_server_keys(conn, &aes256));
             conn->actual_protocol_version = S2N_TLS12;
@@ -399,7 +399,7 @@ int main(int argc, char **argv)
             conn->server_protocol_version = S2N_TLS12;
             conn->client_protocol_version = S2N_TLS12;
             conn->actual_protocol_version = S2N_TLS12;
-            conn->initial.cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
+            conn->initial->cipher_suite->record_alg = &s2n_record_alg_aes256_gcm;
             EXPECT_SUCCESS(destroy_server_keys(conn));
             EXPECT_SUCCESS(setup_server_keys(conn, &aes256));
             conn->actual_protocol_version = S2N_TLS12;
@@ -171,6 +171,32 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_stuffer_wipe(&conn->in));
     }
 
+    /* TLS1.0 chains the IV across records, so check a run of records that span several MAC and encrypt chunks */
+    conn->actual_protocol_version = S2N_TLS10;
+    memcpy(conn->secure.client_implicit_iv, conn->secure.server_implicit_iv, S2N_TLS_MAX_IV_LEN);
+    for (int i = 0; i < 8; i++) {
+        struct s2n_blob in = {.data = random_data,.size = max_aligned_fragment - (i * 517) };
+        int bytes_written;
+
+        EXPECT_SUCCESS(s2n_stuffer_wipe(&conn->out));
+        EXPECT_SUCCESS(bytes_written = s2n_record_write(conn, TLS_APPLICATION_DATA, &in));
+
+        EXPECT_SUCCESS(s2n_stuffer_wipe(&conn->in));
+        EXPECT_SUCCESS(s2n_stuffer_wipe(&conn->header_in));
+        EXPECT_SUCCESS(s2n_stuffer_copy(&conn->out, &conn->header_in, 5));
+        EXPECT_SUCCESS(s2n_stuffer_copy(&conn->out, &conn->in, s2n_stuffer_data_available(&conn->out)));
+
+        uint8_t content_type;
+        uint16_t fragment_length;
+        EXPECT_SUCCESS(s2n_record_header_parse(conn, &content_type, &fragment_length));
+        EXPECT_SUCCESS(s2n_record_parse(conn));
+        EXPECT_EQUAL(s2n_stuffer_data_available(&conn->in), bytes_written);
+        EXPECT_BYTEARRAY_EQUAL(s2n_stuffer_raw_read(&conn->in, bytes_written), random_data, bytes_written);
+
+        EXPECT_SUCCESS(s2n_stuffer_wipe(&conn->header_in));
+        EXPECT_SUCCESS(s2n_stuffer_wipe(&conn->in));
+    }
+
     EXPECT_SUCCESS(conn->secure.cipher_suite->record_alg->cipher->destroy_key(&conn->secure.server_key));
     EXPECT_SUCCESS(conn->secure.cipher_suite->record_alg->cipher->destroy_key(&conn->secure.client_key));
     EXPECT_SUCCESS(s2n_connection_free(conn));
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include <string.h>
+
+#include "tls/s2n_anti_replay.h"
+#include "utils/s2n_blob.h"
+#include "utils/s2n_random.h"
+
+#define WINDOW 1000
+
+int main(int argc, char **argv)
+{
+    struct s2n_anti_replay *filter = NULL;
+    uint8_t key[32];
+    uint8_t other_key[32];
+
+    BEGIN_TEST();
+
+    memset(key, 0x5a, sizeof(key));
+    memset(other_key, 0xa5, sizeof(other_key));
+
+    /* A filter needs a window */
+    EXPECT_FAILURE_WITH_ERRNO(s2n_anti_replay_new(&filter, 0, 100), S2N_ERR_INVALID_ARGUMENT);
+    EXPECT_NULL(filter);
+
+    /* Freeing a filter that was never created is a no-op */
+    EXPECT_SUCCESS(s2n_anti_replay_free(&filter));
+
+    /* A key is new the first time, and seen after that */
+    {
+        EXPECT_SUCCESS(s2n_anti_replay_new(&filter, WINDOW, 100));
+
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, 1, key, sizeof(key)), 0);
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, 2, key, sizeof(key)), 1);
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, 3, other_key, sizeof(other_key)), 0);
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, 4, other_key, sizeof(other_key)), 1);
+
+        EXPECT_SUCCESS(s2n_anti_replay_free(&filter));
+        EXPECT_NULL(filter);
+    }
+
+    /* A key is remembered for at least a whole window, and forgotten after two */
+    {
+        EXPECT_SUCCESS(s2n_anti_replay_new(&filter, WINDOW, 100));
+
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, 0, key, sizeof(key)), 0);
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, WINDOW - 1, key, sizeof(key)), 1);
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, WINDOW + 1, key, sizeof(key)), 1);
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, 3 * WINDOW, key, sizeof(key)), 0);
+
+        /* A clock that goes backwards doesn't make the filter forget */
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, WINDOW, key, sizeof(key)), 1);
+
+        EXPECT_SUCCESS(s2n_anti_replay_free(&filter));
+    }
+
+    /* Keys too short to index the filter are refused */
+    {
+        EXPECT_SUCCESS(s2n_anti_replay_new(&filter, WINDOW, 100));
+
+        EXPECT_FAILURE_WITH_ERRNO(s2n_anti_replay_check_and_record(filter, 0, key, S2N_ANTI_REPLAY_MIN_KEY_SIZE - 1),
+                S2N_ERR_INVALID_ARGUMENT);
+        EXPECT_EQUAL(s2n_anti_replay_check_and_record(filter, 0, key, S2N_ANTI_REPLAY_MIN_KEY_SIZE), 0);
+
+        EXPECT_SUCCESS(s2n_anti_replay_free(&filter));
+    }
+
+    /* Sized for its entries, the filter rarely mistakes a new key for a replay */
+    {
+        const int entries = 1000;
+        int false_positives = 0;
+
+        EXPECT_SUCCESS(s2n_anti_replay_new(&filter, WINDOW, entries));
+
+        for (int i = 0; i < entries; i++) {
+            struct s2n_blob random = {.data = key,.size = sizeof(key) };
+            EXPECT_SUCCESS(s2n_get_public_random_data(&random));
+            EXPECT_SUCCESS(s2n_anti_replay_check_and_record(filter, 0, key, sizeof(key)));
+        }
+
+        for (int i = 0; i < entries; i++) {
+            struct s2n_blob random = {.data = other_key,.size = sizeof(other_key) };
+            EXPECT_SUCCESS(s2n_get_public_random_data(&random));
+
+            int seen;
+            EXPECT_SUCCESS(seen = s2n_anti_replay_check_and_record(filter, 0, other_key, sizeof(other_key)));
+            false_positives += seen;
+        }
+
+        EXPECT_TRUE(false_positives < entries / 20);
+
+        EXPECT_SUCCESS(s2n_anti_replay_free(&filter));
+    }
+
+    END_TEST();
+}
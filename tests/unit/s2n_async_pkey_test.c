@@ -0,0 +1,329 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_pkey.h"
+
+#include "tls/s2n_async_pkey.h"
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+static struct s2n_async_pkey_op *pending_op = NULL;
+static int callback_calls = 0;
+
+/* Hangs on to the operation, the test completes it later */
+static int async_pkey_store(struct s2n_connection *conn, struct s2n_async_pkey_op *op)
+{
+    callback_calls++;
+    pending_op = op;
+    return 0;
+}
+
+/* Completes the operation before returning, like an application with a fast local key might */
+static int async_pkey_inline(struct s2n_connection *conn, struct s2n_async_pkey_op *op)
+{
+    callback_calls++;
+    GUARD(s2n_async_pkey_op_perform(op));
+    GUARD(s2n_async_pkey_op_apply(op, conn));
+    GUARD(s2n_async_pkey_op_free(op));
+    return 0;
+}
+
+static int async_pkey_fail(struct s2n_connection *conn, struct s2n_async_pkey_op *op)
+{
+    callback_calls++;
+    GUARD(s2n_async_pkey_op_free(op));
+    return -1;
+}
+
+static int broken_sign(const struct s2n_pkey *priv, struct s2n_hash_state *digest, struct s2n_blob *signature)
+{
+    S2N_ERROR(S2N_ERR_SIGN);
+}
+
+/* Performs the operation with a key that can't sign, and applies the failure */
+static int async_pkey_broken_key(struct s2n_connection *conn, struct s2n_async_pkey_op *op)
+{
+    struct s2n_pkey broken_key = *op->key;
+    broken_key.sign = broken_sign;
+
+    callback_calls++;
+    op->key = &broken_key;
+    eq_check(s2n_async_pkey_op_perform(op), -1);
+    eq_check(s2n_async_pkey_op_perform(op), -1);
+    eq_check(s2n_errno, S2N_ERR_ASYNC_ALREADY_PERFORMED);
+    GUARD(s2n_async_pkey_op_apply(op, conn));
+    GUARD(s2n_async_pkey_op_free(op));
+    return 0;
+}
+
+static void *perform_op(void *op)
+{
+    if (s2n_async_pkey_op_perform(op) < 0) {
+        return NULL;
+    }
+
+    return op;
+}
+
+/* Drives both ends of the handshake, finishing each async operation on another thread */
+static int negotiate_with_async_pkey(struct s2n_connection *server_conn, struct s2n_connection *client_conn,
+                                     s2n_async_pkey_op_type expected_type, int *async_blocks)
+{
+    s2n_blocked_status blocked;
+    int server_done = 0;
+    int client_done = 0;
+
+    *async_blocks = 0;
+
+    do {
+        if (!client_done) {
+            if (s2n_negotiate(client_conn, &blocked) == 0) {
+                client_done = 1;
+            } else if (s2n_error_get_type(s2n_errno) != S2N_ERR_T_BLOCKED) {
+                return -1;
+            }
+        }
+
+        if (!server_done) {
+            if (s2n_negotiate(server_conn, &blocked) == 0) {
+                server_done = 1;
+            } else if (s2n_error_get_type(s2n_errno) != S2N_ERR_T_BLOCKED) {
+                return -1;
+            } else if (blocked == S2N_BLOCKED_ON_APPLICATION_INPUT) {
+                s2n_async_pkey_op_type type;
+                pthread_t thread;
+                void *result = NULL;
+
+                eq_check(s2n_errno, S2N_ERR_ASYNC_BLOCKED);
+                notnull_check(pending_op);
+                GUARD(s2n_async_pkey_op_get_op_type(pending_op, &type));
+                eq_check(type, expected_type);
+                (*async_blocks)++;
+
+                /* Nothing happens until the operation is applied */
+                eq_check(s2n_negotiate(server_conn, &blocked), -1);
+                eq_check(blocked, S2N_BLOCKED_ON_APPLICATION_INPUT);
+                eq_check(s2n_errno, S2N_ERR_ASYNC_BLOCKED);
+
+                /* It can't be applied before it is performed */
+                eq_check(s2n_async_pkey_op_apply(pending_op, server_conn), -1);
+                eq_check(s2n_errno, S2N_ERR_ASYNC_NOT_PERFORMED);
+
+                eq_check(pthread_create(&thread, NULL, perform_op, pending_op), 0);
+                eq_check(pthread_join(thread, &result), 0);
+                eq_check(result, pending_op);
+
+                /* Only on the connection it came from, and only once */
+                eq_check(s2n_async_pkey_op_apply(pending_op, client_conn), -1);
+                eq_check(s2n_errno, S2N_ERR_ASYNC_WRONG_CONNECTION);
+                GUARD(s2n_async_pkey_op_apply(pending_op, server_conn));
+                eq_check(s2n_async_pkey_op_apply(pending_op, server_conn), -1);
+                eq_check(s2n_errno, S2N_ERR_ASYNC_ALREADY_APPLIED);
+
+                GUARD(s2n_async_pkey_op_free(pending_op));
+                pending_op = NULL;
+            }
+        }
+    } while (!client_done || !server_done);
+
+    return 0;
+}
+
+static int try_handshake(struct s2n_config *server_config, struct s2n_config *client_config, struct s2n_cipher_suite *cipher_suite,
+                         s2n_async_pkey_op_type expected_type, int *async_blocks)
+{
+    struct s2n_cipher_preferences server_cipher_preferences;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    s2n_blocked_status blocked;
+    uint8_t buf[5];
+
+    /* Only offer the one cipher suite, to pick between signing and decrypting */
+    memcpy(&server_cipher_preferences, server_config->cipher_preferences, sizeof(server_cipher_preferences));
+    server_cipher_preferences.count = 1;
+    server_cipher_preferences.suites = &cipher_suite;
+
+    notnull_check(server_conn = s2n_connection_new(S2N_SERVER));
+    notnull_check(client_conn = s2n_connection_new(S2N_CLIENT));
+    GUARD(s2n_connection_set_config(server_conn, server_config));
+    GUARD(s2n_connection_set_config(client_conn, client_config));
+    server_conn->cipher_pref_override = &server_cipher_preferences;
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    int rc = negotiate_with_async_pkey(server_conn, client_conn, expected_type, async_blocks);
+    if (rc == 0) {
+        eq_check(server_conn->secure.cipher_suite, cipher_suite);
+
+        /* Both ends agree on the keys */
+        eq_check(s2n_send(server_conn, "hello", 5, &blocked), 5);
+        eq_check(s2n_recv(client_conn, buf, 5, &blocked), 5);
+        eq_check(memcmp(buf, "hello", 5), 0);
+        GUARD(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+    }
+
+    GUARD(s2n_connection_free(server_conn));
+    GUARD(s2n_connection_free(client_conn));
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_config *server_config, *client_config;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    int async_blocks;
+
+    struct {
+        struct s2n_cipher_suite *cipher_suite;
+        s2n_async_pkey_op_type type;
+    } tests[] = {
+        { &s2n_ecdhe_rsa_with_aes_128_gcm_sha256, S2N_ASYNC_SIGN },
+        { &s2n_rsa_with_aes_128_gcm_sha256, S2N_ASYNC_DECRYPT },
+    };
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    for (int i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        /* Without a callback the operation happens inline */
+        callback_calls = 0;
+        EXPECT_SUCCESS(s2n_config_set_async_pkey_callback(server_config, NULL));
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, tests[i].cipher_suite, tests[i].type, &async_blocks));
+        EXPECT_EQUAL(async_blocks, 0);
+        EXPECT_EQUAL(callback_calls, 0);
+
+        /* A callback that finishes the operation straight away doesn't block the handshake */
+        callback_calls = 0;
+        EXPECT_SUCCESS(s2n_config_set_async_pkey_callback(server_config, async_pkey_inline));
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, tests[i].cipher_suite, tests[i].type, &async_blocks));
+        EXPECT_EQUAL(async_blocks, 0);
+        EXPECT_EQUAL(callback_calls, 1);
+
+        /* Otherwise s2n_negotiate() returns until the application applies the operation */
+        callback_calls = 0;
+        EXPECT_SUCCESS(s2n_config_set_async_pkey_callback(server_config, async_pkey_store));
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, tests[i].cipher_suite, tests[i].type, &async_blocks));
+        EXPECT_EQUAL(async_blocks, 1);
+        EXPECT_EQUAL(callback_calls, 1);
+        EXPECT_NULL(pending_op);
+
+        /* A failing callback fails the handshake */
+        callback_calls = 0;
+        EXPECT_SUCCESS(s2n_config_set_async_pkey_callback(server_config, async_pkey_fail));
+        EXPECT_FAILURE(try_handshake(server_config, client_config, tests[i].cipher_suite, tests[i].type, &async_blocks));
+        EXPECT_EQUAL(callback_calls, 1);
+
+        /* So does an operation that failed, once it is applied */
+        if (tests[i].type == S2N_ASYNC_SIGN) {
+            callback_calls = 0;
+            EXPECT_SUCCESS(s2n_config_set_async_pkey_callback(server_config, async_pkey_broken_key));
+            EXPECT_FAILURE_WITH_ERRNO(try_handshake(server_config, client_config, tests[i].cipher_suite, tests[i].type, &async_blocks),
+                                      S2N_ERR_ASYNC_FAILED);
+            EXPECT_EQUAL(callback_calls, 1);
+        }
+    }
+
+    /* An operation from before a wipe can't be applied to the connection's next handshake */
+    {
+        struct s2n_connection *server_conn, *client_conn;
+        struct s2n_stuffer client_to_server, server_to_client;
+        struct s2n_async_pkey_op *stale_op;
+        s2n_blocked_status blocked;
+
+        EXPECT_SUCCESS(s2n_config_set_async_pkey_callback(server_config, async_pkey_store));
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+
+        for (int handshake = 0; handshake < 2; handshake++) {
+            EXPECT_SUCCESS(s2n_stuffer_wipe(&client_to_server));
+            EXPECT_SUCCESS(s2n_stuffer_wipe(&server_to_client));
+            EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+            EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+            while (pending_op == NULL) {
+                EXPECT_FAILURE(s2n_negotiate(client_conn, &blocked));
+                EXPECT_FAILURE(s2n_negotiate(server_conn, &blocked));
+            }
+            EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_APPLICATION_INPUT);
+
+            if (handshake == 0) {
+                stale_op = pending_op;
+                pending_op = NULL;
+                EXPECT_SUCCESS(s2n_connection_wipe(server_conn));
+                EXPECT_SUCCESS(s2n_connection_wipe(client_conn));
+            }
+        }
+
+        /* The new handshake is waiting on an operation too, but not that one */
+        EXPECT_SUCCESS(s2n_async_pkey_op_perform(stale_op));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_async_pkey_op_apply(stale_op, server_conn), S2N_ERR_ASYNC_WRONG_CONNECTION);
+        EXPECT_SUCCESS(s2n_async_pkey_op_free(stale_op));
+
+        EXPECT_SUCCESS(s2n_async_pkey_op_perform(pending_op));
+        EXPECT_SUCCESS(s2n_async_pkey_op_apply(pending_op, server_conn));
+        EXPECT_SUCCESS(s2n_async_pkey_op_free(pending_op));
+        pending_op = NULL;
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    }
+
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
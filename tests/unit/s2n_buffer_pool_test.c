@@ -0,0 +1,195 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_buffer_pool.h"
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define PAYLOAD_SIZE 3000
+
+static int has_no_buffers(struct s2n_connection *conn)
+{
+    return conn->in.blob.data == NULL && conn->out.blob.data == NULL
+        && conn->buffer_in.blob.data == NULL && conn->handshake.io.blob.data == NULL;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_config *server_config, *client_config;
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    struct s2n_buffer_pool_stats stats;
+    s2n_blocked_status blocked;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t sent[PAYLOAD_SIZE];
+    uint8_t received[PAYLOAD_SIZE];
+
+    BEGIN_TEST();
+
+    for (int i = 0; i < sizeof(sent); i++) {
+        sent[i] = i % 251;
+    }
+
+    /* Buffers go back to the pool and are handed out again */
+    {
+        struct s2n_stuffer stuffer;
+        uint8_t *data;
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&stuffer, 0));
+        EXPECT_SUCCESS(s2n_buffer_pool_lease(&stuffer));
+        EXPECT_EQUAL(stuffer.blob.size, S2N_BUFFER_POOL_BUFFER_SIZE);
+        data = stuffer.blob.data;
+
+        /* Only a buffer with nothing left to read can go back */
+        EXPECT_SUCCESS(s2n_stuffer_write_uint8(&stuffer, 1));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_buffer_pool_return(&stuffer), S2N_ERR_STUFFER_HAS_UNPROCESSED_DATA);
+        EXPECT_SUCCESS(s2n_stuffer_skip_read(&stuffer, 1));
+
+        EXPECT_SUCCESS(s2n_buffer_pool_return(&stuffer));
+        EXPECT_NULL(stuffer.blob.data);
+        EXPECT_SUCCESS(s2n_buffer_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 1);
+
+        /* The returned buffer was wiped and comes back first */
+        EXPECT_SUCCESS(s2n_buffer_pool_lease(&stuffer));
+        EXPECT_EQUAL(stuffer.blob.data, data);
+        EXPECT_EQUAL(data[0], '0');
+        EXPECT_EQUAL(s2n_stuffer_data_available(&stuffer), 0);
+        EXPECT_SUCCESS(s2n_buffer_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 0);
+        EXPECT_EQUAL(stats.hits, 1);
+
+        /* A buffer that has been resized is freed rather than pooled */
+        EXPECT_SUCCESS(s2n_stuffer_resize(&stuffer, S2N_BUFFER_POOL_BUFFER_SIZE * 2));
+        EXPECT_SUCCESS(s2n_buffer_pool_return(&stuffer));
+        EXPECT_NULL(stuffer.blob.data);
+        EXPECT_SUCCESS(s2n_buffer_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 0);
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&stuffer));
+    }
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+
+    EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+    EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+    EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+    EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+
+    EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    /* Connections that haven't started their handshake give up their handshake buffer straight away */
+    EXPECT_SUCCESS(s2n_connection_set_dynamic_buffers(server_conn, 1));
+    EXPECT_SUCCESS(s2n_connection_set_dynamic_buffers(client_conn, 1));
+    EXPECT_TRUE(has_no_buffers(server_conn));
+    EXPECT_TRUE(has_no_buffers(client_conn));
+
+    /* An established connection holds no buffers between calls */
+    EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+    EXPECT_TRUE(has_no_buffers(server_conn));
+    EXPECT_TRUE(has_no_buffers(client_conn));
+
+    /* A connection waiting for data doesn't hold a buffer either */
+    EXPECT_FAILURE_WITH_ERRNO(s2n_recv(client_conn, received, sizeof(received), &blocked), S2N_ERR_BLOCKED);
+    EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_READ);
+    EXPECT_TRUE(has_no_buffers(client_conn));
+
+    /* Data the application hasn't read yet keeps its buffer until it has been read */
+    {
+        EXPECT_EQUAL(s2n_send(server_conn, sent, sizeof(sent), &blocked), sizeof(sent));
+        EXPECT_TRUE(has_no_buffers(server_conn));
+
+        EXPECT_EQUAL(s2n_recv(client_conn, received, 1000, &blocked), 1000);
+        EXPECT_NOT_NULL(client_conn->in.blob.data);
+        EXPECT_EQUAL(s2n_recv(client_conn, received + 1000, sizeof(received) - 1000, &blocked), sizeof(received) - 1000);
+        EXPECT_TRUE(has_no_buffers(client_conn));
+        EXPECT_BYTEARRAY_EQUAL(received, sent, sizeof(sent));
+    }
+
+    /* Records in flight come from the pool */
+    EXPECT_SUCCESS(s2n_buffer_pool_get_stats(&stats));
+    EXPECT_TRUE(stats.hits > 0);
+    EXPECT_TRUE(stats.returns > 0);
+
+    /* So does the read-ahead buffer, as long as it fits in a pooled buffer */
+    {
+        struct s2n_buffer_pool_stats before;
+
+        EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, S2N_BUFFER_POOL_BUFFER_SIZE));
+        for (int i = 0; i < 2; i++) {
+            EXPECT_EQUAL(s2n_send(server_conn, sent, sizeof(sent), &blocked), sizeof(sent));
+
+            EXPECT_SUCCESS(s2n_buffer_pool_get_stats(&before));
+            EXPECT_EQUAL(s2n_recv(client_conn, received, sizeof(received), &blocked), sizeof(received));
+            EXPECT_BYTEARRAY_EQUAL(received, sent, sizeof(sent));
+            EXPECT_TRUE(has_no_buffers(client_conn));
+
+            /* buffer_in and in were both borrowed and returned, rather than allocated and freed */
+            EXPECT_SUCCESS(s2n_buffer_pool_get_stats(&stats));
+            EXPECT_EQUAL(stats.hits - before.hits, 2);
+            EXPECT_EQUAL(stats.misses, before.misses);
+            EXPECT_EQUAL(stats.returns - before.returns, 2);
+        }
+
+        EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, 0));
+    }
+
+    /* Wiping a connection turns dynamic buffers off again */
+    EXPECT_SUCCESS(s2n_connection_wipe(server_conn));
+    EXPECT_FALSE(server_conn->dynamic_buffers);
+    EXPECT_NOT_NULL(server_conn->handshake.io.blob.data);
+
+    EXPECT_SUCCESS(s2n_connection_free(server_conn));
+    EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+    EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+
+    /* Cleaning up the thread frees what it has pooled */
+    EXPECT_SUCCESS(s2n_buffer_pool_cleanup_thread());
+    EXPECT_SUCCESS(s2n_buffer_pool_get_stats(&stats));
+    EXPECT_EQUAL(stats.idle, 0);
+
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
@@ -136,6 +136,60 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_config_free(server_config));
     }
 
+    /* Load and add certs in bulk, using several threads */
+    {
+        struct s2n_cert_chain_and_key *certs[NUM_TIED_CERTS + 1] = { NULL };
+        const char *cert_pems[NUM_TIED_CERTS + 1];
+        const char *key_pems[NUM_TIED_CERTS + 1];
+        int tiebreak_priorites[NUM_TIED_CERTS + 1] = { 0 };
+
+        /* The default cert comes first, so that the alligator certs go through the hashmap */
+        for (unsigned int i = 0; i <= NUM_TIED_CERTS; i++) {
+            EXPECT_NOT_NULL(certs[i] = s2n_cert_chain_and_key_new());
+            cert_pems[i] = i ? alligator_cert : cert_chain;
+            key_pems[i] = i ? alligator_key : private_key;
+        }
+
+        /* A mismatched pair anywhere fails the whole load */
+        key_pems[NUM_TIED_CERTS / 2] = private_key;
+        EXPECT_FAILURE_WITH_ERRNO(s2n_cert_chain_and_key_load_pem_bulk(certs, cert_pems, key_pems, NUM_TIED_CERTS + 1, 4),
+                S2N_ERR_KEY_MISMATCH);
+        for (unsigned int i = 0; i <= NUM_TIED_CERTS; i++) {
+            EXPECT_SUCCESS(s2n_cert_chain_and_key_free(certs[i]));
+            EXPECT_NOT_NULL(certs[i] = s2n_cert_chain_and_key_new());
+        }
+        key_pems[NUM_TIED_CERTS / 2] = alligator_key;
+
+        EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem_bulk(certs, cert_pems, key_pems, NUM_TIED_CERTS + 1, 4));
+        for (unsigned int i = 0; i <= NUM_TIED_CERTS; i++) {
+            tiebreak_priorites[i] = i;
+            EXPECT_SUCCESS(s2n_cert_chain_and_key_set_ctx(certs[i], (void*) &tiebreak_priorites[i]));
+        }
+
+        EXPECT_FAILURE_WITH_ERRNO(s2n_config_add_cert_chains_and_keys_to_store(NULL, certs, NUM_TIED_CERTS + 1), S2N_ERR_NULL);
+
+        num_times_cb_executed = 0;
+        EXPECT_NOT_NULL(server_config = s2n_config_new());
+        EXPECT_SUCCESS(s2n_config_set_cert_tiebreak_callback(server_config, test_cert_tiebreak_cb));
+        EXPECT_SUCCESS(s2n_config_add_cert_chains_and_keys_to_store(server_config, certs, NUM_TIED_CERTS + 1));
+        EXPECT_EQUAL(num_times_cb_executed, NUM_TIED_CERTS - 1);
+
+        EXPECT_NOT_NULL(server_conn = create_conn(S2N_SERVER, server_config, server_to_client, client_to_server));
+        EXPECT_NOT_NULL(client_conn = create_conn(S2N_CLIENT, client_config, server_to_client, client_to_server));
+        EXPECT_SUCCESS(s2n_set_server_name(client_conn, "www.alligator.com"));
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+        EXPECT_TRUE(IS_FULL_HANDSHAKE(server_conn->handshake.handshake_type));
+        EXPECT_EQUAL(s2n_connection_get_selected_cert(server_conn), certs[NUM_TIED_CERTS]);
+        EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        for (int i = 0; i <= NUM_TIED_CERTS; i++) {
+            EXPECT_SUCCESS(s2n_cert_chain_and_key_free(certs[i]));
+        }
+        EXPECT_SUCCESS(s2n_config_free(server_config));
+    }
+
     /* Create config with deprecated s2n_config_add_cert_chain_and_key API */
     {
         EXPECT_NOT_NULL(server_config = s2n_config_new());
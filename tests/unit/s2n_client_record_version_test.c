@@ -152,8 +152,8 @@ int main(int argc, char **argv)
         EXPECT_EQUAL(s2n_errno, S2N_ERR_BLOCKED);
         EXPECT_EQUAL(client_blocked, S2N_BLOCKED_ON_READ);
 
-        /* Verify that protocol versions are TLS1.2 now */
-        EXPECT_EQUAL(client_conn->client_protocol_version, S2N_TLS12);
+        /* Verify that the negotiated protocol versions are TLS1.2 now; the test_all client also supports TLS1.3 */
+        EXPECT_EQUAL(client_conn->client_protocol_version, S2N_TLS13);
         EXPECT_EQUAL(client_conn->actual_protocol_version, S2N_TLS12);
         EXPECT_EQUAL(client_conn->server_protocol_version, S2N_TLS12);
 
@@ -294,8 +294,8 @@ int main(int argc, char **argv)
         EXPECT_EQUAL(s2n_errno, S2N_ERR_BLOCKED);
         EXPECT_EQUAL(client_blocked, S2N_BLOCKED_ON_READ);
 
-        /* Verify that protocol versions are SSLv3 with the exeption of client which supports TLS1.2 */
-        EXPECT_EQUAL(client_conn->client_protocol_version, S2N_TLS12);
+        /* Verify that protocol versions are SSLv3 with the exeption of client which supports TLS1.3 */
+        EXPECT_EQUAL(client_conn->client_protocol_version, S2N_TLS13);
         EXPECT_EQUAL(client_conn->actual_protocol_version, S2N_SSLv3);
         EXPECT_EQUAL(client_conn->server_protocol_version, S2N_SSLv3);
 
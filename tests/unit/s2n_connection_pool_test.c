@@ -0,0 +1,220 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_connection.h"
+#include "tls/s2n_connection_pool.h"
+#include "tls/s2n_tls.h"
+#include "stuffer/s2n_stuffer.h"
+
+static struct s2n_config *server_config, *client_config;
+
+static int handshake_and_release(struct s2n_connection *server_conn, struct s2n_connection *client_conn)
+{
+    struct s2n_stuffer client_to_server, server_to_client;
+    s2n_blocked_status blocked;
+    uint8_t buf[5];
+
+    GUARD(s2n_connection_set_config(server_conn, server_config));
+    GUARD(s2n_connection_set_config(client_conn, client_config));
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    GUARD(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+    eq_check(s2n_send(server_conn, "hello", 5, &blocked), 5);
+    eq_check(s2n_recv(client_conn, buf, 5, &blocked), 5);
+    eq_check(memcmp(buf, "hello", 5), 0);
+    GUARD(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+
+    GUARD(s2n_connection_pool_release(server_conn));
+    GUARD(s2n_connection_pool_release(client_conn));
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return 0;
+}
+
+/* Every thread has a pool of its own */
+static void *pool_thread(void *arg)
+{
+    struct s2n_connection_pool_stats stats;
+
+    if (s2n_connection_pool_get_stats(&stats) < 0 || stats.idle != 0 || stats.hits != 0 || stats.misses != 0) {
+        return NULL;
+    }
+
+    struct s2n_connection *conn = s2n_connection_pool_acquire(S2N_SERVER);
+    if (conn == NULL || s2n_connection_pool_release(conn) < 0) {
+        return NULL;
+    }
+
+    if (s2n_connection_pool_get_stats(&stats) < 0 || stats.idle != 1 || stats.misses != 1) {
+        return NULL;
+    }
+
+    if (s2n_cleanup() < 0) {
+        return NULL;
+    }
+
+    return arg;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_connection_pool_stats stats;
+    struct s2n_connection *server_conn, *client_conn;
+    char *cert_chain_pem;
+    char *private_key_pem;
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    /* The low watermark can't be above the high one */
+    EXPECT_FAILURE_WITH_ERRNO(s2n_connection_pool_set_watermarks(2, 1), S2N_ERR_INVALID_ARGUMENT);
+
+    EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+    EXPECT_EQUAL(stats.idle, 0);
+    EXPECT_EQUAL(stats.hits, 0);
+    EXPECT_EQUAL(stats.misses, 0);
+
+    /* An empty pool falls back to allocating a new connection */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_pool_acquire(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_pool_acquire(S2N_CLIENT));
+        EXPECT_SUCCESS(handshake_and_release(server_conn, client_conn));
+
+        EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.misses, 2);
+        EXPECT_EQUAL(stats.releases, 2);
+        EXPECT_EQUAL(stats.idle, 2);
+    }
+
+    /* Released connections are handed out again, in either mode, as good as new */
+    {
+        struct s2n_connection *first, *second;
+
+        EXPECT_NOT_NULL(first = s2n_connection_pool_acquire(S2N_SERVER));
+        EXPECT_NOT_NULL(second = s2n_connection_pool_acquire(S2N_SERVER));
+        EXPECT_TRUE((first == server_conn && second == client_conn) || (first == client_conn && second == server_conn));
+        EXPECT_EQUAL(first->mode, S2N_SERVER);
+        EXPECT_EQUAL(second->mode, S2N_SERVER);
+        EXPECT_EQUAL(first->server_protocol_version, s2n_highest_protocol_version);
+        EXPECT_EQUAL(first->actual_protocol_version, s2n_unknown_protocol_version);
+        EXPECT_NOT_NULL(first->config);
+        EXPECT_NULL(first->pool_next);
+        EXPECT_EQUAL(s2n_conn_get_current_message_type(first), CLIENT_HELLO);
+        EXPECT_EQUAL(s2n_stuffer_data_available(&first->in), 0);
+
+        /* Turn the second one into a client */
+        EXPECT_SUCCESS(s2n_connection_pool_release(second));
+        EXPECT_NOT_NULL(second = s2n_connection_pool_acquire(S2N_CLIENT));
+        EXPECT_EQUAL(second->mode, S2N_CLIENT);
+        EXPECT_EQUAL(second->client_protocol_version, s2n_highest_protocol_version);
+        EXPECT_EQUAL(second->actual_protocol_version, s2n_highest_protocol_version);
+
+        EXPECT_SUCCESS(handshake_and_release(first, second));
+
+        EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.hits, 3);
+        EXPECT_EQUAL(stats.misses, 2);
+        EXPECT_EQUAL(stats.idle, 2);
+    }
+
+    /* Connections released above the high watermark are freed */
+    {
+        EXPECT_SUCCESS(s2n_connection_pool_set_watermarks(0, 1));
+        EXPECT_SUCCESS(s2n_connection_pool_cleanup_thread());
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_pool_acquire(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_pool_acquire(S2N_CLIENT));
+        EXPECT_SUCCESS(handshake_and_release(server_conn, client_conn));
+
+        EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.frees, 1);
+        EXPECT_EQUAL(stats.idle, 1);
+    }
+
+    /* Prefilling tops the pool up to the low watermark */
+    {
+        EXPECT_SUCCESS(s2n_connection_pool_set_watermarks(4, 8));
+        EXPECT_SUCCESS(s2n_connection_pool_prefill());
+        EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 4);
+
+        /* Already full enough */
+        EXPECT_SUCCESS(s2n_connection_pool_prefill());
+        EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 4);
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_pool_acquire(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_pool_acquire(S2N_CLIENT));
+        EXPECT_SUCCESS(handshake_and_release(server_conn, client_conn));
+        EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 4);
+    }
+
+    /* Other threads don't see this thread's pool */
+    {
+        pthread_t thread;
+        void *result = NULL;
+        int marker;
+
+        EXPECT_EQUAL(pthread_create(&thread, NULL, pool_thread, &marker), 0);
+        EXPECT_EQUAL(pthread_join(thread, &result), 0);
+        EXPECT_EQUAL(result, &marker);
+
+        EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 4);
+    }
+
+    /* Pooled connections are cleaned up with the thread */
+    EXPECT_SUCCESS(s2n_connection_pool_cleanup_thread());
+    EXPECT_SUCCESS(s2n_connection_pool_get_stats(&stats));
+    EXPECT_EQUAL(stats.idle, 0);
+
+    EXPECT_SUCCESS(s2n_connection_pool_set_watermarks(S2N_DEFAULT_CONNECTION_POOL_LOW_WATERMARK, S2N_DEFAULT_CONNECTION_POOL_HIGH_WATERMARK));
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
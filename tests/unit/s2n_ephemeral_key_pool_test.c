@@ -0,0 +1,201 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_ecc.h"
+
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_ephemeral_key_pool.h"
+#include "stuffer/s2n_stuffer.h"
+
+static int try_handshake(struct s2n_config *server_config, struct s2n_config *client_config, struct s2n_cipher_suite *cipher_suite)
+{
+    struct s2n_cipher_preferences server_cipher_preferences;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+
+    /* Only offer the one cipher suite, to pick between ECDHE and DHE */
+    memcpy(&server_cipher_preferences, server_config->cipher_preferences, sizeof(server_cipher_preferences));
+    server_cipher_preferences.count = 1;
+    server_cipher_preferences.suites = &cipher_suite;
+
+    notnull_check(server_conn = s2n_connection_new(S2N_SERVER));
+    notnull_check(client_conn = s2n_connection_new(S2N_CLIENT));
+    GUARD(s2n_connection_set_config(server_conn, server_config));
+    GUARD(s2n_connection_set_config(client_conn, client_config));
+    server_conn->cipher_pref_override = &server_cipher_preferences;
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    int rc = s2n_negotiate_test_server_and_client(server_conn, client_conn);
+    if (rc == 0) {
+        eq_check(server_conn->secure.cipher_suite, cipher_suite);
+        GUARD(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+    }
+
+    GUARD(s2n_connection_free(server_conn));
+    GUARD(s2n_connection_free(client_conn));
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_ephemeral_key_pool_stats stats;
+    struct s2n_config *server_config, *client_config;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    char *dhparams_pem;
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(dhparams_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_DHPARAMS, dhparams_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    EXPECT_SUCCESS(s2n_config_add_dhparams(server_config, dhparams_pem));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    /* A TLS1.3 client would take keys from the pool for its key shares too */
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "20190214"));
+
+    EXPECT_FAILURE_WITH_ERRNO(s2n_ephemeral_key_pool_set_depth(S2N_EPHEMERAL_KEY_POOL_MAX_DEPTH + 1), S2N_ERR_INVALID_ARGUMENT);
+
+    /* The pool is off by default, and keys are generated in the handshake */
+    {
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_prefill(server_config));
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, &s2n_ecdhe_rsa_with_aes_128_gcm_sha256));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 0);
+        EXPECT_EQUAL(stats.hits, 0);
+        EXPECT_EQUAL(stats.misses, 0);
+    }
+
+    /* Prefilling stocks every curve and the config's DH group */
+    {
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_set_depth(2));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_prefill(server_config));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 2 * S2N_ECC_SUPPORTED_CURVES_COUNT + 2);
+
+        /* Already full */
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_prefill(server_config));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 2 * S2N_ECC_SUPPORTED_CURVES_COUNT + 2);
+    }
+
+    /* Handshakes take their keys from the pool, each key only once */
+    {
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, &s2n_ecdhe_rsa_with_aes_128_gcm_sha256));
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, &s2n_dhe_rsa_with_aes_128_gcm_sha256));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.hits, 2);
+        EXPECT_EQUAL(stats.misses, 0);
+        EXPECT_EQUAL(stats.idle, 2 * S2N_ECC_SUPPORTED_CURVES_COUNT);
+
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, &s2n_dhe_rsa_with_aes_128_gcm_sha256));
+        EXPECT_SUCCESS(try_handshake(server_config, client_config, &s2n_dhe_rsa_with_aes_128_gcm_sha256));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.hits, 3);
+        EXPECT_EQUAL(stats.misses, 1);
+    }
+
+    /* Pooled keys are never handed out twice */
+    {
+        struct s2n_ecc_params first = { .negotiated_curve = s2n_ecc_supported_curves[1] };
+        struct s2n_ecc_params second = { .negotiated_curve = s2n_ecc_supported_curves[1] };
+
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_prefill(server_config));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_take_ecc(&first));
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_take_ecc(&second));
+        EXPECT_NOT_NULL(first.ec_key);
+        EXPECT_NOT_NULL(second.ec_key);
+        EXPECT_NOT_EQUAL(first.ec_key, second.ec_key);
+        EXPECT_NOT_EQUAL(EC_POINT_cmp(EC_KEY_get0_group(first.ec_key), EC_KEY_get0_public_key(first.ec_key),
+                                      EC_KEY_get0_public_key(second.ec_key), NULL), 0);
+
+        EXPECT_SUCCESS(s2n_ecc_params_free(&first));
+        EXPECT_SUCCESS(s2n_ecc_params_free(&second));
+    }
+
+    /* A forked child doesn't use the keys its parent has */
+    {
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_prefill(server_config));
+
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            struct s2n_ecc_params ecc_params = { .negotiated_curve = s2n_ecc_supported_curves[0] };
+            struct s2n_ephemeral_key_pool_stats child_stats;
+
+            EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+            EXPECT_SUCCESS(s2n_ephemeral_key_pool_take_ecc(&ecc_params));
+            EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&child_stats));
+            EXPECT_EQUAL(child_stats.hits, stats.hits);
+            EXPECT_EQUAL(child_stats.misses, stats.misses + 1);
+            EXPECT_EQUAL(child_stats.idle, 0);
+            EXPECT_SUCCESS(s2n_ecc_params_free(&ecc_params));
+
+            exit(0);
+        }
+
+        int status;
+        EXPECT_EQUAL(waitpid(pid, &status, 0), pid);
+        EXPECT_EQUAL(status, 0);
+
+        EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+        EXPECT_EQUAL(stats.idle, 2 * S2N_ECC_SUPPORTED_CURVES_COUNT + 2);
+    }
+
+    /* Pooled keys are freed with the thread */
+    EXPECT_SUCCESS(s2n_ephemeral_key_pool_cleanup_thread());
+    EXPECT_SUCCESS(s2n_ephemeral_key_pool_get_stats(&stats));
+    EXPECT_EQUAL(stats.idle, 0);
+
+    EXPECT_SUCCESS(s2n_ephemeral_key_pool_set_depth(0));
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+    free(dhparams_pem);
+
+    END_TEST();
+}
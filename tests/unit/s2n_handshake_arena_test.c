@@ -0,0 +1,129 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_connection.h"
+#include "tls/s2n_handshake.h"
+#include "stuffer/s2n_stuffer.h"
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    struct s2n_config *config;
+    s2n_blocked_status blocked;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t message[] = "Application data after the handshake";
+    uint8_t received[sizeof(message)];
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(config, chain_and_key));
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(config));
+
+    /* New connections point into their handshake arena */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(server_conn->handshake_arena);
+        EXPECT_EQUAL(server_conn->initial, &server_conn->handshake_arena->initial);
+        EXPECT_EQUAL(server_conn->prf_space, &server_conn->handshake_arena->prf_space);
+        EXPECT_EQUAL(server_conn->handshake.hashes, &server_conn->handshake_arena->hashes);
+        EXPECT_EQUAL(server_conn->client, server_conn->initial);
+        EXPECT_EQUAL(server_conn->server, server_conn->initial);
+
+        /* The arena is kept if the handshake hasn't completed */
+        EXPECT_SUCCESS(s2n_connection_free_handshake(server_conn));
+        EXPECT_NOT_NULL(server_conn->handshake_arena);
+        EXPECT_NOT_NULL(server_conn->initial);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+    }
+
+    /* The arena is released after the handshake, and allocated again by wipe */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
+
+        for (int i = 0; i < 2; i++) {
+            EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+            EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+            EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+            EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+            EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+
+            EXPECT_SUCCESS(s2n_connection_free_handshake(server_conn));
+            EXPECT_SUCCESS(s2n_connection_free_handshake(client_conn));
+            EXPECT_NULL(server_conn->handshake_arena);
+            EXPECT_NULL(server_conn->initial);
+            EXPECT_NULL(server_conn->prf_space);
+            EXPECT_NULL(server_conn->handshake.hashes);
+            EXPECT_NULL(client_conn->handshake_arena);
+
+            /* Freeing the handshake twice is harmless */
+            EXPECT_SUCCESS(s2n_connection_free_handshake(server_conn));
+
+            /* Records are still protected with the secure parameters */
+            EXPECT_EQUAL(s2n_send(client_conn, message, sizeof(message), &blocked), sizeof(message));
+            EXPECT_EQUAL(s2n_recv(server_conn, received, sizeof(received), &blocked), sizeof(message));
+            EXPECT_BYTEARRAY_EQUAL(received, message, sizeof(message));
+            EXPECT_EQUAL(s2n_send(server_conn, message, sizeof(message), &blocked), sizeof(message));
+            EXPECT_EQUAL(s2n_recv(client_conn, received, sizeof(received), &blocked), sizeof(message));
+            EXPECT_BYTEARRAY_EQUAL(received, message, sizeof(message));
+
+            EXPECT_SUCCESS(s2n_connection_wipe(server_conn));
+            EXPECT_SUCCESS(s2n_connection_wipe(client_conn));
+            EXPECT_NOT_NULL(server_conn->handshake_arena);
+            EXPECT_EQUAL(server_conn->initial, &server_conn->handshake_arena->initial);
+            EXPECT_EQUAL(server_conn->client, server_conn->initial);
+            EXPECT_NOT_NULL(client_conn->handshake_arena);
+
+            EXPECT_SUCCESS(s2n_connection_set_config(server_conn, config));
+            EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
+            EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+            EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+        }
+
+        /* Connections can be freed without releasing the handshake first */
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    EXPECT_SUCCESS(s2n_config_free(config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
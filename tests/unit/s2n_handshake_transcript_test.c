@@ -0,0 +1,231 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_hash.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_handshake.h"
+#include "stuffer/s2n_stuffer.h"
+
+static int negotiate(struct s2n_connection *server_conn, struct s2n_connection *client_conn)
+{
+    struct s2n_stuffer client_to_server, server_to_client;
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    GUARD(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_config *config, *client_config;
+    char *cert_chain_pem;
+    char *private_key_pem;
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(config, chain_and_key));
+    EXPECT_SUCCESS(s2n_config_set_verification_ca_location(config, S2N_DEFAULT_TEST_CERT_CHAIN, NULL));
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(config));
+
+    /* A client without a certificate of its own */
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+
+    /* New connections buffer the transcript and don't start any hashes */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_TRUE(server_conn->handshake.transcript_buffered);
+        for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+            EXPECT_FALSE(s2n_handshake_is_hash_required(&server_conn->handshake, hash_alg));
+        }
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+    }
+
+    /* Hashes started later catch up on the buffered transcript */
+    {
+        uint8_t message[] = "ClientHello ServerHello Certificate";
+        uint8_t late[] = "ServerHelloDone";
+        struct s2n_blob message_blob = { .data = message, .size = sizeof(message) };
+        struct s2n_blob late_blob = { .data = late, .size = sizeof(late) };
+        uint8_t expected[SHA384_DIGEST_LENGTH], actual[SHA384_DIGEST_LENGTH];
+        struct s2n_hash_state hash, handshake_hash;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_stuffer_write(&server_conn->handshake.transcript, &message_blob));
+        EXPECT_SUCCESS(s2n_handshake_require_hash(&server_conn->handshake, S2N_HASH_SHA384));
+        EXPECT_TRUE(s2n_handshake_is_hash_required(&server_conn->handshake, S2N_HASH_SHA384));
+
+        EXPECT_SUCCESS(s2n_stuffer_write(&server_conn->handshake.transcript, &late_blob));
+        EXPECT_SUCCESS(s2n_hash_update(&server_conn->handshake.hashes->sha384, late, sizeof(late)));
+
+        EXPECT_SUCCESS(s2n_hash_new(&hash));
+        EXPECT_SUCCESS(s2n_hash_init(&hash, S2N_HASH_SHA384));
+        EXPECT_SUCCESS(s2n_hash_update(&hash, message, sizeof(message)));
+        EXPECT_SUCCESS(s2n_hash_update(&hash, late, sizeof(late)));
+        EXPECT_SUCCESS(s2n_hash_digest(&hash, expected, SHA384_DIGEST_LENGTH));
+
+        EXPECT_SUCCESS(s2n_handshake_get_hash_state(server_conn, S2N_HASH_SHA384, &handshake_hash));
+        EXPECT_SUCCESS(s2n_hash_copy(&hash, &handshake_hash));
+        EXPECT_SUCCESS(s2n_hash_digest(&hash, actual, SHA384_DIGEST_LENGTH));
+        EXPECT_BYTEARRAY_EQUAL(expected, actual, SHA384_DIGEST_LENGTH);
+
+        /* Getting a hash state starts it too */
+        EXPECT_SUCCESS(s2n_handshake_get_hash_state(server_conn, S2N_HASH_SHA1, &handshake_hash));
+        EXPECT_TRUE(s2n_handshake_is_hash_required(&server_conn->handshake, S2N_HASH_SHA1));
+
+        /* No hash can be started once the transcript is gone */
+        EXPECT_SUCCESS(s2n_handshake_release_transcript(&server_conn->handshake));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_handshake_require_hash(&server_conn->handshake, S2N_HASH_SHA256), S2N_ERR_HASH_NOT_READY);
+        EXPECT_SUCCESS(s2n_handshake_require_hash(&server_conn->handshake, S2N_HASH_SHA384));
+
+        EXPECT_SUCCESS(s2n_hash_free(&hash));
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+    }
+
+    /* Without client auth, only the PRF hash is kept once the hellos are done */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->actual_protocol_version, S2N_TLS12);
+
+        struct s2n_connection *conns[] = { server_conn, client_conn };
+        for (int i = 0; i < 2; i++) {
+            s2n_hash_algorithm prf_hash_alg;
+            EXPECT_SUCCESS(s2n_hmac_hash_alg(conns[i]->secure.cipher_suite->tls12_prf_alg, &prf_hash_alg));
+
+            EXPECT_FALSE(conns[i]->handshake.transcript_buffered);
+            EXPECT_EQUAL(s2n_stuffer_data_available(&conns[i]->handshake.transcript), 0);
+            for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+                EXPECT_EQUAL(s2n_handshake_is_hash_required(&conns[i]->handshake, hash_alg), hash_alg == prf_hash_alg);
+            }
+        }
+
+        /* Wiping the connection starts buffering again */
+        EXPECT_SUCCESS(s2n_connection_wipe(server_conn));
+        EXPECT_TRUE(server_conn->handshake.transcript_buffered);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* With client auth, the CertificateVerify hash is started from the transcript */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_client_auth_type(server_conn, S2N_CERT_AUTH_REQUIRED));
+        EXPECT_SUCCESS(s2n_connection_set_client_auth_type(client_conn, S2N_CERT_AUTH_REQUIRED));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_TRUE(s2n_connection_client_cert_used(server_conn));
+        EXPECT_FALSE(server_conn->handshake.transcript_buffered);
+        EXPECT_FALSE(client_conn->handshake.transcript_buffered);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* A client that sends no certificate ends the wait for CertificateVerify */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_client_auth_type(server_conn, S2N_CERT_AUTH_OPTIONAL));
+        EXPECT_SUCCESS(s2n_connection_set_client_auth_type(client_conn, S2N_CERT_AUTH_OPTIONAL));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_FALSE(s2n_connection_client_cert_used(server_conn));
+        EXPECT_FALSE(server_conn->handshake.transcript_buffered);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* TLS1.3 only ever needs the cipher suite's hash, even when the server could ask for a client certificate */
+    {
+        struct s2n_config *tls13_config;
+
+        EXPECT_NOT_NULL(tls13_config = s2n_config_new());
+        EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(tls13_config, chain_and_key));
+        EXPECT_SUCCESS(s2n_config_disable_x509_verification(tls13_config));
+        EXPECT_SUCCESS(s2n_config_set_cipher_preferences(tls13_config, "default_tls13"));
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_client_auth_type(server_conn, S2N_CERT_AUTH_OPTIONAL));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, tls13_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, tls13_config));
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->actual_protocol_version, S2N_TLS13);
+
+        struct s2n_connection *conns[] = { server_conn, client_conn };
+        for (int i = 0; i < 2; i++) {
+            s2n_hash_algorithm transcript_hash_alg;
+            EXPECT_SUCCESS(s2n_hmac_hash_alg(conns[i]->secure.cipher_suite->tls12_prf_alg, &transcript_hash_alg));
+
+            EXPECT_FALSE(conns[i]->handshake.transcript_buffered);
+            EXPECT_EQUAL(s2n_stuffer_data_available(&conns[i]->handshake.transcript), 0);
+            for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+                EXPECT_EQUAL(s2n_handshake_is_hash_required(&conns[i]->handshake, hash_alg), hash_alg == transcript_hash_alg);
+            }
+        }
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(s2n_config_free(tls13_config));
+    }
+
+    EXPECT_SUCCESS(s2n_config_free(config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
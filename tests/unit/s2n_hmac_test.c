@@ -286,5 +286,30 @@ int main(int argc, char **argv)
     /* Reference value from python */
     EXPECT_EQUAL(memcmp(output_pad, "0a834a1ed265042e2897405edb4fdd9818950cd5bea10b828f2fed45a1cb6dbd2107e4b04eb20f211998cd4e8c7e11ebdcb0103ac63882481e1bb8083d07f4be", 64 * 2), 0);
 
+    /* Balancing after a digest hashes the extra data from where the message left off in its hash block,
+     * and always hashes hash_block_size - 1 filler bytes without completing a block
+     */
+    for (int i = 0; i <= 130; i++) {
+        uint8_t data[256] = { 0 };
+        uint64_t inner_bytes, outer_bytes;
+
+        EXPECT_SUCCESS(s2n_hmac_new(&hmac));
+        EXPECT_SUCCESS(s2n_hmac_init(&hmac, S2N_HMAC_SHA1, sekrit, strlen((char *)sekrit)));
+        EXPECT_SUCCESS(s2n_hmac_update(&hmac, data, i));
+        uint32_t currently_in_hash_block = hmac.currently_in_hash_block;
+        EXPECT_EQUAL(currently_in_hash_block, i % 64);
+
+        EXPECT_SUCCESS(s2n_hmac_digest_two_compression_rounds(&hmac, digest_pad, 20));
+        EXPECT_SUCCESS(s2n_hmac_digest_balance(&hmac, currently_in_hash_block, data, 130 - i));
+
+        EXPECT_SUCCESS(s2n_hash_get_currently_in_hash_total(&hmac.inner, &inner_bytes));
+        EXPECT_SUCCESS(s2n_hash_get_currently_in_hash_total(&hmac.outer, &outer_bytes));
+        EXPECT_EQUAL(inner_bytes, currently_in_hash_block + 130 - i);
+        EXPECT_EQUAL(outer_bytes, 64 - currently_in_hash_block - 1);
+
+        EXPECT_FAILURE(s2n_hmac_digest_balance(&hmac, 64, data, 0));
+        EXPECT_SUCCESS(s2n_hmac_free(&hmac));
+    }
+
     END_TEST();
 }
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#define DATA_SIZE (64 * 1024)
+
+/* Connects a pair of non-blocking TCP sockets over loopback, where kTLS is available */
+static int loopback_pair(int *server_fd, int *client_fd)
+{
+    struct sockaddr_in addr = {0};
+    socklen_t addr_len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    gte_check(listen_fd, 0);
+    GUARD(bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)));
+    GUARD(listen(listen_fd, 1));
+    GUARD(getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len));
+
+    *client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    gte_check(*client_fd, 0);
+    GUARD(connect(*client_fd, (struct sockaddr *) &addr, sizeof(addr)));
+    *server_fd = accept(listen_fd, NULL, NULL);
+    gte_check(*server_fd, 0);
+    GUARD(close(listen_fd));
+
+    GUARD(fcntl(*server_fd, F_SETFL, fcntl(*server_fd, F_GETFL) | O_NONBLOCK));
+    GUARD(fcntl(*client_fd, F_SETFL, fcntl(*client_fd, F_GETFL) | O_NONBLOCK));
+
+    return 0;
+}
+
+/* Whether this kernel can do TLS at all */
+static int kernel_supports_ktls()
+{
+    int server_fd, client_fd;
+    GUARD(loopback_pair(&server_fd, &client_fd));
+
+    int supported = setsockopt(client_fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+
+    GUARD(close(server_fd));
+    GUARD(close(client_fd));
+
+    return supported;
+}
+
+/* Sends all of data while draining it on the other side, so neither socket buffer fills up */
+static int exchange(struct s2n_connection *sender, struct s2n_connection *receiver, uint8_t *data, uint8_t *received, uint32_t size)
+{
+    s2n_blocked_status blocked;
+    uint32_t sent = 0;
+    uint32_t recvd = 0;
+
+    while (recvd < size) {
+        if (sent < size) {
+            ssize_t w = s2n_send(sender, data + sent, size - sent, &blocked);
+            if (w < 0) {
+                eq_check(s2n_error_get_type(s2n_errno), S2N_ERR_T_BLOCKED);
+            } else {
+                sent += w;
+            }
+        }
+
+        ssize_t r = s2n_recv(receiver, received + recvd, size - recvd, &blocked);
+        if (r < 0) {
+            eq_check(s2n_error_get_type(s2n_errno), S2N_ERR_T_BLOCKED);
+        } else {
+            gt_check(r, 0);
+            recvd += r;
+        }
+    }
+
+    return memcmp(data, received, size) == 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_config *server_config, *client_config;
+    struct s2n_cert_chain_and_key *chain_and_key;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t *data, *received;
+
+    struct s2n_cipher_suite *test_suites[] = {
+        &s2n_ecdhe_rsa_with_aes_128_gcm_sha256,
+        &s2n_ecdhe_rsa_with_aes_256_gcm_sha384,
+        &s2n_ecdhe_rsa_with_chacha20_poly1305_sha256,
+    };
+
+    BEGIN_TEST();
+
+    int ktls_supported = kernel_supports_ktls();
+    EXPECT_SUCCESS(ktls_supported);
+
+    EXPECT_NOT_NULL(data = malloc(DATA_SIZE));
+    EXPECT_NOT_NULL(received = malloc(DATA_SIZE));
+    for (int i = 0; i < DATA_SIZE; i++) {
+        data[i] = i % 251;
+    }
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    const struct s2n_cipher_preferences *default_cipher_preferences = server_config->cipher_preferences;
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    /* Connections that don't use s2n managed sockets are never offloaded */
+    {
+        struct s2n_connection *server_conn, *client_conn;
+        struct s2n_stuffer client_to_server, server_to_client;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+        EXPECT_SUCCESS(s2n_connection_enable_ktls(server_conn));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+        EXPECT_EQUAL(s2n_connection_is_ktls_send_enabled(server_conn), 0);
+        EXPECT_EQUAL(s2n_connection_is_ktls_recv_enabled(server_conn), 0);
+
+        EXPECT_SUCCESS(exchange(server_conn, client_conn, data, received, DATA_SIZE));
+        EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    }
+
+    /* Offload can't be asked for once the handshake state it derives the keys from has been freed */
+    {
+        struct s2n_connection *server_conn, *client_conn;
+        int server_fd, client_fd;
+
+        EXPECT_SUCCESS(loopback_pair(&server_fd, &client_fd));
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+        EXPECT_SUCCESS(s2n_connection_set_fd(server_conn, server_fd));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+        EXPECT_SUCCESS(s2n_connection_set_fd(client_conn, client_fd));
+
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+
+        /* Straight after the handshake it still works */
+        EXPECT_SUCCESS(s2n_connection_enable_ktls(client_conn));
+        EXPECT_SUCCESS(s2n_connection_free_handshake(client_conn));
+
+        EXPECT_SUCCESS(s2n_connection_free_handshake(server_conn));
+        EXPECT_NULL(server_conn->prf_space);
+        EXPECT_FAILURE_WITH_ERRNO(s2n_connection_enable_ktls(server_conn), S2N_ERR_KTLS_HANDSHAKE_FREED);
+        EXPECT_EQUAL(s2n_connection_is_ktls_send_enabled(server_conn), 0);
+        EXPECT_EQUAL(s2n_connection_is_ktls_recv_enabled(server_conn), 0);
+
+        /* s2n carries on protecting the records itself */
+        EXPECT_SUCCESS(exchange(server_conn, client_conn, data, received, DATA_SIZE));
+        EXPECT_SUCCESS(exchange(client_conn, server_conn, data, received, DATA_SIZE));
+        EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(close(server_fd));
+        EXPECT_SUCCESS(close(client_fd));
+    }
+
+    for (int i = 0; i < sizeof(test_suites) / sizeof(test_suites[0]); i++) {
+        struct s2n_cipher_suite *cur_cipher = test_suites[i];
+        struct s2n_cipher_preferences server_cipher_preferences;
+
+        if (!cur_cipher->available) {
+            /* Skip Ciphers that aren't supported with the linked libcrypto */
+            continue;
+        }
+
+        memcpy(&server_cipher_preferences, default_cipher_preferences, sizeof(server_cipher_preferences));
+        server_cipher_preferences.count = 1;
+        server_cipher_preferences.suites = &cur_cipher;
+        server_config->cipher_preferences = &server_cipher_preferences;
+
+        /* Offload on the server only, then on both ends, so kernel records are checked against s2n's own */
+        for (int client_ktls = 0; client_ktls <= 1; client_ktls++) {
+            struct s2n_connection *server_conn, *client_conn;
+            s2n_blocked_status blocked;
+            int server_fd, client_fd;
+
+            EXPECT_SUCCESS(loopback_pair(&server_fd, &client_fd));
+
+            EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+            EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+            EXPECT_SUCCESS(s2n_connection_set_fd(server_conn, server_fd));
+            EXPECT_SUCCESS(s2n_connection_enable_ktls(server_conn));
+
+            EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+            EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+            EXPECT_SUCCESS(s2n_connection_set_fd(client_conn, client_fd));
+            if (client_ktls) {
+                EXPECT_SUCCESS(s2n_connection_enable_ktls(client_conn));
+            }
+
+            EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+            EXPECT_EQUAL(server_conn->secure.cipher_suite, cur_cipher);
+
+            /* Without kernel support the connection quietly stays in user space */
+            EXPECT_EQUAL(s2n_connection_is_ktls_send_enabled(server_conn), ktls_supported);
+            EXPECT_EQUAL(s2n_connection_is_ktls_recv_enabled(server_conn), ktls_supported);
+            EXPECT_EQUAL(s2n_connection_is_ktls_send_enabled(client_conn), ktls_supported && client_ktls);
+            EXPECT_EQUAL(s2n_connection_is_ktls_recv_enabled(client_conn), ktls_supported && client_ktls);
+
+            /* Records flow both ways, with sequence numbers carried over from the handshake */
+            EXPECT_SUCCESS(exchange(server_conn, client_conn, data, received, DATA_SIZE));
+            EXPECT_SUCCESS(exchange(client_conn, server_conn, data, received, DATA_SIZE));
+            EXPECT_SUCCESS(exchange(server_conn, client_conn, data, received, 1));
+
+            /* In place sends are not available once the kernel frames records */
+            if (s2n_connection_is_ktls_send_enabled(server_conn)) {
+                uint8_t *buf;
+                uint32_t size;
+                EXPECT_FAILURE_WITH_ERRNO(s2n_send_reserve(server_conn, &buf, &size, &blocked), S2N_ERR_SEND_RESERVE);
+            }
+
+            /* close_notify alerts are exchanged as control records */
+            EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+
+            EXPECT_SUCCESS(s2n_connection_free(server_conn));
+            EXPECT_SUCCESS(s2n_connection_free(client_conn));
+            EXPECT_SUCCESS(close(server_fd));
+            EXPECT_SUCCESS(close(client_fd));
+        }
+    }
+
+    server_config->cipher_preferences = default_cipher_preferences;
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+    free(data);
+    free(received);
+
+    END_TEST();
+}
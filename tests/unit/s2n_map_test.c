@@ -19,6 +19,12 @@
 #include <string.h>
 
 #include "utils/s2n_map.h"
+#include "utils/s2n_map_internal.h"
+
+struct test_value {
+    uint64_t counter;
+    uint8_t padding[40];
+};
 
 int main(int argc, char **argv)
 {
@@ -169,5 +175,116 @@ int main(int argc, char **argv)
 
     EXPECT_SUCCESS(s2n_map_free(map));
 
+    /* Keys and values too big to sit in the table are stored out of line, and can replace inline ones */
+    {
+        uint8_t long_key[100];
+        struct test_value value = {0};
+        struct test_value *stored;
+
+        EXPECT_NOT_NULL(map = s2n_map_new_with_initial_capacity(3));
+        EXPECT_EQUAL(map->capacity, 4);
+
+        for (int i = 0; i < 256; i++) {
+            memset(long_key, i, sizeof(long_key));
+            value.counter = i;
+
+            key.data = long_key;
+            key.size = 1 + (i % sizeof(long_key));
+            val.data = (void *) &value;
+            val.size = sizeof(value);
+            EXPECT_SUCCESS(s2n_map_add(map, &key, &val));
+
+            /* Every other key is replaced by a value that fits inline */
+            if (i % 2) {
+                val.data = (void *) "small";
+                val.size = sizeof("small");
+                EXPECT_SUCCESS(s2n_map_put(map, &key, &val));
+            }
+        }
+
+        /* The table grows before it gets more than three quarters full */
+        EXPECT_EQUAL(map->size, 256);
+        EXPECT_TRUE(map->size * 4 <= map->capacity * 3);
+
+        EXPECT_SUCCESS(s2n_map_complete(map));
+
+        for (int i = 0; i < 256; i++) {
+            memset(long_key, i, sizeof(long_key));
+            key.data = long_key;
+            key.size = 1 + (i % sizeof(long_key));
+            EXPECT_EQUAL(s2n_map_lookup(map, &key, &val), 1);
+
+            if (i % 2) {
+                EXPECT_EQUAL(val.size, sizeof("small"));
+                EXPECT_SUCCESS(memcmp(val.data, "small", sizeof("small")));
+                continue;
+            }
+
+            /* Values are aligned, and can be updated in place */
+            EXPECT_EQUAL(val.size, sizeof(struct test_value));
+            EXPECT_EQUAL((uintptr_t) val.data % sizeof(uint64_t), 0);
+            stored = (struct test_value *)(void *) val.data;
+            EXPECT_EQUAL(stored->counter, i);
+            stored->counter += 1000;
+        }
+
+        for (int i = 0; i < 256; i += 2) {
+            memset(long_key, i, sizeof(long_key));
+            key.data = long_key;
+            key.size = 1 + (i % sizeof(long_key));
+            EXPECT_EQUAL(s2n_map_lookup(map, &key, &val), 1);
+            stored = (struct test_value *)(void *) val.data;
+            EXPECT_EQUAL(stored->counter, i + 1000);
+        }
+
+        /* A prefix of a stored key is a different key */
+        memset(long_key, 2, sizeof(long_key));
+        key.data = long_key;
+        key.size = 2;
+        EXPECT_EQUAL(s2n_map_lookup(map, &key, &val), 0);
+
+        EXPECT_SUCCESS(s2n_map_free(map));
+    }
+
+    /* Reserving space up front means the table isn't rebuilt while it fills */
+    {
+        EXPECT_NOT_NULL(map = s2n_map_new_with_initial_capacity(1));
+        EXPECT_SUCCESS(s2n_map_reserve(map, 1000));
+        uint32_t capacity = map->capacity;
+        EXPECT_TRUE(capacity * 3 >= 1000 * 4);
+
+        for (int i = 0; i < 1000; i++) {
+            snprintf(keystr, sizeof(keystr), "%04x", i);
+            snprintf(valstr, sizeof(valstr), "%05d", i);
+            key.data = (void *) keystr;
+            key.size = strlen(keystr) + 1;
+            val.data = (void *) valstr;
+            val.size = strlen(valstr) + 1;
+            EXPECT_SUCCESS(s2n_map_add(map, &key, &val));
+        }
+        EXPECT_EQUAL(map->capacity, capacity);
+
+        /* Reserving no more than there is room for leaves the table as it is */
+        EXPECT_SUCCESS(s2n_map_reserve(map, 0));
+        EXPECT_EQUAL(map->capacity, capacity);
+
+        /* A complete map can't grow */
+        EXPECT_SUCCESS(s2n_map_complete(map));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_map_reserve(map, 1000), S2N_ERR_MAP_IMMUTABLE);
+
+        EXPECT_SUCCESS(s2n_map_free(map));
+    }
+
+    /* Two maps hash keys differently */
+    {
+        struct s2n_map *other;
+
+        EXPECT_NOT_NULL(map = s2n_map_new_with_initial_capacity(16));
+        EXPECT_NOT_NULL(other = s2n_map_new_with_initial_capacity(16));
+        EXPECT_NOT_EQUAL(memcmp(map->hash_key, other->hash_key, sizeof(map->hash_key)), 0);
+        EXPECT_SUCCESS(s2n_map_free(map));
+        EXPECT_SUCCESS(s2n_map_free(other));
+    }
+
     END_TEST();
 }
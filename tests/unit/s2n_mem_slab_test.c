@@ -0,0 +1,200 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "utils/s2n_mem.h"
+#include "utils/s2n_mem_slab.h"
+
+#define ALLOCATIONS 1000
+#define THREADS 4
+
+struct test_object {
+    uint64_t a;
+    uint8_t b[40];
+};
+
+static void *alloc_and_free(void *arg)
+{
+    struct s2n_blob blobs[ALLOCATIONS] = {{0}};
+
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < ALLOCATIONS; i++) {
+            if (s2n_alloc(&blobs[i], 1 + (i % 300)) < 0) {
+                return NULL;
+            }
+            memset(blobs[i].data, round, blobs[i].size);
+        }
+        for (int i = 0; i < ALLOCATIONS; i++) {
+            for (int j = 0; j < blobs[i].size; j++) {
+                if (blobs[i].data[j] != round) {
+                    return NULL;
+                }
+            }
+            if (s2n_free(&blobs[i]) < 0) {
+                return NULL;
+            }
+        }
+    }
+
+    return arg;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_mem_stats before, after;
+    struct s2n_blob blob = {0};
+
+    BEGIN_TEST();
+
+    if (getenv("S2N_DONT_MLOCK") || getenv("S2N_DONT_SLAB")) {
+        /* Slabs are only used for locked memory */
+        END_TEST();
+    }
+
+    /* Small allocations are carved out of a slab, rounded up to their size class */
+    {
+        EXPECT_SUCCESS(s2n_mem_get_stats(&before));
+        EXPECT_SUCCESS(s2n_alloc(&blob, 100));
+        EXPECT_EQUAL(blob.size, 100);
+        EXPECT_EQUAL(blob.allocated, 128);
+        EXPECT_EQUAL(blob.mlocked, 1);
+        EXPECT_EQUAL((uintptr_t) blob.data % 128, 0);
+
+        EXPECT_SUCCESS(s2n_mem_get_stats(&after));
+        EXPECT_EQUAL(after.slab_bytes_in_use, before.slab_bytes_in_use + 128);
+        EXPECT_EQUAL(after.bytes_in_use, before.bytes_in_use + 128);
+        EXPECT_TRUE(after.slab_bytes_reserved >= after.slab_bytes_in_use);
+
+        EXPECT_SUCCESS(s2n_free(&blob));
+        EXPECT_NULL(blob.data);
+        EXPECT_SUCCESS(s2n_mem_get_stats(&after));
+        EXPECT_EQUAL(after.slab_bytes_in_use, before.slab_bytes_in_use);
+        EXPECT_EQUAL(after.bytes_in_use, before.bytes_in_use);
+    }
+
+    /* Freed chunks are wiped and handed out again */
+    {
+        uint8_t *data;
+
+        EXPECT_SUCCESS(s2n_alloc(&blob, 64));
+        memset(blob.data, 0xff, 64);
+        data = blob.data;
+
+        /* Shrinking keeps the chunk, but all of it is wiped on free */
+        EXPECT_SUCCESS(s2n_realloc(&blob, 10));
+        EXPECT_EQUAL(blob.data, data);
+        EXPECT_SUCCESS(s2n_free(&blob));
+
+        EXPECT_SUCCESS(s2n_alloc(&blob, 64));
+        EXPECT_EQUAL(blob.data, data);
+        for (int i = 0; i < 64; i++) {
+            EXPECT_EQUAL(blob.data[i], 0);
+        }
+
+        /* Growing into a bigger class keeps the contents */
+        memset(blob.data, 'a', 64);
+        EXPECT_SUCCESS(s2n_realloc(&blob, 1000));
+        EXPECT_EQUAL(blob.allocated, 1024);
+        for (int i = 0; i < 64; i++) {
+            EXPECT_EQUAL(blob.data[i], 'a');
+        }
+        EXPECT_SUCCESS(s2n_free(&blob));
+    }
+
+    /* Objects freed by size alone go back to the right class */
+    {
+        struct test_object *object;
+
+        EXPECT_SUCCESS(s2n_mem_get_stats(&before));
+        EXPECT_SUCCESS(s2n_alloc(&blob, sizeof(struct test_object)));
+        object = (struct test_object *)(void *) blob.data;
+        object->a = 1;
+
+        EXPECT_SUCCESS(s2n_free_object((uint8_t **) &object, sizeof(struct test_object)));
+        EXPECT_NULL(object);
+        EXPECT_SUCCESS(s2n_mem_get_stats(&after));
+        EXPECT_EQUAL(after.slab_bytes_in_use, before.slab_bytes_in_use);
+        EXPECT_EQUAL(after.bytes_in_use, before.bytes_in_use);
+    }
+
+    /* Many allocations share a few locked slabs */
+    {
+        struct s2n_blob blobs[ALLOCATIONS] = {{0}};
+
+        EXPECT_SUCCESS(s2n_mem_get_stats(&before));
+        for (int i = 0; i < ALLOCATIONS; i++) {
+            EXPECT_SUCCESS(s2n_alloc(&blobs[i], 100));
+        }
+
+        EXPECT_SUCCESS(s2n_mem_get_stats(&after));
+        EXPECT_EQUAL(after.slab_bytes_in_use, before.slab_bytes_in_use + ALLOCATIONS * 128);
+        EXPECT_TRUE(after.slab_bytes_reserved - before.slab_bytes_reserved <= ((ALLOCATIONS * 128) / S2N_SLAB_SIZE + 1) * S2N_SLAB_SIZE);
+        EXPECT_EQUAL(after.mlock_failures, before.mlock_failures);
+
+        for (int i = 0; i < ALLOCATIONS; i++) {
+            EXPECT_SUCCESS(s2n_free(&blobs[i]));
+        }
+
+        /* The slabs are kept for the next allocations */
+        EXPECT_SUCCESS(s2n_mem_get_stats(&before));
+        EXPECT_EQUAL(before.slab_bytes_reserved, after.slab_bytes_reserved);
+        EXPECT_EQUAL(before.slab_bytes_in_use, after.slab_bytes_in_use - ALLOCATIONS * 128);
+    }
+
+    /* Large allocations still get pages of their own */
+    {
+        EXPECT_SUCCESS(s2n_mem_get_stats(&before));
+        EXPECT_SUCCESS(s2n_alloc(&blob, S2N_SLAB_MAX_CHUNK + 1));
+        EXPECT_EQUAL(blob.mlocked, 1);
+        EXPECT_EQUAL(blob.allocated % 4096, 0);
+
+        EXPECT_SUCCESS(s2n_mem_get_stats(&after));
+        EXPECT_EQUAL(after.slab_bytes_in_use, before.slab_bytes_in_use);
+        EXPECT_EQUAL(after.bytes_in_use, before.bytes_in_use + blob.allocated);
+
+        EXPECT_SUCCESS(s2n_free(&blob));
+        EXPECT_SUCCESS(s2n_mem_get_stats(&after));
+        EXPECT_EQUAL(after.bytes_in_use, before.bytes_in_use);
+    }
+
+    /* Threads can share the slabs */
+    {
+        pthread_t threads[THREADS];
+        int marker;
+
+        EXPECT_SUCCESS(s2n_mem_get_stats(&before));
+        for (int i = 0; i < THREADS; i++) {
+            EXPECT_EQUAL(pthread_create(&threads[i], NULL, alloc_and_free, &marker), 0);
+        }
+        for (int i = 0; i < THREADS; i++) {
+            void *result = NULL;
+            EXPECT_EQUAL(pthread_join(threads[i], &result), 0);
+            EXPECT_EQUAL(result, &marker);
+        }
+
+        EXPECT_SUCCESS(s2n_mem_get_stats(&after));
+        EXPECT_EQUAL(after.slab_bytes_in_use, before.slab_bytes_in_use);
+        EXPECT_EQUAL(after.bytes_in_use, before.bytes_in_use);
+    }
+
+    END_TEST();
+}
@@ -20,9 +20,12 @@
 
 #include <s2n.h>
 
+#include "stuffer/s2n_stuffer.h"
 #include "utils/s2n_safety.h"
 #include "testlib/s2n_testlib.h"
 
+#define S2N_PEM_BUNDLE_COPIES 500
+
 static const char *valid_pem_pairs[][2] = {
     { S2N_RSA_2048_PKCS8_CERT_CHAIN,          S2N_RSA_2048_PKCS8_KEY },
     { S2N_RSA_2048_PKCS1_CERT_CHAIN,          S2N_RSA_2048_PKCS1_KEY },
@@ -85,6 +88,43 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
     }
 
+    /* A large bundle of certificates decodes to the same DER as the individual chains */
+    {
+        struct s2n_stuffer chain_pem, bundle_pem, expected_der, bundle_der;
+
+        EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+        EXPECT_SUCCESS(s2n_stuffer_alloc_ro_from_string(&chain_pem, cert_chain_pem));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&expected_der, 0));
+        int certs_in_chain = 0;
+        while (s2n_stuffer_certificate_from_pem(&chain_pem, &expected_der) == 0) {
+            certs_in_chain++;
+        }
+        EXPECT_TRUE(certs_in_chain > 0);
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&bundle_pem, 0));
+        for (int i = 0; i < S2N_PEM_BUNDLE_COPIES; i++) {
+            EXPECT_SUCCESS(s2n_stuffer_write_bytes(&bundle_pem, (uint8_t *) cert_chain_pem, strlen(cert_chain_pem)));
+        }
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&bundle_der, 0));
+        int certs_in_bundle = 0;
+        while (s2n_stuffer_certificate_from_pem(&bundle_pem, &bundle_der) == 0) {
+            certs_in_bundle++;
+        }
+        EXPECT_EQUAL(certs_in_bundle, certs_in_chain * S2N_PEM_BUNDLE_COPIES);
+
+        uint32_t expected_size = s2n_stuffer_data_available(&expected_der);
+        EXPECT_EQUAL(s2n_stuffer_data_available(&bundle_der), expected_size * S2N_PEM_BUNDLE_COPIES);
+        for (int i = 0; i < S2N_PEM_BUNDLE_COPIES; i++) {
+            EXPECT_BYTEARRAY_EQUAL(bundle_der.blob.data + i * expected_size, expected_der.blob.data, expected_size);
+        }
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&chain_pem));
+        EXPECT_SUCCESS(s2n_stuffer_free(&bundle_pem));
+        EXPECT_SUCCESS(s2n_stuffer_free(&expected_der));
+        EXPECT_SUCCESS(s2n_stuffer_free(&bundle_der));
+    }
+
     free(cert_chain_pem);
     free(private_key_pem);
     END_TEST();
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_connection.h"
+#include "tls/s2n_perf.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define CLOCK_STEP 1000
+
+static uint64_t fake_time = 0;
+
+static int fake_clock(void *ctx, uint64_t *nanoseconds)
+{
+    fake_time += CLOCK_STEP;
+    *nanoseconds = fake_time;
+
+    return 0;
+}
+
+static struct s2n_config *server_config, *client_config;
+
+static int handshake_and_send(struct s2n_connection *server_conn, struct s2n_connection *client_conn, ssize_t size)
+{
+    struct s2n_stuffer client_to_server, server_to_client;
+    s2n_blocked_status blocked;
+    uint8_t buf[1024] = { 0 };
+
+    GUARD(s2n_connection_set_config(server_conn, server_config));
+    GUARD(s2n_connection_set_config(client_conn, client_config));
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    GUARD(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+    eq_check(s2n_send(server_conn, buf, size, &blocked), size);
+    eq_check(s2n_recv(client_conn, buf, size, &blocked), size);
+
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return 0;
+}
+
+static void *count_in_thread(void *arg)
+{
+    struct s2n_connection *server_conn = s2n_connection_new(S2N_SERVER);
+    struct s2n_connection *client_conn = s2n_connection_new(S2N_CLIENT);
+
+    if (server_conn == NULL || client_conn == NULL || handshake_and_send(server_conn, client_conn, 10) < 0) {
+        return NULL;
+    }
+
+    if (s2n_connection_free(server_conn) < 0 || s2n_connection_free(client_conn) < 0 || s2n_cleanup() < 0) {
+        return NULL;
+    }
+
+    return arg;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_connection_perf_stats stats;
+    struct s2n_perf_counters totals, suite;
+    char *cert_chain_pem;
+    char *private_key_pem;
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    /* Nothing is counted unless the config asks for it */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(handshake_and_send(server_conn, client_conn, 100));
+
+        EXPECT_SUCCESS(s2n_connection_get_perf_stats(server_conn, &stats));
+        EXPECT_EQUAL(stats.counters.handshakes, 0);
+        EXPECT_EQUAL(stats.counters.records_out, 0);
+        EXPECT_EQUAL(stats.counters.io_calls, 0);
+        EXPECT_EQUAL(stats.handshake_message_count, 0);
+
+        EXPECT_SUCCESS(s2n_perf_get_stats(&totals));
+        EXPECT_EQUAL(totals.handshakes, 0);
+        EXPECT_EQUAL(totals.io_calls, 0);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    EXPECT_SUCCESS(s2n_config_set_perf_counters(server_config, 1));
+    EXPECT_SUCCESS(s2n_config_set_perf_counters(client_config, 1));
+    EXPECT_SUCCESS(s2n_config_set_monotonic_clock(server_config, fake_clock, NULL));
+    EXPECT_SUCCESS(s2n_config_set_monotonic_clock(client_config, fake_clock, NULL));
+
+    /* Connections record a timeline of their handshake and count their records and I/O */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(handshake_and_send(server_conn, client_conn, 100));
+
+        EXPECT_SUCCESS(s2n_connection_get_perf_stats(server_conn, &stats));
+        EXPECT_EQUAL(stats.counters.handshakes, 1);
+        EXPECT_TRUE(stats.counters.handshake_ns > 0);
+        EXPECT_TRUE(stats.counters.handshake_handler_ns > 0);
+        EXPECT_TRUE(stats.counters.handshake_handler_ns < stats.counters.handshake_ns);
+
+        /* The timeline ends with the last message before application data */
+        EXPECT_TRUE(stats.handshake_message_count > 2);
+        EXPECT_STRING_EQUAL(stats.handshake_messages[0].message, "CLIENT_HELLO");
+        EXPECT_STRING_EQUAL(stats.handshake_messages[stats.handshake_message_count - 1].message,
+                s2n_connection_is_session_resumed(server_conn) ? "CLIENT_FINISHED" : "SERVER_FINISHED");
+        EXPECT_EQUAL(stats.handshake_messages[stats.handshake_message_count - 1].elapsed_ns, stats.counters.handshake_ns - CLOCK_STEP);
+        for (int i = 1; i < stats.handshake_message_count; i++) {
+            EXPECT_TRUE(stats.handshake_messages[i].elapsed_ns > stats.handshake_messages[i - 1].elapsed_ns);
+        }
+
+        /* Only the records after the change of cipher spec are encrypted */
+        EXPECT_TRUE(stats.counters.records_out >= 3);
+        EXPECT_TRUE(stats.counters.records_in >= 3);
+        EXPECT_TRUE(stats.counters.bytes_encrypted > 100);
+        EXPECT_TRUE(stats.counters.bytes_decrypted > 0);
+        EXPECT_TRUE(stats.counters.record_crypto_ns > 0);
+
+        /* Reads run into the empty stuffer while the peer hasn't written yet */
+        EXPECT_TRUE(stats.counters.io_calls > 0);
+        EXPECT_TRUE(stats.counters.io_blocked > 0);
+        EXPECT_TRUE(stats.counters.io_blocked < stats.counters.io_calls);
+        EXPECT_EQUAL(stats.counters.io_ns, stats.counters.io_calls * CLOCK_STEP);
+
+        /* The client received the 100 bytes the server sent */
+        EXPECT_SUCCESS(s2n_connection_get_perf_stats(client_conn, &stats));
+        EXPECT_EQUAL(stats.counters.handshakes, 1);
+        EXPECT_STRING_EQUAL(stats.handshake_messages[0].message, "CLIENT_HELLO");
+        EXPECT_TRUE(stats.counters.bytes_decrypted > 100);
+
+        /* Wiping the connection starts its counters over */
+        EXPECT_SUCCESS(s2n_connection_wipe(server_conn));
+        EXPECT_SUCCESS(s2n_connection_get_perf_stats(server_conn, &stats));
+        EXPECT_EQUAL(stats.counters.handshakes, 0);
+        EXPECT_EQUAL(stats.counters.io_calls, 0);
+        EXPECT_EQUAL(stats.handshake_message_count, 0);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* Threads add up to the global counters, which are also kept per cipher suite */
+    {
+        const char *cipher;
+
+        EXPECT_SUCCESS(s2n_perf_get_stats(&totals));
+        EXPECT_EQUAL(totals.handshakes, 2);
+        EXPECT_TRUE(totals.io_calls > 0);
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(handshake_and_send(server_conn, client_conn, 10));
+        EXPECT_NOT_NULL(cipher = s2n_connection_get_cipher(server_conn));
+
+        /* The handshakes only count once the suite is known */
+        EXPECT_SUCCESS(s2n_perf_get_cipher_suite_stats(cipher, &suite));
+        EXPECT_EQUAL(suite.handshakes, 4);
+        EXPECT_TRUE(suite.bytes_encrypted > 110);
+
+        pthread_t thread;
+        void *result = NULL;
+        int marker;
+
+        EXPECT_EQUAL(pthread_create(&thread, NULL, count_in_thread, &marker), 0);
+        EXPECT_EQUAL(pthread_join(thread, &result), 0);
+        EXPECT_EQUAL(result, &marker);
+
+        /* The thread cleaned up, but what it counted is kept */
+        EXPECT_SUCCESS(s2n_perf_get_stats(&totals));
+        EXPECT_EQUAL(totals.handshakes, 6);
+        EXPECT_SUCCESS(s2n_perf_get_cipher_suite_stats(cipher, &suite));
+        EXPECT_EQUAL(suite.handshakes, 6);
+        EXPECT_TRUE(suite.io_calls < totals.io_calls);
+
+        EXPECT_FAILURE_WITH_ERRNO(s2n_perf_get_cipher_suite_stats("NOT-A-CIPHER", &suite), S2N_ERR_CIPHER_NOT_SUPPORTED);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define RECORD_PAYLOAD_SIZE 1000
+
+static int recv_calls = 0;
+static uint32_t recv_budget = UINT32_MAX;
+
+/* Like the testlib stuffer reader, but counts calls and can hold data back */
+static int counting_read(void *io_context, uint8_t *buf, uint32_t len)
+{
+    struct s2n_stuffer *in = (struct s2n_stuffer *) io_context;
+
+    recv_calls++;
+
+    uint32_t n = s2n_stuffer_data_available(in);
+    n = (len < n) ? len : n;
+    n = (recv_budget < n) ? recv_budget : n;
+    if (n == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    GUARD(s2n_stuffer_read_bytes(in, buf, n));
+    if (recv_budget != UINT32_MAX) {
+        recv_budget -= n;
+    }
+    return n;
+}
+
+static int send_records(struct s2n_connection *conn, uint8_t *data, int count)
+{
+    s2n_blocked_status blocked;
+
+    for (int i = 0; i < count; i++) {
+        eq_check(s2n_send(conn, data + i * RECORD_PAYLOAD_SIZE, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_config *server_config, *client_config;
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    s2n_blocked_status blocked;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t sent[3 * RECORD_PAYLOAD_SIZE];
+    uint8_t received[3 * RECORD_PAYLOAD_SIZE];
+
+    BEGIN_TEST();
+
+    for (int i = 0; i < sizeof(sent); i++) {
+        sent[i] = i % 251;
+    }
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+
+    EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+    EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+    EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+    EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+
+    EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    /* Read-ahead is bounded, so a connection can't be made to buffer arbitrary amounts of data */
+    EXPECT_FAILURE_WITH_ERRNO(s2n_connection_set_read_ahead(client_conn, S2N_MAX_READ_AHEAD_LENGTH + 1), S2N_ERR_INVALID_READ_AHEAD_SIZE);
+    EXPECT_FAILURE_WITH_ERRNO(s2n_connection_set_read_ahead(client_conn, UINT32_MAX), S2N_ERR_INVALID_READ_AHEAD_SIZE);
+    EXPECT_EQUAL(client_conn->read_ahead_size, 0);
+    EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, S2N_MAX_READ_AHEAD_LENGTH));
+    EXPECT_EQUAL(client_conn->read_ahead_size, S2N_MAX_READ_AHEAD_LENGTH);
+
+    /* The handshake works through the read-ahead buffer too */
+    EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, S2N_LARGE_RECORD_LENGTH));
+    EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+    EXPECT_EQUAL(s2n_peek_buffered(client_conn), 0);
+
+    EXPECT_SUCCESS(s2n_connection_set_recv_cb(client_conn, counting_read));
+
+    /* Several complete records are drained with a single read */
+    {
+        EXPECT_SUCCESS(send_records(server_conn, sent, 3));
+
+        recv_calls = 0;
+        EXPECT_EQUAL(s2n_recv(client_conn, received, sizeof(received), &blocked), sizeof(received));
+        EXPECT_EQUAL(recv_calls, 1);
+        EXPECT_EQUAL(blocked, S2N_NOT_BLOCKED);
+        EXPECT_BYTEARRAY_EQUAL(received, sent, sizeof(sent));
+        EXPECT_EQUAL(s2n_peek_buffered(client_conn), 0);
+    }
+
+    /* Records that don't fit in the caller's buffer stay queued */
+    {
+        EXPECT_SUCCESS(send_records(server_conn, sent, 2));
+
+        recv_calls = 0;
+        EXPECT_EQUAL(s2n_recv(client_conn, received, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+        EXPECT_EQUAL(recv_calls, 1);
+        EXPECT_TRUE(s2n_peek_buffered(client_conn) > RECORD_PAYLOAD_SIZE);
+        EXPECT_EQUAL(s2n_stuffer_data_available(&server_to_client), 0);
+
+        EXPECT_EQUAL(s2n_recv(client_conn, received + RECORD_PAYLOAD_SIZE, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+        EXPECT_EQUAL(recv_calls, 1);
+        EXPECT_BYTEARRAY_EQUAL(received, sent, 2 * RECORD_PAYLOAD_SIZE);
+        EXPECT_EQUAL(s2n_peek_buffered(client_conn), 0);
+    }
+
+    /* A partial record is carried over to the next call */
+    {
+        EXPECT_SUCCESS(send_records(server_conn, sent, 1));
+        uint32_t record_size = s2n_stuffer_data_available(&server_to_client);
+
+        recv_budget = record_size - 10;
+        EXPECT_FAILURE_WITH_ERRNO(s2n_recv(client_conn, received, sizeof(received), &blocked), S2N_ERR_BLOCKED);
+        EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_READ);
+        EXPECT_EQUAL(s2n_peek_buffered(client_conn), record_size - 10);
+
+        recv_budget = UINT32_MAX;
+        EXPECT_EQUAL(s2n_recv(client_conn, received, sizeof(received), &blocked), RECORD_PAYLOAD_SIZE);
+        EXPECT_BYTEARRAY_EQUAL(received, sent, RECORD_PAYLOAD_SIZE);
+        EXPECT_EQUAL(s2n_peek_buffered(client_conn), 0);
+    }
+
+    /* Without read-ahead each record costs a header read and a body read */
+    {
+        EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, 0));
+        EXPECT_SUCCESS(send_records(server_conn, sent, 2));
+
+        recv_calls = 0;
+        EXPECT_EQUAL(s2n_recv(client_conn, received, sizeof(received), &blocked), RECORD_PAYLOAD_SIZE);
+        EXPECT_EQUAL(recv_calls, 2);
+        EXPECT_EQUAL(s2n_peek_buffered(client_conn), 0);
+        EXPECT_EQUAL(s2n_recv(client_conn, received + RECORD_PAYLOAD_SIZE, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+        EXPECT_EQUAL(recv_calls, 4);
+        EXPECT_BYTEARRAY_EQUAL(received, sent, 2 * RECORD_PAYLOAD_SIZE);
+    }
+
+    /* Buffers can't be released while read-ahead data is pending */
+    {
+        EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, S2N_LARGE_RECORD_LENGTH));
+        EXPECT_SUCCESS(send_records(server_conn, sent, 2));
+        EXPECT_EQUAL(s2n_recv(client_conn, received, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+        EXPECT_FAILURE(s2n_connection_release_buffers(client_conn));
+
+        EXPECT_EQUAL(s2n_recv(client_conn, received, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+        EXPECT_SUCCESS(s2n_connection_release_buffers(client_conn));
+    }
+
+    EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+
+    EXPECT_SUCCESS(s2n_connection_free(server_conn));
+    EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+    EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define RECORD_PAYLOAD_SIZE 1000
+
+/* The plaintext is wiped from conn->in after it has been copied out, the ciphertext is not */
+static int ciphertext_left_in(struct s2n_connection *conn)
+{
+    for (int i = 0; i < RECORD_PAYLOAD_SIZE; i++) {
+        if (conn->in.blob.data[i] != '0') {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_config *server_config, *client_config;
+    struct s2n_cert_chain_and_key *chain_and_key;
+    s2n_blocked_status blocked;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t sent[3 * RECORD_PAYLOAD_SIZE];
+    uint8_t received[3 * RECORD_PAYLOAD_SIZE];
+
+    struct s2n_cipher_suite *test_suites[] = {
+        &s2n_ecdhe_rsa_with_aes_128_gcm_sha256,
+        &s2n_ecdhe_rsa_with_chacha20_poly1305_sha256,
+    };
+
+    BEGIN_TEST();
+
+    for (int i = 0; i < sizeof(sent); i++) {
+        sent[i] = i % 251;
+    }
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    const struct s2n_cipher_preferences *default_cipher_preferences = server_config->cipher_preferences;
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    for (int i = 0; i < sizeof(test_suites) / sizeof(test_suites[0]); i++) {
+        struct s2n_cipher_suite *cur_cipher = test_suites[i];
+        struct s2n_cipher_preferences server_cipher_preferences;
+        struct s2n_connection *server_conn, *client_conn;
+        struct s2n_stuffer client_to_server, server_to_client;
+
+        if (!cur_cipher->available) {
+            /* Skip Ciphers that aren't supported with the linked libcrypto */
+            continue;
+        }
+
+        memcpy(&server_cipher_preferences, default_cipher_preferences, sizeof(server_cipher_preferences));
+        server_cipher_preferences.count = 1;
+        server_cipher_preferences.suites = &cur_cipher;
+        server_config->cipher_preferences = &server_cipher_preferences;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+        EXPECT_SUCCESS(s2n_connection_set_blinding(client_conn, S2N_SELF_SERVICE_BLINDING));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+        EXPECT_EQUAL(client_conn->secure.cipher_suite, cur_cipher);
+
+        /* A record that fits in the caller's buffer is decrypted straight into it */
+        {
+            EXPECT_EQUAL(s2n_send(server_conn, sent, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+
+            memset(received, 0, sizeof(received));
+            EXPECT_EQUAL(s2n_recv(client_conn, received, sizeof(received), &blocked), RECORD_PAYLOAD_SIZE);
+            EXPECT_EQUAL(blocked, S2N_NOT_BLOCKED);
+            EXPECT_BYTEARRAY_EQUAL(received, sent, RECORD_PAYLOAD_SIZE);
+            EXPECT_EQUAL(s2n_peek(client_conn), 0);
+            EXPECT_TRUE(ciphertext_left_in(client_conn));
+        }
+
+        /* An exact fit is decrypted directly too */
+        {
+            EXPECT_EQUAL(s2n_send(server_conn, sent, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+
+            memset(received, 0, sizeof(received));
+            EXPECT_EQUAL(s2n_recv(client_conn, received, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+            EXPECT_BYTEARRAY_EQUAL(received, sent, RECORD_PAYLOAD_SIZE);
+            EXPECT_TRUE(ciphertext_left_in(client_conn));
+        }
+
+        /* A record that doesn't fit goes through conn->in and is handed out in pieces */
+        {
+            EXPECT_EQUAL(s2n_send(server_conn, sent, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+
+            memset(received, 0, sizeof(received));
+            EXPECT_EQUAL(s2n_recv(client_conn, received, RECORD_PAYLOAD_SIZE - 1, &blocked), RECORD_PAYLOAD_SIZE - 1);
+            EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_READ);
+            EXPECT_EQUAL(s2n_peek(client_conn), 1);
+
+            EXPECT_EQUAL(s2n_recv(client_conn, received + RECORD_PAYLOAD_SIZE - 1, 1, &blocked), 1);
+            EXPECT_EQUAL(blocked, S2N_NOT_BLOCKED);
+            EXPECT_BYTEARRAY_EQUAL(received, sent, RECORD_PAYLOAD_SIZE);
+            EXPECT_FALSE(ciphertext_left_in(client_conn));
+        }
+
+        /* With read-ahead, several records land back to back in the caller's buffer */
+        {
+            EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, S2N_LARGE_RECORD_LENGTH));
+            for (int j = 0; j < 3; j++) {
+                EXPECT_EQUAL(s2n_send(server_conn, sent + j * RECORD_PAYLOAD_SIZE, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+            }
+
+            memset(received, 0, sizeof(received));
+            EXPECT_EQUAL(s2n_recv(client_conn, received, sizeof(received), &blocked), sizeof(received));
+            EXPECT_BYTEARRAY_EQUAL(received, sent, sizeof(sent));
+            EXPECT_TRUE(ciphertext_left_in(client_conn));
+            EXPECT_SUCCESS(s2n_connection_set_read_ahead(client_conn, 0));
+        }
+
+        /* A record that fails authentication leaves no plaintext in the caller's buffer */
+        {
+            EXPECT_EQUAL(s2n_send(server_conn, sent, RECORD_PAYLOAD_SIZE, &blocked), RECORD_PAYLOAD_SIZE);
+
+            /* Corrupt the tag */
+            server_to_client.blob.data[server_to_client.write_cursor - 1] ^= 1;
+
+            memset(received, 0xff, sizeof(received));
+            EXPECT_FAILURE_WITH_ERRNO(s2n_recv(client_conn, received, sizeof(received), &blocked), S2N_ERR_DECRYPT);
+            for (int j = 0; j < RECORD_PAYLOAD_SIZE; j++) {
+                EXPECT_EQUAL(received[j], 0);
+            }
+            EXPECT_EQUAL(received[RECORD_PAYLOAD_SIZE], 0xff);
+        }
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    }
+
+    server_config->cipher_preferences = default_cipher_preferences;
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_connection.h"
+#include "tls/s2n_record.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define SEND_SIZE (100 * 1024)
+
+static int send_calls = 0;
+static uint32_t send_budget = UINT32_MAX;
+
+/* Like the testlib stuffer writer, but counts calls and can apply back pressure */
+static int counting_write(void *io_context, const uint8_t *buf, uint32_t len)
+{
+    struct s2n_stuffer *out = (struct s2n_stuffer *) io_context;
+
+    send_calls++;
+
+    uint32_t n = (send_budget < len) ? send_budget : len;
+    if (n == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    GUARD(s2n_stuffer_write_bytes(out, buf, n));
+    if (send_budget != UINT32_MAX) {
+        send_budget -= n;
+    }
+    return n;
+}
+
+static int read_all(struct s2n_connection *conn, uint8_t *buf, ssize_t size)
+{
+    s2n_blocked_status blocked;
+
+    while (size) {
+        ssize_t r = s2n_recv(conn, buf, size, &blocked);
+        gt_check(r, 0);
+        buf += r;
+        size -= r;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_config *server_config, *client_config;
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    s2n_blocked_status blocked;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t *sent, *received;
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(sent = malloc(SEND_SIZE));
+    EXPECT_NOT_NULL(received = malloc(SEND_SIZE));
+    for (int i = 0; i < SEND_SIZE; i++) {
+        sent[i] = i % 251;
+    }
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+
+    EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+    EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+    EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+    EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+
+    EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+
+    /* Writes that grow from one record to several reuse the same output buffer */
+    uint8_t *coalesce_buffer = NULL;
+    for (int i = 1; i < 0xffff; i += 100) {
+        EXPECT_EQUAL(s2n_send(client_conn, sent, i, &blocked), i);
+        EXPECT_SUCCESS(read_all(server_conn, received, i));
+        EXPECT_BYTEARRAY_EQUAL(received, sent, i);
+
+        /* Once grown for a batch, it is kept rather than allocated again for every send */
+        if (coalesce_buffer != NULL) {
+            EXPECT_EQUAL(client_conn->out.blob.data, coalesce_buffer);
+        } else if (client_conn->out.blob.size == S2N_MAX_COALESCED_SEND_LENGTH) {
+            coalesce_buffer = client_conn->out.blob.data;
+        }
+    }
+    EXPECT_NOT_NULL(coalesce_buffer);
+
+    /* Until the application says the connection is idle */
+    EXPECT_SUCCESS(s2n_connection_release_buffers(client_conn));
+    EXPECT_EQUAL(client_conn->out.blob.size, 0);
+
+    EXPECT_SUCCESS(s2n_connection_set_send_cb(server_conn, counting_write));
+
+    /* Many records are written with only a handful of writes */
+    {
+        int max_payload_size = s2n_record_max_write_payload_size(server_conn);
+        int records = (SEND_SIZE + max_payload_size - 1) / max_payload_size;
+
+        send_calls = 0;
+        EXPECT_EQUAL(s2n_send(server_conn, sent, SEND_SIZE, &blocked), SEND_SIZE);
+        EXPECT_EQUAL(blocked, S2N_NOT_BLOCKED);
+        EXPECT_TRUE(send_calls > 0);
+        EXPECT_TRUE(send_calls * 2 <= records);
+        EXPECT_TRUE(send_calls <= SEND_SIZE / (S2N_MAX_COALESCED_SEND_LENGTH - 2 * S2N_LARGE_RECORD_LENGTH) + 1);
+        EXPECT_EQUAL(server_conn->out.blob.size, S2N_MAX_COALESCED_SEND_LENGTH);
+
+        EXPECT_SUCCESS(read_all(client_conn, received, SEND_SIZE));
+        EXPECT_BYTEARRAY_EQUAL(received, sent, SEND_SIZE);
+    }
+
+    /* A single record is still sent with a single write */
+    {
+        send_calls = 0;
+        EXPECT_EQUAL(s2n_send(server_conn, sent, 100, &blocked), 100);
+        EXPECT_EQUAL(send_calls, 1);
+
+        EXPECT_SUCCESS(read_all(client_conn, received, 100));
+        EXPECT_BYTEARRAY_EQUAL(received, sent, 100);
+    }
+
+    /* A write blocked before the first batch is flushed reports nothing as sent */
+    {
+        send_budget = 1000;
+        EXPECT_FAILURE_WITH_ERRNO(s2n_send(server_conn, sent, SEND_SIZE, &blocked), S2N_ERR_BLOCKED);
+        EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_WRITE);
+
+        /* Retrying with the same buffer completes the write */
+        send_budget = UINT32_MAX;
+        EXPECT_EQUAL(s2n_send(server_conn, sent, SEND_SIZE, &blocked), SEND_SIZE);
+
+        EXPECT_SUCCESS(read_all(client_conn, received, SEND_SIZE));
+        EXPECT_BYTEARRAY_EQUAL(received, sent, SEND_SIZE);
+    }
+
+    /* A write blocked after a batch is flushed reports the flushed data as sent */
+    {
+        send_budget = S2N_MAX_COALESCED_SEND_LENGTH;
+        ssize_t written = s2n_send(server_conn, sent, SEND_SIZE, &blocked);
+        EXPECT_TRUE(written > 0);
+        EXPECT_TRUE(written < SEND_SIZE);
+        EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_WRITE);
+
+        /* The records encrypted but not flushed are sent first when the caller retries with the rest */
+        send_budget = UINT32_MAX;
+        EXPECT_EQUAL(s2n_send(server_conn, sent + written, SEND_SIZE - written, &blocked), SEND_SIZE - written);
+
+        EXPECT_SUCCESS(read_all(client_conn, received, SEND_SIZE));
+        EXPECT_BYTEARRAY_EQUAL(received, sent, SEND_SIZE);
+    }
+
+    EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+
+    EXPECT_SUCCESS(s2n_connection_free(server_conn));
+    EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+    EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+    free(sent);
+    free(received);
+
+    END_TEST();
+}
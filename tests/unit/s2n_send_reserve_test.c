@@ -0,0 +1,246 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+static uint32_t send_budget = UINT32_MAX;
+
+/* Like the testlib stuffer writer, but can apply back pressure */
+static int limited_write(void *io_context, const uint8_t *buf, uint32_t len)
+{
+    struct s2n_stuffer *out = (struct s2n_stuffer *) io_context;
+
+    uint32_t n = (send_budget < len) ? send_budget : len;
+    if (n == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    GUARD(s2n_stuffer_write_bytes(out, buf, n));
+    if (send_budget != UINT32_MAX) {
+        send_budget -= n;
+    }
+    return n;
+}
+
+static int read_all(struct s2n_connection *conn, uint8_t *buf, ssize_t size)
+{
+    s2n_blocked_status blocked;
+
+    while (size) {
+        ssize_t r = s2n_recv(conn, buf, size, &blocked);
+        gt_check(r, 0);
+        buf += r;
+        size -= r;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_config *server_config, *client_config;
+    struct s2n_cert_chain_and_key *chain_and_key;
+    s2n_blocked_status blocked;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t received[S2N_LARGE_FRAGMENT_LENGTH];
+
+    /* With and without an explicit nonce in front of the plaintext */
+    struct s2n_cipher_suite *test_suites[] = {
+        &s2n_ecdhe_rsa_with_aes_128_gcm_sha256,
+        &s2n_ecdhe_rsa_with_chacha20_poly1305_sha256,
+    };
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    const struct s2n_cipher_preferences *default_cipher_preferences = server_config->cipher_preferences;
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    for (int i = 0; i < sizeof(test_suites) / sizeof(test_suites[0]); i++) {
+        struct s2n_cipher_suite *cur_cipher = test_suites[i];
+        struct s2n_cipher_preferences server_cipher_preferences;
+        struct s2n_connection *server_conn, *client_conn;
+        struct s2n_stuffer client_to_server, server_to_client;
+        uint8_t *buf;
+        uint32_t size;
+
+        if (!cur_cipher->available) {
+            /* Skip Ciphers that aren't supported with the linked libcrypto */
+            continue;
+        }
+
+        memcpy(&server_cipher_preferences, default_cipher_preferences, sizeof(server_cipher_preferences));
+        server_cipher_preferences.count = 1;
+        server_cipher_preferences.suites = &cur_cipher;
+        server_config->cipher_preferences = &server_cipher_preferences;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->secure.cipher_suite, cur_cipher);
+
+        EXPECT_SUCCESS(s2n_connection_set_send_cb(server_conn, limited_write));
+
+        /* Commit without a reservation fails */
+        EXPECT_FAILURE_WITH_ERRNO(s2n_send_commit(server_conn, 1, &blocked), S2N_ERR_SEND_RESERVE);
+
+        /* Plaintext written into the reserved buffer is sealed in place */
+        {
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            EXPECT_EQUAL(size, s2n_record_max_write_payload_size(server_conn));
+            for (int j = 0; j < size; j++) {
+                buf[j] = j % 251;
+            }
+
+            EXPECT_EQUAL(s2n_send_commit(server_conn, size, &blocked), size);
+            EXPECT_EQUAL(blocked, S2N_NOT_BLOCKED);
+
+            EXPECT_SUCCESS(read_all(client_conn, received, size));
+            for (int j = 0; j < size; j++) {
+                EXPECT_EQUAL(received[j], j % 251);
+            }
+        }
+
+        /* Less than the reserved size can be committed, but never more */
+        {
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            EXPECT_FAILURE_WITH_ERRNO(s2n_send_commit(server_conn, size + 1, &blocked), S2N_ERR_SEND_RESERVE);
+
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            memset(buf, 'a', 10);
+            EXPECT_EQUAL(s2n_send_commit(server_conn, 10, &blocked), 10);
+
+            /* A reservation can only be committed once */
+            EXPECT_FAILURE_WITH_ERRNO(s2n_send_commit(server_conn, 10, &blocked), S2N_ERR_SEND_RESERVE);
+
+            EXPECT_SUCCESS(read_all(client_conn, received, 10));
+            for (int j = 0; j < 10; j++) {
+                EXPECT_EQUAL(received[j], 'a');
+            }
+        }
+
+        /* A committed record is queued even when the socket is full */
+        {
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            memset(buf, 'b', 100);
+
+            send_budget = 0;
+            EXPECT_EQUAL(s2n_send_commit(server_conn, 100, &blocked), 100);
+            EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_WRITE);
+
+            /* The next reservation has to wait for the queued record */
+            EXPECT_FAILURE_WITH_ERRNO(s2n_send_reserve(server_conn, &buf, &size, &blocked), S2N_ERR_BLOCKED);
+            EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_WRITE);
+
+            send_budget = UINT32_MAX;
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            memset(buf, 'c', 100);
+            EXPECT_EQUAL(s2n_send_commit(server_conn, 100, &blocked), 100);
+
+            EXPECT_SUCCESS(read_all(client_conn, received, 200));
+            for (int j = 0; j < 200; j++) {
+                EXPECT_EQUAL(received[j], j < 100 ? 'b' : 'c');
+            }
+        }
+
+        /* Reserved and regular sends can be mixed */
+        {
+            EXPECT_EQUAL(s2n_send(server_conn, "hello", 5, &blocked), 5);
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            memcpy(buf, "world", 5);
+            EXPECT_EQUAL(s2n_send_commit(server_conn, 5, &blocked), 5);
+
+            EXPECT_SUCCESS(read_all(client_conn, received, 10));
+            EXPECT_BYTEARRAY_EQUAL(received, "helloworld", 10);
+        }
+
+        /* Anything else written to conn->out cancels a reservation */
+        {
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            memset(buf, 'd', 100);
+            EXPECT_EQUAL(s2n_send(server_conn, "hello", 5, &blocked), 5);
+            EXPECT_FAILURE_WITH_ERRNO(s2n_send_commit(server_conn, 100, &blocked), S2N_ERR_SEND_RESERVE);
+
+            char world[] = "world";
+            struct iovec iov = { .iov_base = world, .iov_len = 5 };
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            EXPECT_EQUAL(s2n_sendv(server_conn, &iov, 1, &blocked), 5);
+            EXPECT_FAILURE_WITH_ERRNO(s2n_send_commit(server_conn, 100, &blocked), S2N_ERR_SEND_RESERVE);
+
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            EXPECT_SUCCESS(s2n_connection_release_buffers(server_conn));
+            EXPECT_FAILURE_WITH_ERRNO(s2n_send_commit(server_conn, 100, &blocked), S2N_ERR_SEND_RESERVE);
+
+            /* Nothing from the cancelled reservations was sent */
+            EXPECT_SUCCESS(read_all(client_conn, received, 10));
+            EXPECT_BYTEARRAY_EQUAL(received, "helloworld", 10);
+        }
+
+        /* Shutting down cancels a reservation as well */
+        {
+            EXPECT_SUCCESS(s2n_send_reserve(server_conn, &buf, &size, &blocked));
+            EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
+            EXPECT_EQUAL(server_conn->send_reserved_size, 0);
+            EXPECT_FAILURE_WITH_ERRNO(s2n_send_commit(server_conn, 100, &blocked), S2N_ERR_CLOSED);
+        }
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    }
+
+    server_config->cipher_preferences = default_cipher_preferences;
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    free(cert_chain_pem);
+    free(private_key_pem);
+
+    END_TEST();
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define FILE_SIZE (3 * S2N_LARGE_FRAGMENT_LENGTH + 100)
+
+static uint32_t send_budget = UINT32_MAX;
+
+/* Like the testlib stuffer writer, but can apply back pressure */
+static int limited_write(void *io_context, const uint8_t *buf, uint32_t len)
+{
+    struct s2n_stuffer *out = (struct s2n_stuffer *) io_context;
+
+    uint32_t n = (send_budget < len) ? send_budget : len;
+    if (n == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    GUARD(s2n_stuffer_write_bytes(out, buf, n));
+    if (send_budget != UINT32_MAX) {
+        send_budget -= n;
+    }
+    return n;
+}
+
+static int read_all(struct s2n_connection *conn, uint8_t *buf, ssize_t size)
+{
+    s2n_blocked_status blocked;
+
+    while (size) {
+        ssize_t r = s2n_recv(conn, buf, size, &blocked);
+        gt_check(r, 0);
+        buf += r;
+        size -= r;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_config *server_config, *client_config;
+    struct s2n_cert_chain_and_key *chain_and_key;
+    s2n_blocked_status blocked;
+    char *cert_chain_pem;
+    char *private_key_pem;
+    uint8_t *data, *received;
+    char file_name[] = "/tmp/s2n_sendfile_test_XXXXXX";
+    int fd;
+
+    struct s2n_cipher_suite *test_suites[] = {
+        &s2n_ecdhe_rsa_with_aes_128_gcm_sha256,
+        &s2n_ecdhe_rsa_with_chacha20_poly1305_sha256,
+    };
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(data = malloc(FILE_SIZE));
+    EXPECT_NOT_NULL(received = malloc(FILE_SIZE));
+    for (int i = 0; i < FILE_SIZE; i++) {
+        data[i] = i % 251;
+    }
+
+    EXPECT_TRUE((fd = mkstemp(file_name)) >= 0);
+    EXPECT_SUCCESS(unlink(file_name));
+    EXPECT_EQUAL(write(fd, data, FILE_SIZE), FILE_SIZE);
+
+    EXPECT_NOT_NULL(cert_chain_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(private_key_pem = malloc(S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    const struct s2n_cipher_preferences *default_cipher_preferences = server_config->cipher_preferences;
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    for (int i = 0; i < sizeof(test_suites) / sizeof(test_suites[0]); i++) {
+        struct s2n_cipher_suite *cur_cipher = test_suites[i];
+        struct s2n_cipher_preferences server_cipher_preferences;
+        struct s2n_connection *server_conn, *client_conn;
+        struct s2n_stuffer client_to_server, server_to_client;
+
+        if (!cur_cipher->available) {
+            /* Skip Ciphers that aren't supported with the linked libcrypto */
+            continue;
+        }
+
+        memcpy(&server_cipher_preferences, default_cipher_preferences, sizeof(server_cipher_preferences));
+        server_cipher_preferences.count = 1;
+        server_cipher_preferences.suites = &cur_cipher;
+        server_config->cipher_preferences = &server_cipher_preferences;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->secure.cipher_suite, cur_cipher);
+
+        EXPECT_SUCCESS(s2n_connection_set_send_cb(server_conn, limited_write));
+
+        /* A whole file, spanning several records */
+        {
+            EXPECT_EQUAL(s2n_sendfile(server_conn, fd, 0, FILE_SIZE, &blocked), FILE_SIZE);
+            EXPECT_EQUAL(blocked, S2N_NOT_BLOCKED);
+
+            EXPECT_SUCCESS(read_all(client_conn, received, FILE_SIZE));
+            EXPECT_BYTEARRAY_EQUAL(received, data, FILE_SIZE);
+        }
+
+        /* A range from the middle of the file */
+        {
+            EXPECT_EQUAL(s2n_sendfile(server_conn, fd, 1000, 5000, &blocked), 5000);
+
+            EXPECT_SUCCESS(read_all(client_conn, received, 5000));
+            EXPECT_BYTEARRAY_EQUAL(received, data + 1000, 5000);
+        }
+
+        /* Sending nothing is fine */
+        EXPECT_EQUAL(s2n_sendfile(server_conn, fd, 0, 0, &blocked), 0);
+
+        /* The file position is left alone */
+        EXPECT_EQUAL(lseek(fd, 0, SEEK_CUR), FILE_SIZE);
+
+        /* A blocked send is resumed by advancing the offset by what was written */
+        {
+            off_t written = 0;
+            int blocked_calls = 0;
+
+            send_budget = 1000;
+            do {
+                ssize_t w = s2n_sendfile(server_conn, fd, written, FILE_SIZE - written, &blocked);
+                if (w < 0) {
+                    EXPECT_EQUAL(s2n_error_get_type(s2n_errno), S2N_ERR_T_BLOCKED);
+                    w = 0;
+                }
+                if (blocked != S2N_NOT_BLOCKED) {
+                    blocked_calls++;
+                    send_budget = 1000;
+                }
+                written += w;
+            } while (blocked != S2N_NOT_BLOCKED);
+            send_budget = UINT32_MAX;
+
+            EXPECT_EQUAL(written, FILE_SIZE);
+            EXPECT_TRUE(blocked_calls > 0);
+
+            EXPECT_SUCCESS(read_all(client_conn, received, FILE_SIZE));
+            EXPECT_BYTEARRAY_EQUAL(received, data, FILE_SIZE);
+        }
+
+        /* Bad arguments are rejected before anything is sent */
+        EXPECT_FAILURE_WITH_ERRNO(s2n_sendfile(server_conn, fd, -1, 10, &blocked), S2N_ERR_SEND_SIZE);
+        EXPECT_FAILURE_WITH_ERRNO(s2n_sendfile(server_conn, -1, 0, 10, &blocked), S2N_ERR_IO);
+        EXPECT_EQUAL(s2n_stuffer_data_available(&server_to_client), 0);
+
+        /* Asking for more than the file holds fails */
+        EXPECT_FAILURE_WITH_ERRNO(s2n_sendfile(server_conn, fd, FILE_SIZE - 10, 20, &blocked), S2N_ERR_SEND_SIZE);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    }
+
+    server_config->cipher_preferences = default_cipher_preferences;
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+    EXPECT_SUCCESS(close(fd));
+    free(cert_chain_pem);
+    free(private_key_pem);
+    free(data);
+    free(received);
+
+    END_TEST();
+}
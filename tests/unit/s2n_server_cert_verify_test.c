@@ -45,6 +45,8 @@ int main(int argc, char **argv)
 
         struct s2n_connection *client_conn;
         EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        /* Start the SHA256 handshake hash so the test can set its contents directly */
+        EXPECT_SUCCESS(s2n_handshake_require_hash(&client_conn->handshake, S2N_HASH_SHA256));
 
         EXPECT_SUCCESS(s2n_stuffer_alloc(&certificate_in, S2N_MAX_TEST_PEM_SIZE));
         EXPECT_SUCCESS(s2n_stuffer_alloc(&certificate_out, S2N_MAX_TEST_PEM_SIZE));
@@ -58,7 +60,8 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(config, ecdsa_cert));
         EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
         client_conn->handshake_params.our_chain_and_key = ecdsa_cert;
-        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp256r1_sha256;
+        client_conn->secure.cipher_suite = &s2n_tls13_aes_128_gcm_sha256;
+        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp384r1_sha384;
 
         b.data = (uint8_t *) cert_chain_pem;
         b.size = strlen(cert_chain_pem) + 1;
@@ -73,15 +76,15 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_pkey_match(&client_conn->secure.server_public_key, client_conn->handshake_params.our_chain_and_key->private_key));
 
         /* Hash initialization */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
 
         /* Send and receive cert verify */
         EXPECT_SUCCESS(s2n_server_cert_verify_send(client_conn));
 
         /* Reinitialize hash */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
 
         EXPECT_SUCCESS(s2n_server_cert_verify_recv(client_conn));
 
@@ -117,10 +120,13 @@ int main(int argc, char **argv)
 
         struct s2n_connection *client_conn;
         EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        /* Start the SHA256 handshake hash so the test can set its contents directly */
+        EXPECT_SUCCESS(s2n_handshake_require_hash(&client_conn->handshake, S2N_HASH_SHA256));
         EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(config, ecdsa_cert));
         EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
         client_conn->handshake_params.our_chain_and_key = ecdsa_cert;
-        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp256r1_sha256;
+        client_conn->secure.cipher_suite = &s2n_tls13_aes_128_gcm_sha256;
+        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp384r1_sha384;
 
         b.data = (uint8_t *) cert_chain_pem;
         b.size = strlen(cert_chain_pem) + 1;
@@ -134,18 +140,18 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_pkey_match(&client_conn->secure.server_public_key, client_conn->handshake_params.our_chain_and_key->private_key));
 
         /* Initialize send hash with hello */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
-        EXPECT_SUCCESS(s2n_hash_get_currently_in_hash_total(&client_conn->handshake.sha256, &bytes_in_hash));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_get_currently_in_hash_total(&client_conn->handshake.hashes->sha256, &bytes_in_hash));
         EXPECT_EQUAL(bytes_in_hash, 14);
 
         /* Send and receive cert verify */
         EXPECT_SUCCESS(s2n_server_cert_verify_send(client_conn));
 
         /* Initialize receive hash with goodbye */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, goodbye, strlen((char *)goodbye)));
-        EXPECT_SUCCESS(s2n_hash_get_currently_in_hash_total(&client_conn->handshake.sha256, &bytes_in_hash));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, goodbye, strlen((char *)goodbye)));
+        EXPECT_SUCCESS(s2n_hash_get_currently_in_hash_total(&client_conn->handshake.hashes->sha256, &bytes_in_hash));
         EXPECT_EQUAL(bytes_in_hash, 16);
 
         EXPECT_FAILURE_WITH_ERRNO(s2n_server_cert_verify_recv(client_conn), S2N_ERR_VERIFY_SIGNATURE);
@@ -180,10 +186,13 @@ int main(int argc, char **argv)
 
         struct s2n_connection *client_conn;
         EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        /* Start the SHA256 handshake hash so the test can set its contents directly */
+        EXPECT_SUCCESS(s2n_handshake_require_hash(&client_conn->handshake, S2N_HASH_SHA256));
         EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(config, ecdsa_cert));
         EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
         client_conn->handshake_params.our_chain_and_key = ecdsa_cert;
-        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp256r1_sha256;
+        client_conn->secure.cipher_suite = &s2n_tls13_aes_128_gcm_sha256;
+        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp384r1_sha384;
 
         b.data = (uint8_t *) cert_chain_pem;
         b.size = strlen(cert_chain_pem) + 1;
@@ -195,15 +204,15 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_asn1der_to_public_key_and_type(&client_conn->secure.server_public_key, &cert_type, &b));
 
         /* Initialize send hash with hello */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
 
         /* Send and receive cert verify */
         EXPECT_SUCCESS(s2n_server_cert_verify_send(client_conn));
 
         /* Initialize receive hash with hello and flip one bit in client_conn io buffer */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
         EXPECT_TRUE(10 < s2n_stuffer_data_available(&client_conn->handshake.io));
         client_conn->handshake.io.blob.data[10] ^= 1;
 
@@ -240,10 +249,13 @@ int main(int argc, char **argv)
 
         struct s2n_connection *client_conn;
         EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        /* Start the SHA256 handshake hash so the test can set its contents directly */
+        EXPECT_SUCCESS(s2n_handshake_require_hash(&client_conn->handshake, S2N_HASH_SHA256));
         EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(config, ecdsa_cert));
         EXPECT_SUCCESS(s2n_connection_set_config(client_conn, config));
         client_conn->handshake_params.our_chain_and_key = ecdsa_cert;
-        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp256r1_sha256;
+        client_conn->secure.cipher_suite = &s2n_tls13_aes_128_gcm_sha256;
+        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp384r1_sha384;
 
         b.data = (uint8_t *) cert_chain_pem;
         b.size = strlen(cert_chain_pem) + 1;
@@ -256,32 +268,31 @@ int main(int argc, char **argv)
         EXPECT_SUCCESS(s2n_asn1der_to_public_key_and_type(&client_conn->secure.server_public_key, &cert_type, &b));
 
         /* Hash initialization */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
 
-        /* send and receive with mismatched hash algs */
+        /* send and receive with a SignatureScheme for a different curve than the key's */
+        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp256r1_sha256;
         EXPECT_SUCCESS(s2n_server_cert_verify_send(client_conn));
 
-        client_conn->secure.conn_sig_scheme.hash_alg = S2N_HASH_SHA1;
-
         /* Reinitialize hash */
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
 
-        EXPECT_FAILURE(s2n_server_cert_verify_recv(client_conn));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_server_cert_verify_recv(client_conn), S2N_ERR_INVALID_SIGNATURE_SCHEME);
 
         /* send and receive with mismatched signature algs */
-        client_conn->secure.conn_sig_scheme.hash_alg = S2N_HASH_SHA256;
+        client_conn->secure.conn_sig_scheme = s2n_ecdsa_secp384r1_sha384;
         client_conn->secure.conn_sig_scheme.sig_alg = S2N_SIGNATURE_ANONYMOUS;
         client_conn->secure.conn_sig_scheme.iana_value = 0xFFFF;
 
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
 
         EXPECT_SUCCESS(s2n_server_cert_verify_send(client_conn));
 
-        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.sha256, S2N_HASH_SHA256));
-        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.sha256, hello, strlen((char *)hello)));
+        EXPECT_SUCCESS(s2n_hash_init(&client_conn->handshake.hashes->sha256, S2N_HASH_SHA256));
+        EXPECT_SUCCESS(s2n_hash_update(&client_conn->handshake.hashes->sha256, hello, strlen((char *)hello)));
 
         EXPECT_FAILURE(s2n_server_cert_verify_recv(client_conn));
 
@@ -930,6 +930,14 @@ int main(int argc, char **argv)
         EXPECT_BYTEARRAY_EQUAL(((struct s2n_ticket_key *)s2n_set_get(server_config->ticket_keys, 1))->key_name, ticket_key_name1, strlen((char *)ticket_key_name1));
         EXPECT_BYTEARRAY_EQUAL(((struct s2n_ticket_key *)s2n_set_get(server_config->ticket_keys, 2))->key_name, ticket_key_name3, strlen((char *)ticket_key_name3));
 
+        /* Verify that every stored key keeps its expanded encrypt and decrypt contexts */
+        for (int i = 0; i < s2n_set_size(server_config->ticket_keys); i++) {
+            struct s2n_ticket_key *stored_key = s2n_set_get(server_config->ticket_keys, i);
+            EXPECT_NOT_NULL(stored_key->encrypt_key.evp_cipher_ctx);
+            EXPECT_NOT_NULL(stored_key->decrypt_key.evp_cipher_ctx);
+            EXPECT_NOT_EQUAL(stored_key->encrypt_key.evp_cipher_ctx, stored_key->decrypt_key.evp_cipher_ctx);
+        }
+
         EXPECT_SUCCESS(s2n_shutdown_test_server_and_client(server_conn, client_conn));
 
         EXPECT_SUCCESS(s2n_connection_free(server_conn));
@@ -0,0 +1,379 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_ecdsa.h"
+#include "crypto/s2n_openssl.h"
+#include "crypto/s2n_pkey.h"
+
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_sign_engine.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define PAIRS 4
+#define NONCES 8
+
+struct test_pair {
+    struct s2n_connection *server_conn;
+    struct s2n_connection *client_conn;
+    struct s2n_stuffer client_to_server;
+    struct s2n_stuffer server_to_client;
+    int server_done;
+    int client_done;
+    int waiting;
+};
+
+/* Signs the same message each time, so that two signatures only match when they were made with the same nonce */
+static int sign_hello(const struct s2n_pkey *private_key, struct s2n_blob *signature)
+{
+    struct s2n_hash_state sign_hash;
+
+    GUARD(s2n_hash_new(&sign_hash));
+    GUARD(s2n_hash_init(&sign_hash, S2N_HASH_SHA384));
+    GUARD(s2n_hash_update(&sign_hash, "hello", 5));
+
+    signature->size = s2n_pkey_size(private_key);
+    GUARD(s2n_pkey_sign(private_key, &sign_hash, signature));
+    GUARD(s2n_hash_free(&sign_hash));
+
+    return 0;
+}
+
+/* Runs several handshakes side by side, the way an event loop would, with the engine signing for all of them */
+static int negotiate_with_engine(struct s2n_sign_engine *engine, struct test_pair *pairs, int *engine_results)
+{
+    s2n_blocked_status blocked;
+    int all_done;
+
+    *engine_results = 0;
+
+    do {
+        int waiting = 0;
+        all_done = 1;
+
+        for (int i = 0; i < PAIRS; i++) {
+            struct test_pair *pair = &pairs[i];
+
+            if (!pair->client_done) {
+                if (s2n_negotiate(pair->client_conn, &blocked) == 0) {
+                    pair->client_done = 1;
+                } else if (s2n_error_get_type(s2n_errno) != S2N_ERR_T_BLOCKED) {
+                    return -1;
+                }
+            }
+
+            if (!pair->server_done && !pair->waiting) {
+                if (s2n_negotiate(pair->server_conn, &blocked) == 0) {
+                    pair->server_done = 1;
+                } else if (s2n_error_get_type(s2n_errno) != S2N_ERR_T_BLOCKED) {
+                    return -1;
+                } else if (blocked == S2N_BLOCKED_ON_APPLICATION_INPUT) {
+                    eq_check(s2n_errno, S2N_ERR_ASYNC_BLOCKED);
+                    pair->waiting = 1;
+                }
+            }
+
+            all_done &= pair->client_done && pair->server_done;
+            waiting += pair->waiting;
+        }
+
+        if (waiting) {
+            struct pollfd fd = { .fd = s2n_sign_engine_get_fd(engine), .events = POLLIN };
+            struct s2n_connection *conns[PAIRS];
+            uint32_t conn_count = 0;
+
+            gt_check(poll(&fd, 1, 10000), 0);
+            GUARD(s2n_sign_engine_poll(engine, conns, PAIRS, &conn_count));
+
+            for (int i = 0; i < conn_count; i++) {
+                for (int j = 0; j < PAIRS; j++) {
+                    if (pairs[j].server_conn == conns[i]) {
+                        eq_check(pairs[j].waiting, 1);
+                        pairs[j].waiting = 0;
+                        (*engine_results)++;
+                    }
+                }
+            }
+        }
+    } while (!all_done);
+
+    return 0;
+}
+
+static int try_handshakes(struct s2n_sign_engine *engine, struct s2n_config *server_config, struct s2n_config *client_config,
+                          int *engine_results)
+{
+    struct test_pair pairs[PAIRS];
+    s2n_blocked_status blocked;
+    uint8_t buf[5];
+
+    memset(pairs, 0, sizeof(pairs));
+
+    for (int i = 0; i < PAIRS; i++) {
+        struct test_pair *pair = &pairs[i];
+
+        notnull_check(pair->server_conn = s2n_connection_new(S2N_SERVER));
+        notnull_check(pair->client_conn = s2n_connection_new(S2N_CLIENT));
+        GUARD(s2n_connection_set_config(pair->server_conn, server_config));
+        GUARD(s2n_connection_set_config(pair->client_conn, client_config));
+
+        GUARD(s2n_stuffer_growable_alloc(&pair->client_to_server, 0));
+        GUARD(s2n_stuffer_growable_alloc(&pair->server_to_client, 0));
+        GUARD(s2n_connection_set_io_stuffers(&pair->client_to_server, &pair->server_to_client, pair->server_conn));
+        GUARD(s2n_connection_set_io_stuffers(&pair->server_to_client, &pair->client_to_server, pair->client_conn));
+    }
+
+    int rc = negotiate_with_engine(engine, pairs, engine_results);
+
+    for (int i = 0; i < PAIRS; i++) {
+        struct test_pair *pair = &pairs[i];
+
+        if (rc == 0) {
+            eq_check(s2n_send(pair->server_conn, "hello", 5, &blocked), 5);
+            eq_check(s2n_recv(pair->client_conn, buf, 5, &blocked), 5);
+            eq_check(memcmp(buf, "hello", 5), 0);
+            GUARD(s2n_shutdown_test_server_and_client(pair->server_conn, pair->client_conn));
+        }
+
+        GUARD(s2n_connection_free(pair->server_conn));
+        GUARD(s2n_connection_free(pair->client_conn));
+        GUARD(s2n_stuffer_free(&pair->client_to_server));
+        GUARD(s2n_stuffer_free(&pair->server_to_client));
+    }
+
+    return rc;
+}
+
+/* The worker tops the stock up in the background */
+static int wait_for_nonces(const struct s2n_pkey *key)
+{
+    uint32_t missing = 0;
+
+    for (int i = 0; i < 1000; i++) {
+        GUARD(s2n_ecdsa_nonces_missing(key, &missing));
+        if (missing == 0) {
+            return 0;
+        }
+        usleep(10000);
+    }
+
+    S2N_ERROR(S2N_ERR_SAFETY);
+}
+
+static struct s2n_cert_chain_and_key *load_chain_and_key(const char *cert_chain_file, const char *private_key_file)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    char cert_chain_pem[S2N_MAX_TEST_PEM_SIZE];
+    char private_key_pem[S2N_MAX_TEST_PEM_SIZE];
+
+    GUARD_PTR(s2n_read_test_pem(cert_chain_file, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE));
+    GUARD_PTR(s2n_read_test_pem(private_key_file, private_key_pem, S2N_MAX_TEST_PEM_SIZE));
+    notnull_check_ptr(chain_and_key = s2n_cert_chain_and_key_new());
+    GUARD_PTR(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem));
+
+    return chain_and_key;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *rsa_chain_and_key, *ecdsa_chain_and_key;
+    struct s2n_config *rsa_config, *ecdsa_config, *client_config;
+    struct s2n_cipher_suite *ecdsa_suite = &s2n_ecdhe_ecdsa_with_aes_128_gcm_sha256;
+    struct s2n_cipher_preferences ecdsa_preferences;
+    struct s2n_sign_engine *engine;
+    int engine_results;
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(rsa_chain_and_key = load_chain_and_key(S2N_DEFAULT_TEST_CERT_CHAIN, S2N_DEFAULT_TEST_PRIVATE_KEY));
+    EXPECT_NOT_NULL(ecdsa_chain_and_key = load_chain_and_key(S2N_ECDSA_P384_PKCS1_CERT_CHAIN, S2N_ECDSA_P384_PKCS1_KEY));
+
+    EXPECT_NOT_NULL(rsa_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(rsa_config, rsa_chain_and_key));
+    EXPECT_NOT_NULL(ecdsa_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(ecdsa_config, ecdsa_chain_and_key));
+
+    /* Composite and CBC ciphers can be missing from the libcrypto, so stick to one that is always there */
+    memcpy(&ecdsa_preferences, ecdsa_config->cipher_preferences, sizeof(ecdsa_preferences));
+    ecdsa_preferences.count = 1;
+    ecdsa_preferences.suites = &ecdsa_suite;
+    ecdsa_config->cipher_preferences = &ecdsa_preferences;
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "test_all"));
+
+    EXPECT_NULL(s2n_sign_engine_new(0, 1000));
+    EXPECT_EQUAL(s2n_errno, S2N_ERR_INVALID_ARGUMENT);
+
+    /* Signatures made with precomputed nonces verify like any other */
+    if (S2N_LIBCRYPTO_SUPPORTS_ECDSA_SIGN_SETUP) {
+        const struct s2n_pkey *private_key = ecdsa_chain_and_key->private_key;
+        struct s2n_pkey public_key;
+        s2n_cert_type cert_type;
+        struct s2n_hash_state sign_hash, verify_hash;
+        struct s2n_blob signature = {0};
+        uint32_t missing;
+
+        EXPECT_SUCCESS(s2n_asn1der_to_public_key_and_type(&public_key, &cert_type, &ecdsa_chain_and_key->cert_chain->head->raw));
+        EXPECT_EQUAL(cert_type, S2N_CERT_TYPE_ECDSA_SIGN);
+
+        EXPECT_SUCCESS(s2n_ecdsa_nonces_init(ecdsa_chain_and_key->private_key, 4));
+        EXPECT_SUCCESS(s2n_ecdsa_nonces_missing(private_key, &missing));
+        EXPECT_EQUAL(missing, 4);
+        EXPECT_SUCCESS(s2n_ecdsa_nonces_precompute(private_key, 2));
+        EXPECT_SUCCESS(s2n_ecdsa_nonces_missing(private_key, &missing));
+        EXPECT_EQUAL(missing, 2);
+
+        EXPECT_SUCCESS(s2n_hash_new(&sign_hash));
+        EXPECT_SUCCESS(s2n_hash_new(&verify_hash));
+        EXPECT_SUCCESS(s2n_alloc(&signature, s2n_pkey_size(private_key)));
+
+        for (int i = 0; i < 3; i++) {
+            EXPECT_SUCCESS(s2n_hash_init(&sign_hash, S2N_HASH_SHA384));
+            EXPECT_SUCCESS(s2n_hash_init(&verify_hash, S2N_HASH_SHA384));
+            EXPECT_SUCCESS(s2n_hash_update(&sign_hash, "hello", 5));
+            EXPECT_SUCCESS(s2n_hash_update(&verify_hash, "hello", 5));
+
+            signature.size = s2n_pkey_size(private_key);
+            EXPECT_SUCCESS(s2n_pkey_sign(private_key, &sign_hash, &signature));
+            EXPECT_SUCCESS(s2n_pkey_verify(&public_key, &verify_hash, &signature));
+        }
+
+        /* Each nonce was used once, and the third signature went without */
+        EXPECT_SUCCESS(s2n_ecdsa_nonces_missing(private_key, &missing));
+        EXPECT_EQUAL(missing, 4);
+
+        /* The stock never grows past its capacity */
+        EXPECT_SUCCESS(s2n_ecdsa_nonces_precompute(private_key, 10));
+        EXPECT_SUCCESS(s2n_ecdsa_nonces_missing(private_key, &missing));
+        EXPECT_EQUAL(missing, 0);
+
+        /* A forked child never signs with a nonce its parent has in stock */
+        {
+            uint8_t child_signatures[4][256];
+            uint32_t child_sizes[4];
+            int fds[2];
+
+            EXPECT_TRUE(s2n_pkey_size(private_key) <= sizeof(child_signatures[0]));
+            EXPECT_SUCCESS(pipe(fds));
+
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                for (int i = 0; i < 4; i++) {
+                    EXPECT_SUCCESS(sign_hello(private_key, &signature));
+                    EXPECT_EQUAL(write(fds[1], &signature.size, sizeof(signature.size)), sizeof(signature.size));
+                    EXPECT_EQUAL(write(fds[1], signature.data, signature.size), signature.size);
+                }
+                close(fds[1]);
+
+                /* The parent's stock was thrown away rather than used */
+                EXPECT_SUCCESS(s2n_ecdsa_nonces_missing(private_key, &missing));
+                EXPECT_EQUAL(missing, 4);
+
+                exit(0);
+            }
+
+            close(fds[1]);
+            for (int i = 0; i < 4; i++) {
+                EXPECT_EQUAL(read(fds[0], &child_sizes[i], sizeof(child_sizes[i])), sizeof(child_sizes[i]));
+                EXPECT_TRUE(child_sizes[i] <= sizeof(child_signatures[i]));
+                EXPECT_EQUAL(read(fds[0], child_signatures[i], child_sizes[i]), child_sizes[i]);
+            }
+            close(fds[0]);
+
+            int status;
+            EXPECT_EQUAL(waitpid(pid, &status, 0), pid);
+            EXPECT_EQUAL(status, 0);
+
+            /* The parent still has its whole stock, and none of it was used by the child */
+            EXPECT_SUCCESS(s2n_ecdsa_nonces_missing(private_key, &missing));
+            EXPECT_EQUAL(missing, 0);
+            for (int i = 0; i < 4; i++) {
+                EXPECT_SUCCESS(sign_hello(private_key, &signature));
+                for (int j = 0; j < 4; j++) {
+                    EXPECT_FALSE(signature.size == child_sizes[j] && memcmp(signature.data, child_signatures[j], signature.size) == 0);
+                }
+            }
+            EXPECT_SUCCESS(s2n_ecdsa_nonces_missing(private_key, &missing));
+            EXPECT_EQUAL(missing, 4);
+        }
+
+        EXPECT_SUCCESS(s2n_pkey_free(&public_key));
+        EXPECT_SUCCESS(s2n_free(&signature));
+        EXPECT_SUCCESS(s2n_hash_free(&sign_hash));
+        EXPECT_SUCCESS(s2n_hash_free(&verify_hash));
+    }
+
+    EXPECT_NOT_NULL(engine = s2n_sign_engine_new(PAIRS, 1000));
+    EXPECT_SUCCESS(s2n_sign_engine_add_cert_chain_and_key(engine, rsa_chain_and_key, NONCES));
+    EXPECT_SUCCESS(s2n_sign_engine_add_cert_chain_and_key(engine, ecdsa_chain_and_key, NONCES));
+    EXPECT_SUCCESS(s2n_config_set_sign_engine(rsa_config, engine));
+    EXPECT_SUCCESS(s2n_config_set_sign_engine(ecdsa_config, engine));
+
+    /* Nothing to hand back yet */
+    {
+        struct s2n_connection *conns[PAIRS];
+        uint32_t conn_count = 1;
+
+        EXPECT_SUCCESS(s2n_sign_engine_poll(engine, conns, PAIRS, &conn_count));
+        EXPECT_EQUAL(conn_count, 0);
+    }
+
+    /* Every server hands its private key operation to the engine */
+    EXPECT_SUCCESS(try_handshakes(engine, rsa_config, client_config, &engine_results));
+    EXPECT_EQUAL(engine_results, PAIRS);
+
+    EXPECT_SUCCESS(try_handshakes(engine, ecdsa_config, client_config, &engine_results));
+    EXPECT_EQUAL(engine_results, PAIRS);
+
+    /* The engine keeps the ECDSA key's nonces topped up */
+    if (S2N_LIBCRYPTO_SUPPORTS_ECDSA_SIGN_SETUP) {
+        EXPECT_SUCCESS(wait_for_nonces(ecdsa_chain_and_key->private_key));
+        EXPECT_SUCCESS(try_handshakes(engine, ecdsa_config, client_config, &engine_results));
+        EXPECT_EQUAL(engine_results, PAIRS);
+        EXPECT_SUCCESS(wait_for_nonces(ecdsa_chain_and_key->private_key));
+    }
+
+    /* Without the engine the keys are used inline again */
+    EXPECT_SUCCESS(s2n_config_set_sign_engine(ecdsa_config, NULL));
+    EXPECT_NULL(ecdsa_config->async_pkey_cb);
+    EXPECT_SUCCESS(try_handshakes(engine, ecdsa_config, client_config, &engine_results));
+    EXPECT_EQUAL(engine_results, 0);
+
+    EXPECT_SUCCESS(s2n_sign_engine_free(engine));
+    EXPECT_SUCCESS(s2n_config_free(rsa_config));
+    EXPECT_SUCCESS(s2n_config_free(ecdsa_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(rsa_chain_and_key));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(ecdsa_chain_and_key));
+
+    END_TEST();
+}
@@ -15,6 +15,9 @@
 
 #include "s2n_test.h"
 
+#include "testlib/s2n_testlib.h"
+
+#include "stuffer/s2n_stuffer.h"
 #include "utils/s2n_blob.h"
 
 #include <s2n.h>
@@ -24,6 +27,11 @@ int raises_error()
   S2N_ERROR(S2N_ERR_INVALID_ARGUMENT);
 }
 
+int raises_blocked()
+{
+  S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
+}
+
 int main(int argc, char **argv)
 {
     BEGIN_TEST();
@@ -47,5 +55,37 @@ int main(int argc, char **argv)
 
     /* Free the stacktrace to avoid memory leaks */
     EXPECT_SUCCESS(s2n_free_stacktrace());
+
+    /* Blocking sets the error, but doesn't take a stacktrace */
+    EXPECT_FAILURE_WITH_ERRNO_NO_RESET(raises_blocked(), S2N_ERR_BLOCKED);
+    EXPECT_NOT_NULL(s2n_debug_str);
+    EXPECT_SUCCESS(s2n_get_stacktrace(&trace));
+    EXPECT_NULL(trace.trace);
+    EXPECT_EQUAL(trace.trace_size, 0);
+
+    /* Nor does a connection waiting on its peer */
+    {
+        struct s2n_connection *conn;
+        struct s2n_stuffer input, output;
+        s2n_blocked_status blocked;
+
+        EXPECT_NOT_NULL(conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&input, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&output, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&input, &output, conn));
+
+        for (int i = 0; i < 1000; i++) {
+            EXPECT_FAILURE_WITH_ERRNO_NO_RESET(s2n_negotiate(conn, &blocked), S2N_ERR_BLOCKED);
+            EXPECT_EQUAL(blocked, S2N_BLOCKED_ON_READ);
+        }
+
+        EXPECT_SUCCESS(s2n_get_stacktrace(&trace));
+        EXPECT_NULL(trace.trace);
+
+        EXPECT_SUCCESS(s2n_connection_free(conn));
+        EXPECT_SUCCESS(s2n_stuffer_free(&input));
+        EXPECT_SUCCESS(s2n_stuffer_free(&output));
+    }
+
     END_TEST();
 }
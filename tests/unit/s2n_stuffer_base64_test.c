@@ -77,6 +77,51 @@ int main(int argc, char **argv)
         EXPECT_EQUAL(memcmp(mirror.blob.data, entropy.blob.data, i), 0);
     }
 
+    /* Decoding stops cleanly at the first non-base64 character, even mid-stream */
+    {
+        struct s2n_stuffer encoded, decoded;
+        EXPECT_SUCCESS(s2n_stuffer_alloc_ro_from_string(&encoded, "SGVsbG8gd29ybGQh -----END"));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&decoded, 0));
+        EXPECT_SUCCESS(s2n_stuffer_read_base64(&encoded, &decoded));
+        EXPECT_EQUAL(s2n_stuffer_data_available(&decoded), strlen(hello_world));
+        EXPECT_EQUAL(memcmp(decoded.blob.data, hello_world, strlen(hello_world)), 0);
+        EXPECT_EQUAL(encoded.read_cursor, 16);
+        EXPECT_SUCCESS(s2n_stuffer_free(&encoded));
+        EXPECT_SUCCESS(s2n_stuffer_free(&decoded));
+    }
+
+    /* Invalid characters after the first in a group are still rejected */
+    {
+        struct s2n_stuffer encoded, decoded;
+        EXPECT_SUCCESS(s2n_stuffer_alloc_ro_from_string(&encoded, "SGVsbG8gd2!ybGQh"));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&decoded, 0));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_stuffer_read_base64(&encoded, &decoded), S2N_ERR_INVALID_BASE64);
+        EXPECT_SUCCESS(s2n_stuffer_free(&encoded));
+        EXPECT_SUCCESS(s2n_stuffer_free(&decoded));
+    }
+
+    /* Large inputs decode into a growable stuffer */
+    {
+        struct s2n_stuffer large_entropy, encoded, decoded;
+        uint8_t large_pad[3000];
+        struct s2n_blob large_r = {.data = large_pad, .size = sizeof(large_pad)};
+
+        EXPECT_SUCCESS(s2n_get_urandom_data(&large_r));
+        EXPECT_SUCCESS(s2n_stuffer_init(&large_entropy, &large_r));
+        EXPECT_SUCCESS(s2n_stuffer_skip_write(&large_entropy, sizeof(large_pad)));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&encoded, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&decoded, 0));
+
+        EXPECT_SUCCESS(s2n_stuffer_write_base64(&encoded, &large_entropy));
+        EXPECT_SUCCESS(s2n_stuffer_read_base64(&encoded, &decoded));
+        EXPECT_EQUAL(s2n_stuffer_data_available(&encoded), 0);
+        EXPECT_EQUAL(s2n_stuffer_data_available(&decoded), sizeof(large_pad));
+        EXPECT_EQUAL(memcmp(decoded.blob.data, large_pad, sizeof(large_pad)), 0);
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&encoded));
+        EXPECT_SUCCESS(s2n_stuffer_free(&decoded));
+    }
+
     EXPECT_SUCCESS(s2n_stuffer_free(&stuffer));
     EXPECT_SUCCESS(s2n_stuffer_free(&scratch));
     EXPECT_SUCCESS(s2n_stuffer_free(&mirror));
@@ -0,0 +1,409 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_connection.h"
+#include "tls/s2n_early_data.h"
+#include "tls/s2n_handshake.h"
+#include "tls/s2n_resume.h"
+#include "tls/s2n_tls.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define MAX_EARLY_DATA 1024
+
+static uint8_t ticket_key_name[16] = "2019.11.04.00\0";
+static uint8_t ticket_key[32] = { 0x07, 0x77, 0x09, 0x36, 0x2c, 0x2e, 0x32, 0xdf, 0x0d, 0xdc,
+                                  0x3f, 0x0d, 0xc4, 0x7b, 0xba, 0x63, 0x90, 0xb6, 0xc7, 0x3b,
+                                  0xb5, 0x0f, 0x9c, 0x31, 0x22, 0xec, 0x84, 0x4a, 0xd7, 0xc2,
+                                  0xb3, 0xe5 };
+
+/* A clock that runs ahead of the real one by the given number of nanoseconds */
+static int skewed_clock(void *data, uint64_t *nanoseconds)
+{
+    struct timespec current_time;
+    clock_gettime(CLOCK_REALTIME, &current_time);
+
+    *nanoseconds = current_time.tv_sec * 1000000000;
+    *nanoseconds += current_time.tv_nsec;
+    *nanoseconds += *(uint64_t *) data;
+
+    return 0;
+}
+
+static int exchange_application_data(struct s2n_connection *server_conn, struct s2n_connection *client_conn)
+{
+    uint8_t message[] = "Application data after the handshake";
+    uint8_t received[sizeof(message)];
+    s2n_blocked_status blocked;
+
+    S2N_ERROR_IF(s2n_send(server_conn, message, sizeof(message), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_recv(client_conn, received, sizeof(received), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(memcmp(message, received, sizeof(message)), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_send(client_conn, message, sizeof(message), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_recv(server_conn, received, sizeof(received), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(memcmp(message, received, sizeof(message)), S2N_ERR_SAFETY);
+
+    return 0;
+}
+
+struct early_data_result {
+    ssize_t sent;
+    ssize_t received;
+    uint8_t received_data[2 * MAX_EARLY_DATA];
+    int client_accepted;
+    int server_accepted;
+    uint32_t server_handshake_type;
+};
+
+/* Runs a handshake between new connections, sending early data behind the ClientHello, and
+ * replaces the session with whatever the client has afterwards. What the client sent up to
+ * its early data is copied to client_hello if it is not NULL.
+ */
+static int handshake(struct s2n_config *server_config, struct s2n_config *client_config,
+        uint8_t *session, int *session_length, const uint8_t *data, ssize_t data_len,
+        struct early_data_result *result, struct s2n_stuffer *client_hello)
+{
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+    s2n_blocked_status blocked;
+
+    notnull_check(server_conn = s2n_connection_new(S2N_SERVER));
+    notnull_check(client_conn = s2n_connection_new(S2N_CLIENT));
+    GUARD(s2n_connection_set_config(server_conn, server_config));
+    GUARD(s2n_connection_set_config(client_conn, client_config));
+    if (*session_length > 0) {
+        GUARD(s2n_connection_set_session(client_conn, session, *session_length));
+    }
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    int r = result->sent = s2n_send_early_data(client_conn, data, data_len, &blocked);
+    if (r >= 0 && client_hello) {
+        r = s2n_stuffer_write_bytes(client_hello, client_to_server.blob.data + client_to_server.read_cursor,
+                s2n_stuffer_data_available(&client_to_server));
+    }
+    if (r >= 0) {
+        r = result->received = s2n_recv_early_data(server_conn, result->received_data, sizeof(result->received_data), &blocked);
+    }
+    if (r >= 0) {
+        r = s2n_negotiate_test_server_and_client(server_conn, client_conn);
+    }
+    if (r == 0) {
+        r = exchange_application_data(server_conn, client_conn);
+    }
+    if (r == 0) {
+        result->client_accepted = s2n_connection_is_early_data_accepted(client_conn);
+        result->server_accepted = s2n_connection_is_early_data_accepted(server_conn);
+        result->server_handshake_type = server_conn->handshake.handshake_type;
+        r = *session_length = s2n_connection_get_session(client_conn, session, S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES + 512);
+    }
+
+    GUARD(s2n_connection_free(server_conn));
+    GUARD(s2n_connection_free(client_conn));
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return r < 0 ? r : 0;
+}
+
+/* A shared store with room for one ClientHello, that checks and records it in one step */
+static uint8_t replay_entry[64];
+static uint64_t replay_entry_size;
+static int replay_checks;
+
+static int check_and_record(struct s2n_connection *conn, void *ctx, uint64_t ttl, const void *key, uint64_t key_size)
+{
+    S2N_ERROR_IF(key_size > sizeof(replay_entry), S2N_ERR_SAFETY);
+    replay_checks++;
+
+    if (key_size == replay_entry_size && memcmp(key, replay_entry, key_size) == 0) {
+        return 1;
+    }
+
+    memcpy(replay_entry, key, key_size);
+    replay_entry_size = key_size;
+
+    return 0;
+}
+
+static int failing_check_and_record(struct s2n_connection *conn, void *ctx, uint64_t ttl, const void *key, uint64_t key_size)
+{
+    return -1;
+}
+
+/* The session cache only stores sessions, it doesn't know about early data */
+static int cache_store(struct s2n_connection *conn, void *ctx, uint64_t ttl, const void *key, uint64_t key_size,
+        const void *value, uint64_t value_size)
+{
+    return 0;
+}
+
+static int cache_retrieve(struct s2n_connection *conn, void *ctx, const void *key, uint64_t key_size,
+        void *value, uint64_t *value_size)
+{
+    return -1;
+}
+
+static int cache_delete(struct s2n_connection *conn, void *ctx, const void *key, uint64_t key_size)
+{
+    return 0;
+}
+
+/* Sends what a client sent before to a new server, which mustn't accept its early data again */
+static int replay(struct s2n_config *server_config, struct s2n_stuffer *client_hello)
+{
+    struct s2n_connection *server_conn;
+    struct s2n_stuffer server_to_client;
+    s2n_blocked_status blocked;
+    uint8_t received[MAX_EARLY_DATA];
+
+    notnull_check(server_conn = s2n_connection_new(S2N_SERVER));
+    GUARD(s2n_connection_set_config(server_conn, server_config));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(client_hello, &server_to_client, server_conn));
+
+    int r = s2n_recv_early_data(server_conn, received, sizeof(received), &blocked);
+    if (r == 0 && (!server_conn->tls13_psk.accepted || s2n_connection_is_early_data_accepted(server_conn))) {
+        r = -1;
+    }
+
+    GUARD(s2n_connection_free(server_conn));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_config *server_config, *client_config;
+    char cert_chain[S2N_MAX_TEST_PEM_SIZE];
+    char private_key[S2N_MAX_TEST_PEM_SIZE];
+
+    uint8_t session[S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES + 512];
+    int session_length;
+    struct early_data_result result;
+    uint8_t early_data[2 * MAX_EARLY_DATA];
+    uint64_t skew = 0;
+
+    BEGIN_TEST();
+
+    for (int i = 0; i < sizeof(early_data); i++) {
+        early_data[i] = i;
+    }
+
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain, private_key));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(server_config, "default_tls13"));
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    EXPECT_SUCCESS(s2n_config_set_session_tickets_onoff(server_config, 1));
+    EXPECT_SUCCESS(s2n_config_add_ticket_crypto_key(server_config, ticket_key_name, strlen((char *) ticket_key_name),
+            ticket_key, sizeof(ticket_key), 0));
+    EXPECT_SUCCESS(s2n_config_set_max_early_data_size(server_config, MAX_EARLY_DATA));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "default_tls13"));
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_session_tickets_onoff(client_config, 1));
+
+    /* The replay window needs a window */
+    EXPECT_FAILURE_WITH_ERRNO(s2n_config_set_early_data_replay_window(server_config, 0, 100), S2N_ERR_INVALID_ARGUMENT);
+
+    /* Only clients send early data, and only servers receive it */
+    {
+        struct s2n_connection *conn;
+        s2n_blocked_status blocked;
+
+        EXPECT_NOT_NULL(conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_send_early_data(conn, early_data, 1, &blocked), S2N_ERR_SERVER_MODE);
+        EXPECT_SUCCESS(s2n_connection_free(conn));
+
+        EXPECT_NOT_NULL(conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_recv_early_data(conn, early_data, 1, &blocked), S2N_ERR_CLIENT_MODE);
+        EXPECT_SUCCESS(s2n_connection_free(conn));
+    }
+
+    /* Without a ticket there is no early data, and the server issues a ticket that allows it */
+    {
+        session_length = 0;
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        EXPECT_EQUAL(result.sent, 0);
+        EXPECT_EQUAL(result.received, 0);
+        EXPECT_FALSE(result.client_accepted);
+        EXPECT_FALSE(result.server_accepted);
+        EXPECT_TRUE(IS_FULL_HANDSHAKE(result.server_handshake_type));
+        EXPECT_EQUAL(session[0], S2N_STATE_WITH_TLS13_TICKET);
+    }
+
+    /* The ticket lets the client send early data the server reads before the handshake completes */
+    {
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        EXPECT_EQUAL(result.sent, 100);
+        EXPECT_EQUAL(result.received, 100);
+        EXPECT_BYTEARRAY_EQUAL(result.received_data, early_data, 100);
+        EXPECT_TRUE(result.client_accepted);
+        EXPECT_TRUE(result.server_accepted);
+        EXPECT_FALSE(IS_FULL_HANDSHAKE(result.server_handshake_type));
+        EXPECT_TRUE(IS_EARLY_DATA_HANDSHAKE(result.server_handshake_type));
+    }
+
+    /* The client sends no more early data than the ticket allows */
+    {
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, sizeof(early_data),
+                &result, NULL));
+
+        EXPECT_EQUAL(result.sent, MAX_EARLY_DATA);
+        EXPECT_EQUAL(result.received, MAX_EARLY_DATA);
+        EXPECT_BYTEARRAY_EQUAL(result.received_data, early_data, MAX_EARLY_DATA);
+        EXPECT_TRUE(result.server_accepted);
+    }
+
+    /* A ClientHello seen before is a replay: its early data is not accepted */
+    {
+        struct s2n_stuffer client_hello;
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_hello, 0));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, &client_hello));
+        EXPECT_TRUE(result.server_accepted);
+
+        EXPECT_SUCCESS(replay(server_config, &client_hello));
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_hello));
+    }
+
+    /* A server that no longer takes early data skips it, and the handshake goes on */
+    {
+        EXPECT_SUCCESS(s2n_config_set_max_early_data_size(server_config, 0));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        EXPECT_EQUAL(result.sent, 100);
+        EXPECT_EQUAL(result.received, 0);
+        EXPECT_FALSE(result.client_accepted);
+        EXPECT_FALSE(result.server_accepted);
+        EXPECT_FALSE(IS_FULL_HANDSHAKE(result.server_handshake_type));
+        EXPECT_FALSE(IS_EARLY_DATA_HANDSHAKE(result.server_handshake_type));
+
+        /* The ticket it issued doesn't allow early data */
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        EXPECT_EQUAL(result.sent, 0);
+        EXPECT_FALSE(result.client_accepted);
+        EXPECT_FALSE(IS_FULL_HANDSHAKE(result.server_handshake_type));
+
+        EXPECT_SUCCESS(s2n_config_set_max_early_data_size(server_config, MAX_EARLY_DATA));
+    }
+
+    /* A ClientHello whose ticket age is off by more than the window allows is too old for early data */
+    {
+        session_length = 0;
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        skew = 6 * (uint64_t) ONE_SEC_IN_NANOS;
+        EXPECT_SUCCESS(s2n_config_set_wall_clock(server_config, skewed_clock, &skew));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        EXPECT_EQUAL(result.sent, 100);
+        EXPECT_EQUAL(result.received, 0);
+        EXPECT_FALSE(result.server_accepted);
+        EXPECT_FALSE(IS_FULL_HANDSHAKE(result.server_handshake_type));
+
+        skew = 0;
+    }
+
+    /* A TLS1.2 server can't make sense of early data, which is why it is only sent with a TLS1.3 ticket */
+    {
+        struct s2n_config *tls12_server_config;
+        EXPECT_NOT_NULL(tls12_server_config = s2n_config_new());
+        EXPECT_SUCCESS(s2n_config_set_cipher_preferences(tls12_server_config, "default"));
+        EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(tls12_server_config, chain_and_key));
+
+        session_length = 0;
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        EXPECT_FAILURE(handshake(tls12_server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+
+        EXPECT_SUCCESS(s2n_config_free(tls12_server_config));
+    }
+
+    /* A server with session cache callbacks still uses its own filter for early data */
+    {
+        struct s2n_stuffer client_hello;
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_hello, 0));
+
+        EXPECT_SUCCESS(s2n_config_set_cache_store_callback(server_config, cache_store, NULL));
+        EXPECT_SUCCESS(s2n_config_set_cache_retrieve_callback(server_config, cache_retrieve, NULL));
+        EXPECT_SUCCESS(s2n_config_set_cache_delete_callback(server_config, cache_delete, NULL));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, &client_hello));
+        EXPECT_TRUE(result.server_accepted);
+
+        /* The cache never remembers anything, so it would have let the replay through */
+        EXPECT_SUCCESS(replay(server_config, &client_hello));
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_hello));
+    }
+
+    /* Servers sharing tickets can remember the ClientHellos they have seen through the replay callback */
+    {
+        struct s2n_stuffer client_hello;
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_hello, 0));
+
+        EXPECT_SUCCESS(s2n_config_set_early_data_replay_callback(server_config, check_and_record, NULL));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, &client_hello));
+        EXPECT_TRUE(result.server_accepted);
+        EXPECT_EQUAL(replay_checks, 1);
+
+        EXPECT_SUCCESS(replay(server_config, &client_hello));
+        EXPECT_EQUAL(replay_checks, 2);
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_hello));
+    }
+
+    /* A callback that can't tell counts as having seen the ClientHello */
+    {
+        EXPECT_SUCCESS(s2n_config_set_early_data_replay_callback(server_config, failing_check_and_record, NULL));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, early_data, 100, &result, NULL));
+        EXPECT_FALSE(result.server_accepted);
+
+        EXPECT_SUCCESS(s2n_config_set_early_data_replay_callback(server_config, NULL, NULL));
+    }
+
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+
+    END_TEST();
+}
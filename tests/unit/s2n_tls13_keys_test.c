@@ -146,6 +146,28 @@ int main(int argc, char **argv)
         "860c06edc07858ee8e78f0e7428c58ed"
         "d6b43f2ca3e6e95f02ed063cf0e1cad8");
 
+    S2N_BLOB_FROM_HEX(client_finished,
+        "14000020a8ec436d677634ae525ac1fcebe1"
+        "1a039ec17694fac6e98527b642f2edd5ce61");
+
+    S2N_BLOB_FROM_HEX(expect_resumption_master_secret,
+        "7df235f2031d2a051287d02b0241b0bf"
+        "daf86cc856231f2d5aba46c434ec196c");
+
+    S2N_BLOB_FROM_HEX(ticket_nonce, "0000");
+
+    S2N_BLOB_FROM_HEX(expect_resumption_psk,
+        "4ecd0eb6ec3b4d87f5d6028f922ca4c5"
+        "851a277fd41311c9e62d2c9492e1c4f3");
+
+    S2N_BLOB_FROM_HEX(expect_resumption_early_secret,
+        "9b2188e9b2fc6d64d71dc329900e20bb"
+        "41915000f678aa839cbb797cb7d8332c");
+
+    S2N_BLOB_FROM_HEX(expect_resumption_binder_key,
+        "69fe131a3bbad5d63c64eebcc30e395b"
+        "9d8107726a13d074e389dbc8a4e47256");
+
     BEGIN_TEST();
 
     DEFER_CLEANUP(struct s2n_tls13_keys secrets = {0}, s2n_tls13_keys_free);
@@ -153,7 +175,7 @@ int main(int argc, char **argv)
     EXPECT_SUCCESS(s2n_tls13_keys_init(&secrets, S2N_HMAC_SHA256));
 
     /* Derive Early Secrets */
-    EXPECT_SUCCESS(s2n_tls13_derive_early_secrets(&secrets));
+    EXPECT_SUCCESS(s2n_tls13_derive_early_secrets(&secrets, NULL));
 
     S2N_BLOB_EXPECT_EQUAL(secrets.extract_secret, expected_early_secret);
     S2N_BLOB_EXPECT_EQUAL(secrets.derive_secret, expect_derived_handshake_secret);
@@ -240,5 +262,26 @@ int main(int argc, char **argv)
     S2N_BLOB_EXPECT_EQUAL(expect_handshake_traffic_server_key, handshake_traffic_server_key);
     S2N_BLOB_EXPECT_EQUAL(expect_handshake_traffic_server_iv, handshake_traffic_server_iv);
 
+    /* Derive the resumption master secret after the client Finished, and the PSK of a ticket with that nonce */
+    EXPECT_SUCCESS(s2n_hash_update(&hash_state, client_finished.data, client_finished.size));
+
+    s2n_tls13_key_blob(resumption_master_secret, secrets.size);
+    EXPECT_SUCCESS(s2n_tls13_derive_resumption_master_secret(&secrets, &hash_state, &resumption_master_secret));
+    S2N_BLOB_EXPECT_EQUAL(expect_resumption_master_secret, resumption_master_secret);
+
+    s2n_tls13_key_blob(resumption_psk, secrets.size);
+    EXPECT_SUCCESS(s2n_tls13_derive_resumption_psk(&secrets, &resumption_master_secret, &ticket_nonce, &resumption_psk));
+    S2N_BLOB_EXPECT_EQUAL(expect_resumption_psk, resumption_psk);
+
+    /* The resumed handshake starts its key schedule with the PSK, which also gives the binder key */
+    DEFER_CLEANUP(struct s2n_tls13_keys resumption_secrets = {0}, s2n_tls13_keys_free);
+    EXPECT_SUCCESS(s2n_tls13_keys_init(&resumption_secrets, S2N_HMAC_SHA256));
+    EXPECT_SUCCESS(s2n_tls13_derive_early_secrets(&resumption_secrets, &resumption_psk));
+    S2N_BLOB_EXPECT_EQUAL(expect_resumption_early_secret, resumption_secrets.extract_secret);
+
+    s2n_tls13_key_blob(binder_key, resumption_secrets.size);
+    EXPECT_SUCCESS(s2n_tls13_derive_binder_key(&resumption_secrets, &binder_key));
+    S2N_BLOB_EXPECT_EQUAL(expect_resumption_binder_key, binder_key);
+
     END_TEST();
 }
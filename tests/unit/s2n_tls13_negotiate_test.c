@@ -0,0 +1,341 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_ecc.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_handshake.h"
+#include "tls/s2n_signature_scheme.h"
+#include "stuffer/s2n_stuffer.h"
+
+static const uint8_t tls12_downgrade_bytes[] = { 0x44, 0x4F, 0x57, 0x4E, 0x47, 0x52, 0x44, 0x01 };
+
+/* Application data is protected with the negotiated keys in both directions */
+static int exchange_application_data(struct s2n_connection *server_conn, struct s2n_connection *client_conn)
+{
+    uint8_t message[] = "Application data after the handshake";
+    uint8_t received[sizeof(message)];
+    s2n_blocked_status blocked;
+
+    S2N_ERROR_IF(s2n_send(client_conn, message, sizeof(message), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_recv(server_conn, received, sizeof(received), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(memcmp(message, received, sizeof(message)), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_send(server_conn, message, sizeof(message), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_recv(client_conn, received, sizeof(received), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(memcmp(message, received, sizeof(message)), S2N_ERR_SAFETY);
+
+    return 0;
+}
+
+static int negotiate(struct s2n_connection *server_conn, struct s2n_connection *client_conn)
+{
+    struct s2n_stuffer client_to_server, server_to_client;
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    int r = s2n_negotiate_test_server_and_client(server_conn, client_conn);
+    if (r == 0) {
+        r = exchange_application_data(server_conn, client_conn);
+    }
+
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return r;
+}
+
+/* Renames the key shares for P-256 and P-384 in a ClientHello to groups s2n doesn't support,
+ * as if the client only had key shares for other groups.
+ */
+static int hide_key_shares(uint8_t *data, uint32_t size)
+{
+    const uint8_t p256_share[] = { 0x00, 0x17, 0x00, 0x41, 0x04 };
+    const uint8_t p384_share[] = { 0x00, 0x18, 0x00, 0x61, 0x04 };
+    int hidden = 0;
+
+    for (uint32_t i = 0; i + sizeof(p256_share) <= size; i++) {
+        if (!memcmp(data + i, p256_share, sizeof(p256_share)) || !memcmp(data + i, p384_share, sizeof(p384_share))) {
+            data[i] = 0x01;
+            hidden++;
+        }
+    }
+
+    return hidden;
+}
+
+/* The client writes its ClientHello, which loses all its usable key shares on the way */
+static int client_hello_without_key_shares(struct s2n_connection *client_conn, struct s2n_stuffer *client_to_server)
+{
+    s2n_blocked_status blocked;
+
+    S2N_ERROR_IF(s2n_negotiate(client_conn, &blocked) == 0 || s2n_errno != S2N_ERR_BLOCKED, S2N_ERR_SAFETY);
+    S2N_ERROR_IF(hide_key_shares(client_to_server->blob.data, client_to_server->write_cursor) == 0, S2N_ERR_SAFETY);
+
+    /* The client hashes the same ClientHello the server receives */
+    struct s2n_stuffer *transcript = &client_conn->handshake.transcript;
+    if (s2n_stuffer_data_available(transcript)) {
+        S2N_ERROR_IF(hide_key_shares(transcript->blob.data, transcript->write_cursor) == 0, S2N_ERR_SAFETY);
+    }
+
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        GUARD(s2n_ecc_params_free(&client_conn->secure.client_ecc_params[i]));
+        client_conn->secure.client_ecc_params[i].negotiated_curve = NULL;
+    }
+
+    return 0;
+}
+
+static struct s2n_cert_chain_and_key *load_chain_and_key(const char *cert_chain_file, const char *private_key_file)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    char cert_chain_pem[S2N_MAX_TEST_PEM_SIZE];
+    char private_key_pem[S2N_MAX_TEST_PEM_SIZE];
+
+    if (s2n_read_test_pem(cert_chain_file, cert_chain_pem, S2N_MAX_TEST_PEM_SIZE) < 0
+            || s2n_read_test_pem(private_key_file, private_key_pem, S2N_MAX_TEST_PEM_SIZE) < 0) {
+        return NULL;
+    }
+    if ((chain_and_key = s2n_cert_chain_and_key_new()) == NULL) {
+        return NULL;
+    }
+    if (s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain_pem, private_key_pem) < 0) {
+        s2n_cert_chain_and_key_free(chain_and_key);
+        return NULL;
+    }
+
+    return chain_and_key;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *rsa_chain_and_key, *ecdsa_chain_and_key;
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_config *rsa_config, *ecdsa_config, *tls12_config;
+
+    BEGIN_TEST();
+
+    EXPECT_NOT_NULL(rsa_chain_and_key = load_chain_and_key(S2N_DEFAULT_TEST_CERT_CHAIN, S2N_DEFAULT_TEST_PRIVATE_KEY));
+    EXPECT_NOT_NULL(ecdsa_chain_and_key = load_chain_and_key(S2N_ECDSA_P384_PKCS1_CERT_CHAIN, S2N_ECDSA_P384_PKCS1_KEY));
+
+    /* TLS1.3 is opted into with cipher preferences that contain TLS1.3 cipher suites */
+    EXPECT_NOT_NULL(rsa_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(rsa_config, "default_tls13"));
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(rsa_config, rsa_chain_and_key));
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(rsa_config));
+
+    EXPECT_NOT_NULL(ecdsa_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(ecdsa_config, "default_tls13"));
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(ecdsa_config, ecdsa_chain_and_key));
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(ecdsa_config));
+
+    EXPECT_NOT_NULL(tls12_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(tls12_config, "default"));
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(tls12_config, rsa_chain_and_key));
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(tls12_config));
+
+    /* An RSA certificate signs the TLS1.3 CertificateVerify with RSA-PSS */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, rsa_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, rsa_config));
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->actual_protocol_version, S2N_TLS13);
+        EXPECT_EQUAL(client_conn->actual_protocol_version, S2N_TLS13);
+        EXPECT_EQUAL(server_conn->secure.conn_sig_scheme.iana_value, s2n_rsa_pss_rsae_sha256.iana_value);
+        EXPECT_EQUAL(client_conn->secure.conn_sig_scheme.iana_value, s2n_rsa_pss_rsae_sha256.iana_value);
+        EXPECT_EQUAL(server_conn->secure.cipher_suite, client_conn->secure.cipher_suite);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* An ECDSA certificate signs with the scheme for its own curve */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, ecdsa_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, rsa_config));
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->actual_protocol_version, S2N_TLS13);
+        EXPECT_EQUAL(client_conn->actual_protocol_version, S2N_TLS13);
+        EXPECT_EQUAL(server_conn->secure.conn_sig_scheme.iana_value, s2n_ecdsa_secp384r1_sha384.iana_value);
+        EXPECT_EQUAL(client_conn->secure.conn_sig_scheme.iana_value, s2n_ecdsa_secp384r1_sha384.iana_value);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* A TLS1.3 client falls back to TLS1.2 with a server that doesn't support TLS1.3 */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, tls12_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, rsa_config));
+        EXPECT_EQUAL(client_conn->client_protocol_version, S2N_TLS13);
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->actual_protocol_version, S2N_TLS12);
+        EXPECT_EQUAL(client_conn->actual_protocol_version, S2N_TLS12);
+        EXPECT_NOT_EQUAL(memcmp(&client_conn->secure.server_random[S2N_TLS_RANDOM_DATA_LEN - sizeof(tls12_downgrade_bytes)],
+                tls12_downgrade_bytes, sizeof(tls12_downgrade_bytes)), 0);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* A TLS1.3 server negotiating TLS1.2 marks the server random for the client */
+    {
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, rsa_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, tls12_config));
+        EXPECT_EQUAL(client_conn->client_protocol_version, S2N_TLS12);
+
+        EXPECT_SUCCESS(negotiate(server_conn, client_conn));
+        EXPECT_EQUAL(server_conn->actual_protocol_version, S2N_TLS12);
+        EXPECT_EQUAL(client_conn->actual_protocol_version, S2N_TLS12);
+        EXPECT_BYTEARRAY_EQUAL(&client_conn->secure.server_random[S2N_TLS_RANDOM_DATA_LEN - sizeof(tls12_downgrade_bytes)],
+                tls12_downgrade_bytes, sizeof(tls12_downgrade_bytes));
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* A TLS1.3 client rejects a TLS1.2 ServerHello from a server that supports TLS1.3 */
+    {
+        struct s2n_stuffer client_to_server, server_to_client;
+        s2n_blocked_status blocked;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, rsa_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, tls12_config));
+        EXPECT_SUCCESS(s2n_connection_set_blinding(client_conn, S2N_SELF_SERVICE_BLINDING));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(client_conn, &blocked), S2N_ERR_BLOCKED);
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(server_conn, &blocked), S2N_ERR_BLOCKED);
+
+        /* The ClientHello looked like TLS1.2 to the server, as if supported_versions was stripped on the way */
+        client_conn->client_protocol_version = S2N_TLS13;
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(client_conn, &blocked), S2N_ERR_PROTOCOL_DOWNGRADE_DETECTED);
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* A server without a usable key share asks for one with a HelloRetryRequest */
+    {
+        struct s2n_stuffer client_to_server, server_to_client;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, rsa_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, rsa_config));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_SUCCESS(client_hello_without_key_shares(client_conn, &client_to_server));
+        EXPECT_SUCCESS(s2n_negotiate_test_server_and_client(server_conn, client_conn));
+        EXPECT_SUCCESS(exchange_application_data(server_conn, client_conn));
+
+        EXPECT_EQUAL(server_conn->handshake.handshake_type, NEGOTIATED | FULL_HANDSHAKE | HELLO_RETRY_REQUEST);
+        EXPECT_EQUAL(client_conn->handshake.handshake_type, NEGOTIATED | FULL_HANDSHAKE | HELLO_RETRY_REQUEST);
+        EXPECT_STRING_EQUAL(s2n_connection_get_handshake_type_name(client_conn), "NEGOTIATED|FULL_HANDSHAKE|HELLO_RETRY_REQUEST");
+        EXPECT_EQUAL(server_conn->secure.server_ecc_params.negotiated_curve, s2n_ecc_supported_curves[0]);
+        EXPECT_EQUAL(client_conn->secure.server_ecc_params.negotiated_curve, s2n_ecc_supported_curves[0]);
+
+        /* Only the requested key share was generated for the second ClientHello */
+        for (int i = 1; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+            EXPECT_NULL(client_conn->secure.client_ecc_params[i].ec_key);
+        }
+
+        /* The message_hash standing in for the first ClientHello only needed the cipher suite's hash */
+        struct s2n_connection *conns[] = { server_conn, client_conn };
+        for (int i = 0; i < 2; i++) {
+            s2n_hash_algorithm transcript_hash_alg;
+            EXPECT_SUCCESS(s2n_hmac_hash_alg(conns[i]->secure.cipher_suite->tls12_prf_alg, &transcript_hash_alg));
+            for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+                EXPECT_EQUAL(s2n_handshake_is_hash_required(&conns[i]->handshake, hash_alg), hash_alg == transcript_hash_alg);
+            }
+        }
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    /* The server only retries once */
+    {
+        struct s2n_stuffer client_to_server, server_to_client;
+        s2n_blocked_status blocked;
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, rsa_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, rsa_config));
+        EXPECT_SUCCESS(s2n_connection_set_blinding(server_conn, S2N_SELF_SERVICE_BLINDING));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_SUCCESS(client_hello_without_key_shares(client_conn, &client_to_server));
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(server_conn, &blocked), S2N_ERR_BLOCKED);
+        EXPECT_EQUAL(s2n_conn_get_current_message_type(server_conn), CLIENT_HELLO);
+
+        /* The second ClientHello doesn't have the requested key share either */
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(client_conn, &blocked), S2N_ERR_BLOCKED);
+        EXPECT_EQUAL(hide_key_shares(client_to_server.blob.data, client_to_server.write_cursor), 1);
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(server_conn, &blocked), S2N_ERR_BAD_KEY_SHARE);
+
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+    }
+
+    EXPECT_SUCCESS(s2n_config_free(rsa_config));
+    EXPECT_SUCCESS(s2n_config_free(ecdsa_config));
+    EXPECT_SUCCESS(s2n_config_free(tls12_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(rsa_chain_and_key));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(ecdsa_chain_and_key));
+
+    END_TEST();
+}
@@ -103,8 +103,10 @@ int main(int argc, char **argv)
         struct s2n_connection *conn;
         uint8_t certificate_request_context_len;
 
-        struct s2n_cert cert = {.raw = tls13_cert_chain,.next = NULL};
-        struct s2n_cert_chain cert_chain = {.head = &cert};
+        /* The hex ends with the CertificateEntry's empty extensions, which aren't part of the certificate */
+        struct s2n_blob raw_cert = {.data = tls13_cert_chain.data, .size = tls13_cert_chain.size - 2};
+        struct s2n_cert cert = {.raw = raw_cert,.next = NULL};
+        struct s2n_cert_chain cert_chain = {.head = &cert, .chain_size = raw_cert.size + 3};
         struct s2n_cert_chain_and_key cert_chain_and_key = {.cert_chain = &cert_chain};
 
         /* tls13 mode */
@@ -114,6 +116,7 @@ int main(int argc, char **argv)
         EXPECT_EQUAL(conn->actual_protocol_version, S2N_TLS13);
         EXPECT_SUCCESS(s2n_server_cert_send(conn));
         EXPECT_EQUAL(s2n_stuffer_data_available(&conn->handshake.io), tls13_cert.size);
+        EXPECT_BYTEARRAY_EQUAL(s2n_stuffer_raw_read(&conn->handshake.io, 0), tls13_cert.data, tls13_cert.size);
         GUARD(s2n_stuffer_read_uint8(&conn->handshake.io, &certificate_request_context_len));
         /* server's certificate request context should always be of zero length */
         EXPECT_EQUAL(certificate_request_context_len, 0);
@@ -125,14 +128,13 @@ int main(int argc, char **argv)
         conn->handshake_params.our_chain_and_key = &cert_chain_and_key;
         EXPECT_EQUAL(conn->actual_protocol_version, S2N_TLS12);
         EXPECT_SUCCESS(s2n_server_cert_send(conn));
-        /* In tls1.2 there is no certificate request context.
-           TLS1.2 Cert length = TLS1.3 Cert length -1 (server's request context)*/
-        EXPECT_EQUAL(s2n_stuffer_data_available(&conn->handshake.io), tls13_cert.size - 1);
+        /* In tls1.2 there is no certificate request context or certificate extensions.
+           TLS1.2 Cert length = TLS1.3 Cert length -1 (server's request context) -2 (extensions length) */
+        EXPECT_EQUAL(s2n_stuffer_data_available(&conn->handshake.io), tls13_cert.size - 3);
         EXPECT_SUCCESS(s2n_connection_free(conn));
     }
 
     free(tls13_cert_chain_hex);
-    /* free memory allocated in s2n_alloc*/
-    free(tls13_cert.data);
+    EXPECT_SUCCESS(s2n_free(&tls13_cert));
     END_TEST();
 }
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "s2n_test.h"
+
+#include "testlib/s2n_testlib.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <s2n.h>
+
+#include "tls/extensions/s2n_client_psk_key_exchange_modes.h"
+#include "tls/s2n_client_extensions.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_handshake.h"
+#include "tls/s2n_resume.h"
+#include "tls/s2n_tls.h"
+#include "stuffer/s2n_stuffer.h"
+
+static uint8_t ticket_key_name[16] = "2019.11.04.00\0";
+static uint8_t ticket_key[32] = { 0x07, 0x77, 0x09, 0x36, 0x2c, 0x2e, 0x32, 0xdf, 0x0d, 0xdc,
+                                  0x3f, 0x0d, 0xc4, 0x7b, 0xba, 0x63, 0x90, 0xb6, 0xc7, 0x3b,
+                                  0xb5, 0x0f, 0x9c, 0x31, 0x22, 0xec, 0x84, 0x4a, 0xd7, 0xc2,
+                                  0xb3, 0xe5 };
+static uint8_t other_ticket_key_name[16] = "2019.11.05.00\0";
+static uint8_t other_ticket_key[32] = { 0x06, 0xa6, 0xb8, 0x8c, 0x58, 0x53, 0x36, 0x1a, 0x06, 0x10,
+                                        0x4c, 0x9c, 0xeb, 0x35, 0xb4, 0x5c, 0xef, 0x76, 0x00, 0x14,
+                                        0x90, 0x46, 0x71, 0x01, 0x4a, 0x19, 0x3f, 0x40, 0xc1, 0x5f,
+                                        0xc2, 0x44 };
+
+/* A clock that runs ahead of the real one by the given number of nanoseconds */
+static int skewed_clock(void *data, uint64_t *nanoseconds)
+{
+    struct timespec current_time;
+    clock_gettime(CLOCK_REALTIME, &current_time);
+
+    *nanoseconds = current_time.tv_sec * 1000000000;
+    *nanoseconds += current_time.tv_nsec;
+    *nanoseconds += *(uint64_t *) data;
+
+    return 0;
+}
+
+/* Rewrites the psk_key_exchange_modes the server sees to psk_ke only. The binder covers the
+ * raw ClientHello rather than the parsed extensions, so the PSK is still accepted.
+ */
+static int offer_psk_ke_only(struct s2n_connection *conn, void *ctx)
+{
+    struct s2n_client_hello_parsed_extension parsed_extension;
+    GUARD(s2n_client_hello_get_parsed_extension(conn->client_hello.parsed_extensions,
+            TLS_EXTENSION_PSK_KEY_EXCHANGE_MODES, &parsed_extension));
+
+    for (int i = 1; i < parsed_extension.extension.size; i++) {
+        parsed_extension.extension.data[i] = TLS_PSK_KE_MODE;
+    }
+
+    return 0;
+}
+
+/* Application data is protected with the negotiated keys in both directions. This is also where
+ * the client reads the NewSessionTicket the server sent after its Finished.
+ */
+static int exchange_application_data(struct s2n_connection *server_conn, struct s2n_connection *client_conn)
+{
+    uint8_t message[] = "Application data after the handshake";
+    uint8_t received[sizeof(message)];
+    s2n_blocked_status blocked;
+
+    S2N_ERROR_IF(s2n_send(server_conn, message, sizeof(message), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_recv(client_conn, received, sizeof(received), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(memcmp(message, received, sizeof(message)), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_send(client_conn, message, sizeof(message), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(s2n_recv(server_conn, received, sizeof(received), &blocked) != sizeof(message), S2N_ERR_SAFETY);
+    S2N_ERROR_IF(memcmp(message, received, sizeof(message)), S2N_ERR_SAFETY);
+
+    return 0;
+}
+
+/* Runs a handshake between new connections, resuming the session if there is one, and
+ * replaces the session with whatever the client has afterwards.
+ */
+static int handshake(struct s2n_config *server_config, struct s2n_config *client_config,
+        uint8_t *session, int *session_length, uint32_t *server_handshake_type, struct s2n_tls13_psk *server_psk)
+{
+    struct s2n_connection *server_conn, *client_conn;
+    struct s2n_stuffer client_to_server, server_to_client;
+
+    notnull_check(server_conn = s2n_connection_new(S2N_SERVER));
+    notnull_check(client_conn = s2n_connection_new(S2N_CLIENT));
+    GUARD(s2n_connection_set_config(server_conn, server_config));
+    GUARD(s2n_connection_set_config(client_conn, client_config));
+    if (*session_length > 0) {
+        GUARD(s2n_connection_set_session(client_conn, session, *session_length));
+    }
+
+    GUARD(s2n_stuffer_growable_alloc(&client_to_server, 0));
+    GUARD(s2n_stuffer_growable_alloc(&server_to_client, 0));
+    GUARD(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+    GUARD(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+    int r = s2n_negotiate_test_server_and_client(server_conn, client_conn);
+    if (r == 0) {
+        r = exchange_application_data(server_conn, client_conn);
+    }
+    if (r == 0) {
+        *server_handshake_type = server_conn->handshake.handshake_type;
+        *server_psk = server_conn->tls13_psk;
+        r = *session_length = s2n_connection_get_session(client_conn, session, S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES + 512);
+    }
+
+    GUARD(s2n_connection_free(server_conn));
+    GUARD(s2n_connection_free(client_conn));
+    GUARD(s2n_stuffer_free(&client_to_server));
+    GUARD(s2n_stuffer_free(&server_to_client));
+
+    return r < 0 ? r : 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct s2n_cert_chain_and_key *chain_and_key;
+    struct s2n_config *server_config, *client_config;
+    char cert_chain[S2N_MAX_TEST_PEM_SIZE];
+    char private_key[S2N_MAX_TEST_PEM_SIZE];
+
+    uint8_t session[S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES + 512];
+    int session_length;
+    uint32_t handshake_type;
+    struct s2n_tls13_psk server_psk;
+    uint64_t skew = 0;
+
+    BEGIN_TEST();
+
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_CERT_CHAIN, cert_chain, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_SUCCESS(s2n_read_test_pem(S2N_DEFAULT_TEST_PRIVATE_KEY, private_key, S2N_MAX_TEST_PEM_SIZE));
+    EXPECT_NOT_NULL(chain_and_key = s2n_cert_chain_and_key_new());
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_load_pem(chain_and_key, cert_chain, private_key));
+
+    EXPECT_NOT_NULL(server_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(server_config, "default_tls13"));
+    EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(server_config, chain_and_key));
+    EXPECT_SUCCESS(s2n_config_set_session_tickets_onoff(server_config, 1));
+    EXPECT_SUCCESS(s2n_config_add_ticket_crypto_key(server_config, ticket_key_name, strlen((char *) ticket_key_name),
+            ticket_key, sizeof(ticket_key), 0));
+
+    EXPECT_NOT_NULL(client_config = s2n_config_new());
+    EXPECT_SUCCESS(s2n_config_set_cipher_preferences(client_config, "default_tls13"));
+    EXPECT_SUCCESS(s2n_config_disable_x509_verification(client_config));
+    EXPECT_SUCCESS(s2n_config_set_session_tickets_onoff(client_config, 1));
+
+    /* A full handshake ends with the server issuing a ticket the client can save */
+    {
+        session_length = 0;
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_TRUE(IS_FULL_HANDSHAKE(handshake_type));
+        EXPECT_TRUE(handshake_type & WITH_SESSION_TICKET);
+        EXPECT_FALSE(server_psk.accepted);
+        EXPECT_EQUAL(session[0], S2N_STATE_WITH_TLS13_TICKET);
+        EXPECT_TRUE(session_length > S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES);
+    }
+
+    /* The ticket resumes the session without certificates, and the server issues a new one */
+    {
+        uint8_t first_session[sizeof(session)];
+        memcpy(first_session, session, session_length);
+        int first_session_length = session_length;
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_FALSE(IS_FULL_HANDSHAKE(handshake_type));
+        EXPECT_TRUE(handshake_type & WITH_SESSION_TICKET);
+        EXPECT_TRUE(server_psk.accepted);
+        EXPECT_EQUAL(server_psk.ke_mode, TLS_PSK_DHE_KE_MODE);
+        EXPECT_EQUAL(server_psk.identity, 0);
+        EXPECT_TRUE(session_length != first_session_length || memcmp(session, first_session, session_length));
+    }
+
+    /* A server can pick psk_ke, which skips the key exchange altogether */
+    {
+        EXPECT_SUCCESS(s2n_config_set_client_hello_cb(server_config, offer_psk_ke_only, NULL));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_FALSE(IS_FULL_HANDSHAKE(handshake_type));
+        EXPECT_TRUE(server_psk.accepted);
+        EXPECT_EQUAL(server_psk.ke_mode, TLS_PSK_KE_MODE);
+
+        EXPECT_SUCCESS(s2n_config_set_client_hello_cb(server_config, NULL, NULL));
+    }
+
+    /* A ticket the server can't decrypt falls back to a full handshake */
+    {
+        struct s2n_config *other_server_config;
+        EXPECT_NOT_NULL(other_server_config = s2n_config_new());
+        EXPECT_SUCCESS(s2n_config_set_cipher_preferences(other_server_config, "default_tls13"));
+        EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(other_server_config, chain_and_key));
+        EXPECT_SUCCESS(s2n_config_set_session_tickets_onoff(other_server_config, 1));
+        EXPECT_SUCCESS(s2n_config_add_ticket_crypto_key(other_server_config, other_ticket_key_name,
+                strlen((char *) other_ticket_key_name), other_ticket_key, sizeof(other_ticket_key), 0));
+
+        EXPECT_SUCCESS(handshake(other_server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_TRUE(IS_FULL_HANDSHAKE(handshake_type));
+        EXPECT_FALSE(server_psk.accepted);
+
+        EXPECT_SUCCESS(s2n_config_free(other_server_config));
+    }
+
+    /* A ticket past the session state lifetime falls back to a full handshake */
+    {
+        session_length = 0;
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        skew = 2 * ONE_SEC_IN_NANOS;
+        EXPECT_SUCCESS(s2n_config_set_session_state_lifetime(server_config, 1));
+        EXPECT_SUCCESS(s2n_config_set_wall_clock(server_config, skewed_clock, &skew));
+
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_TRUE(IS_FULL_HANDSHAKE(handshake_type));
+        EXPECT_FALSE(server_psk.accepted);
+
+        skew = 0;
+        EXPECT_SUCCESS(s2n_config_set_session_state_lifetime(server_config, S2N_TLS13_MAX_TICKET_LIFETIME_IN_SECS));
+    }
+
+    /* A ClientHello changed on the way fails the binder check */
+    {
+        struct s2n_connection *server_conn, *client_conn;
+        struct s2n_stuffer client_to_server, server_to_client;
+        s2n_blocked_status blocked;
+
+        session_length = 0;
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_NOT_NULL(server_conn = s2n_connection_new(S2N_SERVER));
+        EXPECT_NOT_NULL(client_conn = s2n_connection_new(S2N_CLIENT));
+        EXPECT_SUCCESS(s2n_connection_set_config(server_conn, server_config));
+        EXPECT_SUCCESS(s2n_connection_set_config(client_conn, client_config));
+        EXPECT_SUCCESS(s2n_connection_set_session(client_conn, session, session_length));
+
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&client_to_server, 0));
+        EXPECT_SUCCESS(s2n_stuffer_growable_alloc(&server_to_client, 0));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&client_to_server, &server_to_client, server_conn));
+        EXPECT_SUCCESS(s2n_connection_set_io_stuffers(&server_to_client, &client_to_server, client_conn));
+
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(client_conn, &blocked), S2N_ERR_BLOCKED);
+        EXPECT_TRUE(client_conn->tls13_psk.offered);
+
+        /* The binder is the last thing in the ClientHello */
+        client_to_server.blob.data[client_to_server.write_cursor - 1] ^= 0x01;
+        EXPECT_FAILURE_WITH_ERRNO(s2n_negotiate(server_conn, &blocked), S2N_ERR_BAD_MESSAGE);
+
+        EXPECT_SUCCESS(s2n_connection_free(server_conn));
+        EXPECT_SUCCESS(s2n_connection_free(client_conn));
+        EXPECT_SUCCESS(s2n_stuffer_free(&client_to_server));
+        EXPECT_SUCCESS(s2n_stuffer_free(&server_to_client));
+    }
+
+    /* A TLS1.2 server ignores the TLS1.3 ticket, and issues a TLS1.2 one instead */
+    {
+        struct s2n_config *tls12_server_config;
+        EXPECT_NOT_NULL(tls12_server_config = s2n_config_new());
+        EXPECT_SUCCESS(s2n_config_set_cipher_preferences(tls12_server_config, "default"));
+        EXPECT_SUCCESS(s2n_config_add_cert_chain_and_key_to_store(tls12_server_config, chain_and_key));
+        EXPECT_SUCCESS(s2n_config_set_session_tickets_onoff(tls12_server_config, 1));
+        EXPECT_SUCCESS(s2n_config_add_ticket_crypto_key(tls12_server_config, ticket_key_name, strlen((char *) ticket_key_name),
+                ticket_key, sizeof(ticket_key), 0));
+
+        EXPECT_SUCCESS(handshake(tls12_server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_TRUE(IS_FULL_HANDSHAKE(handshake_type));
+        EXPECT_TRUE(handshake_type & WITH_SESSION_TICKET);
+        EXPECT_EQUAL(session[0], S2N_STATE_WITH_SESSION_TICKET);
+
+        EXPECT_SUCCESS(s2n_config_free(tls12_server_config));
+    }
+
+    /* Without tickets on the server, no NewSessionTicket is sent and there is nothing to resume */
+    {
+        EXPECT_SUCCESS(s2n_config_set_session_tickets_onoff(server_config, 0));
+
+        session_length = 0;
+        EXPECT_SUCCESS(handshake(server_config, client_config, session, &session_length, &handshake_type, &server_psk));
+
+        EXPECT_TRUE(IS_FULL_HANDSHAKE(handshake_type));
+        EXPECT_FALSE(handshake_type & WITH_SESSION_TICKET);
+        EXPECT_EQUAL(session_length, 0);
+    }
+
+    EXPECT_SUCCESS(s2n_config_free(server_config));
+    EXPECT_SUCCESS(s2n_config_free(client_config));
+    EXPECT_SUCCESS(s2n_cert_chain_and_key_free(chain_and_key));
+
+    END_TEST();
+}
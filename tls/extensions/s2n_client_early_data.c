@@ -0,0 +1,66 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "tls/extensions/s2n_client_early_data.h"
+
+#include "tls/s2n_tls.h"
+#include "utils/s2n_safety.h"
+
+/*
+ * Early data is only asked for together with the PSK it is protected with, so the
+ * size is decided after the pre_shared_key extension's.
+ */
+int s2n_extensions_client_early_data_size(struct s2n_connection *conn)
+{
+    if (conn->early_data.status != S2N_EARLY_DATA_REQUESTED) {
+        return 0;
+    }
+
+    if (!conn->tls13_psk.offered) {
+        conn->early_data.status = S2N_EARLY_DATA_NOT_REQUESTED;
+        return 0;
+    }
+
+    /* extension type and an empty extension */
+    return 2 + 2;
+}
+
+int s2n_extensions_client_early_data_send(struct s2n_connection *conn, struct s2n_stuffer *out)
+{
+    if (conn->early_data.status != S2N_EARLY_DATA_REQUESTED) {
+        return 0;
+    }
+
+    GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_EARLY_DATA));
+    GUARD(s2n_stuffer_write_uint16(out, 0));
+
+    return 0;
+}
+
+/*
+ * Server notes that the client is sending early data. Whether it is accepted is decided
+ * once the PSK is chosen, see s2n_early_data_server_select().
+ * A client can't send early data after a HelloRetryRequest.
+ * See https://tools.ietf.org/html/rfc8446#section-4.2.10
+ */
+int s2n_extensions_client_early_data_recv(struct s2n_connection *conn, struct s2n_stuffer *extension)
+{
+    S2N_ERROR_IF(s2n_stuffer_data_available(extension), S2N_ERR_BAD_MESSAGE);
+    S2N_ERROR_IF(IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type), S2N_ERR_BAD_MESSAGE);
+
+    conn->early_data.status = S2N_EARLY_DATA_REQUESTED;
+
+    return 0;
+}
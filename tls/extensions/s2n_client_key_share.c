@@ -126,6 +126,17 @@ int s2n_extensions_client_key_share_recv(struct s2n_connection *conn, struct s2n
 
 int s2n_extensions_client_key_share_size(struct s2n_connection *conn)
 {
+    /* After a HelloRetryRequest, only the key share for the group the server selected is sent */
+    if (conn != NULL && IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type)
+            && conn->secure.server_ecc_params.negotiated_curve != NULL) {
+        return S2N_SIZE_OF_EXTENSION_TYPE
+            + S2N_SIZE_OF_EXTENSION_DATA_SIZE
+            + S2N_SIZE_OF_CLIENT_SHARES_SIZE
+            + S2N_SIZE_OF_KEY_SHARE_SIZE
+            + S2N_SIZE_OF_NAMED_GROUP
+            + conn->secure.server_ecc_params.negotiated_curve->share_size;
+    }
+
     return s2n_client_key_share_extension_size;
 }
 
@@ -135,7 +146,7 @@ int s2n_extensions_client_key_share_send(struct s2n_connection *conn, struct s2n
 
     const uint16_t extension_type = TLS_EXTENSION_KEY_SHARE;
     const uint16_t extension_data_size =
-            s2n_client_key_share_extension_size - S2N_SIZE_OF_EXTENSION_TYPE - S2N_SIZE_OF_EXTENSION_DATA_SIZE;
+            s2n_extensions_client_key_share_size(conn) - S2N_SIZE_OF_EXTENSION_TYPE - S2N_SIZE_OF_EXTENSION_DATA_SIZE;
     const uint16_t client_shares_size =
             extension_data_size - S2N_SIZE_OF_CLIENT_SHARES_SIZE;
 
@@ -159,6 +170,11 @@ static int s2n_ecdhe_supported_curves_send(struct s2n_connection *conn, struct s
         ecc_params = &conn->secure.client_ecc_params[i];
         named_curve = s2n_ecc_supported_curves[i];
 
+        if (IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type)
+                && named_curve != conn->secure.server_ecc_params.negotiated_curve) {
+            continue;
+        }
+
         ecc_params->negotiated_curve = named_curve;
         GUARD(s2n_ecdhe_parameters_send(ecc_params, out));
     }
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <sys/param.h>
+
+#include "tls/extensions/s2n_client_pre_shared_key.h"
+#include "tls/extensions/s2n_client_psk_key_exchange_modes.h"
+
+#include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_client_extensions.h"
+#include "tls/s2n_resume.h"
+#include "tls/s2n_tls.h"
+#include "tls/s2n_tls13_handshake.h"
+
+#include "utils/s2n_safety.h"
+
+#define ONE_MILLISEC_IN_NANOS   1000000
+
+/* From https://tools.ietf.org/html/rfc8446#section-4.2.11 :
+ *
+ *  struct {
+ *      opaque identity<1..2^16-1>;
+ *      uint32 obfuscated_ticket_age;
+ *  } PskIdentity;
+ *
+ *  opaque PskBinderEntry<32..255>;
+ *
+ *  struct {
+ *      PskIdentity identities<7..2^16-1>;
+ *      PskBinderEntry binders<33..2^16-1>;
+ *  } OfferedPsks;
+ */
+#define S2N_PSK_LIST_SIZE_LEN       2
+#define S2N_PSK_IDENTITY_SIZE_LEN   2
+#define S2N_PSK_TICKET_AGE_LEN      4
+#define S2N_PSK_BINDER_SIZE_LEN     1
+#define S2N_PSK_MIN_BINDER_SIZE     32
+
+/*
+ * The ticket is only offered while it is within the lifetime the server gave it, and with
+ * a cipher suite that has the hash the PSK was made with. After a HelloRetryRequest that
+ * has to be the suite the server picked.
+ */
+static int s2n_client_can_offer_psk(struct s2n_connection *conn)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+
+    if (!conn->config->use_tickets || conn->client_ticket.size == 0 || psk->secret_size == 0 || psk->cipher_suite == NULL) {
+        return 0;
+    }
+
+    uint64_t now;
+    GUARD(conn->config->wall_clock(conn->config->sys_clock_ctx, &now));
+    if (now < psk->ticket_issue_time || now - psk->ticket_issue_time >= (uint64_t) conn->ticket_lifetime_hint * ONE_SEC_IN_NANOS) {
+        return 0;
+    }
+
+    if (IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type)) {
+        return conn->secure.cipher_suite->tls12_prf_alg == psk->cipher_suite->tls12_prf_alg;
+    }
+
+    const struct s2n_cipher_preferences *cipher_preferences;
+    GUARD(s2n_connection_get_cipher_preferences(conn, &cipher_preferences));
+
+    for (int i = 0; i < cipher_preferences->count; i++) {
+        const struct s2n_cipher_suite *cipher_suite = cipher_preferences->suites[i];
+        if (cipher_suite->available && cipher_suite->minimum_required_tls_version >= S2N_TLS13
+                && cipher_suite->tls12_prf_alg == psk->cipher_suite->tls12_prf_alg) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Whether the PSK is offered is decided here, once for each ClientHello.
+ */
+int s2n_extensions_client_pre_shared_key_size(struct s2n_connection *conn)
+{
+    int can_offer_psk;
+    GUARD(can_offer_psk = s2n_client_can_offer_psk(conn));
+
+    conn->tls13_psk.offered = can_offer_psk;
+    if (!can_offer_psk) {
+        return 0;
+    }
+
+    return 2 + 2
+        + S2N_PSK_LIST_SIZE_LEN + S2N_PSK_IDENTITY_SIZE_LEN + conn->client_ticket.size + S2N_PSK_TICKET_AGE_LEN
+        + S2N_PSK_LIST_SIZE_LEN + S2N_PSK_BINDER_SIZE_LEN + conn->tls13_psk.secret_size;
+}
+
+/*
+ * Sends the ticket as the only identity. This must be the last extension in the ClientHello,
+ * since the binder covers the whole ClientHello up to the binders list.
+ * See https://tools.ietf.org/html/rfc8446#section-4.2.11.2
+ */
+int s2n_extensions_client_pre_shared_key_send(struct s2n_connection *conn, struct s2n_stuffer *out)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+    S2N_ERROR_IF(out != &conn->handshake.io, S2N_ERR_SAFETY);
+
+    uint64_t now;
+    GUARD(conn->config->wall_clock(conn->config->sys_clock_ctx, &now));
+    uint32_t ticket_age_in_millis = (now - psk->ticket_issue_time) / ONE_MILLISEC_IN_NANOS;
+
+    const uint16_t identities_size = S2N_PSK_IDENTITY_SIZE_LEN + conn->client_ticket.size + S2N_PSK_TICKET_AGE_LEN;
+    const uint16_t binders_size = S2N_PSK_BINDER_SIZE_LEN + psk->secret_size;
+
+    GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_PRE_SHARED_KEY));
+    GUARD(s2n_stuffer_write_uint16(out, S2N_PSK_LIST_SIZE_LEN + identities_size + S2N_PSK_LIST_SIZE_LEN + binders_size));
+
+    GUARD(s2n_stuffer_write_uint16(out, identities_size));
+    GUARD(s2n_stuffer_write_uint16(out, conn->client_ticket.size));
+    GUARD(s2n_stuffer_write(out, &conn->client_ticket));
+    GUARD(s2n_stuffer_write_uint32(out, ticket_age_in_millis + psk->ticket_age_add));
+
+    GUARD(s2n_stuffer_write_uint16(out, binders_size));
+    GUARD(s2n_stuffer_write_uint8(out, psk->secret_size));
+    struct s2n_blob binder = { .size = psk->secret_size };
+    binder.data = s2n_stuffer_raw_write(out, binder.size);
+    notnull_check(binder.data);
+
+    /* The handshake header is part of what the binder covers */
+    GUARD(s2n_handshake_finish_header(conn));
+
+    struct s2n_blob partial_client_hello = { .data = out->blob.data };
+    partial_client_hello.size = out->write_cursor - S2N_PSK_LIST_SIZE_LEN - binders_size;
+    GUARD(s2n_tls13_compute_psk_binder(conn, psk, &partial_client_hello, &binder));
+
+    return 0;
+}
+
+/*
+ * Server decrypts the first identity it can, and checks the binder that goes with it.
+ * A ticket that can't be used anymore only means a full handshake, but a bad binder
+ * means the ClientHello was tampered with.
+ */
+static int s2n_client_pre_shared_key_select(struct s2n_connection *conn, struct s2n_stuffer *identities,
+        struct s2n_stuffer *binders, uint16_t binders_size)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+
+    for (uint16_t i = 0; s2n_stuffer_data_available(identities); i++) {
+        uint16_t identity_size;
+        GUARD(s2n_stuffer_read_uint16(identities, &identity_size));
+        S2N_ERROR_IF(identity_size == 0, S2N_ERR_BAD_MESSAGE);
+
+        struct s2n_blob identity = { .size = identity_size };
+        identity.data = s2n_stuffer_raw_read(identities, identity.size);
+        notnull_check(identity.data);
+
+        uint32_t obfuscated_ticket_age;
+        GUARD(s2n_stuffer_read_uint32(identities, &obfuscated_ticket_age));
+
+        uint8_t binder_size;
+        GUARD(s2n_stuffer_read_uint8(binders, &binder_size));
+        S2N_ERROR_IF(binder_size < S2N_PSK_MIN_BINDER_SIZE, S2N_ERR_BAD_MESSAGE);
+
+        struct s2n_blob wire_binder = { .size = binder_size };
+        wire_binder.data = s2n_stuffer_raw_read(binders, wire_binder.size);
+        notnull_check(wire_binder.data);
+
+        if (psk->accepted) {
+            continue;
+        }
+
+        struct s2n_tls13_psk candidate = {0};
+        if (s2n_tls13_decrypt_session_ticket(conn, &identity, &candidate) < 0
+                || candidate.cipher_suite->tls12_prf_alg != conn->secure.cipher_suite->tls12_prf_alg) {
+            continue;
+        }
+
+        /* The binder covers the whole ClientHello message up to the binders list */
+        struct s2n_blob partial_client_hello = { .data = conn->handshake.io.blob.data };
+        partial_client_hello.size = conn->handshake.io.write_cursor - S2N_PSK_LIST_SIZE_LEN - binders_size;
+
+        s2n_tls13_key_blob(binder, candidate.secret_size);
+        S2N_ERROR_IF(wire_binder.size != binder.size, S2N_ERR_BAD_MESSAGE);
+        GUARD(s2n_tls13_compute_psk_binder(conn, &candidate, &partial_client_hello, &binder));
+        S2N_ERROR_IF(!s2n_constant_time_equals(binder.data, wire_binder.data, binder.size), S2N_ERR_BAD_MESSAGE);
+
+        memcpy_check(psk->secret, candidate.secret, S2N_TLS_SECRET_LEN);
+        psk->secret_size = candidate.secret_size;
+        psk->cipher_suite = candidate.cipher_suite;
+        psk->ticket_age_add = candidate.ticket_age_add;
+        psk->ticket_issue_time = candidate.ticket_issue_time;
+        psk->max_early_data_size = candidate.max_early_data_size;
+        psk->obfuscated_ticket_age = obfuscated_ticket_age;
+        memcpy_check(psk->binder, binder.data, binder.size);
+        psk->binder_size = binder.size;
+        psk->identity = i;
+        psk->accepted = 1;
+    }
+
+    /* Every identity has a binder */
+    S2N_ERROR_IF(s2n_stuffer_data_available(binders), S2N_ERR_BAD_MESSAGE);
+
+    return 0;
+}
+
+/*
+ * Server processes the pre_shared_key extension once the cipher suite is chosen, since
+ * only a PSK made with the same hash can be used.
+ */
+int s2n_extensions_client_pre_shared_key_recv(struct s2n_connection *conn)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+    psk->accepted = 0;
+
+    struct s2n_client_hello_parsed_extension parsed_extension = {0};
+    if (!conn->config->use_tickets || conn->client_hello.parsed_extensions == NULL
+            || s2n_client_hello_get_parsed_extension(conn->client_hello.parsed_extensions, TLS_EXTENSION_PRE_SHARED_KEY, &parsed_extension) < 0) {
+        return 0;
+    }
+
+    /* A client has to say how a PSK can be used */
+    S2N_ERROR_IF(psk->ke_modes == 0, S2N_ERR_BAD_MESSAGE);
+
+    struct s2n_stuffer extension = {0};
+    GUARD(s2n_stuffer_init(&extension, &parsed_extension.extension));
+    GUARD(s2n_stuffer_write(&extension, &parsed_extension.extension));
+
+    uint16_t identities_size;
+    GUARD(s2n_stuffer_read_uint16(&extension, &identities_size));
+    struct s2n_blob identities_blob = { .size = identities_size };
+    identities_blob.data = s2n_stuffer_raw_read(&extension, identities_blob.size);
+    notnull_check(identities_blob.data);
+
+    uint16_t binders_size;
+    GUARD(s2n_stuffer_read_uint16(&extension, &binders_size));
+    S2N_ERROR_IF(identities_size == 0 || binders_size == 0 || binders_size != s2n_stuffer_data_available(&extension), S2N_ERR_BAD_MESSAGE);
+    struct s2n_blob binders_blob = { .size = binders_size };
+    binders_blob.data = s2n_stuffer_raw_read(&extension, binders_blob.size);
+    notnull_check(binders_blob.data);
+
+    struct s2n_stuffer identities = {0};
+    GUARD(s2n_stuffer_init(&identities, &identities_blob));
+    GUARD(s2n_stuffer_write(&identities, &identities_blob));
+
+    struct s2n_stuffer binders = {0};
+    GUARD(s2n_stuffer_init(&binders, &binders_blob));
+    GUARD(s2n_stuffer_write(&binders, &binders_blob));
+
+    GUARD(s2n_client_pre_shared_key_select(conn, &identities, &binders, binders_size));
+
+    /* psk_dhe_ke keeps forward secrecy, so it is preferred whenever the client allows it */
+    if (psk->accepted) {
+        psk->ke_mode = (psk->ke_modes & S2N_PSK_KE_MODE_BIT(TLS_PSK_DHE_KE_MODE)) ? TLS_PSK_DHE_KE_MODE : TLS_PSK_KE_MODE;
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "tls/extensions/s2n_client_psk_key_exchange_modes.h"
+
+#include "tls/s2n_tls.h"
+#include "utils/s2n_safety.h"
+
+/* The client offers both modes and lets the server choose. psk_dhe_ke is listed first since it keeps forward secrecy */
+static const uint8_t s2n_psk_key_exchange_modes[] = { TLS_PSK_DHE_KE_MODE, TLS_PSK_KE_MODE };
+
+/*
+ * A client that can't use tickets has no reason to send this extension,
+ * and without it the server won't issue TLS1.3 tickets.
+ */
+int s2n_extensions_client_psk_key_exchange_modes_size(struct s2n_connection *conn)
+{
+    if (!conn->config->use_tickets) {
+        return 0;
+    }
+
+    /* extension type, extension size, list size, and the modes */
+    return 2 + 2 + 1 + sizeof(s2n_psk_key_exchange_modes);
+}
+
+int s2n_extensions_client_psk_key_exchange_modes_send(struct s2n_connection *conn, struct s2n_stuffer *out)
+{
+    if (!conn->config->use_tickets) {
+        return 0;
+    }
+
+    GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_PSK_KEY_EXCHANGE_MODES));
+    GUARD(s2n_stuffer_write_uint16(out, 1 + sizeof(s2n_psk_key_exchange_modes)));
+    GUARD(s2n_stuffer_write_uint8(out, sizeof(s2n_psk_key_exchange_modes)));
+    GUARD(s2n_stuffer_write_bytes(out, s2n_psk_key_exchange_modes, sizeof(s2n_psk_key_exchange_modes)));
+
+    return 0;
+}
+
+/*
+ * Server records which of the modes it supports the client offered. Unknown modes are ignored.
+ * See https://tools.ietf.org/html/rfc8446#section-4.2.9
+ */
+int s2n_extensions_client_psk_key_exchange_modes_recv(struct s2n_connection *conn, struct s2n_stuffer *extension)
+{
+    uint8_t modes_size;
+    GUARD(s2n_stuffer_read_uint8(extension, &modes_size));
+    S2N_ERROR_IF(modes_size == 0 || modes_size != s2n_stuffer_data_available(extension), S2N_ERR_BAD_MESSAGE);
+
+    conn->tls13_psk.ke_modes = 0;
+    for (int i = 0; i < modes_size; i++) {
+        uint8_t mode;
+        GUARD(s2n_stuffer_read_uint8(extension, &mode));
+
+        if (mode == TLS_PSK_KE_MODE || mode == TLS_PSK_DHE_KE_MODE) {
+            conn->tls13_psk.ke_modes |= S2N_PSK_KE_MODE_BIT(mode);
+        }
+    }
+
+    return 0;
+}
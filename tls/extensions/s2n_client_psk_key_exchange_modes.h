@@ -0,0 +1,25 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include "tls/s2n_connection.h"
+#include "stuffer/s2n_stuffer.h"
+
+#define S2N_PSK_KE_MODE_BIT(mode)   (1 << (mode))
+
+extern int s2n_extensions_client_psk_key_exchange_modes_size(struct s2n_connection *conn);
+extern int s2n_extensions_client_psk_key_exchange_modes_send(struct s2n_connection *conn, struct s2n_stuffer *out);
+extern int s2n_extensions_client_psk_key_exchange_modes_recv(struct s2n_connection *conn, struct s2n_stuffer *extension);
@@ -14,6 +14,7 @@
  */
 
 #include "tls/extensions/s2n_key_share.h"
+#include "tls/s2n_ephemeral_key_pool.h"
 #include "tls/s2n_tls.h"
 #include "utils/s2n_safety.h"
 
@@ -26,7 +27,7 @@ int s2n_ecdhe_parameters_send(struct s2n_ecc_params *ecc_params, struct s2n_stuf
     GUARD(s2n_stuffer_write_uint16(out, ecc_params->negotiated_curve->iana_id));
     GUARD(s2n_stuffer_write_uint16(out, ecc_params->negotiated_curve->share_size));
 
-    GUARD(s2n_ecc_generate_ephemeral_key(ecc_params));
+    GUARD(s2n_ephemeral_key_pool_take_ecc(ecc_params));
     GUARD(s2n_ecc_write_ecc_params_point(ecc_params, out));
 
     return 0;
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <string.h>
+
+#include "tls/extensions/s2n_server_early_data.h"
+
+#include "tls/s2n_tls.h"
+#include "utils/s2n_safety.h"
+
+/* The server's EncryptedExtensions carry an empty early_data extension when it accepts the early data */
+int s2n_extensions_server_early_data_size(struct s2n_connection *conn)
+{
+    if (conn->early_data.status != S2N_EARLY_DATA_ACCEPTED) {
+        return 0;
+    }
+
+    return 2 + 2;
+}
+
+int s2n_extensions_server_early_data_send(struct s2n_connection *conn, struct s2n_stuffer *out)
+{
+    if (conn->early_data.status != S2N_EARLY_DATA_ACCEPTED) {
+        return 0;
+    }
+
+    GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_EARLY_DATA));
+    GUARD(s2n_stuffer_write_uint16(out, 0));
+
+    return 0;
+}
+
+/*
+ * Client learns its early data was accepted, which is only possible for the PSK it offered
+ * and with the suite that PSK was issued with.
+ */
+int s2n_extensions_server_early_data_recv(struct s2n_connection *conn, struct s2n_stuffer *extension)
+{
+    S2N_ERROR_IF(s2n_stuffer_data_available(extension), S2N_ERR_BAD_MESSAGE);
+    S2N_ERROR_IF(conn->early_data.status != S2N_EARLY_DATA_REQUESTED || !conn->tls13_psk.accepted, S2N_ERR_BAD_MESSAGE);
+    S2N_ERROR_IF(memcmp(conn->tls13_psk.cipher_suite->iana_value, conn->secure.cipher_suite->iana_value, S2N_TLS_CIPHER_SUITE_LEN),
+            S2N_ERR_BAD_MESSAGE);
+
+    conn->early_data.status = S2N_EARLY_DATA_ACCEPTED;
+    conn->handshake.handshake_type |= WITH_EARLY_DATA;
+
+    return 0;
+}
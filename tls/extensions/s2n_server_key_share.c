@@ -16,8 +16,51 @@
 #include "tls/extensions/s2n_server_key_share.h"
 
 #include "tls/s2n_client_extensions.h"
+#include "tls/s2n_tls.h"
 #include "utils/s2n_safety.h"
 
+static int s2n_ecc_supported_curve_index(const struct s2n_ecc_named_curve *curve)
+{
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        if (curve == s2n_ecc_supported_curves[i]) {
+            return i;
+        }
+    }
+
+    S2N_ERROR(S2N_ERR_ECDHE_UNSUPPORTED_CURVE);
+}
+
+/*
+ * Server picks the curve for the key exchange after the ClientHello is processed.
+ *
+ * The most preferred curve is kept if the client sent a key share for it, otherwise any curve
+ * the client did send a key share for is used. If the client sent no usable key share, the
+ * server asks for one with a HelloRetryRequest, which can only happen once.
+ */
+int s2n_extensions_server_key_share_select(struct s2n_connection *conn)
+{
+    const struct s2n_ecc_named_curve *server_curve = conn->secure.server_ecc_params.negotiated_curve;
+    notnull_check(server_curve);
+
+    int curve_index;
+    GUARD(curve_index = s2n_ecc_supported_curve_index(server_curve));
+    if (conn->secure.client_ecc_params[curve_index].ec_key != NULL) {
+        return 0;
+    }
+
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        if (conn->secure.client_ecc_params[i].ec_key != NULL) {
+            conn->secure.server_ecc_params.negotiated_curve = s2n_ecc_supported_curves[i];
+            return 0;
+        }
+    }
+
+    S2N_ERROR_IF(IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type), S2N_ERR_BAD_KEY_SHARE);
+    conn->handshake.handshake_type |= HELLO_RETRY_REQUEST;
+
+    return 0;
+}
+
 /*
  * Check whether client has sent a corresponding curve and key_share
  */
@@ -27,14 +70,8 @@ int s2n_extensions_server_key_share_send_check(struct s2n_connection *conn)
     server_curve = conn->secure.server_ecc_params.negotiated_curve;
     notnull_check(server_curve);
 
-    int curve_index = -1;
-    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
-        if (server_curve == s2n_ecc_supported_curves[i]) {
-            curve_index = i;
-            break;
-        }
-    }
-    gt_check(curve_index, -1);
+    int curve_index;
+    GUARD(curve_index = s2n_ecc_supported_curve_index(server_curve));
 
     const struct s2n_ecc_params client_ecc = conn->secure.client_ecc_params[curve_index];
     client_curve = client_ecc.negotiated_curve;
@@ -56,7 +93,8 @@ int s2n_extensions_server_key_share_send_size(struct s2n_connection *conn)
 {
     const struct s2n_ecc_named_curve* curve = conn->secure.server_ecc_params.negotiated_curve;
 
-    if (curve == NULL) {
+    /* A psk_ke resumption has no key exchange */
+    if (curve == NULL || IS_PSK_KE_ONLY(conn)) {
         return 0;
     }
 
@@ -76,6 +114,10 @@ int s2n_extensions_server_key_share_send_size(struct s2n_connection *conn)
  */
 int s2n_extensions_server_key_share_send(struct s2n_connection *conn, struct s2n_stuffer *out)
 {
+    if (IS_PSK_KE_ONLY(conn)) {
+        return 0;
+    }
+
     GUARD(s2n_extensions_server_key_share_send_check(conn));
     notnull_check(out);
 
@@ -90,6 +132,66 @@ int s2n_extensions_server_key_share_send(struct s2n_connection *conn, struct s2n
     return 0;
 }
 
+/*
+ * Size of the Key Share extension in a HelloRetryRequest, which only names the selected group.
+ */
+int s2n_extensions_server_key_share_retry_send_size(struct s2n_connection *conn)
+{
+    return S2N_SIZE_OF_EXTENSION_TYPE
+        + S2N_SIZE_OF_EXTENSION_DATA_SIZE
+        + S2N_SIZE_OF_NAMED_GROUP;
+}
+
+/*
+ * Sends Key Share extension in a HelloRetryRequest.
+ *
+ * From https://tools.ietf.org/html/rfc8446#section-4.2.8
+ * In a HelloRetryRequest message, the "extension_data" field of this
+ * extension contains a KeyShareHelloRetryRequest value.
+ */
+int s2n_extensions_server_key_share_retry_send(struct s2n_connection *conn, struct s2n_stuffer *out)
+{
+    const struct s2n_ecc_named_curve *server_curve = conn->secure.server_ecc_params.negotiated_curve;
+    notnull_check(server_curve);
+    notnull_check(out);
+
+    GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_KEY_SHARE));
+    GUARD(s2n_stuffer_write_uint16(out, S2N_SIZE_OF_NAMED_GROUP));
+    GUARD(s2n_stuffer_write_uint16(out, server_curve->iana_id));
+
+    return 0;
+}
+
+/*
+ * Client receives the group selected in a HelloRetryRequest.
+ *
+ * The key shares sent in the first ClientHello are discarded, and the next ClientHello
+ * only carries a key share for the group in conn->secure.server_ecc_params.
+ */
+static int s2n_extensions_server_key_share_retry_recv(struct s2n_connection *conn, uint16_t named_group)
+{
+    const struct s2n_ecc_named_curve *selected_curve = NULL;
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        if (named_group == s2n_ecc_supported_curves[i]->iana_id) {
+            selected_curve = s2n_ecc_supported_curves[i];
+
+            /* The server can't ask for a key share the client already sent */
+            S2N_ERROR_IF(conn->secure.client_ecc_params[i].ec_key != NULL, S2N_ERR_BAD_KEY_SHARE);
+            break;
+        }
+    }
+    S2N_ERROR_IF(selected_curve == NULL, S2N_ERR_BAD_KEY_SHARE);
+
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        GUARD(s2n_ecc_params_free(&conn->secure.client_ecc_params[i]));
+        conn->secure.client_ecc_params[i].negotiated_curve = NULL;
+    }
+
+    conn->secure.server_ecc_params.negotiated_curve = selected_curve;
+
+    return 0;
+}
+
 /*
  * Client receives a Server Hello key share.
  *
@@ -102,10 +204,17 @@ int s2n_extensions_server_key_share_recv(struct s2n_connection *conn, struct s2n
 
     uint16_t named_group, share_size;
 
-    /* Make sure we can read the next 4 bytes */
-    S2N_ERROR_IF(s2n_stuffer_data_available(extension) < 4, S2N_ERR_BAD_KEY_SHARE);
-
+    S2N_ERROR_IF(s2n_stuffer_data_available(extension) < S2N_SIZE_OF_NAMED_GROUP, S2N_ERR_BAD_KEY_SHARE);
     GUARD(s2n_stuffer_read_uint16(extension, &named_group));
+
+    if (s2n_conn_get_current_message_type(conn) == HELLO_RETRY_MSG) {
+        S2N_ERROR_IF(s2n_stuffer_data_available(extension) != 0, S2N_ERR_BAD_KEY_SHARE);
+        GUARD(s2n_extensions_server_key_share_retry_recv(conn, named_group));
+        return 0;
+    }
+
+    /* Make sure we can read the next 2 bytes */
+    S2N_ERROR_IF(s2n_stuffer_data_available(extension) < S2N_SIZE_OF_KEY_SHARE_SIZE, S2N_ERR_BAD_KEY_SHARE);
     GUARD(s2n_stuffer_read_uint16(extension, &share_size));
 
     /* and the remaining amount of bytes */
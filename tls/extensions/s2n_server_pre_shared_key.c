@@ -0,0 +1,59 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include "tls/extensions/s2n_server_pre_shared_key.h"
+
+#include "tls/s2n_tls.h"
+#include "utils/s2n_safety.h"
+
+/* The server's pre_shared_key extension is the index of the identity it accepted */
+int s2n_extensions_server_pre_shared_key_size(struct s2n_connection *conn)
+{
+    if (!conn->tls13_psk.accepted) {
+        return 0;
+    }
+
+    return 2 + 2 + 2;
+}
+
+int s2n_extensions_server_pre_shared_key_send(struct s2n_connection *conn, struct s2n_stuffer *out)
+{
+    if (!conn->tls13_psk.accepted) {
+        return 0;
+    }
+
+    GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_PRE_SHARED_KEY));
+    GUARD(s2n_stuffer_write_uint16(out, 2));
+    GUARD(s2n_stuffer_write_uint16(out, conn->tls13_psk.identity));
+
+    return 0;
+}
+
+/*
+ * Client learns the server accepted its PSK. The client only offers one identity.
+ * Whether the suite matches the PSK is checked once the ServerHello's suite is set.
+ */
+int s2n_extensions_server_pre_shared_key_recv(struct s2n_connection *conn, struct s2n_stuffer *extension)
+{
+    uint16_t identity;
+    GUARD(s2n_stuffer_read_uint16(extension, &identity));
+    S2N_ERROR_IF(s2n_stuffer_data_available(extension), S2N_ERR_BAD_MESSAGE);
+    S2N_ERROR_IF(!conn->tls13_psk.offered || identity != 0, S2N_ERR_BAD_MESSAGE);
+
+    conn->tls13_psk.identity = identity;
+    conn->tls13_psk.accepted = 1;
+
+    return 0;
+}
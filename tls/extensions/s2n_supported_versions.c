@@ -18,6 +18,8 @@
 
 #include "tls/extensions/s2n_supported_versions.h"
 #include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_tls.h"
 
 #include "utils/s2n_safety.h"
 
@@ -29,3 +31,23 @@ int s2n_connection_get_minimum_supported_version(struct s2n_connection *conn, ui
 
     return 0;
 }
+
+int s2n_connection_get_maximum_supported_version(struct s2n_connection *conn, uint8_t *max_version)
+{
+    *max_version = s2n_highest_protocol_version;
+    if (*max_version >= S2N_TLS13 || (conn->config == NULL && conn->cipher_pref_override == NULL)) {
+        return 0;
+    }
+
+    /* Connections opt in to TLS1.3 by choosing cipher preferences with TLS1.3 cipher suites */
+    const struct s2n_cipher_preferences *cipher_preferences;
+    GUARD(s2n_connection_get_cipher_preferences(conn, &cipher_preferences));
+    for (int i = 0; i < cipher_preferences->count; i++) {
+        if (cipher_preferences->suites[i]->available && cipher_preferences->suites[i]->minimum_required_tls_version >= S2N_TLS13) {
+            *max_version = S2N_TLS13;
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -19,3 +19,4 @@
 #include "stuffer/s2n_stuffer.h"
 
 extern int s2n_connection_get_minimum_supported_version(struct s2n_connection *conn, uint8_t *min_version);
+extern int s2n_connection_get_maximum_supported_version(struct s2n_connection *conn, uint8_t *max_version);
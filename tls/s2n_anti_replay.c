@@ -0,0 +1,188 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_anti_replay.h"
+
+#include "utils/s2n_blob.h"
+#include "utils/s2n_mem.h"
+#include "utils/s2n_safety.h"
+
+#define S2N_ANTI_REPLAY_MIN_BITS    1024
+#define S2N_ANTI_REPLAY_BITS_PER_ENTRY  10
+
+/* Each shard covers the keys whose first byte selects it. The current
+ * generation collects new keys; once a window has passed it becomes the
+ * previous generation, and keys are looked up in both.
+ */
+struct s2n_anti_replay_shard {
+    pthread_mutex_t lock;
+    uint64_t window_start;
+    uint8_t started;
+    uint8_t *current;
+    uint8_t *previous;
+};
+
+struct s2n_anti_replay {
+    uint64_t window_in_nanos;
+    uint32_t bits_per_filter;
+    struct s2n_blob bits;
+    struct s2n_anti_replay_shard shards[S2N_ANTI_REPLAY_SHARDS];
+};
+
+int s2n_anti_replay_new(struct s2n_anti_replay **filter, uint64_t window_in_nanos, uint32_t max_entries)
+{
+    notnull_check(filter);
+    S2N_ERROR_IF(window_in_nanos == 0, S2N_ERR_INVALID_ARGUMENT);
+
+    uint64_t wanted_bits = ((uint64_t) max_entries * S2N_ANTI_REPLAY_BITS_PER_ENTRY) / S2N_ANTI_REPLAY_SHARDS;
+    uint64_t bits_per_filter = S2N_ANTI_REPLAY_MIN_BITS;
+    while (bits_per_filter < wanted_bits) {
+        bits_per_filter <<= 1;
+    }
+    /* Two generations per shard must fit in one allocation */
+    S2N_ERROR_IF(bits_per_filter / 8 * 2 * S2N_ANTI_REPLAY_SHARDS > UINT32_MAX, S2N_ERR_INVALID_ARGUMENT);
+    uint32_t bytes_per_filter = bits_per_filter / 8;
+
+    struct s2n_blob mem = {0};
+    GUARD(s2n_alloc(&mem, sizeof(struct s2n_anti_replay)));
+    memset_check(mem.data, 0, mem.size);
+    struct s2n_anti_replay *new_filter = (struct s2n_anti_replay *)(void *) mem.data;
+
+    new_filter->window_in_nanos = window_in_nanos;
+    new_filter->bits_per_filter = bits_per_filter;
+
+    if (s2n_alloc(&new_filter->bits, bytes_per_filter * 2 * S2N_ANTI_REPLAY_SHARDS) < 0) {
+        GUARD(s2n_free(&mem));
+        S2N_ERROR_PRESERVE_ERRNO();
+    }
+    memset_check(new_filter->bits.data, 0, new_filter->bits.size);
+
+    for (int i = 0; i < S2N_ANTI_REPLAY_SHARDS; i++) {
+        struct s2n_anti_replay_shard *shard = &new_filter->shards[i];
+        shard->current = new_filter->bits.data + (2 * i) * bytes_per_filter;
+        shard->previous = new_filter->bits.data + (2 * i + 1) * bytes_per_filter;
+
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+            for (int j = 0; j < i; j++) {
+                pthread_mutex_destroy(&new_filter->shards[j].lock);
+            }
+            GUARD(s2n_free(&new_filter->bits));
+            GUARD(s2n_free(&mem));
+            S2N_ERROR(S2N_ERR_LOCK);
+        }
+    }
+
+    *filter = new_filter;
+
+    return 0;
+}
+
+int s2n_anti_replay_free(struct s2n_anti_replay **filter)
+{
+    notnull_check(filter);
+    if (*filter == NULL) {
+        return 0;
+    }
+
+    for (int i = 0; i < S2N_ANTI_REPLAY_SHARDS; i++) {
+        pthread_mutex_destroy(&(*filter)->shards[i].lock);
+    }
+    GUARD(s2n_free(&(*filter)->bits));
+    GUARD(s2n_free_object((uint8_t **) filter, sizeof(struct s2n_anti_replay)));
+
+    return 0;
+}
+
+/* Moves the shard forward to the window that now falls in. Called with the shard lock held. */
+static void s2n_anti_replay_rotate(struct s2n_anti_replay *filter, struct s2n_anti_replay_shard *shard, uint64_t now)
+{
+    uint32_t bytes_per_filter = filter->bits_per_filter / 8;
+
+    if (!shard->started) {
+        shard->window_start = now;
+        shard->started = 1;
+        return;
+    }
+
+    /* A clock that went backwards leaves the window where it is */
+    if (now < shard->window_start) {
+        return;
+    }
+
+    uint64_t elapsed = now - shard->window_start;
+    if (elapsed >= 2 * filter->window_in_nanos) {
+        memset(shard->current, 0, bytes_per_filter);
+        memset(shard->previous, 0, bytes_per_filter);
+        shard->window_start = now;
+    } else if (elapsed >= filter->window_in_nanos) {
+        uint8_t *expired = shard->previous;
+        shard->previous = shard->current;
+        shard->current = expired;
+        memset(shard->current, 0, bytes_per_filter);
+        shard->window_start += filter->window_in_nanos;
+    }
+}
+
+static uint32_t s2n_anti_replay_bit_index(struct s2n_anti_replay *filter, const uint8_t *key, int hash)
+{
+    const uint8_t *bytes = key + 1 + hash * 4;
+    uint32_t index = ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+
+    return index & (filter->bits_per_filter - 1);
+}
+
+static uint8_t s2n_anti_replay_filter_contains(struct s2n_anti_replay *filter, const uint8_t *bits, const uint8_t *key)
+{
+    for (int i = 0; i < S2N_ANTI_REPLAY_HASHES; i++) {
+        uint32_t index = s2n_anti_replay_bit_index(filter, key, i);
+        if (!(bits[index / 8] & (1 << (index % 8)))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int s2n_anti_replay_check_and_record(struct s2n_anti_replay *filter, uint64_t now, const uint8_t *key, uint32_t key_size)
+{
+    notnull_check(filter);
+    notnull_check(key);
+    S2N_ERROR_IF(key_size < S2N_ANTI_REPLAY_MIN_KEY_SIZE, S2N_ERR_INVALID_ARGUMENT);
+
+    struct s2n_anti_replay_shard *shard = &filter->shards[key[0] % S2N_ANTI_REPLAY_SHARDS];
+
+    S2N_ERROR_IF(pthread_mutex_lock(&shard->lock) != 0, S2N_ERR_LOCK);
+
+    s2n_anti_replay_rotate(filter, shard, now);
+
+    int seen = s2n_anti_replay_filter_contains(filter, shard->current, key)
+            || s2n_anti_replay_filter_contains(filter, shard->previous, key);
+
+    if (!seen) {
+        for (int i = 0; i < S2N_ANTI_REPLAY_HASHES; i++) {
+            uint32_t index = s2n_anti_replay_bit_index(filter, key, i);
+            shard->current[index / 8] |= (1 << (index % 8));
+        }
+    }
+
+    S2N_ERROR_IF(pthread_mutex_unlock(&shard->lock) != 0, S2N_ERR_LOCK);
+
+    return seen;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* The anti-replay filter remembers the ClientHellos that carried early data
+ * for a bounded time window using a fixed amount of memory. It is split into
+ * shards so that concurrent handshakes rarely contend on the same lock, and
+ * each shard keeps two generations of bloom filter bits so that an entry is
+ * remembered for at least one full window.
+ *
+ * A bloom filter can report a ClientHello as seen when it was not. That only
+ * makes the server reject early data that it could have accepted, which the
+ * client recovers from by resending the data after the handshake.
+ */
+#define S2N_ANTI_REPLAY_SHARDS          16
+#define S2N_ANTI_REPLAY_HASHES          4
+#define S2N_ANTI_REPLAY_MIN_KEY_SIZE    (1 + S2N_ANTI_REPLAY_HASHES * 4)
+
+struct s2n_anti_replay;
+
+extern int s2n_anti_replay_new(struct s2n_anti_replay **filter, uint64_t window_in_nanos, uint32_t max_entries);
+extern int s2n_anti_replay_free(struct s2n_anti_replay **filter);
+
+/* The key must be the output of a MAC or hash function, as the filter indexes
+ * its bits directly with the key bytes. Returns 1 if the key may have been seen
+ * in the last window and 0 if it is new, in which case it is recorded.
+ */
+extern int s2n_anti_replay_check_and_record(struct s2n_anti_replay *filter, uint64_t now, const uint8_t *key, uint32_t key_size);
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <s2n.h>
+
+#include "crypto/s2n_hash.h"
+#include "crypto/s2n_pkey.h"
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_async_pkey.h"
+#include "tls/s2n_config.h"
+#include "tls/s2n_connection.h"
+
+#include "utils/s2n_blob.h"
+#include "utils/s2n_mem.h"
+#include "utils/s2n_safety.h"
+
+static int s2n_async_pkey_op_allocate(struct s2n_connection *conn, s2n_async_pkey_op_type type, struct s2n_async_pkey_op **op)
+{
+    struct s2n_blob mem = {0};
+
+    notnull_check(conn->handshake_params.our_chain_and_key);
+
+    GUARD(s2n_alloc(&mem, sizeof(struct s2n_async_pkey_op)));
+    GUARD(s2n_blob_zero(&mem));
+
+    *op = (struct s2n_async_pkey_op *)(void *) mem.data;
+    (*op)->type = type;
+    (*op)->conn = conn;
+    (*op)->handshake_generation = conn->handshake_generation;
+    (*op)->key = conn->handshake_params.our_chain_and_key->private_key;
+
+    return 0;
+}
+
+static int s2n_async_pkey_invoke(struct s2n_connection *conn, struct s2n_async_pkey_op *op)
+{
+    conn->handshake.async_state = S2N_ASYNC_INVOKED;
+
+    /* The callback owns op from here on, whatever it returns */
+    S2N_ERROR_IF(conn->config->async_pkey_cb(conn, op) < 0, S2N_ERR_ASYNC_CALLBACK_FAILED);
+
+    /* The callback may have performed and applied the operation itself */
+    if (conn->handshake.async_state == S2N_ASYNC_COMPLETE) {
+        conn->handshake.async_state = S2N_ASYNC_NOT_INVOKED;
+        return 0;
+    }
+    if (conn->handshake.async_state == S2N_ASYNC_FAILED) {
+        conn->handshake.async_state = S2N_ASYNC_NOT_INVOKED;
+        S2N_ERROR(S2N_ERR_ASYNC_FAILED);
+    }
+
+    S2N_ERROR_BLOCKED(S2N_ERR_ASYNC_BLOCKED);
+}
+
+int s2n_async_pkey_sign(struct s2n_connection *conn, s2n_signature_algorithm sig_alg, struct s2n_hash_state *digest, s2n_async_pkey_sign_complete on_complete)
+{
+    notnull_check(conn);
+    notnull_check(digest);
+    notnull_check(on_complete);
+    notnull_check(conn->handshake_params.our_chain_and_key);
+
+    if (conn->config->async_pkey_cb == NULL) {
+        const struct s2n_pkey *key = conn->handshake_params.our_chain_and_key->private_key;
+        DEFER_CLEANUP(struct s2n_blob signature = {0}, s2n_free);
+
+        int max_signature_size = s2n_pkey_size(key);
+        gt_check(max_signature_size, 0);
+        GUARD(s2n_alloc(&signature, max_signature_size));
+        S2N_ERROR_IF(s2n_pkey_sign_with_sig_alg(key, sig_alg, digest, &signature) < 0, S2N_ERR_DH_FAILED_SIGNING);
+
+        GUARD(on_complete(conn, &signature));
+
+        return 0;
+    }
+
+    struct s2n_async_pkey_op *op;
+    GUARD(s2n_async_pkey_op_allocate(conn, S2N_ASYNC_SIGN, &op));
+    op->op.sign.sig_alg = sig_alg;
+    op->op.sign.on_complete = on_complete;
+
+    /* The connection goes on using its own digest, so the operation gets a copy */
+    if (s2n_hash_new(&op->op.sign.digest) < 0 || s2n_hash_copy(&op->op.sign.digest, digest) < 0) {
+        GUARD(s2n_async_pkey_op_free(op));
+        S2N_ERROR_PRESERVE_ERRNO();
+    }
+
+    GUARD(s2n_async_pkey_invoke(conn, op));
+
+    return 0;
+}
+
+int s2n_async_pkey_decrypt(struct s2n_connection *conn, struct s2n_blob *encrypted, struct s2n_blob *init_decrypted,
+                           s2n_async_pkey_decrypt_complete on_complete)
+{
+    notnull_check(conn);
+    notnull_check(encrypted);
+    notnull_check(init_decrypted);
+    notnull_check(on_complete);
+    notnull_check(conn->handshake_params.our_chain_and_key);
+
+    if (conn->config->async_pkey_cb == NULL) {
+        /* Set rsa_failed to 1 if s2n_pkey_decrypt returns anything other than zero */
+        uint8_t rsa_failed = !!s2n_pkey_decrypt(conn->handshake_params.our_chain_and_key->private_key, encrypted, init_decrypted);
+
+        GUARD(on_complete(conn, rsa_failed, init_decrypted));
+
+        return 0;
+    }
+
+    struct s2n_async_pkey_op *op;
+    GUARD(s2n_async_pkey_op_allocate(conn, S2N_ASYNC_DECRYPT, &op));
+    op->op.decrypt.on_complete = on_complete;
+
+    /* The output starts out as the caller's random fallback, which is kept if decryption fails */
+    if (s2n_dup(encrypted, &op->op.decrypt.encrypted) < 0 || s2n_dup(init_decrypted, &op->op.decrypt.decrypted) < 0) {
+        GUARD(s2n_async_pkey_op_free(op));
+        S2N_ERROR_PRESERVE_ERRNO();
+    }
+
+    GUARD(s2n_async_pkey_invoke(conn, op));
+
+    return 0;
+}
+
+int s2n_config_set_async_pkey_callback(struct s2n_config *config, s2n_async_pkey_fn fn)
+{
+    notnull_check(config);
+
+    config->async_pkey_cb = fn;
+    config->sign_engine = NULL;
+
+    return 0;
+}
+
+int s2n_async_pkey_op_get_op_type(struct s2n_async_pkey_op *op, s2n_async_pkey_op_type *type)
+{
+    notnull_check(op);
+    notnull_check(type);
+
+    *type = op->type;
+
+    return 0;
+}
+
+static int s2n_async_pkey_op_run(struct s2n_async_pkey_op *op)
+{
+    switch (op->type) {
+        case S2N_ASYNC_SIGN: {
+            struct s2n_async_pkey_sign_data *sign = &op->op.sign;
+            int max_signature_size = s2n_pkey_size(op->key);
+            gt_check(max_signature_size, 0);
+
+            GUARD(s2n_alloc(&sign->signature, max_signature_size));
+            S2N_ERROR_IF(s2n_pkey_sign_with_sig_alg(op->key, sign->sig_alg, &sign->digest, &sign->signature) < 0, S2N_ERR_DH_FAILED_SIGNING);
+            break;
+        }
+        case S2N_ASYNC_DECRYPT: {
+            struct s2n_async_pkey_decrypt_data *decrypt = &op->op.decrypt;
+
+            /* Failures are folded into the handshake like the synchronous path does, to avoid a padding oracle */
+            decrypt->rsa_failed = !!s2n_pkey_decrypt(op->key, &decrypt->encrypted, &decrypt->decrypted);
+            break;
+        }
+        default:
+            S2N_ERROR(S2N_ERR_SAFETY);
+    }
+
+    return 0;
+}
+
+int s2n_async_pkey_op_perform(struct s2n_async_pkey_op *op)
+{
+    notnull_check(op);
+    S2N_ERROR_IF(op->complete || op->failed, S2N_ERR_ASYNC_ALREADY_PERFORMED);
+
+    /* A failed operation can still be applied, which fails the handshake */
+    if (s2n_async_pkey_op_run(op) < 0) {
+        op->failed = 1;
+        S2N_ERROR_PRESERVE_ERRNO();
+    }
+
+    op->complete = 1;
+
+    return 0;
+}
+
+int s2n_async_pkey_op_apply(struct s2n_async_pkey_op *op, struct s2n_connection *conn)
+{
+    notnull_check(op);
+    notnull_check(conn);
+    S2N_ERROR_IF(!op->complete && !op->failed, S2N_ERR_ASYNC_NOT_PERFORMED);
+    S2N_ERROR_IF(op->applied, S2N_ERR_ASYNC_ALREADY_APPLIED);
+    S2N_ERROR_IF(op->conn != conn || conn->handshake.async_state != S2N_ASYNC_INVOKED, S2N_ERR_ASYNC_WRONG_CONNECTION);
+    /* A wiped connection may already be waiting on an operation for its next handshake */
+    S2N_ERROR_IF(op->handshake_generation != conn->handshake_generation, S2N_ERR_ASYNC_WRONG_CONNECTION);
+
+    if (op->failed) {
+        conn->handshake.async_state = S2N_ASYNC_FAILED;
+        op->applied = 1;
+        return 0;
+    }
+
+    switch (op->type) {
+        case S2N_ASYNC_SIGN:
+            GUARD(op->op.sign.on_complete(conn, &op->op.sign.signature));
+            break;
+        case S2N_ASYNC_DECRYPT:
+            GUARD(op->op.decrypt.on_complete(conn, op->op.decrypt.rsa_failed, &op->op.decrypt.decrypted));
+            break;
+        default:
+            S2N_ERROR(S2N_ERR_SAFETY);
+    }
+
+    conn->handshake.async_state = S2N_ASYNC_COMPLETE;
+    op->applied = 1;
+
+    return 0;
+}
+
+int s2n_async_pkey_op_free(struct s2n_async_pkey_op *op)
+{
+    notnull_check(op);
+
+    switch (op->type) {
+        case S2N_ASYNC_SIGN:
+            GUARD(s2n_hash_free(&op->op.sign.digest));
+            GUARD(s2n_free(&op->op.sign.signature));
+            break;
+        case S2N_ASYNC_DECRYPT:
+            GUARD(s2n_free(&op->op.decrypt.encrypted));
+            GUARD(s2n_free(&op->op.decrypt.decrypted));
+            break;
+    }
+
+    GUARD(s2n_free_object((uint8_t **) &op, sizeof(struct s2n_async_pkey_op)));
+
+    return 0;
+}
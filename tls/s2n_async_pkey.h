@@ -0,0 +1,100 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <s2n.h>
+
+#include "crypto/s2n_hash.h"
+#include "crypto/s2n_signature.h"
+
+#include "error/s2n_errno.h"
+
+#include "utils/s2n_blob.h"
+
+struct s2n_connection;
+struct s2n_pkey;
+
+typedef enum {
+    S2N_ASYNC_NOT_INVOKED = 0,
+    S2N_ASYNC_INVOKED,
+    S2N_ASYNC_COMPLETE,
+    S2N_ASYNC_FAILED,
+} s2n_async_state;
+
+/* Called on the connection's own thread, from s2n_async_pkey_op_apply() or straight away when there is no callback */
+typedef int (*s2n_async_pkey_sign_complete)(struct s2n_connection *conn, struct s2n_blob *signature);
+typedef int (*s2n_async_pkey_decrypt_complete)(struct s2n_connection *conn, uint8_t rsa_failed, struct s2n_blob *decrypted);
+
+struct s2n_async_pkey_sign_data {
+    s2n_signature_algorithm sig_alg;
+    struct s2n_hash_state digest;
+    struct s2n_blob signature;
+    s2n_async_pkey_sign_complete on_complete;
+};
+
+struct s2n_async_pkey_decrypt_data {
+    struct s2n_blob encrypted;
+    struct s2n_blob decrypted;
+    uint8_t rsa_failed;
+    s2n_async_pkey_decrypt_complete on_complete;
+};
+
+/* Everything the operation needs is copied in, so that it can be performed on
+ * any thread without touching the connection.
+ */
+struct s2n_async_pkey_op {
+    s2n_async_pkey_op_type type;
+    struct s2n_connection *conn;
+    /* The conn->handshake_generation the operation was started in */
+    uint32_t handshake_generation;
+    const struct s2n_pkey *key;
+    unsigned complete:1;
+    unsigned failed:1;
+    unsigned applied:1;
+
+    union {
+        struct s2n_async_pkey_sign_data sign;
+        struct s2n_async_pkey_decrypt_data decrypt;
+    } op;
+
+    /* Links operations queued up in a s2n_sign_engine */
+    struct s2n_async_pkey_op *next;
+};
+
+/* A handler that started an async operation is called again once the operation
+ * has been applied. This makes that second call return straight away, since the
+ * completion function has already done the rest of its work, or fail if the
+ * operation itself failed.
+ */
+#define S2N_ASYNC_PKEY_GUARD(conn)                                      \
+    do {                                                                \
+        switch ((conn)->handshake.async_state) {                        \
+            case S2N_ASYNC_NOT_INVOKED:                                 \
+                break;                                                  \
+            case S2N_ASYNC_INVOKED:                                     \
+                S2N_ERROR_BLOCKED(S2N_ERR_ASYNC_BLOCKED);               \
+            case S2N_ASYNC_COMPLETE:                                    \
+                (conn)->handshake.async_state = S2N_ASYNC_NOT_INVOKED;  \
+                return 0;                                               \
+            case S2N_ASYNC_FAILED:                                      \
+                (conn)->handshake.async_state = S2N_ASYNC_NOT_INVOKED;  \
+                S2N_ERROR(S2N_ERR_ASYNC_FAILED);                        \
+        }                                                               \
+    } while (0)
+
+extern int s2n_async_pkey_sign(struct s2n_connection *conn, s2n_signature_algorithm sig_alg, struct s2n_hash_state *digest, s2n_async_pkey_sign_complete on_complete);
+extern int s2n_async_pkey_decrypt(struct s2n_connection *conn, struct s2n_blob *encrypted, struct s2n_blob *init_decrypted,
+                                  s2n_async_pkey_decrypt_complete on_complete);
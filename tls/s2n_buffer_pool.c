@@ -0,0 +1,101 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <s2n.h>
+
+#include "error/s2n_errno.h"
+
+#include "stuffer/s2n_stuffer.h"
+
+#include "tls/s2n_buffer_pool.h"
+
+#include "utils/s2n_blob.h"
+#include "utils/s2n_mem.h"
+#include "utils/s2n_safety.h"
+
+/* Record buffers for connections with dynamic buffers. A connection only holds
+ * one while a record is on its way in or out, so a thread needs as many as it
+ * has records in flight at once, however many connections it has. Like the
+ * other pools, each thread has its own and no locking is involved.
+ */
+static __thread struct s2n_blob pool_buffers[S2N_BUFFER_POOL_MAX_DEPTH];
+static __thread struct s2n_buffer_pool_stats pool_stats = {0};
+
+int s2n_buffer_pool_lease(struct s2n_stuffer *stuffer)
+{
+    notnull_check(stuffer);
+
+    if (stuffer->blob.data) {
+        return 0;
+    }
+
+    if (pool_stats.idle == 0) {
+        pool_stats.misses++;
+        GUARD(s2n_stuffer_resize(stuffer, S2N_BUFFER_POOL_BUFFER_SIZE));
+        return 0;
+    }
+
+    /* An empty growable stuffer is in the same state as a new one, apart from its buffer */
+    S2N_ERROR_IF(stuffer->growable == 0, S2N_ERR_RESIZE_STATIC_STUFFER);
+    stuffer->blob = pool_buffers[--pool_stats.idle];
+    pool_buffers[pool_stats.idle] = (struct s2n_blob) {0};
+    stuffer->read_cursor = 0;
+    stuffer->write_cursor = 0;
+    stuffer->tainted = 0;
+    pool_stats.hits++;
+
+    return 0;
+}
+
+int s2n_buffer_pool_return(struct s2n_stuffer *stuffer)
+{
+    notnull_check(stuffer);
+
+    if (stuffer->blob.data == NULL) {
+        return 0;
+    }
+
+    S2N_ERROR_IF(s2n_stuffer_data_available(stuffer), S2N_ERR_STUFFER_HAS_UNPROCESSED_DATA);
+    GUARD(s2n_stuffer_wipe(stuffer));
+
+    if (stuffer->blob.size != S2N_BUFFER_POOL_BUFFER_SIZE || pool_stats.idle == S2N_BUFFER_POOL_MAX_DEPTH) {
+        GUARD(s2n_stuffer_resize(stuffer, 0));
+        return 0;
+    }
+
+    pool_buffers[pool_stats.idle++] = stuffer->blob;
+    stuffer->blob = (struct s2n_blob) {0};
+    pool_stats.returns++;
+
+    return 0;
+}
+
+int s2n_buffer_pool_get_stats(struct s2n_buffer_pool_stats *stats)
+{
+    notnull_check(stats);
+
+    *stats = pool_stats;
+
+    return 0;
+}
+
+int s2n_buffer_pool_cleanup_thread(void)
+{
+    while (pool_stats.idle > 0) {
+        GUARD(s2n_free(&pool_buffers[--pool_stats.idle]));
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <s2n.h>
+
+#include "stuffer/s2n_stuffer.h"
+
+#include "tls/s2n_tls_parameters.h"
+
+/* Every pooled buffer is big enough for a whole record, in either direction */
+#define S2N_BUFFER_POOL_BUFFER_SIZE S2N_LARGE_RECORD_LENGTH
+#define S2N_BUFFER_POOL_MAX_DEPTH   64
+
+/* Gives stuffer a pooled buffer, or a new one if the pool is empty. A stuffer that already has a buffer keeps it. */
+extern int s2n_buffer_pool_lease(struct s2n_stuffer *stuffer);
+
+/* Wipes stuffer, which must have no unread data, and takes its buffer back. Buffers
+ * that have been resized, or that don't fit in the pool, are freed instead.
+ */
+extern int s2n_buffer_pool_return(struct s2n_stuffer *stuffer);
+
+/* Frees every buffer pooled by the calling thread */
+extern int s2n_buffer_pool_cleanup_thread(void);
@@ -47,12 +47,6 @@
  */
 int s2n_verify_cbc(struct s2n_connection *conn, struct s2n_hmac_state *hmac, struct s2n_blob *decrypted)
 {
-    /* Set up MAC copy workspace */
-    struct s2n_hmac_state *copy = &conn->client->record_mac_copy_workspace;
-    if (conn->mode == S2N_CLIENT) {
-       copy = &conn->server->record_mac_copy_workspace;
-    }
-    
     uint8_t mac_digest_size;
     GUARD(s2n_hmac_digest_size(hmac->alg, &mac_digest_size));
 
@@ -67,9 +61,9 @@ int s2n_verify_cbc(struct s2n_connection *conn, struct s2n_hmac_state *hmac, str
 
     int payload_length = MAX(payload_and_padding_size - padding_length - 1, 0);
 
-    /* Update the MAC */
+    /* Update the MAC, and remember where in the hash block the payload ended */
     GUARD(s2n_hmac_update(hmac, decrypted->data, payload_length));
-    GUARD(s2n_hmac_copy(copy, hmac));
+    uint32_t currently_in_hash_block = hmac->currently_in_hash_block;
 
     /* Check the MAC */
     uint8_t check_digest[S2N_MAX_DIGEST_LEN];
@@ -78,8 +72,12 @@ int s2n_verify_cbc(struct s2n_connection *conn, struct s2n_hmac_state *hmac, str
 
     int mismatches = s2n_constant_time_equals(decrypted->data + payload_length, check_digest, mac_digest_size) ^ 1;
 
-    /* Compute a MAC on the rest of the data so that we perform the same number of hash operations */
-    GUARD(s2n_hmac_update(copy, decrypted->data + payload_length + mac_digest_size, decrypted->size - payload_length - mac_digest_size - 1));
+    /* Compute a MAC on the rest of the data so that we perform the same number of hash operations.
+     * This picks up from where the payload left off in the hash block, so no copy of the HMAC state
+     * is needed to keep the number of compression rounds independent of the padding length.
+     */
+    GUARD(s2n_hmac_digest_balance(hmac, currently_in_hash_block, decrypted->data + payload_length + mac_digest_size,
+                                  decrypted->size - payload_length - mac_digest_size - 1));
 
     /* SSLv3 doesn't specify what the padding should actually be */
     if (conn->actual_protocol_version == S2N_SSLv3) {
@@ -95,8 +93,6 @@ int s2n_verify_cbc(struct s2n_connection *conn, struct s2n_hmac_state *hmac, str
         mismatches |= (decrypted->data[j] ^ padding_length) & mask;
     }
 
-    GUARD(s2n_hmac_reset(copy));
-
     S2N_ERROR_IF(mismatches, S2N_ERR_CBC_VERIFY);
 
     return 0;
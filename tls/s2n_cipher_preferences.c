@@ -908,6 +908,12 @@ int s2n_config_set_cipher_preferences(struct s2n_config *config, const char *ver
 int s2n_connection_set_cipher_preferences(struct s2n_connection *conn, const char *version)
 {
     GUARD(s2n_find_cipher_pref_from_version(version, &conn->cipher_pref_override));
+
+    /* The versions a client offers depend on its cipher preferences */
+    if (conn->mode == S2N_CLIENT) {
+        GUARD(s2n_connection_init_protocol_versions(conn));
+    }
+
     return 0;
 }
 
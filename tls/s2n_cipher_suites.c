@@ -18,9 +18,11 @@
 #include "error/s2n_errno.h"
 
 #include "crypto/s2n_cipher.h"
+#include "crypto/s2n_ecdsa.h"
 #include "crypto/s2n_openssl.h"
 
 #include "tls/s2n_cipher_preferences.h"
+#include "tls/s2n_signature_algorithms.h"
 #include "tls/s2n_tls.h"
 #include "tls/s2n_kex.h"
 #include "utils/s2n_safety.h"
@@ -960,7 +962,8 @@ int s2n_cipher_suites_cleanup(void)
     return 0;
 }
 
-struct s2n_cipher_suite *s2n_cipher_suite_from_wire(const uint8_t cipher_suite[S2N_TLS_CIPHER_SUITE_LEN])
+/* Returns the position of the cipher suite in s2n_all_cipher_suites, or -1 if it isn't there */
+static int s2n_cipher_suite_search(const uint8_t cipher_suite[S2N_TLS_CIPHER_SUITE_LEN])
 {
     int low = 0;
     int top = (sizeof(s2n_all_cipher_suites) / sizeof(struct s2n_cipher_suite*)) - 1;
@@ -972,7 +975,7 @@ struct s2n_cipher_suite *s2n_cipher_suite_from_wire(const uint8_t cipher_suite[S
         int m = memcmp(s2n_all_cipher_suites[mid]->iana_value, cipher_suite, 2);
 
         if (m == 0) {
-            return s2n_all_cipher_suites[mid];
+            return mid;
         } else if (m > 0) {
             top = mid - 1;
         } else if (m < 0) {
@@ -980,7 +983,37 @@ struct s2n_cipher_suite *s2n_cipher_suite_from_wire(const uint8_t cipher_suite[S
         }
     }
 
-    return NULL;
+    return -1;
+}
+
+struct s2n_cipher_suite *s2n_cipher_suite_from_wire(const uint8_t cipher_suite[S2N_TLS_CIPHER_SUITE_LEN])
+{
+    int index = s2n_cipher_suite_search(cipher_suite);
+    if (index < 0) {
+        return NULL;
+    }
+
+    return s2n_all_cipher_suites[index];
+}
+
+int s2n_cipher_suite_get_index(const struct s2n_cipher_suite *cipher_suite)
+{
+    notnull_check(cipher_suite);
+
+    return s2n_cipher_suite_search(cipher_suite->iana_value);
+}
+
+int s2n_cipher_suite_get_index_by_name(const char *name)
+{
+    notnull_check(name);
+
+    for (int i = 0; i < s2n_array_len(s2n_all_cipher_suites); i++) {
+        if (!strcmp(s2n_all_cipher_suites[i]->name, name)) {
+            return i;
+        }
+    }
+
+    return -1;
 }
 
 int s2n_set_cipher_as_client(struct s2n_connection *conn, uint8_t wire[S2N_TLS_CIPHER_SUITE_LEN])
@@ -1016,16 +1049,16 @@ static int s2n_wire_ciphers_contain(const uint8_t * match, const uint8_t * wire,
  * 1. Certificates that match the client's ServerName extension.
  * 2. Default certificates
  */
-static struct s2n_cert_chain_and_key *s2n_conn_get_compatible_cert_chain_and_key(struct s2n_connection *conn, struct s2n_cipher_suite *cipher_suite)
+static struct s2n_cert_chain_and_key *s2n_conn_get_compatible_cert_chain_and_key(struct s2n_connection *conn, s2n_authentication_method auth_method)
 {
     if (conn->handshake_params.exact_sni_match_exists) {
         /* This may return NULL if there was an SNI match, but not a match the cipher_suite's authentication type. */
-        return conn->handshake_params.exact_sni_matches[cipher_suite->auth_method];
+        return conn->handshake_params.exact_sni_matches[auth_method];
     } if (conn->handshake_params.wc_sni_match_exists) {
-        return conn->handshake_params.wc_sni_matches[cipher_suite->auth_method];
+        return conn->handshake_params.wc_sni_matches[auth_method];
     } else {
         /* We don't have any name matches. Use the default certificate that works with the key type. */
-        return conn->config->default_cert_per_auth_method.certs[cipher_suite->auth_method];
+        return conn->config->default_cert_per_auth_method.certs[auth_method];
     }
 }
 
@@ -1039,7 +1072,7 @@ static int s2n_set_cipher_and_cert_as_server(struct s2n_connection *conn, uint8_
      * version, and the client cipher list contains TLS_FALLBACK_SCSV, then the server must abort the connection since
      * TLS_FALLBACK_SCSV should only be present when the client previously failed to negotiate a higher TLS version.
      */
-    if (conn->client_protocol_version < s2n_highest_protocol_version) {
+    if (conn->client_protocol_version < conn->server_protocol_version) {
         uint8_t fallback_scsv[S2N_TLS_CIPHER_SUITE_LEN] = { TLS_FALLBACK_SCSV };
         if (s2n_wire_ciphers_contain(fallback_scsv, wire, count, cipher_suite_len)) {
             conn->closed = 1;
@@ -1074,10 +1107,15 @@ static int s2n_set_cipher_and_cert_as_server(struct s2n_connection *conn, uint8_
                 continue;
             }
 
+            /* TLS 1.3 cipher suites can't be used with older versions, and TLS 1.3 can only use them */
+            if ((match->minimum_required_tls_version >= S2N_TLS13) != (conn->actual_protocol_version >= S2N_TLS13)) {
+                continue;
+            }
+
             /* TLS 1.3 does not include key exchange in cipher suites */
             if (match->minimum_required_tls_version < S2N_TLS13) {
                 /* Skip the suite if it is not compatible with any certificates */
-                conn->handshake_params.our_chain_and_key = s2n_conn_get_compatible_cert_chain_and_key(conn, match);
+                conn->handshake_params.our_chain_and_key = s2n_conn_get_compatible_cert_chain_and_key(conn, match->auth_method);
                 if (!conn->handshake_params.our_chain_and_key) {
                     continue;
                 }
@@ -1126,3 +1164,47 @@ int s2n_set_cipher_and_cert_as_tls_server(struct s2n_connection *conn, uint8_t *
 {
     return s2n_set_cipher_and_cert_as_server(conn, wire, count, S2N_TLS_CIPHER_SUITE_LEN);
 }
+
+int s2n_set_cert_and_sig_scheme_as_tls13_server(struct s2n_connection *conn)
+{
+    const struct s2n_sig_scheme_list *peer_pref_list = &conn->handshake_params.client_sig_hash_algs;
+    const struct s2n_signature_scheme* const* our_pref_list;
+    size_t our_pref_len;
+    GUARD(s2n_get_signature_scheme_pref_list(conn, &our_pref_list, &our_pref_len));
+
+    /* TLS 1.3 cipher suites don't name an authentication method, so the certificate is the first one that can
+     * sign with a SignatureScheme both sides support, in our order of preference.
+     */
+    for (int i = 0; i < our_pref_len; i++) {
+        const struct s2n_signature_scheme *candidate = our_pref_list[i];
+
+        uint8_t offered = 0;
+        for (int j = 0; j < peer_pref_list->len; j++) {
+            if (peer_pref_list->iana_list[j] == candidate->iana_value) {
+                offered = 1;
+                break;
+            }
+        }
+        if (!offered) {
+            continue;
+        }
+
+        s2n_authentication_method auth_method;
+        GUARD(s2n_get_auth_method_from_sig_alg(candidate->sig_alg, &auth_method));
+        struct s2n_cert_chain_and_key *chain_and_key = s2n_conn_get_compatible_cert_chain_and_key(conn, auth_method);
+        if (chain_and_key == NULL) {
+            continue;
+        }
+
+        /* TLS 1.3 ECDSA SignatureSchemes also fix the curve of the key */
+        if (candidate->signature_curve != NULL && !s2n_ecdsa_pkey_matches_curve(chain_and_key->private_key, candidate->signature_curve)) {
+            continue;
+        }
+
+        conn->handshake_params.our_chain_and_key = chain_and_key;
+        conn->secure.conn_sig_scheme = *candidate;
+        return 0;
+    }
+
+    S2N_ERROR(S2N_ERR_INVALID_SIGNATURE_SCHEME);
+}
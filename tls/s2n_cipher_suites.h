@@ -138,6 +138,10 @@ extern struct s2n_cipher_suite s2n_tls13_chacha20_poly1305_sha256;
 extern int s2n_cipher_suites_init(void);
 extern int s2n_cipher_suites_cleanup(void);
 extern struct s2n_cipher_suite *s2n_cipher_suite_from_wire(const uint8_t cipher_suite[S2N_TLS_CIPHER_SUITE_LEN]);
+/* Cipher suites are numbered by their position in the list of all suites, or -1 for suites not in it */
+extern int s2n_cipher_suite_get_index(const struct s2n_cipher_suite *cipher_suite);
+extern int s2n_cipher_suite_get_index_by_name(const char *name);
 extern int s2n_set_cipher_as_client(struct s2n_connection *conn, uint8_t wire[S2N_TLS_CIPHER_SUITE_LEN]);
 extern int s2n_set_cipher_and_cert_as_sslv2_server(struct s2n_connection *conn, uint8_t * wire, uint16_t count);
 extern int s2n_set_cipher_and_cert_as_tls_server(struct s2n_connection *conn, uint8_t * wire, uint16_t count);
+extern int s2n_set_cert_and_sig_scheme_as_tls13_server(struct s2n_connection *conn);
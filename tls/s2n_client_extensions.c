@@ -29,10 +29,12 @@
 
 #include "extensions/s2n_client_supported_versions.h"
 #include "extensions/s2n_client_key_share.h"
+#include "extensions/s2n_client_psk_key_exchange_modes.h"
+#include "extensions/s2n_client_pre_shared_key.h"
+#include "extensions/s2n_client_early_data.h"
 #include "stuffer/s2n_stuffer.h"
 
 #include "tls/s2n_tls.h"
-#include "tls/s2n_tls13.h"
 #include "utils/s2n_safety.h"
 #include "utils/s2n_blob.h"
 
@@ -81,7 +83,8 @@ int s2n_client_extensions_send(struct s2n_connection *conn, struct s2n_stuffer *
     uint16_t application_protocols_len = client_app_protocols->size;
     uint16_t server_name_len = strlen(conn->server_name);
     uint16_t mfl_code_len = sizeof(conn->config->mfl_code);
-    uint16_t client_ticket_len = conn->client_ticket.size;
+    /* A TLS1.3 ticket is offered in the pre_shared_key extension instead */
+    uint16_t client_ticket_len = conn->tls13_psk.secret_size ? 0 : conn->client_ticket.size;
 
     if (server_name_len) {
         total_size += 9 + server_name_len;
@@ -127,9 +130,15 @@ int s2n_client_extensions_send(struct s2n_connection *conn, struct s2n_stuffer *
         }
     }
 
+    int pre_shared_key_size = 0;
     if (conn->client_protocol_version >= S2N_TLS13) {
         total_size += s2n_extensions_client_supported_versions_size(conn);
         total_size += s2n_extensions_client_key_share_size(conn);
+        total_size += s2n_extensions_client_psk_key_exchange_modes_size(conn);
+
+        GUARD(pre_shared_key_size = s2n_extensions_client_pre_shared_key_size(conn));
+        total_size += pre_shared_key_size;
+        total_size += s2n_extensions_client_early_data_size(conn);
     }
 
     GUARD(s2n_stuffer_write_uint16(out, total_size));
@@ -137,6 +146,7 @@ int s2n_client_extensions_send(struct s2n_connection *conn, struct s2n_stuffer *
     if (conn->client_protocol_version >= S2N_TLS13) {
         GUARD(s2n_extensions_client_supported_versions_send(conn, out));
         GUARD(s2n_extensions_client_key_share_send(conn, out));
+        GUARD(s2n_extensions_client_psk_key_exchange_modes_send(conn, out));
     }
 
     if (conn->actual_protocol_version >= S2N_TLS12) {
@@ -196,7 +206,7 @@ int s2n_client_extensions_send(struct s2n_connection *conn, struct s2n_stuffer *
     if (conn->config->use_tickets) {
         GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_SESSION_TICKET));
         GUARD(s2n_stuffer_write_uint16(out, client_ticket_len));
-        GUARD(s2n_stuffer_write(out, &conn->client_ticket));
+        GUARD(s2n_stuffer_write_bytes(out, conn->client_ticket.data, client_ticket_len));
     }
 
     /*
@@ -240,6 +250,15 @@ int s2n_client_extensions_send(struct s2n_connection *conn, struct s2n_stuffer *
         }
     }
 
+    if (conn->client_protocol_version >= S2N_TLS13) {
+        GUARD(s2n_extensions_client_early_data_send(conn, out));
+    }
+
+    /* The pre_shared_key extension has to be the last one */
+    if (pre_shared_key_size) {
+        GUARD(s2n_extensions_client_pre_shared_key_send(conn, out));
+    }
+
     return 0;
 }
 
@@ -288,15 +307,28 @@ int s2n_client_extensions_recv(struct s2n_connection *conn, struct s2n_array *pa
             GUARD(s2n_recv_pq_kem_extension(conn, &extension));
             break;
         case TLS_EXTENSION_SUPPORTED_VERSIONS:
-            if (s2n_is_tls13_enabled()) {
+            if (conn->server_protocol_version >= S2N_TLS13) {
                 GUARD(s2n_extensions_client_supported_versions_recv(conn, &extension));
             }
             break;
         case TLS_EXTENSION_KEY_SHARE:
-            if (s2n_is_tls13_enabled()) {
+            if (conn->server_protocol_version >= S2N_TLS13) {
                 GUARD(s2n_extensions_client_key_share_recv(conn, &extension));
             }
             break;
+        case TLS_EXTENSION_PSK_KEY_EXCHANGE_MODES:
+            if (conn->server_protocol_version >= S2N_TLS13) {
+                GUARD(s2n_extensions_client_psk_key_exchange_modes_recv(conn, &extension));
+            }
+            break;
+        case TLS_EXTENSION_EARLY_DATA:
+            if (conn->server_protocol_version >= S2N_TLS13) {
+                GUARD(s2n_extensions_client_early_data_recv(conn, &extension));
+            }
+            break;
+        /* The pre_shared_key extension is processed after the cipher suite is chosen, see s2n_client_hello_recv() */
+        case TLS_EXTENSION_PRE_SHARED_KEY:
+            break;
         }
     }
 
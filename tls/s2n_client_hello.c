@@ -33,6 +33,9 @@
 #include "tls/s2n_tls.h"
 #include "tls/s2n_client_extensions.h"
 #include "tls/s2n_tls_digest_preferences.h"
+#include "tls/extensions/s2n_client_pre_shared_key.h"
+#include "tls/extensions/s2n_server_key_share.h"
+#include "tls/extensions/s2n_supported_versions.h"
 
 #include "stuffer/s2n_stuffer.h"
 
@@ -249,6 +252,9 @@ static int s2n_populate_client_hello_extensions(struct s2n_client_hello *ch)
 
         lte_check(ext_size, s2n_stuffer_data_available(&in));
 
+        /* The pre_shared_key binders cover everything before them, so it has to be the last extension */
+        S2N_ERROR_IF(ext_type == TLS_EXTENSION_PRE_SHARED_KEY && ext_size != s2n_stuffer_data_available(&in), S2N_ERR_BAD_MESSAGE);
+
         /* fail early if we encountered a duplicate extension */
         S2N_ERROR_IF(S2N_CBIT_TEST(parsed_extensions_mask, ext_type), S2N_ERR_BAD_MESSAGE);
         S2N_CBIT_SET(parsed_extensions_mask, ext_type);
@@ -283,6 +289,9 @@ int s2n_handshake_status_handler(struct s2n_connection *conn)
     {
         /* We've selected the parameters for the handshake, update the required hashes for this connection */
         GUARD(s2n_conn_update_required_handshake_hashes(conn));
+    } else {
+        /* Keep every hash for SSLv2 ClientHellos, and stop buffering the transcript */
+        GUARD(s2n_handshake_require_all_hashes(&conn->handshake));
     }
 
     return 0;
@@ -293,6 +302,9 @@ int s2n_process_client_hello(struct s2n_connection *conn)
      * Negotiate protocol version, cipher suite, ALPN, select a cert, etc. */
     struct s2n_client_hello *client_hello = &conn->client_hello;
 
+    /* The config is final now, so the highest version we'll accept is known before supported_versions is read */
+    GUARD(s2n_connection_get_maximum_supported_version(conn, &conn->server_protocol_version));
+
     if (client_hello->parsed_extensions != NULL && client_hello->parsed_extensions->num_of_elements > 0) {
         GUARD(s2n_client_extensions_recv(conn, client_hello->parsed_extensions));
     }
@@ -312,15 +324,30 @@ int s2n_process_client_hello(struct s2n_connection *conn)
     /* Now choose the ciphers and the cert chain. */
     GUARD(s2n_set_cipher_and_cert_as_tls_server(conn, client_hello->cipher_suites.data, client_hello->cipher_suites.size / 2));
 
-    /* And set the signature and hash algorithm used for key exchange signatures */
-    GUARD(s2n_choose_sig_scheme_from_peer_preference_list(conn, &conn->handshake_params.client_sig_hash_algs,
-                                                           &conn->secure.conn_sig_scheme));
+    if (conn->actual_protocol_version >= S2N_TLS13) {
+        /* TLS1.3 cipher suites don't name a certificate type, so the cert is picked by SignatureScheme */
+        GUARD(s2n_set_cert_and_sig_scheme_as_tls13_server(conn));
+    } else {
+        /* And set the signature and hash algorithm used for key exchange signatures */
+        GUARD(s2n_choose_sig_scheme_from_peer_preference_list(conn, &conn->handshake_params.client_sig_hash_algs,
+                                                               &conn->secure.conn_sig_scheme));
+    }
 
     return 0;
 }
 
 int s2n_client_hello_recv(struct s2n_connection *conn)
 {
+    uint8_t hello_retry = IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type);
+    const struct s2n_cipher_suite *hello_retry_cipher_suite = conn->secure.cipher_suite;
+
+    /* The ClientHello sent after a HelloRetryRequest replaces the first one */
+    if (hello_retry) {
+        GUARD(s2n_stuffer_wipe(&conn->client_hello.raw_message));
+        GUARD(s2n_client_hello_free_parsed_extensions(&conn->client_hello));
+        conn->tls13_psk.ke_modes = 0;
+    }
+
     /* Parse client hello */
     GUARD(s2n_parse_client_hello(conn));
 
@@ -329,8 +356,10 @@ int s2n_client_hello_recv(struct s2n_connection *conn)
     /* Mark the collected client hello as available when parsing is done and before the client hello callback */
     conn->client_hello.parsed = 1;
 
-    /* Call client_hello_cb if exists, letting application to modify s2n_connection or swap s2n_config */
-    if (conn->config->client_hello_cb) {
+    /* Call client_hello_cb if exists, letting application to modify s2n_connection or swap s2n_config.
+     * The application already saw the first ClientHello of a retried handshake.
+     */
+    if (conn->config->client_hello_cb && !hello_retry) {
         int rc = conn->config->client_hello_cb(conn, conn->config->client_hello_cb_ctx);
         if (rc < 0) {
             GUARD(s2n_queue_reader_handshake_failure_alert(conn));
@@ -341,6 +370,24 @@ int s2n_client_hello_recv(struct s2n_connection *conn)
         }
     }
     GUARD(s2n_process_client_hello(conn));
+
+    /* A retried handshake has to negotiate what the HelloRetryRequest was sent for */
+    S2N_ERROR_IF(hello_retry && (conn->actual_protocol_version < S2N_TLS13 || conn->secure.cipher_suite != hello_retry_cipher_suite),
+            S2N_ERR_BAD_MESSAGE);
+
+    /* TLS1.3 has no session lookup message, so the handshake type is set as soon as the ClientHello is processed */
+    if (conn->actual_protocol_version >= S2N_TLS13) {
+        GUARD(s2n_extensions_client_pre_shared_key_recv(conn));
+        GUARD(s2n_handshake_status_handler(conn));
+
+        /* A psk_ke resumption has no key exchange, so there is no key share to pick */
+        if (!IS_PSK_KE_ONLY(conn)) {
+            GUARD(s2n_extensions_server_key_share_select(conn));
+        }
+
+        GUARD(s2n_early_data_server_select(conn));
+    }
+
     return 0;
 }
 
@@ -354,13 +401,15 @@ int s2n_client_hello_send(struct s2n_connection *conn)
     b.data = conn->secure.client_random;
     b.size = S2N_TLS_RANDOM_DATA_LEN;
 
-    /* Create the client random data */
+    /* Create the client random data, which is kept for the ClientHello sent after a HelloRetryRequest */
     GUARD(s2n_stuffer_init(&client_random, &b));
 
     r.data = s2n_stuffer_raw_write(&client_random, S2N_TLS_RANDOM_DATA_LEN);
     r.size = S2N_TLS_RANDOM_DATA_LEN;
     notnull_check(r.data);
-    GUARD(s2n_get_public_random_data(&r));
+    if (!IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type)) {
+        GUARD(s2n_get_public_random_data(&r));
+    }
 
     uint8_t reported_protocol_version = MIN(conn->client_protocol_version, S2N_TLS12);
     client_protocol_version[0] = reported_protocol_version / 10;
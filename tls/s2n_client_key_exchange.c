@@ -13,6 +13,8 @@
  * permissions and limitations under the License.
  */
 
+#include <sys/param.h>
+
 #include <s2n.h>
 
 #include "error/s2n_errno.h"
@@ -86,12 +88,49 @@ static int calculate_keys(struct s2n_connection *conn, struct s2n_blob *shared_k
     return 0;
 }
 
+/* The pre-master secret starts with the version in the ClientHello, which a TLS1.3 client caps at TLS1.2 */
+static int s2n_rsa_client_hello_version(struct s2n_connection *conn, uint8_t client_protocol_version[S2N_TLS_PROTOCOL_VERSION_LEN])
+{
+    uint8_t client_hello_version = MIN(conn->client_protocol_version, S2N_TLS12);
+
+    client_protocol_version[0] = client_hello_version / 10;
+    client_protocol_version[1] = client_hello_version % 10;
+    return 0;
+}
+
+static int s2n_rsa_client_key_recv_complete(struct s2n_connection *conn, uint8_t rsa_failed, struct s2n_blob *decrypted)
+{
+    uint8_t client_protocol_version[S2N_TLS_PROTOCOL_VERSION_LEN];
+
+    eq_check(decrypted->size, S2N_TLS_SECRET_LEN);
+
+    /* Keep a copy of the client protocol version in wire format */
+    GUARD(s2n_rsa_client_hello_version(conn, client_protocol_version));
+
+    /* The async path decrypts into its own buffer */
+    if (decrypted->data != conn->secure.rsa_premaster_secret) {
+        memcpy_check(conn->secure.rsa_premaster_secret, decrypted->data, S2N_TLS_SECRET_LEN);
+    }
+
+    conn->handshake.rsa_failed = rsa_failed;
+
+    /* Set rsa_failed to 1, if it isn't already, if the protocol version isn't what we expect */
+    conn->handshake.rsa_failed |= !s2n_constant_time_equals(client_protocol_version, conn->secure.rsa_premaster_secret, S2N_TLS_PROTOCOL_VERSION_LEN);
+    return 0;
+}
+
 int s2n_rsa_client_key_recv(struct s2n_connection *conn, struct s2n_blob *shared_key)
 {
     struct s2n_stuffer *in = &conn->handshake.io;
     uint8_t client_protocol_version[S2N_TLS_PROTOCOL_VERSION_LEN];
     uint16_t length;
 
+    /* The pre-master secret always ends up here, including when the handler is called again after an async decrypt */
+    shared_key->data = conn->secure.rsa_premaster_secret;
+    shared_key->size = S2N_TLS_SECRET_LEN;
+
+    S2N_ASYNC_PKEY_GUARD(conn);
+
     if (conn->actual_protocol_version == S2N_SSLv3) {
         length = s2n_stuffer_data_available(in);
     } else {
@@ -101,12 +140,7 @@ int s2n_rsa_client_key_recv(struct s2n_connection *conn, struct s2n_blob *shared
     S2N_ERROR_IF(length > s2n_stuffer_data_available(in), S2N_ERR_BAD_MESSAGE);
 
     /* Keep a copy of the client protocol version in wire format */
-    client_protocol_version[0] = conn->client_protocol_version / 10;
-    client_protocol_version[1] = conn->client_protocol_version % 10;
-
-    /* Decrypt the pre-master secret */
-    shared_key->data = conn->secure.rsa_premaster_secret;
-    shared_key->size = S2N_TLS_SECRET_LEN;
+    GUARD(s2n_rsa_client_hello_version(conn, client_protocol_version));
 
     struct s2n_blob encrypted = {.size = length, .data = s2n_stuffer_raw_read(in, length)};
     notnull_check(encrypted.data);
@@ -117,11 +151,8 @@ int s2n_rsa_client_key_recv(struct s2n_connection *conn, struct s2n_blob *shared
     conn->secure.rsa_premaster_secret[0] = client_protocol_version[0];
     conn->secure.rsa_premaster_secret[1] = client_protocol_version[1];
 
-    /* Set rsa_failed to 1 if s2n_pkey_decrypt returns anything other than zero */
-    conn->handshake.rsa_failed = !!s2n_pkey_decrypt(conn->handshake_params.our_chain_and_key->private_key, &encrypted, shared_key);
-
-    /* Set rsa_failed to 1, if it isn't already, if the protocol version isn't what we expect */
-    conn->handshake.rsa_failed |= !s2n_constant_time_equals(client_protocol_version, shared_key->data, S2N_TLS_PROTOCOL_VERSION_LEN);
+    /* Decrypt the pre-master secret, possibly once an async private key operation completes */
+    GUARD(s2n_async_pkey_decrypt(conn, &encrypted, shared_key, s2n_rsa_client_key_recv_complete));
     return 0;
 }
 
@@ -204,8 +235,7 @@ int s2n_ecdhe_client_key_send(struct s2n_connection *conn, struct s2n_blob *shar
 int s2n_rsa_client_key_send(struct s2n_connection *conn, struct s2n_blob *shared_key)
 {
     uint8_t client_protocol_version[S2N_TLS_PROTOCOL_VERSION_LEN];
-    client_protocol_version[0] = conn->client_protocol_version / 10;
-    client_protocol_version[1] = conn->client_protocol_version % 10;
+    GUARD(s2n_rsa_client_hello_version(conn, client_protocol_version));
 
     shared_key->data = conn->secure.rsa_premaster_secret;
     shared_key->size = S2N_TLS_SECRET_LEN;
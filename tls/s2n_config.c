@@ -21,6 +21,7 @@
 #include "crypto/s2n_certificate.h"
 #include "crypto/s2n_fips.h"
 
+#include "tls/s2n_anti_replay.h"
 #include "tls/s2n_cipher_preferences.h"
 #include "tls/s2n_tls13.h"
 #include "utils/s2n_safety.h"
@@ -85,10 +86,13 @@ static int s2n_config_init(struct s2n_config *config)
     config->status_request_type = S2N_STATUS_REQUEST_NONE;
     config->wall_clock = wall_clock;
     config->monotonic_clock = monotonic_clock;
+    config->perf_counters = 0;
     config->verify_host = NULL;
     config->data_for_verify_host = NULL;
     config->client_hello_cb = NULL;
     config->client_hello_cb_ctx = NULL;
+    config->async_pkey_cb = NULL;
+    config->sign_engine = NULL;
     config->cache_store = NULL;
     config->cache_store_data = NULL;
     config->cache_retrieve = NULL;
@@ -105,6 +109,12 @@ static int s2n_config_init(struct s2n_config *config)
     config->ticket_key_hashes = NULL;
     config->encrypt_decrypt_key_lifetime_in_nanos = S2N_TICKET_ENCRYPT_DECRYPT_KEY_LIFETIME_IN_NANOS;
     config->decrypt_key_lifetime_in_nanos = S2N_TICKET_DECRYPT_KEY_LIFETIME_IN_NANOS;
+    config->max_early_data_size = 0;
+    config->early_data_replay_window_in_nanos = S2N_EARLY_DATA_REPLAY_WINDOW_IN_NANOS;
+    config->early_data_max_client_hellos = S2N_EARLY_DATA_MAX_CLIENT_HELLOS;
+    config->anti_replay = NULL;
+    config->early_data_replay_cb = NULL;
+    config->early_data_replay_data = NULL;
 
     /* By default, only the client will authenticate the Server's Certificate. The Server does not request or
      * authenticate any client certificates. */
@@ -143,6 +153,7 @@ static int s2n_config_cleanup(struct s2n_config *config)
     config->check_ocsp = 0;
 
     GUARD(s2n_config_free_session_ticket_keys(config));
+    GUARD(s2n_anti_replay_free(&config->anti_replay));
     GUARD(s2n_config_free_cert_chain_and_key(config));
     GUARD(s2n_config_free_dhparams(config));
     GUARD(s2n_free(&config->application_protocols));
@@ -346,6 +357,9 @@ int s2n_config_init_session_ticket_keys(struct s2n_config *config)
 int s2n_config_free_session_ticket_keys(struct s2n_config *config)
 {
     if (config->ticket_keys != NULL) {
+        for (int i = 0; i < s2n_set_size(config->ticket_keys); i++) {
+            GUARD(s2n_ticket_key_free_session_keys(s2n_set_get(config->ticket_keys, i)));
+        }
         GUARD(s2n_set_free_p(&config->ticket_keys));
     }
 
@@ -523,6 +537,34 @@ int s2n_config_add_cert_chain_and_key_to_store(struct s2n_config *config, struct
     return 0;
 }
 
+int s2n_config_add_cert_chains_and_keys_to_store(struct s2n_config *config, struct s2n_cert_chain_and_key **cert_key_pairs,
+                                                uint32_t num_cert_key_pairs)
+{
+    notnull_check(config);
+    notnull_check(config->domain_name_to_cert_map);
+    notnull_check(cert_key_pairs);
+
+    /* Size the map for every name up front, rather than letting it double its way there */
+    uint64_t name_count = 0;
+    for (uint32_t i = 0; i < num_cert_key_pairs; i++) {
+        notnull_check(cert_key_pairs[i]);
+        uint32_t san_count = s2n_array_num_elements(cert_key_pairs[i]->san_names);
+        name_count += san_count ? san_count : s2n_array_num_elements(cert_key_pairs[i]->cn_names);
+    }
+    S2N_ERROR_IF(name_count > UINT32_MAX, S2N_ERR_INTEGER_OVERFLOW);
+
+    GUARD(s2n_map_unlock(config->domain_name_to_cert_map));
+    int reserved = s2n_map_reserve(config->domain_name_to_cert_map, name_count);
+    GUARD(s2n_map_complete(config->domain_name_to_cert_map));
+    GUARD(reserved);
+
+    for (uint32_t i = 0; i < num_cert_key_pairs; i++) {
+        GUARD(s2n_config_add_cert_chain_and_key_to_store(config, cert_key_pairs[i]));
+    }
+
+    return 0;
+}
+
 int s2n_config_clear_default_certificates(struct s2n_config *config)
 {
     notnull_check(config);
@@ -606,6 +648,15 @@ extern int s2n_config_set_monotonic_clock(struct s2n_config *config, s2n_clock_t
     return 0;
 }
 
+int s2n_config_set_perf_counters(struct s2n_config *config, uint8_t enabled)
+{
+    notnull_check(config);
+
+    config->perf_counters = enabled;
+
+    return 0;
+}
+
 int s2n_config_set_cache_store_callback(struct s2n_config *config, s2n_cache_store_callback cache_store_callback, void *data)
 {
     notnull_check(cache_store_callback);
@@ -807,6 +858,47 @@ int s2n_config_add_ticket_crypto_key(struct s2n_config *config,
     return 0;
 }
 
+int s2n_config_set_max_early_data_size(struct s2n_config *config, uint32_t max_early_data_size)
+{
+    notnull_check(config);
+
+    config->max_early_data_size = max_early_data_size;
+
+    if (max_early_data_size > 0 && config->anti_replay == NULL) {
+        GUARD(s2n_anti_replay_new(&config->anti_replay, config->early_data_replay_window_in_nanos,
+                config->early_data_max_client_hellos));
+    }
+
+    return 0;
+}
+
+int s2n_config_set_early_data_replay_window(struct s2n_config *config, uint32_t window_in_secs, uint32_t max_client_hellos)
+{
+    notnull_check(config);
+    S2N_ERROR_IF(window_in_secs == 0, S2N_ERR_INVALID_ARGUMENT);
+
+    config->early_data_replay_window_in_nanos = ((uint64_t) window_in_secs * ONE_SEC_IN_NANOS);
+    config->early_data_max_client_hellos = max_client_hellos;
+
+    if (config->anti_replay != NULL) {
+        GUARD(s2n_anti_replay_free(&config->anti_replay));
+        GUARD(s2n_anti_replay_new(&config->anti_replay, config->early_data_replay_window_in_nanos,
+                config->early_data_max_client_hellos));
+    }
+
+    return 0;
+}
+
+int s2n_config_set_early_data_replay_callback(struct s2n_config *config, s2n_early_data_replay_callback replay_callback, void *data)
+{
+    notnull_check(config);
+
+    config->early_data_replay_cb = replay_callback;
+    config->early_data_replay_data = data;
+
+    return 0;
+}
+
 int s2n_config_set_cert_tiebreak_callback(struct s2n_config *config, s2n_cert_tiebreak_callback cert_tiebreak_cb)
 {
     config->cert_tiebreak_cb = cert_tiebreak_cb;
@@ -28,7 +28,11 @@
 #define S2N_MAX_TICKET_KEYS 48
 #define S2N_MAX_TICKET_KEY_HASHES 500 /* 10KB */
 
+#define S2N_EARLY_DATA_REPLAY_WINDOW_IN_NANOS   10000000000
+#define S2N_EARLY_DATA_MAX_CLIENT_HELLOS        65536
+
 struct s2n_cipher_preferences;
+struct s2n_anti_replay;
 
 struct s2n_config {
     struct s2n_dh_params *dhparams;
@@ -44,6 +48,7 @@ struct s2n_config {
     s2n_status_request_type status_request_type;
     s2n_clock_time_nanoseconds wall_clock;
     s2n_clock_time_nanoseconds monotonic_clock;
+    uint8_t perf_counters;
 
     void *sys_clock_ctx;
     void *monotonic_clock_ctx;
@@ -51,6 +56,9 @@ struct s2n_config {
     s2n_client_hello_fn *client_hello_cb;
     void *client_hello_cb_ctx;
 
+    s2n_async_pkey_fn async_pkey_cb;
+    struct s2n_sign_engine *sign_engine;
+
     uint64_t session_state_lifetime_in_nanos;
 
     uint8_t use_tickets;
@@ -59,6 +67,16 @@ struct s2n_config {
     uint64_t encrypt_decrypt_key_lifetime_in_nanos;
     uint64_t decrypt_key_lifetime_in_nanos;
 
+    /* TLS1.3 early data is only accepted while max_early_data_size is non-zero.
+     * Resumed ClientHellos carrying early data are remembered for the replay
+     * window, by early_data_replay_cb when it is set and in anti_replay otherwise. */
+    uint32_t max_early_data_size;
+    uint64_t early_data_replay_window_in_nanos;
+    uint32_t early_data_max_client_hellos;
+    struct s2n_anti_replay *anti_replay;
+    s2n_early_data_replay_callback early_data_replay_cb;
+    void *early_data_replay_data;
+
     /* If caching is being used, these must all be set */
     s2n_cache_store_callback cache_store;
     void *cache_store_data;
@@ -28,17 +28,20 @@
 #include "error/s2n_errno.h"
 
 #include "tls/s2n_tls_parameters.h"
+#include "tls/s2n_buffer_pool.h"
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_client_extensions.h"
 #include "tls/s2n_connection.h"
 #include "tls/s2n_connection_evp_digests.h"
 #include "tls/s2n_handshake.h"
+#include "tls/s2n_ktls.h"
 #include "tls/s2n_record.h"
 #include "tls/s2n_alerts.h"
 #include "tls/s2n_tls.h"
 #include "tls/s2n_prf.h"
 #include "tls/s2n_resume.h"
 #include "tls/s2n_kem.h"
+#include "tls/extensions/s2n_supported_versions.h"
 
 #include "crypto/s2n_certificate.h"
 #include "crypto/s2n_cipher.h"
@@ -51,23 +54,79 @@
 #include "utils/s2n_blob.h"
 #include "utils/s2n_mem.h"
 
+static int s2n_connection_attach_handshake_arena(struct s2n_connection *conn, struct s2n_handshake_arena *handshake_arena)
+{
+    conn->handshake_arena = handshake_arena;
+    conn->initial = handshake_arena ? &handshake_arena->initial : NULL;
+    conn->prf_space = handshake_arena ? &handshake_arena->prf_space : NULL;
+    conn->handshake.hashes = handshake_arena ? &handshake_arena->hashes : NULL;
+
+    return 0;
+}
+
+static int s2n_connection_new_handshake_arena(struct s2n_connection *conn)
+{
+    struct s2n_blob mem = {0};
+
+    GUARD(s2n_alloc(&mem, sizeof(struct s2n_handshake_arena)));
+    GUARD(s2n_blob_zero(&mem));
+    GUARD(s2n_connection_attach_handshake_arena(conn, (struct s2n_handshake_arena *)(void *)mem.data));
+
+    GUARD(s2n_session_key_alloc(&conn->initial->client_key));
+    GUARD(s2n_session_key_alloc(&conn->initial->server_key));
+
+    GUARD(s2n_prf_new(conn));
+
+    /* The handshake hashes are only allocated once the handshake needs them */
+    GUARD(s2n_hash_new(&conn->handshake.hashes->ccv_hash_copy));
+    GUARD(s2n_hash_new(&conn->handshake.hashes->server_finished_hash_copy));
+    GUARD(s2n_hash_new(&conn->handshake.hashes->prf_md5_hash_copy));
+    GUARD(s2n_hash_new(&conn->handshake.hashes->prf_sha1_hash_copy));
+    GUARD(s2n_hash_new(&conn->handshake.hashes->prf_tls12_hash_copy));
+    GUARD(s2n_hash_new(&conn->prf_space->ssl3.md5));
+    GUARD(s2n_hash_new(&conn->prf_space->ssl3.sha1));
+    GUARD(s2n_hash_new(&conn->initial->signature_hash));
+
+    GUARD(s2n_hmac_new(&conn->initial->client_record_mac));
+    GUARD(s2n_hmac_new(&conn->initial->server_record_mac));
+
+    return 0;
+}
+
+static int s2n_connection_free_handshake_arena(struct s2n_connection *conn)
+{
+    if (conn->handshake_arena == NULL) {
+        return 0;
+    }
+
+    GUARD(s2n_session_key_free(&conn->initial->client_key));
+    GUARD(s2n_session_key_free(&conn->initial->server_key));
+
+    GUARD(s2n_prf_free(conn));
+
+    GUARD(s2n_handshake_free_hashes(&conn->handshake));
+    GUARD(s2n_hash_free(&conn->handshake.hashes->ccv_hash_copy));
+    GUARD(s2n_hash_free(&conn->handshake.hashes->server_finished_hash_copy));
+    GUARD(s2n_hash_free(&conn->handshake.hashes->prf_md5_hash_copy));
+    GUARD(s2n_hash_free(&conn->handshake.hashes->prf_sha1_hash_copy));
+    GUARD(s2n_hash_free(&conn->handshake.hashes->prf_tls12_hash_copy));
+    GUARD(s2n_hash_free(&conn->prf_space->ssl3.md5));
+    GUARD(s2n_hash_free(&conn->prf_space->ssl3.sha1));
+    GUARD(s2n_hash_free(&conn->initial->signature_hash));
+
+    GUARD(s2n_hmac_free(&conn->initial->client_record_mac));
+    GUARD(s2n_hmac_free(&conn->initial->server_record_mac));
+
+    /* The arena is zeroed on the way out, taking the PRF working space with it */
+    GUARD(s2n_free_object((uint8_t **)&conn->handshake_arena, sizeof(struct s2n_handshake_arena)));
+    GUARD(s2n_connection_attach_handshake_arena(conn, NULL));
+
+    return 0;
+}
+
 static int s2n_connection_new_hashes(struct s2n_connection *conn)
 {
-    /* Allocate long-term memory for the Connection's hash states */
-    GUARD(s2n_hash_new(&conn->handshake.md5));
-    GUARD(s2n_hash_new(&conn->handshake.sha1));
-    GUARD(s2n_hash_new(&conn->handshake.sha224));
-    GUARD(s2n_hash_new(&conn->handshake.sha256));
-    GUARD(s2n_hash_new(&conn->handshake.sha384));
-    GUARD(s2n_hash_new(&conn->handshake.sha512));
-    GUARD(s2n_hash_new(&conn->handshake.md5_sha1));
-    GUARD(s2n_hash_new(&conn->handshake.ccv_hash_copy));
-    GUARD(s2n_hash_new(&conn->handshake.prf_md5_hash_copy));
-    GUARD(s2n_hash_new(&conn->handshake.prf_sha1_hash_copy));
-    GUARD(s2n_hash_new(&conn->handshake.prf_tls12_hash_copy));
-    GUARD(s2n_hash_new(&conn->prf_space.ssl3.md5));
-    GUARD(s2n_hash_new(&conn->prf_space.ssl3.sha1));
-    GUARD(s2n_hash_new(&conn->initial.signature_hash));
+    /* Allocate long-term memory for the Connection's hash states. The handshake's own live in the handshake arena. */
     GUARD(s2n_hash_new(&conn->secure.signature_hash));
 
     return 0;
@@ -79,7 +138,7 @@ static int s2n_connection_init_hashes(struct s2n_connection *conn)
 
     if (s2n_hash_is_available(S2N_HASH_MD5)) {
         /* Only initialize hashes that use MD5 if available. */
-        GUARD(s2n_hash_init(&conn->prf_space.ssl3.md5, S2N_HASH_MD5));
+        GUARD(s2n_hash_init(&conn->prf_space->ssl3.md5, S2N_HASH_MD5));
     }
 
 
@@ -88,30 +147,17 @@ static int s2n_connection_init_hashes(struct s2n_connection *conn)
      * NIST Special Publication 800-52 Revision 1.
      */
     if (s2n_is_in_fips_mode()) {
-        GUARD(s2n_hash_allow_md5_for_fips(&conn->handshake.md5));
-        GUARD(s2n_hash_allow_md5_for_fips(&conn->handshake.prf_md5_hash_copy));
-        
-        /* Do not check s2n_hash_is_available before initialization. Allow MD5 and 
-         * SHA-1 for both fips and non-fips mode. This is required to perform the
-         * signature checks in the CertificateVerify message in TLS 1.0 and TLS 1.1. 
-         * This is approved per Nist SP 800-52r1.*/
-        GUARD(s2n_hash_allow_md5_for_fips(&conn->handshake.md5_sha1));
+        GUARD(s2n_hash_allow_md5_for_fips(&conn->handshake.hashes->prf_md5_hash_copy));
     }
     
-    GUARD(s2n_hash_init(&conn->handshake.md5, S2N_HASH_MD5));
-    GUARD(s2n_hash_init(&conn->handshake.prf_md5_hash_copy, S2N_HASH_MD5));
-    GUARD(s2n_hash_init(&conn->handshake.md5_sha1, S2N_HASH_MD5_SHA1));
-
-    GUARD(s2n_hash_init(&conn->handshake.sha1, S2N_HASH_SHA1));
-    GUARD(s2n_hash_init(&conn->handshake.sha224, S2N_HASH_SHA224));
-    GUARD(s2n_hash_init(&conn->handshake.sha256, S2N_HASH_SHA256));
-    GUARD(s2n_hash_init(&conn->handshake.sha384, S2N_HASH_SHA384));
-    GUARD(s2n_hash_init(&conn->handshake.sha512, S2N_HASH_SHA512));
-    GUARD(s2n_hash_init(&conn->handshake.ccv_hash_copy, S2N_HASH_NONE));
-    GUARD(s2n_hash_init(&conn->handshake.prf_tls12_hash_copy, S2N_HASH_NONE));
-    GUARD(s2n_hash_init(&conn->handshake.prf_sha1_hash_copy, S2N_HASH_SHA1));
-    GUARD(s2n_hash_init(&conn->prf_space.ssl3.sha1, S2N_HASH_SHA1));
-    GUARD(s2n_hash_init(&conn->initial.signature_hash, S2N_HASH_NONE));
+    /* The handshake hashes are initialized once the handshake needs them */
+    GUARD(s2n_hash_init(&conn->handshake.hashes->prf_md5_hash_copy, S2N_HASH_MD5));
+    GUARD(s2n_hash_init(&conn->handshake.hashes->ccv_hash_copy, S2N_HASH_NONE));
+    GUARD(s2n_hash_init(&conn->handshake.hashes->server_finished_hash_copy, S2N_HASH_NONE));
+    GUARD(s2n_hash_init(&conn->handshake.hashes->prf_tls12_hash_copy, S2N_HASH_NONE));
+    GUARD(s2n_hash_init(&conn->handshake.hashes->prf_sha1_hash_copy, S2N_HASH_SHA1));
+    GUARD(s2n_hash_init(&conn->prf_space->ssl3.sha1, S2N_HASH_SHA1));
+    GUARD(s2n_hash_init(&conn->initial->signature_hash, S2N_HASH_NONE));
     GUARD(s2n_hash_init(&conn->secure.signature_hash, S2N_HASH_NONE));
 
     return 0;
@@ -120,12 +166,8 @@ static int s2n_connection_init_hashes(struct s2n_connection *conn)
 static int s2n_connection_new_hmacs(struct s2n_connection *conn)
 {
     /* Allocate long-term memory for the Connection's HMAC states */
-    GUARD(s2n_hmac_new(&conn->initial.client_record_mac));
-    GUARD(s2n_hmac_new(&conn->initial.server_record_mac));
-    GUARD(s2n_hmac_new(&conn->initial.record_mac_copy_workspace));
     GUARD(s2n_hmac_new(&conn->secure.client_record_mac));
     GUARD(s2n_hmac_new(&conn->secure.server_record_mac));
-    GUARD(s2n_hmac_new(&conn->secure.record_mac_copy_workspace));
 
     return 0;
 }
@@ -133,12 +175,10 @@ static int s2n_connection_new_hmacs(struct s2n_connection *conn)
 static int s2n_connection_init_hmacs(struct s2n_connection *conn)
 {
     /* Initialize all of the Connection's HMAC states */
-    GUARD(s2n_hmac_init(&conn->initial.client_record_mac, S2N_HMAC_NONE, NULL, 0));
-    GUARD(s2n_hmac_init(&conn->initial.server_record_mac, S2N_HMAC_NONE, NULL, 0));
-    GUARD(s2n_hmac_init(&conn->initial.record_mac_copy_workspace, S2N_HMAC_NONE, NULL, 0));
+    GUARD(s2n_hmac_init(&conn->initial->client_record_mac, S2N_HMAC_NONE, NULL, 0));
+    GUARD(s2n_hmac_init(&conn->initial->server_record_mac, S2N_HMAC_NONE, NULL, 0));
     GUARD(s2n_hmac_init(&conn->secure.client_record_mac, S2N_HMAC_NONE, NULL, 0));
     GUARD(s2n_hmac_init(&conn->secure.server_record_mac, S2N_HMAC_NONE, NULL, 0));
-    GUARD(s2n_hmac_init(&conn->secure.record_mac_copy_workspace, S2N_HMAC_NONE, NULL, 0));
 
     return 0;
 }
@@ -207,11 +247,9 @@ struct s2n_connection *s2n_connection_new(s2n_mode mode)
     /* Allocate long term key memory */
     GUARD_PTR(s2n_session_key_alloc(&conn->secure.client_key));
     GUARD_PTR(s2n_session_key_alloc(&conn->secure.server_key));
-    GUARD_PTR(s2n_session_key_alloc(&conn->initial.client_key));
-    GUARD_PTR(s2n_session_key_alloc(&conn->initial.server_key));
 
-    /* Allocate long term hash and HMAC memory */
-    GUARD_PTR(s2n_prf_new(conn));
+    /* Allocate the handshake arena, and long term hash and HMAC memory */
+    GUARD_PTR(s2n_connection_new_handshake_arena(conn));
 
     GUARD_PTR(s2n_connection_new_hashes(conn));
     GUARD_PTR(s2n_connection_init_hashes(conn));
@@ -228,7 +266,9 @@ struct s2n_connection *s2n_connection_new(s2n_mode mode)
     GUARD_PTR(s2n_stuffer_init(&conn->header_in, &blob));
     GUARD_PTR(s2n_stuffer_growable_alloc(&conn->out, 0));
     GUARD_PTR(s2n_stuffer_growable_alloc(&conn->in, 0));
+    GUARD_PTR(s2n_stuffer_growable_alloc(&conn->buffer_in, 0));
     GUARD_PTR(s2n_stuffer_growable_alloc(&conn->handshake.io, 0));
+    GUARD_PTR(s2n_stuffer_growable_alloc(&conn->handshake.transcript, 0));
     GUARD_PTR(s2n_stuffer_growable_alloc(&conn->client_hello.raw_message, 0));
     GUARD_PTR(s2n_connection_wipe(conn));
     GUARD_PTR(s2n_timer_start(conn->config, &conn->write_timer));
@@ -240,16 +280,18 @@ static int s2n_connection_free_keys(struct s2n_connection *conn)
 {
     GUARD(s2n_session_key_free(&conn->secure.client_key));
     GUARD(s2n_session_key_free(&conn->secure.server_key));
-    GUARD(s2n_session_key_free(&conn->initial.client_key));
-    GUARD(s2n_session_key_free(&conn->initial.server_key));
 
     return 0;
 }
 
 static int s2n_connection_zero(struct s2n_connection *conn, int mode, struct s2n_config *config)
 {
-    /* Zero the whole connection structure */
+    struct s2n_handshake_arena *handshake_arena = conn->handshake_arena;
+
+    /* Zero the whole connection structure, and its handshake arena with it */
     memset_check(conn, 0, sizeof(struct s2n_connection));
+    memset_check(handshake_arena, 0, sizeof(struct s2n_handshake_arena));
+    GUARD(s2n_connection_attach_handshake_arena(conn, handshake_arena));
 
     conn->send = NULL;
     conn->recv = NULL;
@@ -259,12 +301,12 @@ static int s2n_connection_zero(struct s2n_connection *conn, int mode, struct s2n
     conn->close_notify_queued = 0;
     conn->client_session_resumed = 0;
     conn->current_user_data_consumed = 0;
-    conn->initial.cipher_suite = &s2n_null_cipher_suite;
+    conn->initial->cipher_suite = &s2n_null_cipher_suite;
     conn->secure.cipher_suite = &s2n_null_cipher_suite;
-    conn->initial.s2n_kem_keys.negotiated_kem = NULL;
+    conn->initial->s2n_kem_keys.negotiated_kem = NULL;
     conn->secure.s2n_kem_keys.negotiated_kem = NULL;
-    conn->server = &conn->initial;
-    conn->client = &conn->initial;
+    conn->server = conn->initial;
+    conn->client = conn->initial;
     conn->max_outgoing_fragment_length = S2N_DEFAULT_FRAGMENT_LENGTH;
     conn->mfl_code = S2N_TLS_MAX_FRAG_LEN_EXT_NONE;
     conn->handshake.handshake_type = INITIAL;
@@ -311,20 +353,17 @@ static int s2n_connection_wipe_keys(struct s2n_connection *conn)
 static int s2n_connection_reset_hashes(struct s2n_connection *conn)
 {
     /* Reset all of the Connection's hash states */
-    GUARD(s2n_hash_reset(&conn->handshake.md5));
-    GUARD(s2n_hash_reset(&conn->handshake.sha1));
-    GUARD(s2n_hash_reset(&conn->handshake.sha224));
-    GUARD(s2n_hash_reset(&conn->handshake.sha256));
-    GUARD(s2n_hash_reset(&conn->handshake.sha384));
-    GUARD(s2n_hash_reset(&conn->handshake.sha512));
-    GUARD(s2n_hash_reset(&conn->handshake.md5_sha1));
-    GUARD(s2n_hash_reset(&conn->handshake.ccv_hash_copy));
-    GUARD(s2n_hash_reset(&conn->handshake.prf_md5_hash_copy));
-    GUARD(s2n_hash_reset(&conn->handshake.prf_sha1_hash_copy));
-    GUARD(s2n_hash_reset(&conn->handshake.prf_tls12_hash_copy));
-    GUARD(s2n_hash_reset(&conn->prf_space.ssl3.md5));
-    GUARD(s2n_hash_reset(&conn->prf_space.ssl3.sha1));
-    GUARD(s2n_hash_reset(&conn->initial.signature_hash));
+    if (conn->handshake_arena != NULL) {
+        GUARD(s2n_handshake_reset_hashes(&conn->handshake));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->ccv_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->server_finished_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->prf_md5_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->prf_sha1_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->prf_tls12_hash_copy));
+        GUARD(s2n_hash_reset(&conn->prf_space->ssl3.md5));
+        GUARD(s2n_hash_reset(&conn->prf_space->ssl3.sha1));
+        GUARD(s2n_hash_reset(&conn->initial->signature_hash));
+    }
     GUARD(s2n_hash_reset(&conn->secure.signature_hash));
 
     return 0;
@@ -333,12 +372,12 @@ static int s2n_connection_reset_hashes(struct s2n_connection *conn)
 static int s2n_connection_reset_hmacs(struct s2n_connection *conn)
 {
     /* Reset all of the Connection's HMAC states */
-    GUARD(s2n_hmac_reset(&conn->initial.client_record_mac));
-    GUARD(s2n_hmac_reset(&conn->initial.server_record_mac));
-    GUARD(s2n_hmac_reset(&conn->initial.record_mac_copy_workspace));
+    if (conn->handshake_arena != NULL) {
+        GUARD(s2n_hmac_reset(&conn->initial->client_record_mac));
+        GUARD(s2n_hmac_reset(&conn->initial->server_record_mac));
+    }
     GUARD(s2n_hmac_reset(&conn->secure.client_record_mac));
     GUARD(s2n_hmac_reset(&conn->secure.server_record_mac));
-    GUARD(s2n_hmac_reset(&conn->secure.record_mac_copy_workspace));
 
     return 0;
 }
@@ -376,21 +415,7 @@ static int s2n_connection_wipe_io(struct s2n_connection *conn)
 
 static int s2n_connection_free_hashes(struct s2n_connection *conn)
 {
-    /* Free all of the Connection's hash states */
-    GUARD(s2n_hash_free(&conn->handshake.md5));
-    GUARD(s2n_hash_free(&conn->handshake.sha1));
-    GUARD(s2n_hash_free(&conn->handshake.sha224));
-    GUARD(s2n_hash_free(&conn->handshake.sha256));
-    GUARD(s2n_hash_free(&conn->handshake.sha384));
-    GUARD(s2n_hash_free(&conn->handshake.sha512));
-    GUARD(s2n_hash_free(&conn->handshake.md5_sha1));
-    GUARD(s2n_hash_free(&conn->handshake.ccv_hash_copy));
-    GUARD(s2n_hash_free(&conn->handshake.prf_md5_hash_copy));
-    GUARD(s2n_hash_free(&conn->handshake.prf_sha1_hash_copy));
-    GUARD(s2n_hash_free(&conn->handshake.prf_tls12_hash_copy));
-    GUARD(s2n_hash_free(&conn->prf_space.ssl3.md5));
-    GUARD(s2n_hash_free(&conn->prf_space.ssl3.sha1));
-    GUARD(s2n_hash_free(&conn->initial.signature_hash));
+    /* Free all of the Connection's hash states. The handshake arena frees its own. */
     GUARD(s2n_hash_free(&conn->secure.signature_hash));
 
     return 0;
@@ -398,13 +423,9 @@ static int s2n_connection_free_hashes(struct s2n_connection *conn)
 
 static int s2n_connection_free_hmacs(struct s2n_connection *conn)
 {
-    /* Free all of the Connection's HMAC states */
-    GUARD(s2n_hmac_free(&conn->initial.client_record_mac));
-    GUARD(s2n_hmac_free(&conn->initial.server_record_mac));
-    GUARD(s2n_hmac_free(&conn->initial.record_mac_copy_workspace));
+    /* Free all of the Connection's HMAC states. The handshake arena frees its own. */
     GUARD(s2n_hmac_free(&conn->secure.client_record_mac));
     GUARD(s2n_hmac_free(&conn->secure.server_record_mac));
-    GUARD(s2n_hmac_free(&conn->secure.record_mac_copy_workspace));
 
     return 0;
 }
@@ -448,21 +469,24 @@ int s2n_connection_free(struct s2n_connection *conn)
     GUARD(s2n_connection_wipe_keys(conn));
     GUARD(s2n_connection_free_keys(conn));
 
-    GUARD(s2n_prf_free(conn));
-
     GUARD(s2n_connection_reset_hashes(conn));
     GUARD(s2n_connection_free_hashes(conn));
 
     GUARD(s2n_connection_reset_hmacs(conn));
     GUARD(s2n_connection_free_hmacs(conn));
 
+    GUARD(s2n_connection_free_handshake_arena(conn));
+
     GUARD(s2n_connection_free_io_contexts(conn));
 
     GUARD(s2n_free(&conn->client_ticket));
     GUARD(s2n_free(&conn->status_response));
+    GUARD(s2n_stuffer_free(&conn->early_data.in));
     GUARD(s2n_stuffer_free(&conn->in));
+    GUARD(s2n_stuffer_free(&conn->buffer_in));
     GUARD(s2n_stuffer_free(&conn->out));
     GUARD(s2n_stuffer_free(&conn->handshake.io));
+    GUARD(s2n_stuffer_free(&conn->handshake.transcript));
     s2n_x509_validator_wipe(&conn->x509_validator);
     GUARD(s2n_client_hello_free(&conn->client_hello));
     GUARD(s2n_free(&conn->application_protocols_overridden));
@@ -516,6 +540,12 @@ int s2n_connection_set_config(struct s2n_connection *conn, struct s2n_config *co
     }
 
     conn->config = config;
+
+    /* The versions a client offers depend on the cipher preferences of its config */
+    if (conn->mode == S2N_CLIENT) {
+        GUARD(s2n_connection_init_protocol_versions(conn));
+    }
+
     return 0;
 }
 
@@ -530,28 +560,84 @@ void *s2n_connection_get_ctx(struct s2n_connection *conn)
     return conn->context;
 }
 
+int s2n_connection_set_dynamic_buffers(struct s2n_connection *conn, uint8_t enabled)
+{
+    notnull_check(conn);
+
+    conn->dynamic_buffers = enabled;
+
+    if (!enabled) {
+        return 0;
+    }
+
+    /* A connection that hasn't started its handshake doesn't need its handshake buffer yet */
+    if (conn->handshake.message_number == 0 && s2n_stuffer_data_available(&conn->handshake.io) == 0) {
+        GUARD(s2n_buffer_pool_return(&conn->handshake.io));
+    }
+
+    GUARD(s2n_connection_return_buffers(conn));
+
+    return 0;
+}
+
+int s2n_connection_lease_buffer(struct s2n_connection *conn, struct s2n_stuffer *stuffer, uint32_t size)
+{
+    if (conn->dynamic_buffers && size <= S2N_BUFFER_POOL_BUFFER_SIZE) {
+        GUARD(s2n_buffer_pool_lease(stuffer));
+    } else {
+        GUARD(s2n_stuffer_resize_if_empty(stuffer, size));
+    }
+
+    return 0;
+}
+
+int s2n_connection_return_buffers(struct s2n_connection *conn)
+{
+    if (!conn->dynamic_buffers) {
+        return 0;
+    }
+
+    /* Buffers holding part of a record, or data the application hasn't read yet, stay */
+    if (s2n_stuffer_data_available(&conn->in) == 0) {
+        GUARD(s2n_buffer_pool_return(&conn->in));
+    }
+    if (s2n_stuffer_data_available(&conn->buffer_in) == 0) {
+        GUARD(s2n_buffer_pool_return(&conn->buffer_in));
+    }
+    if (s2n_stuffer_data_available(&conn->out) == 0) {
+        GUARD(s2n_buffer_pool_return(&conn->out));
+        conn->send_reserved_size = 0;
+    }
+
+    return 0;
+}
+
 int s2n_connection_release_buffers(struct s2n_connection *conn)
 {
     GUARD(s2n_stuffer_release_if_empty(&conn->out));
+    conn->send_reserved_size = 0;
     GUARD(s2n_stuffer_release_if_empty(&conn->in));
+    GUARD(s2n_stuffer_release_if_empty(&conn->buffer_in));
 
     return 0;
 }
 
 int s2n_connection_free_handshake(struct s2n_connection *conn)
 {
-    /* We are done with the handshake */
-    GUARD(s2n_hash_reset(&conn->handshake.md5));
-    GUARD(s2n_hash_reset(&conn->handshake.sha1));
-    GUARD(s2n_hash_reset(&conn->handshake.sha224));
-    GUARD(s2n_hash_reset(&conn->handshake.sha256));
-    GUARD(s2n_hash_reset(&conn->handshake.sha384));
-    GUARD(s2n_hash_reset(&conn->handshake.sha512));
-    GUARD(s2n_hash_reset(&conn->handshake.md5_sha1));
-    GUARD(s2n_hash_reset(&conn->handshake.ccv_hash_copy));
-    GUARD(s2n_hash_reset(&conn->handshake.prf_md5_hash_copy));
-    GUARD(s2n_hash_reset(&conn->handshake.prf_sha1_hash_copy));
-    GUARD(s2n_hash_reset(&conn->handshake.prf_tls12_hash_copy));
+    /* We are done with the handshake. Once both directions have switched to the secure parameters, nothing
+     * in the handshake arena is used anymore and it can go. Until then, only its hashes are reset.
+     */
+    if (is_handshake_complete(conn) && conn->client == &conn->secure && conn->server == &conn->secure) {
+        GUARD(s2n_connection_free_handshake_arena(conn));
+    } else if (conn->handshake_arena != NULL) {
+        GUARD(s2n_handshake_reset_hashes(&conn->handshake));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->ccv_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->server_finished_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->prf_md5_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->prf_sha1_hash_copy));
+        GUARD(s2n_hash_reset(&conn->handshake.hashes->prf_tls12_hash_copy));
+    }
+    GUARD(s2n_handshake_release_transcript(&conn->handshake));
 
     /* Wipe the buffers we are going to free */
     GUARD(s2n_stuffer_wipe(&conn->handshake.io));
@@ -565,6 +651,7 @@ int s2n_connection_free_handshake(struct s2n_connection *conn)
     GUARD(s2n_free(&conn->client_ticket));
     GUARD(s2n_free(&conn->status_response));
     GUARD(s2n_free(&conn->application_protocols_overridden));
+    GUARD(s2n_stuffer_free(&conn->early_data.in));
 
     /* Remove parsed extensions array from client_hello */
     GUARD(s2n_client_hello_free_parsed_extensions(&conn->client_hello));
@@ -572,19 +659,45 @@ int s2n_connection_free_handshake(struct s2n_connection *conn)
     return 0;
 }
 
+int s2n_connection_init_protocol_versions(struct s2n_connection *conn)
+{
+    uint8_t highest_protocol_version;
+    GUARD(s2n_connection_get_maximum_supported_version(conn, &highest_protocol_version));
+
+    if (conn->mode == S2N_SERVER) {
+        /* Start with the highest protocol version so that the highest common protocol version can be selected */
+        /* during handshake. */
+        conn->server_protocol_version = highest_protocol_version;
+        conn->client_protocol_version = s2n_unknown_protocol_version;
+        conn->actual_protocol_version = s2n_unknown_protocol_version;
+    }
+    else {
+        /* For clients, also set actual_protocol_version.  Record generation uses that value for the initial */
+        /* ClientHello record version. Not all servers ignore the record version in ClientHello. */
+        conn->server_protocol_version = s2n_unknown_protocol_version;
+        conn->client_protocol_version = highest_protocol_version;
+        conn->actual_protocol_version = highest_protocol_version;
+    }
+
+    return 0;
+}
+
 int s2n_connection_wipe(struct s2n_connection *conn)
 {
     /* First make a copy of everything we'd like to save, which isn't very much. */
     int mode = conn->mode;
     struct s2n_config *config = conn->config;
+    uint32_t handshake_generation = conn->handshake_generation;
     struct s2n_stuffer alert_in = {0};
     struct s2n_stuffer reader_alert_out = {0};
     struct s2n_stuffer writer_alert_out = {0};
     struct s2n_stuffer client_ticket_to_decrypt = {0};
     struct s2n_stuffer handshake_io = {0};
+    struct s2n_stuffer handshake_transcript = {0};
     struct s2n_stuffer client_hello_raw_message = {0};
     struct s2n_stuffer header_in = {0};
     struct s2n_stuffer in = {0};
+    struct s2n_stuffer buffer_in = {0};
     struct s2n_stuffer out = {0};
     /* Session keys will be wiped. Preserve structs to avoid reallocation */
     struct s2n_session_key initial_client_key = {0};
@@ -596,6 +709,13 @@ int s2n_connection_wipe(struct s2n_connection *conn)
     struct s2n_connection_hash_handles hash_handles = {0};
     struct s2n_connection_hmac_handles hmac_handles = {0};
 
+    /* A connection whose handshake arena was released needs a new one for its next handshake */
+    if (conn->handshake_arena == NULL) {
+        GUARD(s2n_connection_new_handshake_arena(conn));
+        GUARD(s2n_connection_init_hashes(conn));
+        GUARD(s2n_connection_init_hmacs(conn));
+    }
+
     /* Wipe all of the sensitive stuff */
     GUARD(s2n_connection_wipe_keys(conn));
     GUARD(s2n_connection_reset_hashes(conn));
@@ -605,17 +725,23 @@ int s2n_connection_wipe(struct s2n_connection *conn)
     GUARD(s2n_stuffer_wipe(&conn->writer_alert_out));
     GUARD(s2n_stuffer_wipe(&conn->client_ticket_to_decrypt));
     GUARD(s2n_stuffer_wipe(&conn->handshake.io));
+    GUARD(s2n_stuffer_wipe(&conn->handshake.transcript));
     GUARD(s2n_stuffer_wipe(&conn->client_hello.raw_message));
     GUARD(s2n_stuffer_wipe(&conn->header_in));
     GUARD(s2n_stuffer_wipe(&conn->in));
+    GUARD(s2n_stuffer_wipe(&conn->buffer_in));
     GUARD(s2n_stuffer_wipe(&conn->out));
 
+    /* Wiped buffers are as good as new, so give them to the next connection rather than freeing them */
+    GUARD(s2n_connection_return_buffers(conn));
+
     /* Wipe the I/O-related info and restore the original socket if necessary */
     GUARD(s2n_connection_wipe_io(conn));
 
     GUARD(s2n_free(&conn->client_ticket));
     GUARD(s2n_free(&conn->status_response));
     GUARD(s2n_free(&conn->application_protocols_overridden));
+    GUARD(s2n_stuffer_free(&conn->early_data.in));
 
     /* Remove parsed extensions array from client_hello */
     GUARD(s2n_client_hello_free_parsed_extensions(&conn->client_hello));
@@ -624,8 +750,10 @@ int s2n_connection_wipe(struct s2n_connection *conn)
     GUARD(s2n_stuffer_resize(&conn->handshake.io, S2N_LARGE_RECORD_LENGTH));
 
     /* Truncate the message buffers to save memory, we will dynamically resize it as needed */
+    GUARD(s2n_stuffer_resize(&conn->handshake.transcript, 0));
     GUARD(s2n_stuffer_resize(&conn->client_hello.raw_message, 0));
     GUARD(s2n_stuffer_resize(&conn->in, 0));
+    GUARD(s2n_stuffer_resize(&conn->buffer_in, 0));
     GUARD(s2n_stuffer_resize(&conn->out, 0));
 
     /* Remove context associated with connection */
@@ -646,12 +774,14 @@ int s2n_connection_wipe(struct s2n_connection *conn)
     memcpy_check(&writer_alert_out, &conn->writer_alert_out, sizeof(struct s2n_stuffer));
     memcpy_check(&client_ticket_to_decrypt, &conn->client_ticket_to_decrypt, sizeof(struct s2n_stuffer));
     memcpy_check(&handshake_io, &conn->handshake.io, sizeof(struct s2n_stuffer));
+    memcpy_check(&handshake_transcript, &conn->handshake.transcript, sizeof(struct s2n_stuffer));
     memcpy_check(&client_hello_raw_message, &conn->client_hello.raw_message, sizeof(struct s2n_stuffer));
     memcpy_check(&header_in, &conn->header_in, sizeof(struct s2n_stuffer));
     memcpy_check(&in, &conn->in, sizeof(struct s2n_stuffer));
+    memcpy_check(&buffer_in, &conn->buffer_in, sizeof(struct s2n_stuffer));
     memcpy_check(&out, &conn->out, sizeof(struct s2n_stuffer));
-    memcpy_check(&initial_client_key, &conn->initial.client_key, sizeof(struct s2n_session_key));
-    memcpy_check(&initial_server_key, &conn->initial.server_key, sizeof(struct s2n_session_key));
+    memcpy_check(&initial_client_key, &conn->initial->client_key, sizeof(struct s2n_session_key));
+    memcpy_check(&initial_server_key, &conn->initial->server_key, sizeof(struct s2n_session_key));
     memcpy_check(&secure_client_key, &conn->secure.client_key, sizeof(struct s2n_session_key));
     memcpy_check(&secure_server_key, &conn->secure.server_key, sizeof(struct s2n_session_key));
     GUARD(s2n_connection_save_prf_state(&prf_handles, conn));
@@ -663,17 +793,20 @@ int s2n_connection_wipe(struct s2n_connection *conn)
 
     GUARD(s2n_connection_zero(conn, mode, config));
 
+    conn->handshake_generation = handshake_generation + 1;
     memcpy_check(&conn->alert_in, &alert_in, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->reader_alert_out, &reader_alert_out, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->writer_alert_out, &writer_alert_out, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->client_ticket_to_decrypt, &client_ticket_to_decrypt, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->handshake.io, &handshake_io, sizeof(struct s2n_stuffer));
+    memcpy_check(&conn->handshake.transcript, &handshake_transcript, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->client_hello.raw_message, &client_hello_raw_message, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->header_in, &header_in, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->in, &in, sizeof(struct s2n_stuffer));
+    memcpy_check(&conn->buffer_in, &buffer_in, sizeof(struct s2n_stuffer));
     memcpy_check(&conn->out, &out, sizeof(struct s2n_stuffer));
-    memcpy_check(&conn->initial.client_key, &initial_client_key, sizeof(struct s2n_session_key));
-    memcpy_check(&conn->initial.server_key, &initial_server_key, sizeof(struct s2n_session_key));
+    memcpy_check(&conn->initial->client_key, &initial_client_key, sizeof(struct s2n_session_key));
+    memcpy_check(&conn->initial->server_key, &initial_server_key, sizeof(struct s2n_session_key));
     memcpy_check(&conn->secure.client_key, &secure_client_key, sizeof(struct s2n_session_key));
     memcpy_check(&conn->secure.server_key, &secure_server_key, sizeof(struct s2n_session_key));
     GUARD(s2n_connection_restore_prf_state(conn, &prf_handles));
@@ -684,23 +817,10 @@ int s2n_connection_wipe(struct s2n_connection *conn)
     GUARD(s2n_connection_init_hashes(conn));
     GUARD(s2n_connection_init_hmacs(conn));
 
-    /* Require all handshakes hashes. This set can be reduced as the handshake progresses. */
-    GUARD(s2n_handshake_require_all_hashes(&conn->handshake));
+    /* Buffer the handshake messages until we know which handshake hashes they are needed for */
+    GUARD(s2n_handshake_buffer_transcript(&conn->handshake));
 
-    if (conn->mode == S2N_SERVER) {
-        /* Start with the highest protocol version so that the highest common protocol version can be selected */
-        /* during handshake. */
-        conn->server_protocol_version = s2n_highest_protocol_version;
-        conn->client_protocol_version = s2n_unknown_protocol_version;
-        conn->actual_protocol_version = s2n_unknown_protocol_version;
-    }
-    else {
-        /* For clients, also set actual_protocol_version.  Record generation uses that value for the initial */
-        /* ClientHello record version. Not all servers ignore the record version in ClientHello. */
-        conn->server_protocol_version = s2n_unknown_protocol_version;
-        conn->client_protocol_version = s2n_highest_protocol_version;
-        conn->actual_protocol_version = s2n_highest_protocol_version;
-    }
+    GUARD(s2n_connection_init_protocol_versions(conn));
 
     return 0;
 }
@@ -850,6 +970,37 @@ int s2n_connection_set_fd(struct s2n_connection *conn, int fd)
     return 0;
 }
 
+int s2n_connection_enable_ktls(struct s2n_connection *conn)
+{
+    notnull_check(conn);
+
+    /* The kernel's keys are derived again with the handshake's PRF, which s2n_connection_free_handshake() frees */
+    S2N_ERROR_IF(is_handshake_complete(conn) && conn->prf_space == NULL, S2N_ERR_KTLS_HANDSHAKE_FREED);
+
+    conn->ktls_requested = 1;
+
+    /* If the handshake is already over, offload right away */
+    if (is_handshake_complete(conn)) {
+        GUARD(s2n_ktls_enable(conn));
+    }
+
+    return 0;
+}
+
+int s2n_connection_is_ktls_send_enabled(struct s2n_connection *conn)
+{
+    notnull_check(conn);
+
+    return conn->ktls_send_enabled;
+}
+
+int s2n_connection_is_ktls_recv_enabled(struct s2n_connection *conn)
+{
+    notnull_check(conn);
+
+    return conn->ktls_recv_enabled;
+}
+
 int s2n_connection_use_corked_io(struct s2n_connection *conn)
 {
     if (!conn->managed_io) {
@@ -1123,6 +1274,15 @@ int s2n_connection_set_dynamic_record_threshold(struct s2n_connection *conn, uin
     return 0;
 }
 
+int s2n_connection_set_read_ahead(struct s2n_connection *conn, uint32_t max_bytes)
+{
+    notnull_check(conn);
+    S2N_ERROR_IF(max_bytes > S2N_MAX_READ_AHEAD_LENGTH, S2N_ERR_INVALID_READ_AHEAD_SIZE);
+
+    conn->read_ahead_size = max_bytes;
+    return 0;
+}
+
 int s2n_connection_set_verify_host_callback(struct s2n_connection *conn, s2n_verify_host_fn verify_host_fn, void *data) {
     notnull_check(conn);
 
@@ -1144,11 +1304,19 @@ int s2n_connection_recv_stuffer(struct s2n_stuffer *stuffer, struct s2n_connecti
 
   RECV:
     errno = 0;
+    uint64_t io_start;
+    GUARD(s2n_perf_start(conn, &io_start));
     int r = conn->recv(conn->recv_io_context, stuffer->blob.data + stuffer->write_cursor, len);
+    const uint8_t would_block = r < 0 && (errno == EWOULDBLOCK || errno == EAGAIN);
+    GUARD(s2n_perf_io(conn, io_start, would_block));
     if (r < 0) {
         if (errno == EINTR) {
             goto RECV;
         }
+        if (would_block) {
+            /* The caller turns this into S2N_ERR_BLOCKED, so don't pay for a stack trace */
+            S2N_ERROR_BLOCKED(S2N_ERR_RECV_STUFFER_FROM_CONN);
+        }
         S2N_ERROR(S2N_ERR_RECV_STUFFER_FROM_CONN);
     }
 
@@ -1171,11 +1339,19 @@ int s2n_connection_send_stuffer(struct s2n_stuffer *stuffer, struct s2n_connecti
 
   SEND:
     errno = 0;
+    uint64_t io_start;
+    GUARD(s2n_perf_start(conn, &io_start));
     int w = conn->send(conn->send_io_context, stuffer->blob.data + stuffer->read_cursor, len);
+    const uint8_t would_block = w < 0 && (errno == EWOULDBLOCK || errno == EAGAIN);
+    GUARD(s2n_perf_io(conn, io_start, would_block));
     if (w < 0) {
         if (errno == EINTR) {
             goto SEND;
         }
+        if (would_block) {
+            /* The caller turns this into S2N_ERR_BLOCKED, so don't pay for a stack trace */
+            S2N_ERROR_BLOCKED(S2N_ERR_SEND_STUFFER_TO_CONN);
+        }
         S2N_ERROR(S2N_ERR_SEND_STUFFER_TO_CONN);
     }
 
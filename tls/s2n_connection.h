@@ -25,6 +25,8 @@
 #include "tls/s2n_client_hello.h"
 #include "tls/s2n_crypto.h"
 #include "tls/s2n_config.h"
+#include "tls/s2n_early_data.h"
+#include "tls/s2n_perf.h"
 #include "tls/s2n_prf.h"
 #include "tls/s2n_x509_validator.h"
 
@@ -40,16 +42,68 @@
 
 #define is_handshake_complete(conn) (APPLICATION_DATA == s2n_conn_get_current_message_type(conn))
 
+/* A resumption handshake in psk_ke mode has no (EC)DHE key exchange */
+#define IS_PSK_KE_ONLY(conn) ((conn)->tls13_psk.accepted && (conn)->tls13_psk.ke_mode == TLS_PSK_KE_MODE)
+
 typedef enum {
     S2N_NO_TICKET = 0,
     S2N_DECRYPT_TICKET,
     S2N_NEW_TICKET
 } s2n_session_ticket_status;
 
+/* Connection state that is dead once the handshake is complete. It is allocated in one piece so that
+ * s2n_connection_free_handshake() can release it in one piece, leaving only what the record layer needs.
+ */
+struct s2n_handshake_arena {
+    struct s2n_crypto_parameters initial;
+    struct s2n_prf_working_space prf_space;
+    struct s2n_handshake_hashes hashes;
+};
+
+/* A TLS1.3 resumption PSK and the ticket parameters that go with it.
+ * See https://tools.ietf.org/html/rfc8446#section-4.6.1
+ */
+struct s2n_tls13_psk {
+    uint8_t secret[S2N_TLS_SECRET_LEN];
+    uint8_t secret_size;
+
+    /* The suite the ticket was issued with. Only a suite with the same hash can resume it */
+    struct s2n_cipher_suite *cipher_suite;
+
+    uint32_t ticket_age_add;
+
+    /* When the client received the ticket, or when the server issued it */
+    uint64_t ticket_issue_time;
+
+    /* How much early data the ticket allows, zero if none */
+    uint32_t max_early_data_size;
+
+    /* The psk_key_exchange_modes offered by the client, one bit per mode */
+    uint8_t ke_modes;
+
+    /* Set when the client offered the PSK in its latest ClientHello */
+    uint8_t offered;
+
+    /* Set once the server accepted the PSK, along with the key exchange mode it picked
+     * and the index of the identity it was offered with
+     */
+    uint8_t accepted;
+    uint8_t ke_mode;
+    uint16_t identity;
+
+    /* Server copy of the accepted identity's age and binder, to decide on early data */
+    uint32_t obfuscated_ticket_age;
+    uint8_t binder[S2N_TLS_SECRET_LEN];
+    uint8_t binder_size;
+};
+
 struct s2n_connection {
     /* The configuration (cert, key .. etc ) */
     struct s2n_config *config;
 
+    /* Next idle connection in the per-thread pool, see s2n_connection_pool.c */
+    struct s2n_connection *pool_next;
+
     /* Overrides Cipher Preferences in config if non-null */
     const struct s2n_cipher_preferences *cipher_pref_override;
 
@@ -73,6 +127,13 @@ struct s2n_connection {
      */
     unsigned corked_io:1;
 
+    /* Should record protection be handed to the kernel once the handshake is done, and
+     * which directions did the kernel take on? Only valid when the connection is using managed_io
+     */
+    unsigned ktls_requested:1;
+    unsigned ktls_send_enabled:1;
+    unsigned ktls_recv_enabled:1;
+
     /* Session resumption indicator on client side */
     unsigned client_session_resumed:1;
 
@@ -98,6 +159,11 @@ struct s2n_connection {
      */
     unsigned server_name_used:1;
 
+    /* Are in, out, buffer_in and handshake.io borrowed from the per-thread buffer pool
+     * only while they hold data? See s2n_connection_set_dynamic_buffers()
+     */
+    unsigned dynamic_buffers:1;
+
     /* Is this connection a client or a server connection */
     s2n_mode mode;
 
@@ -132,8 +198,11 @@ struct s2n_connection {
      * negotiated yet. */
     uint8_t actual_protocol_version_established;
 
-    /* Our crypto parameters */
-    struct s2n_crypto_parameters initial;
+    /* State only needed until the handshake is complete, allocated as a unit. See s2n_connection_free_handshake() */
+    struct s2n_handshake_arena *handshake_arena;
+
+    /* Our crypto parameters. The initial ones live in the handshake arena */
+    struct s2n_crypto_parameters *initial;
     struct s2n_crypto_parameters secure;
 
     /* Which set is the client/server actually using? */
@@ -143,8 +212,8 @@ struct s2n_connection {
     /* Contains parameters needed during the handshake phase */
     struct s2n_handshake_parameters handshake_params;
 
-    /* The PRF needs some storage elements to work with */
-    struct s2n_prf_working_space prf_space;
+    /* The PRF needs some storage elements to work with. Lives in the handshake arena */
+    struct s2n_prf_working_space *prf_space;
 
     /* Whether to use client_cert_auth_type stored in s2n_config or in this s2n_connection.
      *
@@ -166,12 +235,26 @@ struct s2n_connection {
     struct s2n_stuffer out;
     enum { ENCRYPTED, PLAINTEXT } in_status;
 
+    /* Ciphertext read from the socket ahead of the record currently being
+     * processed. Only used when read-ahead is enabled, in which case each
+     * recv asks for up to read_ahead_size bytes and complete records are
+     * then copied out of this stuffer without further syscalls.
+     */
+    struct s2n_stuffer buffer_in;
+    uint32_t read_ahead_size;
+
     /* How much of the current user buffer have we already
      * encrypted and sent or have pending for the wire but have
      * not acknowledged to the user.
      */
     ssize_t current_user_data_consumed;
 
+    /* Size of the plaintext buffer handed out by s2n_send_reserve and
+     * not yet committed. Zero if there is no outstanding reservation.
+     * Anything that writes, flushes or releases conn->out resets it.
+     */
+    uint32_t send_reserved_size;
+
     /* An alert may be fragmented across multiple records,
      * this stuffer is used to re-assemble.
      */
@@ -194,6 +277,11 @@ struct s2n_connection {
     /* Our handshake state machine */
     struct s2n_handshake handshake;
 
+    /* Bumped by every wipe, so that an async private key operation started for
+     * an earlier handshake can tell it isn't wanted any more
+     */
+    uint32_t handshake_generation;
+
     /* Maximum outgoing fragment size for this connection. Does not limit
      * incoming record size.
      *
@@ -223,6 +311,7 @@ struct s2n_connection {
     /* Keep some accounting on each connection */
     uint64_t wire_bytes_in;
     uint64_t wire_bytes_out;
+    struct s2n_connection_perf perf;
 
     /* Is the connection open or closed ? We use C's only
      * atomic type as both the reader and the writer threads
@@ -279,6 +368,12 @@ struct s2n_connection {
     uint8_t ticket_ext_data[S2N_TICKET_SIZE_IN_BYTES];
     struct s2n_stuffer client_ticket_to_decrypt;
 
+    /* TLS1.3 session resumption. A client offers this PSK with the ticket in client_ticket */
+    struct s2n_tls13_psk tls13_psk;
+
+    /* TLS1.3 early data sent with the first ClientHello of a resumed session */
+    struct s2n_early_data early_data;
+
     /* application protocols overridden */
     struct s2n_blob application_protocols_overridden;
 };
@@ -286,9 +381,18 @@ struct s2n_connection {
 int s2n_connection_is_managed_corked(const struct s2n_connection *s2n_connection);
 int s2n_connection_is_client_auth_enabled(struct s2n_connection *s2n_connection);
 
+/* Set the starting protocol versions for the connection's mode */
+int s2n_connection_init_protocol_versions(struct s2n_connection *conn);
+
 /* Kill a bad connection */
 int s2n_connection_kill(struct s2n_connection *conn);
 
+/* Give stuffer a buffer of at least size bytes if it has none, from the buffer pool if the
+ * connection has dynamic buffers. Hand back the connection's empty buffers to the pool.
+ */
+int s2n_connection_lease_buffer(struct s2n_connection *conn, struct s2n_stuffer *stuffer, uint32_t size);
+int s2n_connection_return_buffers(struct s2n_connection *conn);
+
 /* Send/recv a stuffer to/from a connection */
 int s2n_connection_send_stuffer(struct s2n_stuffer *stuffer, struct s2n_connection *conn, uint32_t len);
 int s2n_connection_recv_stuffer(struct s2n_stuffer *stuffer, struct s2n_connection *conn, uint32_t len);
@@ -38,6 +38,7 @@ struct s2n_connection_hash_handles {
     struct s2n_hash_evp_digest sha512;
     struct s2n_hash_evp_digest md5_sha1;
     struct s2n_hash_evp_digest ccv_hash_copy;
+    struct s2n_hash_evp_digest server_finished_hash_copy;
     struct s2n_hash_evp_digest prf_md5_hash_copy;
     struct s2n_hash_evp_digest prf_sha1_hash_copy;
     struct s2n_hash_evp_digest prf_tls12_hash_copy;
@@ -54,10 +55,8 @@ struct s2n_connection_hash_handles {
 /* Allocationg new EVP structs is expensive, so we back them up here and reuse them */
 struct s2n_connection_hmac_handles {
     struct s2n_hmac_evp_backup initial_client;
-    struct s2n_hmac_evp_backup initial_client_copy;
     struct s2n_hmac_evp_backup initial_server;
     struct s2n_hmac_evp_backup secure_client;
-    struct s2n_hmac_evp_backup secure_client_copy;
     struct s2n_hmac_evp_backup secure_server;
 };
 
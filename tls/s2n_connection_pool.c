@@ -0,0 +1,137 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <s2n.h>
+
+#include "crypto/s2n_fips.h"
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_config.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_connection_pool.h"
+#include "tls/s2n_x509_validator.h"
+
+#include "utils/s2n_safety.h"
+#include "utils/s2n_timer.h"
+
+/* The watermarks are shared by all threads, the pools themselves are not, so
+ * taking and returning connections never needs a lock.
+ */
+static uint32_t pool_low_watermark = S2N_DEFAULT_CONNECTION_POOL_LOW_WATERMARK;
+static uint32_t pool_high_watermark = S2N_DEFAULT_CONNECTION_POOL_HIGH_WATERMARK;
+
+static __thread struct s2n_connection *pool_head = NULL;
+static __thread struct s2n_connection_pool_stats pool_stats = {0};
+
+int s2n_connection_pool_set_watermarks(uint32_t low, uint32_t high)
+{
+    S2N_ERROR_IF(low > high, S2N_ERR_INVALID_ARGUMENT);
+
+    pool_low_watermark = low;
+    pool_high_watermark = high;
+
+    return 0;
+}
+
+static int s2n_connection_pool_push(struct s2n_connection *conn)
+{
+    /* The connection may outlive its config and trust store in the pool */
+    s2n_x509_validator_wipe(&conn->x509_validator);
+    GUARD(s2n_connection_wipe(conn));
+    conn->config = NULL;
+
+    conn->pool_next = pool_head;
+    pool_head = conn;
+    pool_stats.idle++;
+
+    return 0;
+}
+
+int s2n_connection_pool_prefill(void)
+{
+    while (pool_stats.idle < pool_low_watermark) {
+        struct s2n_connection *conn = s2n_connection_new(S2N_SERVER);
+        notnull_check(conn);
+        GUARD(s2n_connection_pool_push(conn));
+    }
+
+    return 0;
+}
+
+struct s2n_connection *s2n_connection_pool_acquire(s2n_mode mode)
+{
+    struct s2n_connection *conn = pool_head;
+
+    if (conn == NULL) {
+        pool_stats.misses++;
+        return s2n_connection_new(mode);
+    }
+
+    pool_head = conn->pool_next;
+    conn->pool_next = NULL;
+    pool_stats.idle--;
+    pool_stats.hits++;
+
+    /* The connection was wiped when it was released, only the mode dependent state is left to set up */
+    conn->mode = mode;
+    GUARD_PTR(s2n_connection_init_protocol_versions(conn));
+
+    if (s2n_is_in_fips_mode()) {
+        GUARD_PTR(s2n_connection_set_config(conn, s2n_fetch_default_fips_config()));
+    } else {
+        GUARD_PTR(s2n_connection_set_config(conn, s2n_fetch_default_config()));
+    }
+
+    GUARD_PTR(s2n_timer_start(conn->config, &conn->write_timer));
+
+    return conn;
+}
+
+int s2n_connection_pool_release(struct s2n_connection *conn)
+{
+    notnull_check(conn);
+
+    if (pool_stats.idle >= pool_high_watermark) {
+        pool_stats.frees++;
+        return s2n_connection_free(conn);
+    }
+
+    pool_stats.releases++;
+    GUARD(s2n_connection_pool_push(conn));
+
+    return 0;
+}
+
+int s2n_connection_pool_get_stats(struct s2n_connection_pool_stats *stats)
+{
+    notnull_check(stats);
+
+    *stats = pool_stats;
+
+    return 0;
+}
+
+int s2n_connection_pool_cleanup_thread(void)
+{
+    while (pool_head) {
+        struct s2n_connection *conn = pool_head;
+        pool_head = conn->pool_next;
+        pool_stats.idle--;
+        GUARD(s2n_connection_free(conn));
+    }
+
+    return 0;
+}
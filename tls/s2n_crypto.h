@@ -88,6 +88,7 @@ struct s2n_crypto_parameters {
 
     uint8_t rsa_premaster_secret[S2N_TLS_SECRET_LEN];
     uint8_t master_secret[S2N_TLS_SECRET_LEN];
+    uint8_t resumption_master_secret[S2N_TLS_SECRET_LEN];
     uint8_t client_random[S2N_TLS_RANDOM_DATA_LEN];
     uint8_t server_random[S2N_TLS_RANDOM_DATA_LEN];
     uint8_t client_implicit_iv[S2N_TLS_MAX_IV_LEN];
@@ -96,7 +97,6 @@ struct s2n_crypto_parameters {
     struct s2n_hash_state signature_hash;
     struct s2n_hmac_state client_record_mac;
     struct s2n_hmac_state server_record_mac;
-    struct s2n_hmac_state record_mac_copy_workspace;
     uint8_t client_sequence_number[S2N_TLS_SEQUENCE_NUM_LEN];
     uint8_t server_sequence_number[S2N_TLS_SEQUENCE_NUM_LEN];
 };
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <sys/param.h>
+
+#include <s2n.h>
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_anti_replay.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_early_data.h"
+#include "tls/s2n_resume.h"
+#include "tls/s2n_tls.h"
+#include "tls/s2n_tls13_handshake.h"
+
+#include "stuffer/s2n_stuffer.h"
+
+#include "utils/s2n_safety.h"
+
+#define ONE_MILLISEC_IN_NANOS   1000000
+
+/* The smallest overhead of a TLS1.3 record: the content type and an AEAD tag */
+#define S2N_TLS13_MIN_RECORD_OVERHEAD   (1 + S2N_TLS_GCM_TAG_LEN)
+
+/* The ticket age the client reports has to match how long ago the server issued the ticket.
+ * A ClientHello is fresh for half the replay window either side of that, so it can only be
+ * accepted while the anti-replay filter still remembers it.
+ * See https://tools.ietf.org/html/rfc8446#section-8.3
+ */
+static int s2n_early_data_is_fresh(struct s2n_connection *conn)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+
+    uint64_t now;
+    GUARD(conn->config->wall_clock(conn->config->sys_clock_ctx, &now));
+    if (now < psk->ticket_issue_time) {
+        return 0;
+    }
+
+    uint64_t server_age_in_millis = (now - psk->ticket_issue_time) / ONE_MILLISEC_IN_NANOS;
+    uint64_t client_age_in_millis = (uint32_t) (psk->obfuscated_ticket_age - psk->ticket_age_add);
+    uint64_t tolerance_in_millis = conn->config->early_data_replay_window_in_nanos / 2 / ONE_MILLISEC_IN_NANOS;
+
+    uint64_t skew_in_millis = server_age_in_millis > client_age_in_millis ? server_age_in_millis - client_age_in_millis
+                                                                          : client_age_in_millis - server_age_in_millis;
+
+    return skew_in_millis <= tolerance_in_millis;
+}
+
+/* The PSK binder stands in for the ClientHello: it is a MAC over the whole ClientHello.
+ * Servers that share tickets can share the ClientHellos they have seen through the
+ * replay callback, otherwise the config's anti-replay filter is used.
+ * Returns 1 if the ClientHello may have been seen before.
+ */
+static int s2n_early_data_is_replay(struct s2n_connection *conn)
+{
+    struct s2n_config *config = conn->config;
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+
+    if (config->early_data_replay_cb) {
+        uint64_t ttl_in_secs = (config->early_data_replay_window_in_nanos + ONE_SEC_IN_NANOS - 1) / ONE_SEC_IN_NANOS;
+
+        /* The callback records the ClientHello and reports whether it was already there in one step, so two
+         * servers can't both accept it. Anything but a first sighting, including an error, counts as a replay.
+         */
+        return config->early_data_replay_cb(conn, config->early_data_replay_data, ttl_in_secs, psk->binder, psk->binder_size) != 0;
+    }
+
+    notnull_check(config->anti_replay);
+
+    uint64_t now;
+    GUARD(config->monotonic_clock(config->monotonic_clock_ctx, &now));
+
+    return s2n_anti_replay_check_and_record(config->anti_replay, now, psk->binder, psk->binder_size);
+}
+
+static int s2n_early_data_server_can_accept(struct s2n_connection *conn)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+
+    if (conn->config->max_early_data_size == 0 || IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type)) {
+        return 0;
+    }
+
+    /* Early data is protected with the first PSK, and the suite it was issued with */
+    if (!psk->accepted || psk->identity != 0 || psk->max_early_data_size == 0
+            || memcmp(psk->cipher_suite->iana_value, conn->secure.cipher_suite->iana_value, S2N_TLS_CIPHER_SUITE_LEN)) {
+        return 0;
+    }
+
+    int fresh;
+    GUARD(fresh = s2n_early_data_is_fresh(conn));
+    if (!fresh) {
+        return 0;
+    }
+
+    int replay;
+    GUARD(replay = s2n_early_data_is_replay(conn));
+
+    return !replay;
+}
+
+/*
+ * Server decides on the client's early data once the PSK and the key share are settled,
+ * since a HelloRetryRequest rules it out. Early data that isn't accepted is skipped.
+ */
+int s2n_early_data_server_select(struct s2n_connection *conn)
+{
+    struct s2n_early_data *early_data = &conn->early_data;
+
+    if (early_data->status != S2N_EARLY_DATA_REQUESTED) {
+        return 0;
+    }
+
+    early_data->status = S2N_EARLY_DATA_REJECTED;
+    early_data->skipping = 1;
+
+    int accept;
+    GUARD(accept = s2n_early_data_server_can_accept(conn));
+    if (!accept) {
+        return 0;
+    }
+
+    early_data->status = S2N_EARLY_DATA_ACCEPTED;
+    early_data->skipping = 0;
+    conn->handshake.handshake_type |= WITH_EARLY_DATA;
+
+    return 0;
+}
+
+/* Client stops using the early traffic key after a HelloRetryRequest or a TLS1.2 ServerHello */
+int s2n_early_data_client_reject(struct s2n_connection *conn)
+{
+    if (conn->early_data.status != S2N_EARLY_DATA_REQUESTED) {
+        return 0;
+    }
+
+    conn->early_data.status = S2N_EARLY_DATA_REJECTED;
+    conn->client = conn->initial;
+
+    return 0;
+}
+
+/* Whether the client's records are still protected with the early traffic key */
+int s2n_early_data_in_flight(struct s2n_connection *conn)
+{
+    return conn->early_data.status == S2N_EARLY_DATA_REQUESTED || conn->early_data.status == S2N_EARLY_DATA_ACCEPTED;
+}
+
+/* Moves the client's records on to the handshake traffic key, after the EndOfEarlyData,
+ * or once a client learns that the server didn't accept its early data.
+ */
+int s2n_early_data_end(struct s2n_connection *conn, s2n_early_data_status status)
+{
+    GUARD(s2n_tls13_handle_client_handshake_secret(conn));
+
+    struct s2n_blob client_seq = {.data = conn->secure.client_sequence_number,.size = sizeof(conn->secure.client_sequence_number) };
+    GUARD(s2n_blob_zero(&client_seq));
+    conn->client = &conn->secure;
+
+    conn->early_data.status = status;
+
+    return 0;
+}
+
+/* Server keeps the early data that comes in before the EndOfEarlyData for the application */
+int s2n_early_data_recv_record(struct s2n_connection *conn)
+{
+    struct s2n_early_data *early_data = &conn->early_data;
+
+    /* Early data comes in while the server waits on the client's second flight */
+    message_type_t message_type = s2n_conn_get_current_message_type(conn);
+    S2N_ERROR_IF(conn->mode != S2N_SERVER || early_data->status != S2N_EARLY_DATA_ACCEPTED
+            || (message_type != CLIENT_CHANGE_CIPHER_SPEC && message_type != END_OF_EARLY_DATA), S2N_ERR_BAD_MESSAGE);
+
+    uint32_t size = s2n_stuffer_data_available(&conn->in);
+    S2N_ERROR_IF(size > conn->tls13_psk.max_early_data_size - early_data->bytes, S2N_ERR_MAX_EARLY_DATA_SIZE);
+
+    if (!early_data->in.alloced) {
+        GUARD(s2n_stuffer_growable_alloc(&early_data->in, 0));
+    }
+    GUARD(s2n_stuffer_copy(&conn->in, &early_data->in, size));
+    early_data->bytes += size;
+
+    return 0;
+}
+
+int s2n_early_data_is_skipping(struct s2n_connection *conn, uint8_t record_type)
+{
+    return conn->mode == S2N_SERVER && conn->early_data.skipping && record_type == TLS_APPLICATION_DATA;
+}
+
+/* A server only skips as much early data as it could have accepted */
+int s2n_early_data_skip_record(struct s2n_connection *conn, uint16_t fragment_length)
+{
+    struct s2n_early_data *early_data = &conn->early_data;
+
+    uint32_t limit = MAX(conn->config->max_early_data_size, conn->tls13_psk.max_early_data_size);
+    limit = MAX(limit, S2N_TLS_MAXIMUM_FRAGMENT_LENGTH);
+
+    if (fragment_length > S2N_TLS13_MIN_RECORD_OVERHEAD) {
+        early_data->bytes += fragment_length - S2N_TLS13_MIN_RECORD_OVERHEAD;
+    }
+    S2N_ERROR_IF(early_data->bytes > limit, S2N_ERR_MAX_EARLY_DATA_SIZE);
+
+    return 0;
+}
+
+/* How far s2n_negotiate_early_data() takes the handshake: a client until its ClientHello
+ * is out, and a server until it has early data for the application or knows there is none.
+ */
+int s2n_early_data_wants_handshake(struct s2n_connection *conn)
+{
+    if (conn->mode == S2N_CLIENT) {
+        return s2n_conn_get_current_message_type(conn) == CLIENT_HELLO;
+    }
+
+    if (s2n_stuffer_data_available(&conn->early_data.in)) {
+        return 0;
+    }
+
+    return conn->handshake.handshake_type == INITIAL || conn->early_data.status == S2N_EARLY_DATA_ACCEPTED;
+}
+
+ssize_t s2n_early_data_read(struct s2n_connection *conn, void *buf, ssize_t size)
+{
+    struct s2n_stuffer *in = &conn->early_data.in;
+
+    uint32_t n = MIN(size, s2n_stuffer_data_available(in));
+    GUARD(s2n_stuffer_read_bytes(in, buf, n));
+
+    if (s2n_stuffer_data_available(in) == 0) {
+        GUARD(s2n_stuffer_wipe(in));
+    }
+
+    return n;
+}
+
+ssize_t s2n_send_early_data(struct s2n_connection *conn, const void *buf, ssize_t size, s2n_blocked_status *blocked)
+{
+    notnull_check(conn);
+    notnull_check(blocked);
+    S2N_ERROR_IF(conn->mode != S2N_CLIENT, S2N_ERR_SERVER_MODE);
+
+    struct s2n_early_data *early_data = &conn->early_data;
+
+    /* Only the first ClientHello can ask for early data, with a TLS1.3 ticket that allows it.
+     * Whether it is asked for in the end depends on the ticket being offered.
+     */
+    if (early_data->status == S2N_EARLY_DATA_NOT_REQUESTED && conn->handshake.handshake_type == INITIAL
+            && s2n_conn_get_current_message_type(conn) == CLIENT_HELLO
+            && conn->client_protocol_version >= S2N_TLS13 && conn->tls13_psk.max_early_data_size > 0) {
+        early_data->status = S2N_EARLY_DATA_REQUESTED;
+    }
+
+    GUARD(s2n_negotiate_early_data(conn, blocked));
+
+    /* Early data goes out behind the ClientHello, until the client reads the ServerHello */
+    if (early_data->status != S2N_EARLY_DATA_REQUESTED || s2n_conn_get_current_message_type(conn) != SERVER_HELLO) {
+        *blocked = S2N_NOT_BLOCKED;
+        return 0;
+    }
+
+    ssize_t to_send = MIN(size, conn->tls13_psk.max_early_data_size - early_data->bytes);
+    if (to_send == 0) {
+        *blocked = S2N_NOT_BLOCKED;
+        return 0;
+    }
+
+    ssize_t sent;
+    GUARD(sent = s2n_send(conn, buf, to_send, blocked));
+    early_data->bytes += sent;
+
+    return sent;
+}
+
+ssize_t s2n_recv_early_data(struct s2n_connection *conn, void *buf, ssize_t size, s2n_blocked_status *blocked)
+{
+    notnull_check(conn);
+    notnull_check(blocked);
+    S2N_ERROR_IF(conn->mode != S2N_SERVER, S2N_ERR_CLIENT_MODE);
+
+    while (s2n_stuffer_data_available(&conn->early_data.in) == 0) {
+        /* No more early data is coming */
+        if (conn->handshake.handshake_type != INITIAL && conn->early_data.status != S2N_EARLY_DATA_ACCEPTED) {
+            *blocked = S2N_NOT_BLOCKED;
+            return 0;
+        }
+
+        GUARD(s2n_negotiate_early_data(conn, blocked));
+    }
+
+    *blocked = S2N_NOT_BLOCKED;
+    return s2n_early_data_read(conn, buf, size);
+}
+
+int s2n_connection_is_early_data_accepted(struct s2n_connection *conn)
+{
+    notnull_check(conn);
+
+    return conn->early_data.status == S2N_EARLY_DATA_ACCEPTED || conn->early_data.status == S2N_EARLY_DATA_ENDED;
+}
+
+/* The EndOfEarlyData message is empty, see https://tools.ietf.org/html/rfc8446#section-4.5 */
+int s2n_end_of_early_data_send(struct s2n_connection *conn)
+{
+    return 0;
+}
+
+int s2n_end_of_early_data_recv(struct s2n_connection *conn)
+{
+    S2N_ERROR_IF(s2n_stuffer_data_available(&conn->handshake.io), S2N_ERR_BAD_MESSAGE);
+
+    return 0;
+}
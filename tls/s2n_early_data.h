@@ -0,0 +1,68 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <s2n.h>
+
+#include "stuffer/s2n_stuffer.h"
+
+#include "tls/s2n_crypto.h"
+
+/* TLS1.3 0-RTT data, see https://tools.ietf.org/html/rfc8446#section-4.2.10
+ *
+ * A client asks for early data in its first ClientHello, when it resumes with a ticket
+ * that allows it, and sends it right behind that ClientHello. The server only accepts it
+ * for a fresh ClientHello it hasn't seen before, and otherwise skips over it.
+ */
+typedef enum {
+    S2N_EARLY_DATA_NOT_REQUESTED = 0,
+    S2N_EARLY_DATA_REQUESTED,
+    S2N_EARLY_DATA_ACCEPTED,
+    S2N_EARLY_DATA_REJECTED,
+    S2N_EARLY_DATA_ENDED,
+} s2n_early_data_status;
+
+struct s2n_connection;
+
+struct s2n_early_data {
+    s2n_early_data_status status;
+
+    /* Plaintext bytes sent by a client, or received or skipped by a server */
+    uint32_t bytes;
+
+    /* Set while a server drops the early data records it rejected */
+    uint8_t skipping;
+
+    /* Early data the server received but the application hasn't read yet */
+    struct s2n_stuffer in;
+
+    /* The client handshake traffic secret, put aside until the EndOfEarlyData */
+    uint8_t client_handshake_secret[S2N_TLS_SECRET_LEN];
+};
+
+extern int s2n_early_data_server_select(struct s2n_connection *conn);
+extern int s2n_early_data_client_reject(struct s2n_connection *conn);
+extern int s2n_early_data_in_flight(struct s2n_connection *conn);
+extern int s2n_early_data_end(struct s2n_connection *conn, s2n_early_data_status status);
+
+extern int s2n_early_data_recv_record(struct s2n_connection *conn);
+extern int s2n_early_data_is_skipping(struct s2n_connection *conn, uint8_t record_type);
+extern int s2n_early_data_skip_record(struct s2n_connection *conn, uint16_t fragment_length);
+
+extern int s2n_early_data_wants_handshake(struct s2n_connection *conn);
+extern int s2n_negotiate_early_data(struct s2n_connection *conn, s2n_blocked_status *blocked);
+extern ssize_t s2n_early_data_read(struct s2n_connection *conn, void *buf, ssize_t size);
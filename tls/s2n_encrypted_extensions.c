@@ -24,6 +24,7 @@
 #include "tls/extensions/s2n_server_sct_list.h"
 #include "tls/extensions/s2n_server_max_fragment_length.h"
 #include "tls/extensions/s2n_server_server_name.h"
+#include "tls/extensions/s2n_server_early_data.h"
 
 /**
   * Specified in https://tools.ietf.org/html/rfc8446#section-4.3.1
@@ -47,6 +48,7 @@ int s2n_encrypted_extensions_send(struct s2n_connection *conn)
      * as we are sending an empty EE message
      */
     uint16_t total_size = 0;
+    total_size += s2n_extensions_server_early_data_size(conn);
 
     /* Write length of extensions */
     GUARD(s2n_stuffer_write_uint16(out, total_size));
@@ -55,10 +57,9 @@ int s2n_encrypted_extensions_send(struct s2n_connection *conn)
         return 0;
     }
 
-    /* Write the extensions to the out buffer. For minimal TLS 1.3, this is
-     * a noop, as we are sending an empty EE message
-     */
-    
+    /* Write the extensions to the out buffer */
+    GUARD(s2n_extensions_server_early_data_send(conn, out));
+
     return 0;
 }
 
@@ -82,6 +83,11 @@ int s2n_encrypted_extensions_recv(struct s2n_connection *conn)
         GUARD(s2n_server_encrypted_extensions_parse(conn, &extensions));
     }
 
+    /* The server didn't accept the early data: stop sending it and switch to the handshake key */
+    if (conn->early_data.status == S2N_EARLY_DATA_REQUESTED) {
+        GUARD(s2n_early_data_end(conn, S2N_EARLY_DATA_REJECTED));
+    }
+
     return 0;
 }
 
@@ -124,6 +130,9 @@ int s2n_server_encrypted_extensions_parse(struct s2n_connection *conn, struct s2
         case TLS_EXTENSION_MAX_FRAG_LEN:
             GUARD(s2n_recv_server_max_fragment_length(conn, &extension));
             break;
+        case TLS_EXTENSION_EARLY_DATA:
+            GUARD(s2n_extensions_server_early_data_recv(conn, &extension));
+            break;
         /* Error on known extensions that are not supposed to appear in EE
          * https://tools.ietf.org/html/rfc8446#page-37
          */
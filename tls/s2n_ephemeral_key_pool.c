@@ -0,0 +1,213 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_dhe.h"
+#include "crypto/s2n_ecc.h"
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_config.h"
+#include "tls/s2n_ephemeral_key_pool.h"
+
+#include "utils/s2n_safety.h"
+
+/* Generating an ephemeral key is one of the most expensive steps of a full
+ * handshake. Each thread can keep a stock of keys per curve, and per DH group,
+ * generated ahead of time by s2n_ephemeral_key_pool_prefill() and taken by the
+ * handshake instead. A pooled key is still used for one handshake only. Like
+ * the connection pool, the stock belongs to its thread, so no locking is
+ * involved, and only the depth is shared.
+ */
+static uint32_t pool_depth = 0;
+
+static __thread EC_KEY *ecc_keys[S2N_ECC_SUPPORTED_CURVES_COUNT][S2N_EPHEMERAL_KEY_POOL_MAX_DEPTH];
+static __thread uint32_t ecc_key_count[S2N_ECC_SUPPORTED_CURVES_COUNT];
+/* Keys for every DH group the thread has prefilled for, told apart by their parameters */
+static __thread struct s2n_dh_params dh_keys[S2N_EPHEMERAL_KEY_POOL_MAX_DEPTH];
+static __thread uint32_t dh_key_count;
+/* The process the keys were generated in, so that a forked child doesn't use keys its parent has too */
+static __thread pid_t pool_pid;
+static __thread struct s2n_ephemeral_key_pool_stats pool_stats = {0};
+
+int s2n_ephemeral_key_pool_cleanup_thread(void)
+{
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        while (ecc_key_count[i] > 0) {
+            EC_KEY_free(ecc_keys[i][--ecc_key_count[i]]);
+            ecc_keys[i][ecc_key_count[i]] = NULL;
+        }
+    }
+
+    while (dh_key_count > 0) {
+        GUARD(s2n_dh_params_free(&dh_keys[--dh_key_count]));
+    }
+
+    pool_stats.idle = 0;
+
+    return 0;
+}
+
+/* Keys generated before a fork are thrown away rather than used on both sides of it */
+static int s2n_ephemeral_key_pool_check_fork(void)
+{
+    pid_t pid = getpid();
+
+    if (pool_pid != pid) {
+        GUARD(s2n_ephemeral_key_pool_cleanup_thread());
+        pool_pid = pid;
+    }
+
+    return 0;
+}
+
+static int s2n_ephemeral_key_pool_curve_index(const struct s2n_ecc_named_curve *curve)
+{
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        if (s2n_ecc_supported_curves[i] == curve) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int s2n_ephemeral_key_pool_set_depth(uint32_t depth)
+{
+    S2N_ERROR_IF(depth > S2N_EPHEMERAL_KEY_POOL_MAX_DEPTH, S2N_ERR_INVALID_ARGUMENT);
+
+    pool_depth = depth;
+
+    return 0;
+}
+
+static int s2n_ephemeral_key_pool_prefill_dh(struct s2n_dh_params *group)
+{
+    uint32_t have = 0;
+
+    for (uint32_t i = 0; i < dh_key_count; i++) {
+        uint8_t match = 0;
+        GUARD(s2n_dh_params_match_group(group, &dh_keys[i], &match));
+        have += match;
+    }
+
+    /* The DH stock is shared by every group, so one group can't take more than its depth */
+    while (have < pool_depth && dh_key_count < S2N_EPHEMERAL_KEY_POOL_MAX_DEPTH) {
+        struct s2n_dh_params *dh_params = &dh_keys[dh_key_count];
+
+        GUARD(s2n_dh_params_copy(group, dh_params));
+        if (s2n_dh_generate_ephemeral_key(dh_params) < 0) {
+            GUARD(s2n_dh_params_free(dh_params));
+            S2N_ERROR_PRESERVE_ERRNO();
+        }
+
+        dh_key_count++;
+        pool_stats.idle++;
+        have++;
+    }
+
+    return 0;
+}
+
+int s2n_ephemeral_key_pool_prefill(struct s2n_config *config)
+{
+    GUARD(s2n_ephemeral_key_pool_check_fork());
+
+    for (int i = 0; i < S2N_ECC_SUPPORTED_CURVES_COUNT; i++) {
+        while (ecc_key_count[i] < pool_depth) {
+            struct s2n_ecc_params ecc_params = { .negotiated_curve = s2n_ecc_supported_curves[i] };
+
+            GUARD(s2n_ecc_generate_ephemeral_key(&ecc_params));
+            ecc_keys[i][ecc_key_count[i]++] = ecc_params.ec_key;
+            pool_stats.idle++;
+        }
+    }
+
+    if (config && config->dhparams) {
+        GUARD(s2n_ephemeral_key_pool_prefill_dh(config->dhparams));
+    }
+
+    return 0;
+}
+
+int s2n_ephemeral_key_pool_take_ecc(struct s2n_ecc_params *ecc_params)
+{
+    notnull_check(ecc_params);
+
+    int index = s2n_ephemeral_key_pool_curve_index(ecc_params->negotiated_curve);
+
+    if (pool_depth == 0 || index < 0) {
+        return s2n_ecc_generate_ephemeral_key(ecc_params);
+    }
+
+    GUARD(s2n_ephemeral_key_pool_check_fork());
+
+    if (ecc_key_count[index] == 0) {
+        pool_stats.misses++;
+        return s2n_ecc_generate_ephemeral_key(ecc_params);
+    }
+
+    ecc_key_count[index]--;
+    ecc_params->ec_key = ecc_keys[index][ecc_key_count[index]];
+    ecc_keys[index][ecc_key_count[index]] = NULL;
+    pool_stats.idle--;
+    pool_stats.hits++;
+
+    return 0;
+}
+
+int s2n_ephemeral_key_pool_take_dh(struct s2n_dh_params *group, struct s2n_dh_params *dh_params)
+{
+    notnull_check(group);
+    notnull_check(dh_params);
+
+    if (pool_depth > 0) {
+        GUARD(s2n_ephemeral_key_pool_check_fork());
+
+        for (uint32_t i = 0; i < dh_key_count; i++) {
+            uint8_t match = 0;
+            GUARD(s2n_dh_params_match_group(group, &dh_keys[i], &match));
+            if (match) {
+                /* Ownership moves to the caller, and the last key fills the gap */
+                *dh_params = dh_keys[i];
+                dh_keys[i] = dh_keys[--dh_key_count];
+                dh_keys[dh_key_count].dh = NULL;
+                pool_stats.idle--;
+                pool_stats.hits++;
+                return 0;
+            }
+        }
+
+        pool_stats.misses++;
+    }
+
+    GUARD(s2n_dh_params_copy(group, dh_params));
+    GUARD(s2n_dh_generate_ephemeral_key(dh_params));
+
+    return 0;
+}
+
+int s2n_ephemeral_key_pool_get_stats(struct s2n_ephemeral_key_pool_stats *stats)
+{
+    notnull_check(stats);
+
+    *stats = pool_stats;
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <s2n.h>
+
+#include "crypto/s2n_dhe.h"
+#include "crypto/s2n_ecc.h"
+
+#define S2N_EPHEMERAL_KEY_POOL_MAX_DEPTH 64
+
+/* Frees every key pooled by the calling thread */
+extern int s2n_ephemeral_key_pool_cleanup_thread(void);
+
+/* Hand out a pooled key for the curve or group if there is one, and generate one otherwise */
+extern int s2n_ephemeral_key_pool_take_ecc(struct s2n_ecc_params *ecc_params);
+extern int s2n_ephemeral_key_pool_take_dh(struct s2n_dh_params *group, struct s2n_dh_params *dh_params);
@@ -17,6 +17,8 @@
 
 #include "error/s2n_errno.h"
 
+#include "crypto/s2n_fips.h"
+
 #include "tls/s2n_connection.h"
 #include "tls/s2n_record.h"
 #include "tls/s2n_cipher_suites.h"
@@ -68,29 +70,31 @@ int s2n_handshake_parse_header(struct s2n_connection *conn, uint8_t * message_ty
     return 0;
 }
 
-int s2n_handshake_get_hash_state(struct s2n_connection *conn, s2n_hash_algorithm hash_alg, struct s2n_hash_state *hash_state)
+static int s2n_handshake_hash_state(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg, struct s2n_hash_state **hash_state)
 {
+    notnull_check(handshake->hashes);
+
     switch (hash_alg) {
     case S2N_HASH_MD5:
-        *hash_state = conn->handshake.md5;
+        *hash_state = &handshake->hashes->md5;
         break;
     case S2N_HASH_SHA1:
-        *hash_state = conn->handshake.sha1;
+        *hash_state = &handshake->hashes->sha1;
         break;
     case S2N_HASH_SHA224:
-        *hash_state = conn->handshake.sha224;
+        *hash_state = &handshake->hashes->sha224;
         break;
     case S2N_HASH_SHA256:
-        *hash_state = conn->handshake.sha256;
+        *hash_state = &handshake->hashes->sha256;
         break;
     case S2N_HASH_SHA384:
-        *hash_state = conn->handshake.sha384;
+        *hash_state = &handshake->hashes->sha384;
         break;
     case S2N_HASH_SHA512:
-        *hash_state = conn->handshake.sha512;
+        *hash_state = &handshake->hashes->sha512;
         break;
     case S2N_HASH_MD5_SHA1:
-        *hash_state = conn->handshake.md5_sha1;
+        *hash_state = &handshake->hashes->md5_sha1;
         break;
     default:
         S2N_ERROR(S2N_ERR_HASH_INVALID_ALGORITHM);
@@ -98,51 +102,147 @@ int s2n_handshake_get_hash_state(struct s2n_connection *conn, s2n_hash_algorithm
     return 0;
 }
 
-int s2n_handshake_require_all_hashes(struct s2n_handshake *handshake)
+int s2n_handshake_get_hash_state(struct s2n_connection *conn, s2n_hash_algorithm hash_alg, struct s2n_hash_state *hash_state)
 {
-    memset(handshake->required_hash_algs, 1, sizeof(handshake->required_hash_algs));
+    struct s2n_hash_state *handshake_hash_state;
+    GUARD(s2n_handshake_hash_state(&conn->handshake, hash_alg, &handshake_hash_state));
+
+    /* Hashes nobody asked for yet can still be started from the buffered transcript */
+    GUARD(s2n_handshake_require_hash(&conn->handshake, hash_alg));
+
+    *hash_state = *handshake_hash_state;
     return 0;
 }
 
-static int s2n_handshake_require_hash(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg)
+/* Start keeping a handshake hash, catching it up on the messages buffered so far */
+int s2n_handshake_require_hash(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg)
 {
+    struct s2n_hash_state *hash_state;
+    GUARD(s2n_handshake_hash_state(handshake, hash_alg, &hash_state));
+
+    if (handshake->required_hash_algs[hash_alg]) {
+        return 0;
+    }
+
+    /* Once the transcript is gone, a hash can't be started anymore */
+    S2N_ERROR_IF(!handshake->transcript_buffered, S2N_ERR_HASH_NOT_READY);
+
+    if (!s2n_hash_is_allocated(hash_state)) {
+        GUARD(s2n_hash_new(hash_state));
+    }
+
+    /* MD5 is allowed in FIPS mode for the TLS 1.0 and 1.1 PRF and CertificateVerify signatures, as approved by
+     * NIST Special Publication 800-52 Revision 1. This has to happen before the hash is initialized.
+     */
+    if (s2n_is_in_fips_mode() && (hash_alg == S2N_HASH_MD5 || hash_alg == S2N_HASH_MD5_SHA1)) {
+        GUARD(s2n_hash_allow_md5_for_fips(hash_state));
+    }
+
+    GUARD(s2n_hash_init(hash_state, hash_alg));
+    GUARD(s2n_hash_update(hash_state, handshake->transcript.blob.data, s2n_stuffer_data_available(&handshake->transcript)));
+
     handshake->required_hash_algs[hash_alg] = 1;
     return 0;
 }
 
+int s2n_handshake_require_all_hashes(struct s2n_handshake *handshake)
+{
+    for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+        GUARD(s2n_handshake_require_hash(handshake, hash_alg));
+    }
+
+    GUARD(s2n_handshake_release_transcript(handshake));
+    return 0;
+}
+
+/* Replace everything hashed so far with a synthetic message_hash message carrying its digest.
+ * A TLS1.3 HelloRetryRequest does this to the first ClientHello, see https://tools.ietf.org/html/rfc8446#section-4.4.1
+ */
+int s2n_handshake_hash_as_message_hash(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg)
+{
+    struct s2n_hash_state *hash_state;
+    GUARD(s2n_handshake_hash_state(handshake, hash_alg, &hash_state));
+    S2N_ERROR_IF(!handshake->required_hash_algs[hash_alg], S2N_ERR_HASH_NOT_READY);
+
+    uint8_t digest_size;
+    GUARD(s2n_hash_digest_size(hash_alg, &digest_size));
+
+    uint8_t message_hash[TLS_HANDSHAKE_HEADER_LENGTH + S2N_MAX_DIGEST_LEN] = { TLS_MESSAGE_HASH, 0, 0, digest_size };
+    GUARD(s2n_hash_digest(hash_state, message_hash + TLS_HANDSHAKE_HEADER_LENGTH, digest_size));
+
+    GUARD(s2n_hash_reset(hash_state));
+    GUARD(s2n_hash_update(hash_state, message_hash, TLS_HANDSHAKE_HEADER_LENGTH + digest_size));
+
+    return 0;
+}
+
 uint8_t s2n_handshake_is_hash_required(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg)
 {
     return handshake->required_hash_algs[hash_alg];
 }
 
-/* Update the required handshake hash algs depending on current handshake session state.
+/* Hold on to handshake messages from now on, rather than hashing them into hashes that may never be used */
+int s2n_handshake_buffer_transcript(struct s2n_handshake *handshake)
+{
+    GUARD(s2n_stuffer_wipe(&handshake->transcript));
+    handshake->transcript_buffered = 1;
+
+    return 0;
+}
+
+int s2n_handshake_release_transcript(struct s2n_handshake *handshake)
+{
+    handshake->transcript_buffered = 0;
+
+    GUARD(s2n_stuffer_wipe(&handshake->transcript));
+    GUARD(s2n_stuffer_resize(&handshake->transcript, 0));
+
+    return 0;
+}
+
+int s2n_handshake_reset_hashes(struct s2n_handshake *handshake)
+{
+    for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+        struct s2n_hash_state *hash_state;
+        GUARD(s2n_handshake_hash_state(handshake, hash_alg, &hash_state));
+
+        if (s2n_hash_is_allocated(hash_state)) {
+            GUARD(s2n_hash_reset(hash_state));
+        }
+    }
+
+    return 0;
+}
+
+int s2n_handshake_free_hashes(struct s2n_handshake *handshake)
+{
+    for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+        struct s2n_hash_state *hash_state;
+        GUARD(s2n_handshake_hash_state(handshake, hash_alg, &hash_state));
+
+        if (s2n_hash_is_allocated(hash_state)) {
+            GUARD(s2n_hash_free(hash_state));
+        }
+    }
+
+    return 0;
+}
+
+/* Choose the required handshake hash algs depending on current handshake session state, and start them.
  * This function must called at the end of a handshake message handler. Additionally it must be called after the
  * ClientHello or ServerHello is processed in client and server mode respectively. The relevant handshake parameters
  * are not available until those messages are processed.
  */
 int s2n_conn_update_required_handshake_hashes(struct s2n_connection *conn)
 {
-    /* Clear all of the required hashes */
-    memset(conn->handshake.required_hash_algs, 0, sizeof(conn->handshake.required_hash_algs));
+    uint8_t required_hash_algs[S2N_HASH_SENTINEL] = { 0 };
 
-    message_type_t handshake_message = s2n_conn_get_current_message_type(conn);
-    const uint8_t client_cert_verify_done = (handshake_message >= CLIENT_CERT_VERIFY) ? 1 : 0;
-    s2n_cert_auth_type client_cert_auth_type;
-    GUARD(s2n_connection_get_client_auth_type(conn, &client_cert_auth_type));
-
-    /* If client authentication is possible, all hashes are needed until we're past CLIENT_CERT_VERIFY. */
-    if ((client_cert_auth_type != S2N_CERT_AUTH_NONE) && !client_cert_verify_done) {
-        GUARD(s2n_handshake_require_all_hashes(&conn->handshake));
-        return 0;
-    }
-
-    /* We don't need all of the hashes. Set the hash alg(s) required for the PRF */
     switch (conn->actual_protocol_version) {
     case S2N_SSLv3:
     case S2N_TLS10:
     case S2N_TLS11:
-        GUARD(s2n_handshake_require_hash(&conn->handshake, S2N_HASH_MD5));
-        GUARD(s2n_handshake_require_hash(&conn->handshake, S2N_HASH_SHA1));
+        required_hash_algs[S2N_HASH_MD5] = 1;
+        required_hash_algs[S2N_HASH_SHA1] = 1;
         break;
     case S2N_TLS12:
     {
@@ -150,11 +250,50 @@ int s2n_conn_update_required_handshake_hashes(struct s2n_connection *conn)
         s2n_hmac_algorithm tls12_prf_alg = conn->secure.cipher_suite->tls12_prf_alg;
         s2n_hash_algorithm hash_alg;
         GUARD(s2n_hmac_hash_alg(tls12_prf_alg, &hash_alg));
-        GUARD(s2n_handshake_require_hash(&conn->handshake, hash_alg));
+        required_hash_algs[hash_alg] = 1;
+        break;
+    }
+    default:
+    {
+        /* In TLS 1.3 the key schedule, CertificateVerify, Finished and a HelloRetryRequest's message_hash
+         * all use the Transcript-Hash, which is the cipher suite's hash
+         */
+        s2n_hash_algorithm hash_alg;
+        GUARD(s2n_hmac_hash_alg(conn->secure.cipher_suite->tls12_prf_alg, &hash_alg));
+        required_hash_algs[hash_alg] = 1;
         break;
     }
     }
 
+    /* Start the hashes we now know we need before forgetting about the others */
+    for (s2n_hash_algorithm hash_alg = S2N_HASH_MD5; hash_alg < S2N_HASH_SENTINEL; hash_alg++) {
+        if (required_hash_algs[hash_alg]) {
+            GUARD(s2n_handshake_require_hash(&conn->handshake, hash_alg));
+        }
+    }
+    memcpy_check(conn->handshake.required_hash_algs, required_hash_algs, sizeof(required_hash_algs));
+
+    /* No other hash is ever needed in TLS 1.3, where a client's CertificateVerify uses the same one */
+    if (conn->actual_protocol_version >= S2N_TLS13) {
+        GUARD(s2n_handshake_release_transcript(&conn->handshake));
+        return 0;
+    }
+
+    message_type_t handshake_message = s2n_conn_get_current_message_type(conn);
+    const uint8_t client_cert_verify_done = (handshake_message >= CLIENT_CERT_VERIFY) ? 1 : 0;
+    const uint8_t no_client_cert = (conn->handshake.handshake_type & NO_CLIENT_CERT) ? 1 : 0;
+    s2n_cert_auth_type client_cert_auth_type;
+    GUARD(s2n_connection_get_client_auth_type(conn, &client_cert_auth_type));
+
+    /* If client authentication is possible, the CertificateVerify hash isn't known until we get there. The transcript
+     * is kept until then, and that hash started from it.
+     */
+    if ((client_cert_auth_type != S2N_CERT_AUTH_NONE) && !client_cert_verify_done && !no_client_cert) {
+        return 0;
+    }
+
+    GUARD(s2n_handshake_release_transcript(&conn->handshake));
+
     return 0;
 }
 
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <s2n.h>
 
+#include "tls/s2n_async_pkey.h"
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_crypto.h"
 #include "tls/s2n_signature_algorithms.h"
@@ -49,6 +50,8 @@ typedef enum {
     /* TLS1.3 message types. Defined: https://tools.ietf.org/html/rfc8446#appendix-B.3 */
     ENCRYPTED_EXTENSIONS,
     SERVER_CERT_VERIFY,
+    HELLO_RETRY_MSG,
+    END_OF_EARLY_DATA,
 
     APPLICATION_DATA,
 } message_type_t;
@@ -91,9 +94,10 @@ struct s2n_handshake_parameters {
     uint8_t wc_sni_match_exists;
 };
 
-struct s2n_handshake {
-    struct s2n_stuffer io;
-
+/* The running hashes of the handshake messages. They are dead once the handshake is complete, so they live in the
+ * connection's handshake arena rather than in struct s2n_handshake, see s2n_connection_free_handshake().
+ */
+struct s2n_handshake_hashes {
     struct s2n_hash_state md5;
     struct s2n_hash_state sha1;
     struct s2n_hash_state sha224;
@@ -105,17 +109,35 @@ struct s2n_handshake {
     /* A copy of the handshake messages hash used to validate the CertificateVerify message */
     struct s2n_hash_state ccv_hash_copy;
 
+    /* The TLS1.3 transcript up to the ServerFinished, which the application secrets are derived from.
+     * Only kept when an EndOfEarlyData comes between the ServerFinished and the ClientFinished.
+     */
+    struct s2n_hash_state server_finished_hash_copy;
+
     /* Used for SSLv3, TLS 1.0, and TLS 1.1 PRFs */
     struct s2n_hash_state prf_md5_hash_copy;
     struct s2n_hash_state prf_sha1_hash_copy;
     /*Used for TLS 1.2 PRF */
     struct s2n_hash_state prf_tls12_hash_copy;
+};
+
+struct s2n_handshake {
+    struct s2n_stuffer io;
 
-    /* Hash algorithms required for this handshake. The set of required hashes can be reduced as session parameters are
-     * negotiated, i.e. cipher suite and protocol version.
+    /* Points into the connection's handshake arena, NULL once it has been released */
+    struct s2n_handshake_hashes *hashes;
+
+    /* Hash algorithms required for this handshake. Only the hash states of required algorithms are allocated and kept
+     * up to date. The set is chosen once session parameters are negotiated, i.e. cipher suite and protocol version.
      */
     uint8_t required_hash_algs[S2N_HASH_SENTINEL];
 
+    /* Until the required hash algorithms are known, the handshake messages are kept here instead, so that the hashes
+     * that turn out to be needed can be started from them later.
+     */
+    struct s2n_stuffer transcript;
+    uint8_t transcript_buffered;
+
     uint8_t server_finished[S2N_TLS_SECRET_LEN];
     uint8_t client_finished[S2N_TLS_SECRET_LEN];
 
@@ -150,19 +172,36 @@ struct s2n_handshake {
 #define WITH_SESSION_TICKET         0x20
 #define IS_ISSUING_NEW_SESSION_TICKET( type )   ( (type) & WITH_SESSION_TICKET )
 
+/* TLS1.3 server asked the client for a new key share with a HelloRetryRequest */
+#define HELLO_RETRY_REQUEST         0x80
+#define IS_HELLO_RETRY_HANDSHAKE( type )   ( (type) & HELLO_RETRY_REQUEST )
+
+/* TLS1.3 server accepted the client's early data, which the client ends with an EndOfEarlyData */
+#define WITH_EARLY_DATA             0x100
+#define IS_EARLY_DATA_HANDSHAKE( type )    ( (type) & WITH_EARLY_DATA )
+
     /* Which handshake message number are we processing */
     int message_number;
 
     /* Set to 1 if the RSA verification failed */
     uint8_t rsa_failed;
+
+    /* Where the current message is with an async private key operation */
+    s2n_async_state async_state;
 };
 
 extern message_type_t s2n_conn_get_current_message_type(struct s2n_connection *conn);
 extern int s2n_conn_set_handshake_type(struct s2n_connection *conn);
 extern int s2n_conn_set_handshake_no_client_cert(struct s2n_connection *conn);
 extern int s2n_handshake_require_all_hashes(struct s2n_handshake *handshake);
+extern int s2n_handshake_require_hash(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg);
+extern int s2n_handshake_buffer_transcript(struct s2n_handshake *handshake);
+extern int s2n_handshake_release_transcript(struct s2n_handshake *handshake);
+extern int s2n_handshake_reset_hashes(struct s2n_handshake *handshake);
+extern int s2n_handshake_free_hashes(struct s2n_handshake *handshake);
 extern uint8_t s2n_handshake_is_hash_required(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg);
 extern int s2n_conn_update_required_handshake_hashes(struct s2n_connection *conn);
 extern int s2n_handshake_get_hash_state(struct s2n_connection *conn, s2n_hash_algorithm hash_alg, struct s2n_hash_state *hash_state);
+extern int s2n_handshake_hash_as_message_hash(struct s2n_handshake *handshake, s2n_hash_algorithm hash_alg);
 extern int s2n_conn_find_name_matching_certs(struct s2n_connection *conn);
 extern int s2n_create_wildcard_hostname(struct s2n_stuffer *hostname, struct s2n_stuffer *output);
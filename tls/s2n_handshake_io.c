@@ -22,8 +22,11 @@
 
 #include "crypto/s2n_fips.h"
 
+#include "tls/s2n_buffer_pool.h"
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_connection.h"
+#include "tls/s2n_ktls.h"
+#include "tls/s2n_perf.h"
 #include "tls/s2n_record.h"
 #include "tls/s2n_resume.h"
 #include "tls/s2n_alerts.h"
@@ -44,6 +47,7 @@
 #define TLS_CLIENT_HELLO               1
 #define TLS_SERVER_HELLO               2
 #define TLS_SERVER_NEW_SESSION_TICKET  4
+#define TLS_END_OF_EARLY_DATA          5
 #define TLS_ENCRYPTED_EXTENSIONS       8
 #define TLS_CERTIFICATE               11
 #define TLS_SERVER_KEY                12
@@ -100,6 +104,7 @@ static struct s2n_handshake_action tls13_state_machine[] = {
     [CLIENT_HELLO]              = {TLS_HANDSHAKE, TLS_CLIENT_HELLO, 'C', {s2n_client_hello_recv, s2n_client_hello_send}},
 
     [SERVER_HELLO]              = {TLS_HANDSHAKE, TLS_SERVER_HELLO, 'S', {s2n_server_hello_send, s2n_server_hello_recv}},
+    [HELLO_RETRY_MSG]           = {TLS_HANDSHAKE, TLS_SERVER_HELLO, 'S', {s2n_server_hello_retry_send, s2n_server_hello_recv}},
     [ENCRYPTED_EXTENSIONS]      = {TLS_HANDSHAKE, TLS_ENCRYPTED_EXTENSIONS, 'S', {s2n_encrypted_extensions_send, s2n_encrypted_extensions_recv}},
     [SERVER_CERT_REQ]           = {TLS_HANDSHAKE, TLS_CERT_REQ, 'S', {s2n_client_cert_req_send, s2n_client_cert_req_recv}},
     [SERVER_CERT]               = {TLS_HANDSHAKE, TLS_CERTIFICATE, 'S', {s2n_server_cert_send, s2n_server_cert_recv}},
@@ -109,6 +114,10 @@ static struct s2n_handshake_action tls13_state_machine[] = {
     [CLIENT_CERT]               = {TLS_HANDSHAKE, TLS_CERTIFICATE, 'C', {s2n_client_cert_recv, s2n_client_cert_send}},
     [CLIENT_CERT_VERIFY]        = {TLS_HANDSHAKE, TLS_CERT_VERIFY, 'C', {s2n_client_cert_verify_recv, s2n_client_cert_verify_send}},
     [CLIENT_FINISHED]           = {TLS_HANDSHAKE, TLS_FINISHED, 'C', {s2n_tls13_client_finished_recv, s2n_tls13_client_finished_send}},
+    [END_OF_EARLY_DATA]         = {TLS_HANDSHAKE, TLS_END_OF_EARLY_DATA, 'C', {s2n_end_of_early_data_recv, s2n_end_of_early_data_send}},
+
+    /* Only the server's handshakes include the NewSessionTicket, a client reads it after the handshake */
+    [SERVER_NEW_SESSION_TICKET] = {TLS_HANDSHAKE, TLS_SERVER_NEW_SESSION_TICKET, 'S', {s2n_tls13_server_nst_send, s2n_tls13_server_nst_recv}},
 
     /* Not used by TLS1.3, except to maintain middlebox compatibility */
     [CLIENT_CHANGE_CIPHER_SPEC] = {TLS_CHANGE_CIPHER_SPEC, 0, 'C', {s2n_basic_ccs_recv, s2n_ccs_send}},
@@ -128,6 +137,7 @@ static const char *message_names[] = {
     MESSAGE_NAME_ENTRY(SERVER_CERT),
     MESSAGE_NAME_ENTRY(SERVER_CERT_STATUS),
     MESSAGE_NAME_ENTRY(SERVER_CERT_VERIFY),
+    MESSAGE_NAME_ENTRY(HELLO_RETRY_MSG),
     MESSAGE_NAME_ENTRY(SERVER_KEY),
     MESSAGE_NAME_ENTRY(SERVER_CERT_REQ),
     MESSAGE_NAME_ENTRY(SERVER_HELLO_DONE),
@@ -138,11 +148,12 @@ static const char *message_names[] = {
     MESSAGE_NAME_ENTRY(CLIENT_FINISHED),
     MESSAGE_NAME_ENTRY(SERVER_CHANGE_CIPHER_SPEC),
     MESSAGE_NAME_ENTRY(SERVER_FINISHED),
+    MESSAGE_NAME_ENTRY(END_OF_EARLY_DATA),
     MESSAGE_NAME_ENTRY(APPLICATION_DATA),
 };
 
 /* Maximum number of valid handshakes */
-#define S2N_HANDSHAKES_COUNT        128
+#define S2N_HANDSHAKES_COUNT        512
 
 /* Maximum number of messages in a handshake */
 #define S2N_MAX_HANDSHAKE_LENGTH    32
@@ -367,7 +378,8 @@ static message_type_t handshakes[S2N_HANDSHAKES_COUNT][S2N_MAX_HANDSHAKE_LENGTH]
 /*
  * This selection of handshakes resembles the standard set, but with changes made to support tls1.3.
  *
- * These are just the basic handshakes. At the moment hello retries, session resumption, and early data are not supported.
+ * These are the basic handshakes, hello retries, and PSK session resumption. Early data is not supported yet.
+ * A resumed handshake is authenticated by the PSK, so the server sends no certificate.
  *
  * The CHANGE_CIPHER_SPEC messages are included only for middlebox compatibility.
  * See https://tools.ietf.org/html/rfc8446#appendix-D.4
@@ -378,12 +390,90 @@ static message_type_t tls13_handshakes[S2N_HANDSHAKES_COUNT][S2N_MAX_HANDSHAKE_L
             SERVER_HELLO
     },
 
+    [NEGOTIATED] = {
+            CLIENT_HELLO,
+            SERVER_HELLO, SERVER_CHANGE_CIPHER_SPEC, ENCRYPTED_EXTENSIONS, SERVER_FINISHED,
+            CLIENT_CHANGE_CIPHER_SPEC, CLIENT_FINISHED,
+            APPLICATION_DATA
+    },
+
+    [NEGOTIATED | WITH_SESSION_TICKET] = {
+            CLIENT_HELLO,
+            SERVER_HELLO, SERVER_CHANGE_CIPHER_SPEC, ENCRYPTED_EXTENSIONS, SERVER_FINISHED,
+            CLIENT_CHANGE_CIPHER_SPEC, CLIENT_FINISHED,
+            SERVER_NEW_SESSION_TICKET,
+            APPLICATION_DATA
+    },
+
+    /* The client's CHANGE_CIPHER_SPEC stays just before its second flight, which starts with the EndOfEarlyData */
+    [NEGOTIATED | WITH_EARLY_DATA] = {
+            CLIENT_HELLO,
+            SERVER_HELLO, SERVER_CHANGE_CIPHER_SPEC, ENCRYPTED_EXTENSIONS, SERVER_FINISHED,
+            CLIENT_CHANGE_CIPHER_SPEC, END_OF_EARLY_DATA, CLIENT_FINISHED,
+            APPLICATION_DATA
+    },
+
+    [NEGOTIATED | WITH_EARLY_DATA | WITH_SESSION_TICKET] = {
+            CLIENT_HELLO,
+            SERVER_HELLO, SERVER_CHANGE_CIPHER_SPEC, ENCRYPTED_EXTENSIONS, SERVER_FINISHED,
+            CLIENT_CHANGE_CIPHER_SPEC, END_OF_EARLY_DATA, CLIENT_FINISHED,
+            SERVER_NEW_SESSION_TICKET,
+            APPLICATION_DATA
+    },
+
     [NEGOTIATED | FULL_HANDSHAKE] = {
             CLIENT_HELLO,
             SERVER_HELLO, SERVER_CHANGE_CIPHER_SPEC, ENCRYPTED_EXTENSIONS, SERVER_CERT, SERVER_CERT_VERIFY, SERVER_FINISHED,
             CLIENT_CHANGE_CIPHER_SPEC, CLIENT_FINISHED,
             APPLICATION_DATA
     },
+
+    [NEGOTIATED | FULL_HANDSHAKE | WITH_SESSION_TICKET] = {
+            CLIENT_HELLO,
+            SERVER_HELLO, SERVER_CHANGE_CIPHER_SPEC, ENCRYPTED_EXTENSIONS, SERVER_CERT, SERVER_CERT_VERIFY, SERVER_FINISHED,
+            CLIENT_CHANGE_CIPHER_SPEC, CLIENT_FINISHED,
+            SERVER_NEW_SESSION_TICKET,
+            APPLICATION_DATA
+    },
+
+    /* The client's CHANGE_CIPHER_SPEC goes before its second ClientHello, and the server's after the HelloRetryRequest */
+    [NEGOTIATED | HELLO_RETRY_REQUEST] = {
+            CLIENT_HELLO,
+            HELLO_RETRY_MSG, SERVER_CHANGE_CIPHER_SPEC,
+            CLIENT_CHANGE_CIPHER_SPEC, CLIENT_HELLO,
+            SERVER_HELLO, ENCRYPTED_EXTENSIONS, SERVER_FINISHED,
+            CLIENT_FINISHED,
+            APPLICATION_DATA
+    },
+
+    [NEGOTIATED | HELLO_RETRY_REQUEST | WITH_SESSION_TICKET] = {
+            CLIENT_HELLO,
+            HELLO_RETRY_MSG, SERVER_CHANGE_CIPHER_SPEC,
+            CLIENT_CHANGE_CIPHER_SPEC, CLIENT_HELLO,
+            SERVER_HELLO, ENCRYPTED_EXTENSIONS, SERVER_FINISHED,
+            CLIENT_FINISHED,
+            SERVER_NEW_SESSION_TICKET,
+            APPLICATION_DATA
+    },
+
+    [NEGOTIATED | FULL_HANDSHAKE | HELLO_RETRY_REQUEST] = {
+            CLIENT_HELLO,
+            HELLO_RETRY_MSG, SERVER_CHANGE_CIPHER_SPEC,
+            CLIENT_CHANGE_CIPHER_SPEC, CLIENT_HELLO,
+            SERVER_HELLO, ENCRYPTED_EXTENSIONS, SERVER_CERT, SERVER_CERT_VERIFY, SERVER_FINISHED,
+            CLIENT_FINISHED,
+            APPLICATION_DATA
+    },
+
+    [NEGOTIATED | FULL_HANDSHAKE | HELLO_RETRY_REQUEST | WITH_SESSION_TICKET] = {
+            CLIENT_HELLO,
+            HELLO_RETRY_MSG, SERVER_CHANGE_CIPHER_SPEC,
+            CLIENT_CHANGE_CIPHER_SPEC, CLIENT_HELLO,
+            SERVER_HELLO, ENCRYPTED_EXTENSIONS, SERVER_CERT, SERVER_CERT_VERIFY, SERVER_FINISHED,
+            CLIENT_FINISHED,
+            SERVER_NEW_SESSION_TICKET,
+            APPLICATION_DATA
+    },
 };
 
 #define MAX_HANDSHAKE_TYPE_LEN 128
@@ -396,7 +486,9 @@ static const char* handshake_type_names[] = {
     "OCSP_STATUS|",
     "CLIENT_AUTH|",
     "WITH_SESSION_TICKET|",
-    "NO_CLIENT_CERT|"
+    "NO_CLIENT_CERT|",
+    "HELLO_RETRY_REQUEST|",
+    "WITH_EARLY_DATA|",
 };
 
 #define IS_TLS13_HANDSHAKE( conn )    ((conn)->actual_protocol_version == S2N_TLS13)
@@ -419,6 +511,19 @@ message_type_t s2n_conn_get_current_message_type(struct s2n_connection *conn)
     return ACTIVE_MESSAGE(conn);
 }
 
+/* Runs a message handler, timing it when performance counters are enabled */
+static int s2n_handshake_run_handler(struct s2n_connection *conn, int (*handler) (struct s2n_connection * conn))
+{
+    uint64_t start;
+    GUARD(s2n_perf_start(conn, &start));
+
+    int r = handler(conn);
+
+    GUARD(s2n_perf_handshake_handler(conn, start));
+
+    return r;
+}
+
 static int s2n_advance_message(struct s2n_connection *conn)
 {
     /* Get the mode: 'C'lient or 'S'erver */
@@ -428,6 +533,8 @@ static int s2n_advance_message(struct s2n_connection *conn)
         this_mode = 'C';
     }
 
+    GUARD(s2n_perf_handshake_message(conn, message_names[ACTIVE_MESSAGE(conn)]));
+
     /* Actually advance the message number */
     conn->handshake.message_number++;
 
@@ -438,6 +545,10 @@ static int s2n_advance_message(struct s2n_connection *conn)
         conn->handshake.message_number++;
     }
 
+    if (ACTIVE_STATE(conn).writer == 'B') {
+        GUARD(s2n_perf_handshake_done(conn));
+    }
+
     /* Set TCP_QUICKACK to avoid artificial delay during the handshake */
     GUARD(s2n_socket_quickack(conn));
 
@@ -486,12 +597,26 @@ int s2n_generate_new_client_session_id(struct s2n_connection *conn)
 
 int s2n_conn_set_handshake_type(struct s2n_connection *conn)
 {
+    /* A HelloRetryRequest is remembered for the rest of the handshake */
+    uint32_t hello_retry = conn->handshake.handshake_type & HELLO_RETRY_REQUEST;
+
     /* A handshake type has been negotiated */
     conn->handshake.handshake_type = NEGOTIATED;
 
-    /* In the initial TLS1.3 release, we will only support the basic handshake. */
+    /* A TLS1.3 handshake resumes a session when the server accepts the client's PSK.
+     * Only the server's handshake has the NewSessionTicket, a client reads it once the handshake is complete.
+     */
     if (IS_TLS13_HANDSHAKE(conn)) {
-        conn->handshake.handshake_type |= FULL_HANDSHAKE;
+        conn->handshake.handshake_type |= hello_retry;
+
+        if (!conn->tls13_psk.accepted) {
+            conn->handshake.handshake_type |= FULL_HANDSHAKE;
+        }
+
+        if (conn->mode == S2N_SERVER && s2n_tls13_server_can_send_nst(conn)) {
+            conn->handshake.handshake_type |= WITH_SESSION_TICKET;
+        }
+
         return 0;
     }
 
@@ -564,6 +689,10 @@ int s2n_conn_set_handshake_no_client_cert(struct s2n_connection *conn)
     S2N_ERROR_IF(client_cert_auth_type != S2N_CERT_AUTH_OPTIONAL, S2N_ERR_BAD_MESSAGE);
 
     conn->handshake.handshake_type |= NO_CLIENT_CERT;
+
+    /* There won't be a CertificateVerify to hash for */
+    GUARD(s2n_conn_update_required_handshake_hashes(conn));
+
     return 0;
 }
 
@@ -607,6 +736,10 @@ const char *s2n_connection_get_handshake_type_name(struct s2n_connection *conn)
 
 static int s2n_conn_update_handshake_hashes(struct s2n_connection *conn, struct s2n_blob *data)
 {
+    if (conn->handshake.transcript_buffered) {
+        GUARD(s2n_stuffer_write(&conn->handshake.transcript, data));
+    }
+
     if (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_MD5)) {
         /* The handshake MD5 hash state will fail the s2n_hash_is_available() check
          * since MD5 is not permitted in FIPS mode. This check will not be used as
@@ -614,39 +747,36 @@ static int s2n_conn_update_handshake_hashes(struct s2n_connection *conn, struct
          * PRF, which is required to comply with the TLS 1.0 and 1.1 RFCs and is approved
          * as per NIST Special Publication 800-52 Revision 1.
          */
-        GUARD(s2n_hash_update(&conn->handshake.md5, data->data, data->size));
+        GUARD(s2n_hash_update(&conn->handshake.hashes->md5, data->data, data->size));
     }
 
     if (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_SHA1)) {
-        GUARD(s2n_hash_update(&conn->handshake.sha1, data->data, data->size));
+        GUARD(s2n_hash_update(&conn->handshake.hashes->sha1, data->data, data->size));
     }
 
-    const uint8_t md5_sha1_required = (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_MD5) &&
-                                       s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_SHA1));
-
-    if (md5_sha1_required) {
+    if (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_MD5_SHA1)) {
         /* The MD5_SHA1 hash can still be used for TLS 1.0 and 1.1 in FIPS mode for 
          * the handshake hashes. This will only be used for the signature check in the
          * CertificateVerify message and the PRF. NIST SP 800-52r1 approves use
          * of MD5_SHA1 for these use cases (see footnotes 15 and 20, and section
          * 3.3.2) */
-        GUARD(s2n_hash_update(&conn->handshake.md5_sha1, data->data, data->size));
+        GUARD(s2n_hash_update(&conn->handshake.hashes->md5_sha1, data->data, data->size));
     }
 
     if (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_SHA224)) {
-        GUARD(s2n_hash_update(&conn->handshake.sha224, data->data, data->size));
+        GUARD(s2n_hash_update(&conn->handshake.hashes->sha224, data->data, data->size));
     }
 
     if (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_SHA256)) {
-        GUARD(s2n_hash_update(&conn->handshake.sha256, data->data, data->size));
+        GUARD(s2n_hash_update(&conn->handshake.hashes->sha256, data->data, data->size));
     }
 
     if (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_SHA384)) {
-        GUARD(s2n_hash_update(&conn->handshake.sha384, data->data, data->size));
+        GUARD(s2n_hash_update(&conn->handshake.hashes->sha384, data->data, data->size));
     }
 
     if (s2n_handshake_is_hash_required(&conn->handshake, S2N_HASH_SHA512)) {
-        GUARD(s2n_hash_update(&conn->handshake.sha512, data->data, data->size));
+        GUARD(s2n_hash_update(&conn->handshake.hashes->sha512, data->data, data->size));
     }
 
     return 0;
@@ -684,15 +814,40 @@ static int s2n_conn_post_handshake_hashes_update(struct s2n_connection *conn)
     struct s2n_blob server_seq = {.data = conn->secure.server_sequence_number,.size = sizeof(conn->secure.server_sequence_number) };
 
     switch(s2n_conn_get_current_message_type(conn)) {
+    case CLIENT_HELLO:
+        /* Early data follows the ClientHello that asked for it, protected with the early traffic key */
+        if ((conn->mode == S2N_CLIENT && conn->early_data.status == S2N_EARLY_DATA_REQUESTED)
+                || (conn->mode == S2N_SERVER && conn->early_data.status == S2N_EARLY_DATA_ACCEPTED)) {
+            if (conn->mode == S2N_CLIENT) {
+                conn->secure.cipher_suite = conn->tls13_psk.cipher_suite;
+            }
+            GUARD(s2n_tls13_handle_early_traffic_secret(conn));
+            GUARD(s2n_blob_zero(&client_seq));
+            conn->client = &conn->secure;
+        }
+        break;
     case SERVER_HELLO:
         GUARD(s2n_tls13_handle_handshake_secrets(conn));
-        GUARD(s2n_blob_zero(&client_seq));
         GUARD(s2n_blob_zero(&server_seq));
         conn->server = &conn->secure;
-        conn->client = &conn->secure;
+        if (!s2n_early_data_in_flight(conn)) {
+            GUARD(s2n_blob_zero(&client_seq));
+            conn->client = &conn->secure;
+        }
         GUARD(s2n_stuffer_wipe(&conn->alert_in));
         break;
+    case SERVER_FINISHED:
+        if (IS_EARLY_DATA_HANDSHAKE(conn->handshake.handshake_type)) {
+            GUARD(s2n_tls13_save_server_finished_hash(conn));
+        }
+        break;
+    case END_OF_EARLY_DATA:
+        GUARD(s2n_early_data_end(conn, S2N_EARLY_DATA_ENDED));
+        break;
     case CLIENT_FINISHED:
+        /* The resumption master secret covers the transcript up to the ClientFinished */
+        GUARD(s2n_tls13_handle_resumption_master_secret(conn));
+
         /* Reset sequence numbers for Application Data */
         GUARD(s2n_blob_zero(&client_seq));
         GUARD(s2n_blob_zero(&server_seq));
@@ -716,12 +871,15 @@ static int handshake_write_io(struct s2n_connection *conn)
     /* Populate handshake.io with header/payload for the current state, once.
      * Check wiped instead of s2n_stuffer_data_available to differentiate between the initial call
      * to handshake_write_io and a repeated call after an EWOULDBLOCK.
+     * A handler that was waiting on an async private key operation is called again to
+     * finish its message, which is already partly in handshake.io, or to fail it.
      */
-    if (conn->handshake.io.wiped == 1) {
-        if (record_type == TLS_HANDSHAKE) {
+    if (conn->handshake.io.wiped == 1 || conn->handshake.async_state == S2N_ASYNC_COMPLETE
+            || conn->handshake.async_state == S2N_ASYNC_FAILED) {
+        if (record_type == TLS_HANDSHAKE && conn->handshake.io.wiped == 1) {
             GUARD(s2n_handshake_write_header(conn, ACTIVE_STATE(conn).message_type));
         }
-        GUARD(ACTIVE_STATE(conn).handler[conn->mode] (conn));
+        GUARD(s2n_handshake_run_handler(conn, ACTIVE_STATE(conn).handler[conn->mode]));
         if (record_type == TLS_HANDSHAKE) {
             GUARD(s2n_handshake_finish_header(conn));
         }
@@ -865,7 +1023,7 @@ static int s2n_handshake_handle_sslv2(struct s2n_connection *conn)
  * the connection been killed
  */
 static int s2n_handshake_handle_app_data(struct s2n_connection *conn) {
-    int r = ACTIVE_STATE(conn).handler[conn->mode] (conn);
+    int r = s2n_handshake_run_handler(conn, ACTIVE_STATE(conn).handler[conn->mode]);
 
     if (r == S2N_SUCCESS) {
         /* if r == 0, then we advance the state machine */
@@ -888,84 +1046,72 @@ done:
     return 0;
 }
 
-/* Reading is a little more complicated than writing as the TLS RFCs allow content
- * types to be interleaved at the record layer. We may get an alert message
- * during the handshake phase, or messages of types that we don't support (e.g.
- * HEARTBEAT messages), or during renegotiations we may even get application
- * data messages that need to be handled by the application. The latter is punted
- * for now (s2n does not support renegotiations).
- */
-static int handshake_read_io(struct s2n_connection *conn)
+/* Runs the handler for the complete handshake message in handshake.io */
+/* Finds the current message again after a handler negotiated a version with a different handshake table */
+static int s2n_handshake_resync_message_number(struct s2n_connection *conn, message_type_t current_message)
 {
-    uint8_t record_type;
-    int isSSLv2;
-
-    /* Fill conn->in stuffer necessary for the handshake */
-    GUARD(s2n_read_full_record(conn, &record_type, &isSSLv2));
-
-    if (isSSLv2) {
-        GUARD(s2n_handshake_handle_sslv2(conn));
+    for (int i = 0; i < S2N_MAX_HANDSHAKE_LENGTH; i++) {
+        if (ACTIVE_HANDSHAKES(conn)[conn->handshake.handshake_type][i] == current_message) {
+            conn->handshake.message_number = i;
+            return 0;
+        }
     }
 
-    /* In TLS 1.3, encrypted handshake records would appear to be of record type
-     * TLS_APPLICATION_DATA. The actual record content type is found after the encryped
-     * is decrypted.
-     */
-    if (conn->actual_protocol_version == S2N_TLS13 && record_type == TLS_APPLICATION_DATA) {
-        GUARD(s2n_stuffer_skip_read(&conn->in, s2n_stuffer_data_available(&conn->in) - 1));
+    S2N_ERROR(S2N_ERR_BAD_MESSAGE);
+}
 
-        /* set the true record type */
-        GUARD(s2n_stuffer_read_uint8(&conn->in, &record_type));
+static int s2n_handshake_handle_message(struct s2n_connection *conn)
+{
+    message_type_t current_message = ACTIVE_MESSAGE(conn);
+    uint8_t was_tls13_handshake = IS_TLS13_HANDSHAKE(conn);
 
-        /* wipe this last byte so the rest handshake works like < TLS 1.3 */
-        GUARD(s2n_stuffer_wipe_n(&conn->in, 1));
+    /* Call the relevant handler */
+    int r = s2n_handshake_run_handler(conn, ACTIVE_STATE(conn).handler[conn->mode]);
 
-        /* set the read cursor at where it should be */
-        GUARD(s2n_stuffer_reread(&conn->in));
+    /* A client that offered TLS1.3 reads the ServerHello with the TLS1.3 handshake, which has no
+     * session lookup state, and may be told to carry on with a TLS1.2 one.
+     */
+    if (r >= 0 && was_tls13_handshake != IS_TLS13_HANDSHAKE(conn)) {
+        GUARD(s2n_handshake_resync_message_number(conn, current_message));
     }
 
-    /* Now we have a record, but it could be a partial fragment of a message, or it might
-     * contain several messages.
+    /* Leave the message and the record it came in where they are, the handler will be called again once the
+     * async private key operation has been applied.
      */
-    S2N_ERROR_IF(record_type == TLS_APPLICATION_DATA, S2N_ERR_BAD_MESSAGE);
-    if (record_type == TLS_CHANGE_CIPHER_SPEC) {
-        /* TLS1.2 should not receive unexpected change cipher spec messages, but TLS1.3 might. */
-        if (!IS_TLS13_HANDSHAKE(conn)) {
-            S2N_ERROR_IF(EXPECTED_RECORD_TYPE(conn) != TLS_CHANGE_CIPHER_SPEC, S2N_ERR_BAD_MESSAGE);
-        }
-
-        S2N_ERROR_IF(s2n_stuffer_data_available(&conn->in) != 1, S2N_ERR_BAD_MESSAGE);
+    if (r < 0 && s2n_errno == S2N_ERR_ASYNC_BLOCKED) {
+        return r;
+    }
 
-        GUARD(s2n_stuffer_copy(&conn->in, &conn->handshake.io, s2n_stuffer_data_available(&conn->in)));
-        GUARD(CCS_STATE(conn).handler[conn->mode] (conn));
-        GUARD(s2n_stuffer_wipe(&conn->handshake.io));
+    /* Don't update handshake hashes until after the handler has executed since some handlers need to read the
+     * hash values before they are updated. */
+    GUARD(s2n_handshake_conn_update_hashes(conn));
 
-        /* We're done with the record, wipe it */
-        GUARD(s2n_stuffer_wipe(&conn->header_in));
-        GUARD(s2n_stuffer_wipe(&conn->in));
-        conn->in_status = ENCRYPTED;
+    GUARD(s2n_stuffer_wipe(&conn->handshake.io));
 
-        /* Advance the state machine if this was an expected message */
-        if (EXPECTED_RECORD_TYPE(conn) == TLS_CHANGE_CIPHER_SPEC) {
-            GUARD(s2n_advance_message(conn));
+    if (r < 0) {
+        /* Don't invoke blinding on some of the common errors */
+        switch (s2n_errno) {
+            case S2N_ERR_CANCELLED:
+            case S2N_ERR_CIPHER_NOT_SUPPORTED:
+            case S2N_ERR_PROTOCOL_VERSION_UNSUPPORTED:
+                conn->closed = 1;
+                break;
+            default:
+                GUARD(s2n_connection_kill(conn));
         }
 
-        return 0;
-    } else if (record_type != TLS_HANDSHAKE) {
-        if (record_type == TLS_ALERT) {
-            GUARD(s2n_process_alert_fragment(conn));
-        }
+        return r;
+    }
 
-        /* Ignore record types that we don't support */
+    /* Advance the state machine */
+    GUARD(s2n_advance_message(conn));
 
-        /* We're done with the record, wipe it */
-        GUARD(s2n_stuffer_wipe(&conn->header_in));
-        GUARD(s2n_stuffer_wipe(&conn->in));
-        conn->in_status = ENCRYPTED;
-        return 0;
-    }
+    return 0;
+}
 
-    /* Record is a handshake message */
+/* Handles the handshake messages left in conn->in, and wipes the record once they have all been handled */
+static int s2n_handshake_handle_messages(struct s2n_connection *conn)
+{
     while (s2n_stuffer_data_available(&conn->in)) {
         int r;
         uint8_t actual_handshake_message_type;
@@ -1003,40 +1149,96 @@ static int handshake_read_io(struct s2n_connection *conn)
 
         S2N_ERROR_IF(actual_handshake_message_type != EXPECTED_MESSAGE_TYPE(conn), S2N_ERR_BAD_MESSAGE);
 
-        /* Call the relevant handler */
-        r = ACTIVE_STATE(conn).handler[conn->mode] (conn);
+        GUARD(s2n_handshake_handle_message(conn));
+    }
+
+    /* We're done with the record, wipe it */
+    GUARD(s2n_stuffer_wipe(&conn->header_in));
+    GUARD(s2n_stuffer_wipe(&conn->in));
+    conn->in_status = ENCRYPTED;
+
+    return 0;
+}
+
+/* Reading is a little more complicated than writing as the TLS RFCs allow content
+ * types to be interleaved at the record layer. We may get an alert message
+ * during the handshake phase, or messages of types that we don't support (e.g.
+ * HEARTBEAT messages), or during renegotiations we may even get application
+ * data messages that need to be handled by the application. The latter is punted
+ * for now (s2n does not support renegotiations).
+ */
+static int handshake_read_io(struct s2n_connection *conn)
+{
+    uint8_t record_type;
+    int isSSLv2;
+
+    /* The last message's handler was waiting on an async private key operation. Finish that
+     * message, and carry on with any more that came in the same record.
+     */
+    if (conn->handshake.async_state == S2N_ASYNC_COMPLETE || conn->handshake.async_state == S2N_ASYNC_FAILED) {
+        GUARD(s2n_handshake_handle_message(conn));
+        return s2n_handshake_handle_messages(conn);
+    }
+
+    /* Fill conn->in stuffer necessary for the handshake */
+    GUARD(s2n_read_full_record(conn, &record_type, &isSSLv2));
+
+    if (isSSLv2) {
+        GUARD(s2n_handshake_handle_sslv2(conn));
+    }
+
+    /* Now we have a record, but it could be a partial fragment of a message, or it might
+     * contain several messages.
+     */
+    if (record_type == TLS_APPLICATION_DATA) {
+        /* Only early data can come in before the handshake is done */
+        GUARD(s2n_early_data_recv_record(conn));
 
-        /* Don't update handshake hashes until after the handler has executed since some handlers need to read the
-         * hash values before they are updated. */
-        GUARD(s2n_handshake_conn_update_hashes(conn));
+        /* We're done with the record, wipe it */
+        GUARD(s2n_stuffer_wipe(&conn->header_in));
+        GUARD(s2n_stuffer_wipe(&conn->in));
+        conn->in_status = ENCRYPTED;
+        return 0;
+    } else if (record_type == TLS_CHANGE_CIPHER_SPEC) {
+        /* TLS1.2 should not receive unexpected change cipher spec messages, but TLS1.3 might. */
+        if (!IS_TLS13_HANDSHAKE(conn)) {
+            S2N_ERROR_IF(EXPECTED_RECORD_TYPE(conn) != TLS_CHANGE_CIPHER_SPEC, S2N_ERR_BAD_MESSAGE);
+        }
 
+        S2N_ERROR_IF(s2n_stuffer_data_available(&conn->in) != 1, S2N_ERR_BAD_MESSAGE);
+
+        GUARD(s2n_stuffer_copy(&conn->in, &conn->handshake.io, s2n_stuffer_data_available(&conn->in)));
+        GUARD(s2n_handshake_run_handler(conn, CCS_STATE(conn).handler[conn->mode]));
         GUARD(s2n_stuffer_wipe(&conn->handshake.io));
 
-        if (r < 0) {
-            /* Don't invoke blinding on some of the common errors */
-            switch (s2n_errno) {
-                case S2N_ERR_CANCELLED:
-                case S2N_ERR_CIPHER_NOT_SUPPORTED:
-                case S2N_ERR_PROTOCOL_VERSION_UNSUPPORTED:
-                    conn->closed = 1;
-                    break;
-                default:
-                    GUARD(s2n_connection_kill(conn));
-            }
+        /* We're done with the record, wipe it */
+        GUARD(s2n_stuffer_wipe(&conn->header_in));
+        GUARD(s2n_stuffer_wipe(&conn->in));
+        conn->in_status = ENCRYPTED;
 
-            return r;
+        /* Advance the state machine if this was an expected message */
+        if (EXPECTED_RECORD_TYPE(conn) == TLS_CHANGE_CIPHER_SPEC) {
+            GUARD(s2n_advance_message(conn));
         }
 
-        /* Advance the state machine */
-        GUARD(s2n_advance_message(conn));
-    }
+        return 0;
+    } else if (record_type != TLS_HANDSHAKE) {
+        if (record_type == TLS_ALERT) {
+            GUARD(s2n_process_alert_fragment(conn));
+        }
 
-    /* We're done with the record, wipe it */
-    GUARD(s2n_stuffer_wipe(&conn->header_in));
-    GUARD(s2n_stuffer_wipe(&conn->in));
-    conn->in_status = ENCRYPTED;
+        /* Ignore record types that we don't support */
 
-    return 0;
+        /* We're done with the record, wipe it */
+        GUARD(s2n_stuffer_wipe(&conn->header_in));
+        GUARD(s2n_stuffer_wipe(&conn->in));
+        conn->in_status = ENCRYPTED;
+        return 0;
+    }
+
+    /* Record is a handshake message, so the client has sent all the early data it is going to */
+    conn->early_data.skipping = 0;
+    return s2n_handshake_handle_messages(conn);
 }
 
 static int s2n_try_delete_session_cache(struct s2n_connection *conn) 
@@ -1048,17 +1250,35 @@ static int s2n_try_delete_session_cache(struct s2n_connection *conn)
     return 0;
 }
 
-int s2n_negotiate(struct s2n_connection *conn, s2n_blocked_status * blocked)
+static int s2n_negotiate_impl(struct s2n_connection *conn, s2n_blocked_status * blocked, uint8_t early_data_only)
 {    
     char this = 'S';
     if (conn->mode == S2N_CLIENT) {
         this = 'C';
     }
 
+    if (ACTIVE_STATE(conn).writer != 'B') {
+        GUARD(s2n_perf_handshake_begin(conn));
+
+        /* A connection with dynamic buffers gives its handshake buffer back between handshakes */
+        GUARD(s2n_connection_lease_buffer(conn, &conn->handshake.io, S2N_LARGE_RECORD_LENGTH));
+    }
+
     while (ACTIVE_STATE(conn).writer != 'B') {
+        /* Nothing can happen until the application applies the async private key operation */
+        if (conn->handshake.async_state == S2N_ASYNC_INVOKED) {
+            *blocked = S2N_BLOCKED_ON_APPLICATION_INPUT;
+            S2N_ERROR_BLOCKED(S2N_ERR_ASYNC_BLOCKED);
+        }
+
         /* Flush any pending I/O or alert messages */
         GUARD(s2n_flush(conn, blocked));
 
+        /* Stop as soon as early data can be sent or received */
+        if (early_data_only && !s2n_early_data_wants_handshake(conn)) {
+            break;
+        }
+
         if (ACTIVE_STATE(conn).writer == 'A') {
             /* We are in a state that is blocked on application data */
             *blocked = S2N_BLOCKED_ON_APPLICATION_INPUT;
@@ -1077,7 +1297,12 @@ int s2n_negotiate(struct s2n_connection *conn, s2n_blocked_status * blocked)
             }
         } else if (ACTIVE_STATE(conn).writer == this) {
             *blocked = S2N_BLOCKED_ON_WRITE;
-            if (handshake_write_io(conn) < 0 && s2n_errno != S2N_ERR_BLOCKED) {
+            int r = handshake_write_io(conn);
+            if (r < 0 && s2n_errno == S2N_ERR_ASYNC_BLOCKED) {
+                *blocked = S2N_BLOCKED_ON_APPLICATION_INPUT;
+                S2N_ERROR_PRESERVE_ERRNO();
+            }
+            if (r < 0 && s2n_errno != S2N_ERR_BLOCKED) {
                 /* Non-retryable write error. The peer might have sent an alert. Try and read it. */
                 const int write_errno = errno;
                 const int write_s2n_errno = s2n_errno;
@@ -1098,6 +1323,10 @@ int s2n_negotiate(struct s2n_connection *conn, s2n_blocked_status * blocked)
             *blocked = S2N_BLOCKED_ON_READ;
             int r = handshake_read_io(conn);
 
+            if (r < 0 && s2n_errno == S2N_ERR_ASYNC_BLOCKED) {
+                *blocked = S2N_BLOCKED_ON_APPLICATION_INPUT;
+                S2N_ERROR_PRESERVE_ERRNO();
+            }
             if (r < 0) {
                 s2n_try_delete_session_cache(conn);
                 S2N_ERROR_PRESERVE_ERRNO();
@@ -1106,7 +1335,17 @@ int s2n_negotiate(struct s2n_connection *conn, s2n_blocked_status * blocked)
 
         /* If the handshake has just ended, free up memory */
         if (ACTIVE_STATE(conn).writer == 'B') {
-            GUARD(s2n_stuffer_resize(&conn->handshake.io, 0));
+            if (conn->dynamic_buffers) {
+                GUARD(s2n_stuffer_wipe(&conn->handshake.io));
+                GUARD(s2n_buffer_pool_return(&conn->handshake.io));
+            } else {
+                GUARD(s2n_stuffer_resize(&conn->handshake.io, 0));
+            }
+
+            /* Hand record protection over to the kernel, if asked to */
+            if (conn->ktls_requested) {
+                GUARD(s2n_ktls_enable(conn));
+            }
         }
     }
 
@@ -1114,3 +1353,23 @@ int s2n_negotiate(struct s2n_connection *conn, s2n_blocked_status * blocked)
 
     return 0;
 }
+
+int s2n_negotiate(struct s2n_connection *conn, s2n_blocked_status * blocked)
+{
+    int result = s2n_negotiate_impl(conn, blocked, 0);
+
+    /* Don't hold on to empty record buffers while waiting for the peer */
+    GUARD(s2n_connection_return_buffers(conn));
+
+    return result;
+}
+
+/* Takes the handshake only as far as s2n_send_early_data() and s2n_recv_early_data() need it */
+int s2n_negotiate_early_data(struct s2n_connection *conn, s2n_blocked_status * blocked)
+{
+    int result = s2n_negotiate_impl(conn, blocked, 1);
+
+    GUARD(s2n_connection_return_buffers(conn));
+
+    return result;
+}
@@ -0,0 +1,472 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <s2n.h>
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <linux/tls.h>
+#endif
+
+#include "error/s2n_errno.h"
+
+#include "crypto/s2n_cipher.h"
+
+#include "stuffer/s2n_stuffer.h"
+
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_ktls.h"
+#include "tls/s2n_perf.h"
+#include "tls/s2n_prf.h"
+#include "tls/s2n_tls_parameters.h"
+
+#include "utils/s2n_blob.h"
+#include "utils/s2n_safety.h"
+#include "utils/s2n_socket.h"
+
+#if defined(TLS_TX) && defined(TLS_RX) && defined(TLS_SET_RECORD_TYPE) && defined(TLS_GET_RECORD_TYPE)
+#define S2N_KTLS_SUPPORTED 1
+#endif
+
+/* Older libc headers don't know about the kernel TLS socket options */
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+/* The most buffers handed to the kernel in a single writev() */
+#define S2N_KTLS_MAX_IOVECS 16
+
+#if S2N_KTLS_SUPPORTED
+
+union s2n_ktls_crypto_info {
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+#ifdef TLS_CIPHER_AES_GCM_256
+    struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+#endif
+};
+
+static int s2n_ktls_supports_cipher(const struct s2n_cipher *cipher)
+{
+    if (cipher == &s2n_aes128_gcm) {
+        return 1;
+    }
+#ifdef TLS_CIPHER_AES_GCM_256
+    if (cipher == &s2n_aes256_gcm) {
+        return 1;
+    }
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    if (cipher == &s2n_chacha20_poly1305) {
+        return 1;
+    }
+#endif
+
+    return 0;
+}
+
+/* s2n uses the sequence number as the explicit part of the AES-GCM nonce, so the kernel is handed
+ * the sequence number for both and keeps them in step from there on.
+ */
+static int s2n_ktls_crypto_info_init(const struct s2n_cipher *cipher, uint8_t *key, uint8_t *implicit_iv, uint8_t *sequence_number,
+                                     union s2n_ktls_crypto_info *crypto_info, uint32_t *crypto_info_size)
+{
+    memset_check(crypto_info, 0, sizeof(*crypto_info));
+
+    if (cipher == &s2n_aes128_gcm) {
+        struct tls12_crypto_info_aes_gcm_128 *gcm = &crypto_info->aes_gcm_128;
+        gcm->info.version = TLS_1_2_VERSION;
+        gcm->info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy_check(gcm->key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+        memcpy_check(gcm->salt, implicit_iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+        memcpy_check(gcm->iv, sequence_number, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+        memcpy_check(gcm->rec_seq, sequence_number, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+        *crypto_info_size = sizeof(*gcm);
+        return 0;
+    }
+#ifdef TLS_CIPHER_AES_GCM_256
+    if (cipher == &s2n_aes256_gcm) {
+        struct tls12_crypto_info_aes_gcm_256 *gcm = &crypto_info->aes_gcm_256;
+        gcm->info.version = TLS_1_2_VERSION;
+        gcm->info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy_check(gcm->key, key, TLS_CIPHER_AES_GCM_256_KEY_SIZE);
+        memcpy_check(gcm->salt, implicit_iv, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+        memcpy_check(gcm->iv, sequence_number, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+        memcpy_check(gcm->rec_seq, sequence_number, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+        *crypto_info_size = sizeof(*gcm);
+        return 0;
+    }
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    if (cipher == &s2n_chacha20_poly1305) {
+        /* The nonce is fully implicit, RFC 7905 Section 2 */
+        struct tls12_crypto_info_chacha20_poly1305 *chacha = &crypto_info->chacha20_poly1305;
+        chacha->info.version = TLS_1_2_VERSION;
+        chacha->info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        memcpy_check(chacha->key, key, TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE);
+        memcpy_check(chacha->iv, implicit_iv, TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+        memcpy_check(chacha->rec_seq, sequence_number, TLS_CIPHER_CHACHA20_POLY1305_REC_SEQ_SIZE);
+        *crypto_info_size = sizeof(*chacha);
+        return 0;
+    }
+#endif
+
+    S2N_ERROR(S2N_ERR_CIPHER_NOT_SUPPORTED);
+}
+
+static int s2n_ktls_set_crypto_info(int fd, int direction, const struct s2n_cipher *cipher, uint8_t *key, uint8_t *implicit_iv, uint8_t *sequence_number)
+{
+    union s2n_ktls_crypto_info crypto_info;
+    uint32_t crypto_info_size = 0;
+
+    GUARD(s2n_ktls_crypto_info_init(cipher, key, implicit_iv, sequence_number, &crypto_info, &crypto_info_size));
+    int r = setsockopt(fd, SOL_TLS, direction, &crypto_info, crypto_info_size);
+
+    struct s2n_blob crypto_info_blob = {.data = (uint8_t *) &crypto_info,.size = sizeof(crypto_info) };
+    GUARD(s2n_blob_zero(&crypto_info_blob));
+
+    return r;
+}
+
+static int s2n_ktls_install(struct s2n_connection *conn, int fd)
+{
+    const struct s2n_cipher *cipher = conn->secure.cipher_suite->record_alg->cipher;
+
+    /* The keys aren't kept around once they're loaded into the cipher contexts, so derive them again */
+    uint8_t key_block[S2N_MAX_KEY_BLOCK_LEN];
+    struct s2n_blob key_block_blob = {.data = key_block,.size = sizeof(key_block) };
+    GUARD(s2n_prf_key_block(conn, &key_block_blob));
+
+    /* The key block is laid out as client MAC key, server MAC key, client key, server key */
+    uint8_t mac_size;
+    GUARD(s2n_hmac_digest_size(conn->secure.cipher_suite->record_alg->hmac_alg, &mac_size));
+    uint8_t *client_key = key_block + 2 * mac_size;
+    uint8_t *server_key = client_key + cipher->key_material_size;
+
+    uint8_t *write_key = server_key;
+    uint8_t *write_iv = conn->secure.server_implicit_iv;
+    uint8_t *write_sequence_number = conn->secure.server_sequence_number;
+    uint8_t *read_key = client_key;
+    uint8_t *read_iv = conn->secure.client_implicit_iv;
+    uint8_t *read_sequence_number = conn->secure.client_sequence_number;
+    if (conn->mode == S2N_CLIENT) {
+        write_key = client_key;
+        write_iv = conn->secure.client_implicit_iv;
+        write_sequence_number = conn->secure.client_sequence_number;
+        read_key = server_key;
+        read_iv = conn->secure.server_implicit_iv;
+        read_sequence_number = conn->secure.server_sequence_number;
+    }
+
+    /* Records s2n has already encrypted must reach the socket before the kernel starts adding its own */
+    if (!conn->ktls_send_enabled && s2n_stuffer_data_available(&conn->out) == 0
+            && s2n_ktls_set_crypto_info(fd, TLS_TX, cipher, write_key, write_iv, write_sequence_number) == 0) {
+        conn->ktls_send_enabled = 1;
+        conn->send_reserved_size = 0;
+    }
+
+    /* Likewise, anything s2n has already read off the socket has to be decrypted by s2n */
+    if (!conn->ktls_recv_enabled && conn->in_status == ENCRYPTED && s2n_peek_buffered(conn) == 0
+            && s2n_ktls_set_crypto_info(fd, TLS_RX, cipher, read_key, read_iv, read_sequence_number) == 0) {
+        conn->ktls_recv_enabled = 1;
+    }
+
+    GUARD(s2n_blob_zero(&key_block_blob));
+
+    return 0;
+}
+
+static int s2n_ktls_write_fd(struct s2n_connection *conn)
+{
+    return ((struct s2n_socket_write_io_context *) conn->send_io_context)->fd;
+}
+
+static int s2n_ktls_read_fd(struct s2n_connection *conn)
+{
+    return ((struct s2n_socket_read_io_context *) conn->recv_io_context)->fd;
+}
+
+#endif /* S2N_KTLS_SUPPORTED */
+
+int s2n_ktls_enable(struct s2n_connection *conn)
+{
+    notnull_check(conn);
+
+#if S2N_KTLS_SUPPORTED
+    /* The kernel only needs s2n's sockets, not any I/O callbacks the application has installed */
+    if (!conn->managed_io || conn->send != s2n_socket_write || conn->recv != s2n_socket_read) {
+        return 0;
+    }
+
+    int fd = s2n_ktls_write_fd(conn);
+    if (fd != s2n_ktls_read_fd(conn)) {
+        return 0;
+    }
+
+    /* TLS1.3 record protection is left to s2n for now */
+    if (conn->actual_protocol_version != S2N_TLS12 || !s2n_ktls_supports_cipher(conn->secure.cipher_suite->record_alg->cipher)) {
+        return 0;
+    }
+
+    /* This fails if the kernel was built without TLS support or the tls module can't be loaded */
+    if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0 && errno != EEXIST) {
+        return 0;
+    }
+
+    GUARD(s2n_ktls_install(conn, fd));
+#endif
+
+    return 0;
+}
+
+ssize_t s2n_ktls_sendv_with_offset(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, ssize_t offs, s2n_blocked_status *blocked)
+{
+#if S2N_KTLS_SUPPORTED
+    struct iovec iov[S2N_KTLS_MAX_IOVECS];
+    ssize_t total = 0;
+
+    *blocked = S2N_BLOCKED_ON_WRITE;
+
+    while (1) {
+        /* Gather the next batch of buffers, skipping over what has already been sent */
+        ssize_t skip = offs + total;
+        int iov_count = 0;
+        for (ssize_t i = 0; i < count && iov_count < S2N_KTLS_MAX_IOVECS; i++) {
+            if (skip >= (ssize_t) bufs[i].iov_len) {
+                skip -= bufs[i].iov_len;
+                continue;
+            }
+            iov[iov_count].iov_base = (uint8_t *) bufs[i].iov_base + skip;
+            iov[iov_count].iov_len = bufs[i].iov_len - skip;
+            iov_count++;
+            skip = 0;
+        }
+
+        if (iov_count == 0) {
+            break;
+        }
+
+        errno = 0;
+        uint64_t io_start;
+        GUARD(s2n_perf_start(conn, &io_start));
+        ssize_t w = writev(s2n_ktls_write_fd(conn), iov, iov_count);
+        GUARD(s2n_perf_io(conn, io_start, w < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)));
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                /* As with s2n_sendv, data that reached the socket counts as sent */
+                if (total) {
+                    return total;
+                }
+                S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
+            }
+            S2N_ERROR(S2N_ERR_IO);
+        }
+
+        conn->wire_bytes_out += w;
+        total += w;
+    }
+
+    *blocked = S2N_NOT_BLOCKED;
+
+    return total;
+#else
+    S2N_ERROR(S2N_ERR_UNIMPLEMENTED);
+#endif
+}
+
+ssize_t s2n_ktls_sendfile(struct s2n_connection *conn, int fd, off_t offset, size_t count, s2n_blocked_status *blocked)
+{
+#if S2N_KTLS_SUPPORTED
+    off_t start = offset;
+
+    *blocked = S2N_BLOCKED_ON_WRITE;
+
+    while (offset - start < count) {
+        errno = 0;
+        uint64_t io_start;
+        GUARD(s2n_perf_start(conn, &io_start));
+        ssize_t w = sendfile(s2n_ktls_write_fd(conn), fd, &offset, count - (offset - start));
+        GUARD(s2n_perf_io(conn, io_start, w < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)));
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                if (offset > start) {
+                    return offset - start;
+                }
+                S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
+            }
+            S2N_ERROR(S2N_ERR_IO);
+        }
+
+        /* The file is shorter than we were asked to send */
+        S2N_ERROR_IF(w == 0, S2N_ERR_SEND_SIZE);
+        conn->wire_bytes_out += w;
+    }
+
+    *blocked = S2N_NOT_BLOCKED;
+
+    return count;
+#else
+    S2N_ERROR(S2N_ERR_UNIMPLEMENTED);
+#endif
+}
+
+int s2n_ktls_send_alert(struct s2n_connection *conn, struct s2n_blob *alert)
+{
+#if S2N_KTLS_SUPPORTED
+    uint8_t control[CMSG_SPACE(sizeof(uint8_t))] = { 0 };
+    struct iovec iov = {.iov_base = alert->data,.iov_len = alert->size };
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    /* Anything written without a record type is sent as application data */
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint8_t));
+    *CMSG_DATA(cmsg) = TLS_ALERT;
+
+    ssize_t w;
+    do {
+        errno = 0;
+        uint64_t io_start;
+        GUARD(s2n_perf_start(conn, &io_start));
+        w = sendmsg(s2n_ktls_write_fd(conn), &msg, 0);
+        GUARD(s2n_perf_io(conn, io_start, w < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)));
+    } while (w < 0 && errno == EINTR);
+
+    if (w < 0) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN) {
+            S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
+        }
+        S2N_ERROR(S2N_ERR_IO);
+    }
+    eq_check(w, alert->size);
+    conn->wire_bytes_out += w;
+
+    return 0;
+#else
+    S2N_ERROR(S2N_ERR_UNIMPLEMENTED);
+#endif
+}
+
+int s2n_ktls_read_full_record(struct s2n_connection *conn, uint8_t *record_type, struct s2n_blob *direct)
+{
+#if S2N_KTLS_SUPPORTED
+    uint8_t *buf;
+    uint32_t len;
+
+    /* Application data can go straight to the caller, anything else is handled from conn->in */
+    const int into_caller = direct && direct->size;
+    if (into_caller) {
+        buf = direct->data;
+        len = direct->size;
+    } else {
+        GUARD(s2n_connection_lease_buffer(conn, &conn->in, S2N_LARGE_FRAGMENT_LENGTH));
+        buf = conn->in.blob.data + conn->in.write_cursor;
+        len = s2n_stuffer_space_remaining(&conn->in);
+    }
+
+    uint8_t control[CMSG_SPACE(sizeof(uint8_t))] = { 0 };
+    struct iovec iov = {.iov_base = buf,.iov_len = len };
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t r;
+    do {
+        errno = 0;
+        uint64_t io_start;
+        GUARD(s2n_perf_start(conn, &io_start));
+        r = recvmsg(s2n_ktls_read_fd(conn), &msg, 0);
+        GUARD(s2n_perf_io(conn, io_start, r < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)));
+    } while (r < 0 && errno == EINTR);
+
+    if (r == 0) {
+        conn->closed = 1;
+        S2N_ERROR(S2N_ERR_CLOSED);
+    } else if (r < 0) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN) {
+            S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
+        }
+        if (errno == EBADMSG) {
+            /* The record failed authentication */
+            GUARD(s2n_connection_kill(conn));
+            S2N_ERROR(S2N_ERR_DECRYPT);
+        }
+        S2N_ERROR(S2N_ERR_IO);
+    }
+    conn->wire_bytes_in += r;
+
+    /* The kernel never mixes record types in a single read */
+    *record_type = TLS_APPLICATION_DATA;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_TLS && cmsg->cmsg_type == TLS_GET_RECORD_TYPE) {
+        *record_type = *CMSG_DATA(cmsg);
+    }
+
+    if (!into_caller) {
+        GUARD(s2n_stuffer_skip_write(&conn->in, r));
+        conn->in_status = PLAINTEXT;
+        if (direct) {
+            direct->size = 0;
+        }
+        return 0;
+    }
+
+    if (*record_type == TLS_APPLICATION_DATA) {
+        direct->size = r;
+        return 0;
+    }
+
+    /* A control record landed in the caller's buffer. Move it to conn->in where the
+     * alert handling expects it, and don't leave it behind.
+     */
+    struct s2n_blob control_record = {.data = buf,.size = r };
+    GUARD(s2n_connection_lease_buffer(conn, &conn->in, S2N_LARGE_FRAGMENT_LENGTH));
+    GUARD(s2n_stuffer_write(&conn->in, &control_record));
+    GUARD(s2n_blob_zero(&control_record));
+    conn->in_status = PLAINTEXT;
+    direct->size = 0;
+
+    return 0;
+#else
+    S2N_ERROR(S2N_ERR_UNIMPLEMENTED);
+#endif
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <s2n.h>
+
+#include "tls/s2n_connection.h"
+
+#include "utils/s2n_blob.h"
+
+/* Hands record protection for the connection over to the kernel, for
+ * whichever directions it can. Failure to offload is not an error, the
+ * connection carries on with s2n doing the record layer itself.
+ */
+extern int s2n_ktls_enable(struct s2n_connection *conn);
+
+extern ssize_t s2n_ktls_sendv_with_offset(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, ssize_t offs, s2n_blocked_status *blocked);
+extern ssize_t s2n_ktls_sendfile(struct s2n_connection *conn, int fd, off_t offset, size_t count, s2n_blocked_status *blocked);
+extern int s2n_ktls_send_alert(struct s2n_connection *conn, struct s2n_blob *alert);
+extern int s2n_ktls_read_full_record(struct s2n_connection *conn, uint8_t *record_type, struct s2n_blob *direct);
@@ -0,0 +1,343 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <s2n.h>
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_cipher_suites.h"
+#include "tls/s2n_config.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_perf.h"
+
+#include "utils/s2n_blob.h"
+#include "utils/s2n_mem.h"
+#include "utils/s2n_safety.h"
+
+/* Every thread counts into a block of its own, with a bucket for each cipher
+ * suite and a last one for connections that haven't negotiated a suite yet.
+ * A block only ever has one writer, so it is updated with plain relaxed loads
+ * and stores, and readers add the blocks up without taking a lock. A thread
+ * that cleans up gives its block back, and the next thread to need one carries
+ * on counting in it, so nothing that was counted is lost. Blocks are only
+ * freed by s2n_perf_cleanup().
+ *
+ * Connection counters can be updated by a reader and a writer thread at the
+ * same time, so they use atomic adds instead.
+ */
+#define S2N_PERF_MAX_CIPHER_SUITES  64
+#define S2N_PERF_NO_CIPHER_SUITE    S2N_PERF_MAX_CIPHER_SUITES
+#define S2N_PERF_BUCKETS            (S2N_PERF_MAX_CIPHER_SUITES + 1)
+
+struct s2n_perf_block {
+    struct s2n_perf_counters buckets[S2N_PERF_BUCKETS];
+    struct s2n_perf_block *next;
+    int in_use;
+};
+
+static struct s2n_perf_block *perf_blocks = NULL;
+static __thread struct s2n_perf_block *perf_block = NULL;
+
+#define S2N_PERF_COUNTER_FIELDS (sizeof(struct s2n_perf_counters) / sizeof(uint64_t))
+
+#define S2N_PERF_COUNT(conn, counters, field, value) do {                                   \
+        __atomic_fetch_add(&(conn)->perf.stats.counters.field, (value), __ATOMIC_RELAXED);  \
+        s2n_perf_add(&(counters)->field, (value));                                          \
+    } while (0)
+
+static inline int s2n_perf_enabled(struct s2n_connection *conn)
+{
+    return conn->config && conn->config->perf_counters;
+}
+
+static inline void s2n_perf_add(uint64_t *counter, uint64_t value)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static int s2n_perf_now(struct s2n_connection *conn, uint64_t *now)
+{
+    GUARD(conn->config->monotonic_clock(conn->config->monotonic_clock_ctx, now));
+
+    return 0;
+}
+
+static int s2n_perf_block_claim(void)
+{
+    /* Take over a block some other thread has given back */
+    for (struct s2n_perf_block *block = __atomic_load_n(&perf_blocks, __ATOMIC_ACQUIRE); block; block = block->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&block->in_use, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            perf_block = block;
+            return 0;
+        }
+    }
+
+    struct s2n_blob mem = {0};
+    GUARD(s2n_alloc(&mem, sizeof(struct s2n_perf_block)));
+    GUARD(s2n_blob_zero(&mem));
+
+    struct s2n_perf_block *block = (struct s2n_perf_block *)(void *) mem.data;
+    block->in_use = 1;
+    block->next = __atomic_load_n(&perf_blocks, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&perf_blocks, &block->next, block, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    perf_block = block;
+
+    return 0;
+}
+
+/* Finds the calling thread's counters for the connection's cipher suite */
+static int s2n_perf_thread_counters(struct s2n_connection *conn, struct s2n_perf_counters **counters)
+{
+    if (perf_block == NULL) {
+        GUARD(s2n_perf_block_claim());
+    }
+
+    if (conn->perf.cipher_suite != conn->secure.cipher_suite) {
+        int index = s2n_cipher_suite_get_index(conn->secure.cipher_suite);
+        conn->perf.bucket = (index < 0 || index >= S2N_PERF_MAX_CIPHER_SUITES) ? S2N_PERF_NO_CIPHER_SUITE : index;
+        conn->perf.cipher_suite = conn->secure.cipher_suite;
+    }
+
+    *counters = &perf_block->buckets[conn->perf.bucket];
+
+    return 0;
+}
+
+int s2n_perf_start(struct s2n_connection *conn, uint64_t *start)
+{
+    *start = 0;
+
+    if (s2n_perf_enabled(conn)) {
+        GUARD(s2n_perf_now(conn, start));
+    }
+
+    return 0;
+}
+
+int s2n_perf_io(struct s2n_connection *conn, uint64_t start, uint8_t blocked)
+{
+    if (!s2n_perf_enabled(conn)) {
+        return 0;
+    }
+
+    /* The caller still has to look at errno from the I/O callback */
+    int saved_errno = errno;
+
+    uint64_t now;
+    struct s2n_perf_counters *counters;
+    GUARD(s2n_perf_now(conn, &now));
+    GUARD(s2n_perf_thread_counters(conn, &counters));
+
+    S2N_PERF_COUNT(conn, counters, io_calls, 1);
+    S2N_PERF_COUNT(conn, counters, io_ns, now - start);
+    if (blocked) {
+        S2N_PERF_COUNT(conn, counters, io_blocked, 1);
+    }
+
+    errno = saved_errno;
+
+    return 0;
+}
+
+int s2n_perf_record_in(struct s2n_connection *conn, const struct s2n_cipher_suite *cipher_suite, uint64_t start, uint32_t bytes)
+{
+    if (!s2n_perf_enabled(conn)) {
+        return 0;
+    }
+
+    struct s2n_perf_counters *counters;
+    GUARD(s2n_perf_thread_counters(conn, &counters));
+    S2N_PERF_COUNT(conn, counters, records_in, 1);
+
+    /* Records before the first change of cipher spec aren't protected */
+    if (cipher_suite != &s2n_null_cipher_suite) {
+        uint64_t now;
+        GUARD(s2n_perf_now(conn, &now));
+        S2N_PERF_COUNT(conn, counters, record_crypto_ns, now - start);
+        S2N_PERF_COUNT(conn, counters, bytes_decrypted, bytes);
+    }
+
+    return 0;
+}
+
+int s2n_perf_record_out(struct s2n_connection *conn, const struct s2n_cipher_suite *cipher_suite, uint64_t start, uint32_t bytes)
+{
+    if (!s2n_perf_enabled(conn)) {
+        return 0;
+    }
+
+    struct s2n_perf_counters *counters;
+    GUARD(s2n_perf_thread_counters(conn, &counters));
+    S2N_PERF_COUNT(conn, counters, records_out, 1);
+
+    if (cipher_suite != &s2n_null_cipher_suite) {
+        uint64_t now;
+        GUARD(s2n_perf_now(conn, &now));
+        S2N_PERF_COUNT(conn, counters, record_crypto_ns, now - start);
+        S2N_PERF_COUNT(conn, counters, bytes_encrypted, bytes);
+    }
+
+    return 0;
+}
+
+int s2n_perf_handshake_begin(struct s2n_connection *conn)
+{
+    if (!s2n_perf_enabled(conn) || conn->perf.handshake_started) {
+        return 0;
+    }
+
+    GUARD(s2n_perf_now(conn, &conn->perf.handshake_start));
+    conn->perf.handshake_started = 1;
+
+    return 0;
+}
+
+int s2n_perf_handshake_handler(struct s2n_connection *conn, uint64_t start)
+{
+    if (!s2n_perf_enabled(conn)) {
+        return 0;
+    }
+
+    uint64_t now;
+    struct s2n_perf_counters *counters;
+    GUARD(s2n_perf_now(conn, &now));
+    GUARD(s2n_perf_thread_counters(conn, &counters));
+
+    S2N_PERF_COUNT(conn, counters, handshake_handler_ns, now - start);
+
+    return 0;
+}
+
+int s2n_perf_handshake_message(struct s2n_connection *conn, const char *message)
+{
+    if (!s2n_perf_enabled(conn) || !conn->perf.handshake_started) {
+        return 0;
+    }
+
+    struct s2n_connection_perf_stats *stats = &conn->perf.stats;
+    if (stats->handshake_message_count == S2N_PERF_MAX_HANDSHAKE_MESSAGES) {
+        return 0;
+    }
+
+    uint64_t now;
+    GUARD(s2n_perf_now(conn, &now));
+
+    stats->handshake_messages[stats->handshake_message_count].message = message;
+    stats->handshake_messages[stats->handshake_message_count].elapsed_ns = now - conn->perf.handshake_start;
+    stats->handshake_message_count++;
+
+    return 0;
+}
+
+int s2n_perf_handshake_done(struct s2n_connection *conn)
+{
+    if (!s2n_perf_enabled(conn) || !conn->perf.handshake_started) {
+        return 0;
+    }
+
+    uint64_t now;
+    struct s2n_perf_counters *counters;
+    GUARD(s2n_perf_now(conn, &now));
+    GUARD(s2n_perf_thread_counters(conn, &counters));
+
+    S2N_PERF_COUNT(conn, counters, handshakes, 1);
+    S2N_PERF_COUNT(conn, counters, handshake_ns, now - conn->perf.handshake_start);
+
+    return 0;
+}
+
+int s2n_connection_get_perf_stats(struct s2n_connection *conn, struct s2n_connection_perf_stats *stats)
+{
+    notnull_check(conn);
+    notnull_check(stats);
+
+    *stats = conn->perf.stats;
+
+    return 0;
+}
+
+/* Adds one bucket of every thread's counters, or all of them if bucket is negative */
+static int s2n_perf_sum(int bucket, struct s2n_perf_counters *counters)
+{
+    uint64_t *total = (uint64_t *)(void *) counters;
+
+    *counters = (struct s2n_perf_counters) {0};
+
+    for (struct s2n_perf_block *block = __atomic_load_n(&perf_blocks, __ATOMIC_ACQUIRE); block; block = block->next) {
+        for (int i = 0; i < S2N_PERF_BUCKETS; i++) {
+            if (bucket >= 0 && i != bucket) {
+                continue;
+            }
+
+            uint64_t *counter = (uint64_t *)(void *) &block->buckets[i];
+            for (int j = 0; j < S2N_PERF_COUNTER_FIELDS; j++) {
+                total[j] += __atomic_load_n(&counter[j], __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    return 0;
+}
+
+int s2n_perf_get_stats(struct s2n_perf_counters *counters)
+{
+    notnull_check(counters);
+
+    GUARD(s2n_perf_sum(-1, counters));
+
+    return 0;
+}
+
+int s2n_perf_get_cipher_suite_stats(const char *cipher_suite, struct s2n_perf_counters *counters)
+{
+    notnull_check(cipher_suite);
+    notnull_check(counters);
+
+    int index = s2n_cipher_suite_get_index_by_name(cipher_suite);
+    S2N_ERROR_IF(index < 0 || index >= S2N_PERF_MAX_CIPHER_SUITES, S2N_ERR_CIPHER_NOT_SUPPORTED);
+
+    GUARD(s2n_perf_sum(index, counters));
+
+    return 0;
+}
+
+int s2n_perf_cleanup_thread(void)
+{
+    if (perf_block) {
+        __atomic_store_n(&perf_block->in_use, 0, __ATOMIC_RELEASE);
+        perf_block = NULL;
+    }
+
+    return 0;
+}
+
+int s2n_perf_cleanup(void)
+{
+    struct s2n_perf_block *block = __atomic_exchange_n(&perf_blocks, NULL, __ATOMIC_ACQ_REL);
+    perf_block = NULL;
+
+    while (block) {
+        struct s2n_perf_block *next = block->next;
+        GUARD(s2n_free_object((uint8_t **) &block, sizeof(struct s2n_perf_block)));
+        block = next;
+    }
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <s2n.h>
+
+struct s2n_connection;
+struct s2n_cipher_suite;
+
+/* Performance counters kept on each connection. They are zeroed along with the
+ * rest of the connection when it is wiped.
+ */
+struct s2n_connection_perf {
+    struct s2n_connection_perf_stats stats;
+    uint64_t handshake_start;
+    /* The cipher suite the calling thread's counters were last looked up for */
+    const struct s2n_cipher_suite *cipher_suite;
+    uint32_t bucket;
+    unsigned handshake_started:1;
+};
+
+/* Each of these does nothing unless the connection's config has performance
+ * counters enabled. A start time taken with s2n_perf_start() is handed to the
+ * function that accounts for the work once it is done.
+ */
+extern int s2n_perf_start(struct s2n_connection *conn, uint64_t *start);
+extern int s2n_perf_io(struct s2n_connection *conn, uint64_t start, uint8_t blocked);
+extern int s2n_perf_record_in(struct s2n_connection *conn, const struct s2n_cipher_suite *cipher_suite, uint64_t start, uint32_t bytes);
+extern int s2n_perf_record_out(struct s2n_connection *conn, const struct s2n_cipher_suite *cipher_suite, uint64_t start, uint32_t bytes);
+extern int s2n_perf_handshake_begin(struct s2n_connection *conn);
+extern int s2n_perf_handshake_handler(struct s2n_connection *conn, uint64_t start);
+extern int s2n_perf_handshake_message(struct s2n_connection *conn, const char *message);
+extern int s2n_perf_handshake_done(struct s2n_connection *conn);
+
+/* Gives the calling thread's counters back for another thread to carry on with */
+extern int s2n_perf_cleanup_thread(void);
+/* Frees every thread's counters, once no thread will count anything else */
+extern int s2n_perf_cleanup(void);
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <sys/param.h>
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_buffer_pool.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_post_handshake.h"
+#include "tls/s2n_tls.h"
+
+#include "stuffer/s2n_stuffer.h"
+
+#include "utils/s2n_safety.h"
+
+/* From RFC 8446: https://tools.ietf.org/html/rfc8446#appendix-B.3 */
+#define TLS_SERVER_NEW_SESSION_TICKET  4
+
+static int s2n_post_handshake_message_recv(struct s2n_connection *conn, uint8_t message_type)
+{
+    switch (message_type) {
+    case TLS_SERVER_NEW_SESSION_TICKET:
+        S2N_ERROR_IF(conn->mode != S2N_CLIENT, S2N_ERR_BAD_MESSAGE);
+        GUARD(s2n_tls13_server_nst_recv(conn));
+        break;
+    default:
+        /* KeyUpdate and post-handshake authentication aren't supported, so those messages are skipped */
+        GUARD(s2n_stuffer_skip_read(&conn->handshake.io, s2n_stuffer_data_available(&conn->handshake.io)));
+        break;
+    }
+
+    return 0;
+}
+
+/*
+ * Handles the handshake messages in a record read after the handshake. A message can be
+ * fragmented across records, so the fragments are kept in conn->handshake.io until the
+ * whole message is there, the same way they are during the handshake.
+ */
+int s2n_post_handshake_recv(struct s2n_connection *conn)
+{
+    struct s2n_stuffer *message = &conn->handshake.io;
+
+    /* The handshake buffer was released at the end of the handshake */
+    GUARD(s2n_connection_lease_buffer(conn, message, S2N_LARGE_RECORD_LENGTH));
+
+    while (s2n_stuffer_data_available(&conn->in)) {
+        uint32_t buffered = s2n_stuffer_data_available(message);
+        if (buffered < TLS_HANDSHAKE_HEADER_LENGTH) {
+            uint32_t bytes_to_take = MIN(TLS_HANDSHAKE_HEADER_LENGTH - buffered, s2n_stuffer_data_available(&conn->in));
+            GUARD(s2n_stuffer_copy(&conn->in, message, bytes_to_take));
+            continue;
+        }
+
+        uint8_t message_type;
+        uint32_t message_length;
+        GUARD(s2n_handshake_parse_header(conn, &message_type, &message_length));
+        S2N_ERROR_IF(message_length > S2N_MAXIMUM_HANDSHAKE_MESSAGE_LENGTH, S2N_ERR_BAD_MESSAGE);
+
+        uint32_t bytes_to_take = MIN(message_length - s2n_stuffer_data_available(message), s2n_stuffer_data_available(&conn->in));
+        GUARD(s2n_stuffer_copy(&conn->in, message, bytes_to_take));
+
+        if (s2n_stuffer_data_available(message) < message_length) {
+            /* Wait for the rest of the message in the next record */
+            GUARD(s2n_stuffer_reread(message));
+            break;
+        }
+
+        GUARD(s2n_post_handshake_message_recv(conn, message_type));
+        GUARD(s2n_stuffer_wipe(message));
+    }
+
+    /* Only a partial message keeps the buffer */
+    if (s2n_stuffer_data_available(message) == 0) {
+        if (conn->dynamic_buffers) {
+            GUARD(s2n_buffer_pool_return(message));
+        } else {
+            GUARD(s2n_stuffer_resize(message, 0));
+        }
+    }
+
+    return 0;
+}
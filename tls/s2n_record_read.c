@@ -26,6 +26,8 @@
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_connection.h"
 #include "tls/s2n_crypto.h"
+#include "tls/s2n_perf.h"
+#include "tls/s2n_record.h"
 #include "tls/s2n_record_read.h"
 
 #include "utils/s2n_safety.h"
@@ -93,7 +95,7 @@ int s2n_record_header_parse(
     return 0;
 }
 
-int s2n_record_parse(struct s2n_connection *conn)
+static int s2n_record_parse_internal(struct s2n_connection *conn, struct s2n_blob *out)
 {
     uint8_t content_type;
     uint16_t encrypted_length;
@@ -103,8 +105,10 @@ int s2n_record_parse(struct s2n_connection *conn)
     struct s2n_crypto_parameters *current_client_crypto = conn->client;
     struct s2n_crypto_parameters *current_server_crypto = conn->server;
     if (conn->actual_protocol_version == S2N_TLS13 && content_type == TLS_CHANGE_CIPHER_SPEC) {
-        conn->client = &conn->initial;
-        conn->server = &conn->initial;
+        /* The initial parameters are gone along with the handshake arena */
+        S2N_ERROR_IF(conn->initial == NULL, S2N_ERR_BAD_MESSAGE);
+        conn->client = conn->initial;
+        conn->server = conn->initial;
     }
 
     const struct s2n_cipher_suite *cipher_suite = conn->client->cipher_suite;
@@ -126,9 +130,15 @@ int s2n_record_parse(struct s2n_connection *conn)
         conn->server = current_server_crypto;
     }
 
+    /* Only AEAD ciphers can decrypt into a separate buffer */
+    S2N_ERROR_IF(out && cipher_suite->record_alg->cipher->type != S2N_AEAD, S2N_ERR_CIPHER_TYPE);
+
+    uint64_t crypto_start;
+    GUARD(s2n_perf_start(conn, &crypto_start));
+
     switch (cipher_suite->record_alg->cipher->type) {
     case S2N_AEAD:
-        GUARD(s2n_record_parse_aead(cipher_suite, conn, content_type, encrypted_length, implicit_iv, mac, sequence_number, session_key));
+        GUARD(s2n_record_parse_aead_into(cipher_suite, conn, content_type, encrypted_length, implicit_iv, mac, sequence_number, session_key, out));
         break;
     case S2N_CBC:
         GUARD(s2n_record_parse_cbc(cipher_suite, conn, content_type, encrypted_length, implicit_iv, mac, sequence_number, session_key));
@@ -144,5 +154,64 @@ int s2n_record_parse(struct s2n_connection *conn)
         break;
     }
 
+    GUARD(s2n_perf_record_in(conn, cipher_suite, crypto_start, encrypted_length));
+
+    return 0;
+}
+
+int s2n_record_parse(struct s2n_connection *conn)
+{
+    return s2n_record_parse_internal(conn, NULL);
+}
+
+int s2n_record_can_parse_into(struct s2n_connection *conn, uint32_t size)
+{
+    uint8_t content_type;
+    uint16_t encrypted_length;
+    GUARD(s2n_record_header_parse(conn, &content_type, &encrypted_length));
+
+    /* TLS 1.3 hides the real content type inside the encrypted record, so we can't tell
+     * whether it is application data until it has been decrypted.
+     */
+    if (content_type != TLS_APPLICATION_DATA || conn->actual_protocol_version >= S2N_TLS13) {
+        return 0;
+    }
+
+    const struct s2n_cipher_suite *cipher_suite = (conn->mode == S2N_CLIENT) ? conn->server->cipher_suite : conn->client->cipher_suite;
+    const struct s2n_cipher *cipher = cipher_suite->record_alg->cipher;
+    if (cipher->type != S2N_AEAD) {
+        return 0;
+    }
+
+    uint32_t overhead = cipher->io.aead.record_iv_size + cipher->io.aead.tag_size;
+    return encrypted_length > overhead && encrypted_length - overhead <= size;
+}
+
+int s2n_record_parse_into(struct s2n_connection *conn, struct s2n_blob *out)
+{
+    notnull_check(out);
+
+    return s2n_record_parse_internal(conn, out);
+}
+
+int s2n_tls13_parse_record_type(struct s2n_stuffer *stuffer, uint8_t *record_type)
+{
+    uint32_t plaintext_length = s2n_stuffer_data_available(stuffer);
+    uint8_t *plaintext = s2n_stuffer_raw_read(stuffer, 0);
+    notnull_check(plaintext);
+
+    /* The real content type is the last non-zero byte of the plaintext, anything after it is padding
+     * https://tools.ietf.org/html/rfc8446#section-5.4
+     */
+    while (plaintext_length > 0 && plaintext[plaintext_length - 1] == 0) {
+        plaintext_length--;
+    }
+    S2N_ERROR_IF(plaintext_length == 0, S2N_ERR_BAD_MESSAGE);
+
+    *record_type = plaintext[plaintext_length - 1];
+
+    /* Drop the content type and the padding so the rest of the record reads like < TLS 1.3 */
+    GUARD(s2n_stuffer_wipe_n(stuffer, s2n_stuffer_data_available(stuffer) - plaintext_length + 1));
+
     return 0;
 }
@@ -40,6 +40,23 @@ int s2n_record_parse_aead(
     struct s2n_hmac_state *mac,
     uint8_t * sequence_number,
     struct s2n_session_key *session_key)
+{
+    return s2n_record_parse_aead_into(cipher_suite, conn, content_type, encrypted_length, implicit_iv, mac, sequence_number, session_key, NULL);
+}
+
+/* Decrypts the record in conn->in. If out is NULL the plaintext is left in conn->in for the caller to
+ * read, otherwise it is written straight to out and out->size is set to the plaintext length.
+ */
+int s2n_record_parse_aead_into(
+    const struct s2n_cipher_suite *cipher_suite,
+    struct s2n_connection *conn,
+    uint8_t content_type,
+    uint16_t encrypted_length,
+    uint8_t * implicit_iv,
+    struct s2n_hmac_state *mac,
+    uint8_t * sequence_number,
+    struct s2n_session_key *session_key,
+    struct s2n_blob *out)
 {
     const int is_tls13_record = cipher_suite->record_alg->flags & S2N_TLS13_RECORD_AEAD_NONCE;
     /* TLS 1.3 record protection uses a different 5 byte associated data than TLS 1.2's */
@@ -104,10 +121,33 @@ int s2n_record_parse_aead(
     /* Check that we have some data to decrypt */
     ne_check(en.size, 0);
 
-    GUARD(cipher_suite->record_alg->cipher->io.aead.decrypt(session_key, &iv, &aad, &en, &en));
+    if (out == NULL) {
+        GUARD(cipher_suite->record_alg->cipher->io.aead.decrypt(session_key, &iv, &aad, &en, &en));
+    } else {
+        gte_check(out->size, payload_length);
+        struct s2n_blob plaintext = {.data = out->data,.size = payload_length };
+        if (cipher_suite->record_alg->cipher->io.aead.decrypt(session_key, &iv, &aad, &en, &plaintext) < 0) {
+            /* Don't leave unauthenticated plaintext behind in the caller's buffer */
+            GUARD(s2n_blob_zero(&plaintext));
+            S2N_ERROR_PRESERVE_ERRNO();
+        }
+    }
     struct s2n_blob seq = {.data = sequence_number,.size = S2N_TLS_SEQUENCE_NUM_LEN };
     GUARD(s2n_increment_sequence_number(&seq));
 
+    if (out != NULL) {
+        out->size = payload_length;
+
+        /* conn->in only ever held ciphertext, so it can be reused without erasing it. Nothing
+         * refers to the raw read any more, so the stuffer can be resized again too.
+         */
+        GUARD(s2n_stuffer_rewrite(&conn->in));
+        conn->in.tainted = 0;
+        GUARD(s2n_stuffer_wipe(&conn->header_in));
+
+        return 0;
+    }
+
     /* O.k., we've successfully read and decrypted the record, now we need to align the stuffer
      * for reading the plaintext data.
      */
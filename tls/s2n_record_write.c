@@ -20,6 +20,7 @@
 
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_connection.h"
+#include "tls/s2n_perf.h"
 #include "tls/s2n_record.h"
 #include "tls/s2n_crypto.h"
 
@@ -35,6 +36,12 @@
 
 #define TLS13_CONTENT_TYPE_LENGTH 1
 
+/* CBC payloads are MACed and encrypted this many bytes at a time. Small enough
+ * that a chunk is still in L1 when it is encrypted, and a multiple of every
+ * CBC block size we support.
+ */
+#define S2N_CBC_STITCH_CHUNK_SIZE 2048
+
 extern uint8_t s2n_unknown_protocol_version;
 
 /* How much overhead does the IV, MAC, TAG and padding bytes introduce ? */
@@ -101,14 +108,48 @@ int s2n_record_min_write_payload_size(struct s2n_connection *conn)
     return s2n_record_rounded_write_payload_size(conn, min_outgoing_fragement_length);
 }
 
+int s2n_record_write_payload_offset(struct s2n_connection *conn)
+{
+    struct s2n_crypto_parameters *active = conn->server;
+
+    if (conn->mode == S2N_CLIENT) {
+        active = conn->client;
+    }
+
+    /* The plaintext follows the record header and any explicit IV */
+    int offset = S2N_TLS_RECORD_HEADER_LENGTH;
+    switch (active->cipher_suite->record_alg->cipher->type) {
+    case S2N_AEAD:
+        if (active->cipher_suite->record_alg->flags & S2N_TLS12_AES_GCM_AEAD_NONCE) {
+            offset += S2N_TLS_SEQUENCE_NUM_LEN;
+        }
+        break;
+    case S2N_CBC:
+        if (conn->actual_protocol_version > S2N_TLS10) {
+            offset += active->cipher_suite->record_alg->cipher->io.cbc.block_size;
+        }
+        break;
+    case S2N_COMPOSITE:
+        if (conn->actual_protocol_version > S2N_TLS10) {
+            offset += active->cipher_suite->record_alg->cipher->io.comp.block_size;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return offset;
+}
+
 int s2n_record_write_protocol_version(struct s2n_connection *conn)
 {
     uint8_t record_protocol_version = conn->actual_protocol_version;
-    if (conn->server_protocol_version == s2n_unknown_protocol_version) {
+    if (conn->server_protocol_version == s2n_unknown_protocol_version && conn->client == conn->initial) {
         /* Some legacy TLS implementations can't handle records with protocol version higher than TLS1.0.
          * To provide maximum compatibility, send record version as TLS1.0 if server protocol version isn't
          * established yet, which happens only during ClientHello message. Note, this has no effect on
-         * protocol version in ClientHello, so we're still able to negotiate protocol versions above TLS1.0 */
+         * protocol version in ClientHello, so we're still able to negotiate protocol versions above TLS1.0.
+         * Early data is already protected, and only goes to TLS1.3 servers. */
         record_protocol_version = MIN(record_protocol_version, S2N_TLS10);
     }
 
@@ -169,19 +210,55 @@ static inline int s2n_record_encrypt(
     return 0;
 }
 
-int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const struct iovec *in, int in_count, size_t offs, size_t to_write)
+/* MACs and encrypts the block aligned part of a CBC payload one chunk at a time,
+ * so that each chunk is read from cache by the cipher rather than making a second
+ * pass over the whole record. The chaining value is carried in iv between chunks.
+ * Whatever is left over is MACed here and encrypted later along with the MAC and
+ * padding; the number of bytes already encrypted is returned in sealed.
+ */
+static int s2n_record_write_cbc_stitched(const struct s2n_cipher *cipher, struct s2n_session_key *session_key, struct s2n_hmac_state *mac,
+                                         struct s2n_blob *iv, uint8_t *payload, uint16_t payload_size, uint16_t *sealed)
+{
+    const uint16_t block_size = cipher->io.cbc.block_size;
+    const uint16_t aligned_size = payload_size - (payload_size % block_size);
+    eq_check(iv->size, block_size);
+
+    for (uint16_t offset = 0; offset < aligned_size; ) {
+        struct s2n_blob chunk = { .data = payload + offset, .size = MIN(S2N_CBC_STITCH_CHUNK_SIZE, aligned_size - offset) };
+
+        GUARD(s2n_hmac_update(mac, chunk.data, chunk.size));
+        GUARD(cipher->io.cbc.encrypt(session_key, iv, &chunk, &chunk));
+        memcpy_check(iv->data, chunk.data + chunk.size - block_size, block_size);
+
+        offset += chunk.size;
+    }
+
+    GUARD(s2n_hmac_update(mac, payload + aligned_size, payload_size - aligned_size));
+    *sealed = aligned_size;
+
+    return 0;
+}
+
+/* Writes and encrypts a single record at the end of conn->out. If in is NULL the
+ * plaintext has already been placed at s2n_record_write_payload_offset() past the
+ * current write cursor, and is sealed where it is instead of being copied.
+ */
+static int s2n_record_writev_internal(struct s2n_connection *conn, uint8_t content_type, const struct iovec *in, int in_count, size_t offs, size_t to_write)
 {
     struct s2n_blob iv;
     uint8_t padding = 0;
     uint16_t block_size = 0;
+    uint16_t cbc_sealed = 0;
     uint8_t aad_iv[S2N_TLS_MAX_IV_LEN] = { 0 };
 
     /* In TLS 1.3, handle CCS message as unprotected records */
     struct s2n_crypto_parameters *current_client_crypto = conn->client;
     struct s2n_crypto_parameters *current_server_crypto = conn->server;
     if (conn->actual_protocol_version == S2N_TLS13 && content_type == TLS_CHANGE_CIPHER_SPEC) {
-        conn->client = &conn->initial;
-        conn->server = &conn->initial;
+        /* The initial parameters are gone along with the handshake arena */
+        notnull_check(conn->initial);
+        conn->client = conn->initial;
+        conn->server = conn->initial;
     }
 
     uint8_t *sequence_number = conn->server->server_sequence_number;
@@ -201,7 +278,11 @@ int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const s
     const int is_tls13_record = cipher_suite->record_alg->flags & S2N_TLS13_RECORD_AEAD_NONCE;
     s2n_stack_blob(aad, is_tls13_record ? S2N_TLS13_AAD_LEN : S2N_TLS_MAX_AAD_LEN, S2N_TLS_MAX_AAD_LEN);
 
-    S2N_ERROR_IF(s2n_stuffer_data_available(&conn->out), S2N_ERR_BAD_MESSAGE);
+    /* Records are appended to conn->out, so several of them can be sent with a single write. Any record
+     * moves the write cursor past a s2n_send_reserve() buffer, including the one s2n_send_commit() seals.
+     */
+    const uint32_t record_start = conn->out.write_cursor;
+    conn->send_reserved_size = 0;
 
     uint8_t mac_digest_size;
     GUARD(s2n_hmac_digest_size(mac->alg, &mac_digest_size));
@@ -223,10 +304,13 @@ int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const s
         block_size = cipher_suite->record_alg->cipher->io.comp.block_size;
     }
 
+    uint64_t crypto_start;
+    GUARD(s2n_perf_start(conn, &crypto_start));
+
     /* Start the MAC with the sequence number */
     GUARD(s2n_hmac_update(mac, sequence_number, S2N_TLS_SEQUENCE_NUM_LEN));
 
-    GUARD(s2n_stuffer_resize_if_empty(&conn->out, S2N_LARGE_RECORD_LENGTH));
+    GUARD(s2n_connection_lease_buffer(conn, &conn->out, S2N_LARGE_RECORD_LENGTH));
 
     /* Now that we know the length, start writing the record */
     GUARD(s2n_stuffer_write_uint8(&conn->out, is_tls13_record ?
@@ -237,12 +321,13 @@ int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const s
     /* First write a header that has the payload length, this is for the MAC */
     GUARD(s2n_stuffer_write_uint16(&conn->out, data_bytes_to_take));
 
+    uint8_t *header = conn->out.blob.data + record_start;
     if (conn->actual_protocol_version > S2N_SSLv3) {
-        GUARD(s2n_hmac_update(mac, conn->out.blob.data, S2N_TLS_RECORD_HEADER_LENGTH));
+        GUARD(s2n_hmac_update(mac, header, S2N_TLS_RECORD_HEADER_LENGTH));
     } else {
         /* SSLv3 doesn't include the protocol version in the MAC */
-        GUARD(s2n_hmac_update(mac, conn->out.blob.data, 1));
-        GUARD(s2n_hmac_update(mac, conn->out.blob.data + 3, 2));
+        GUARD(s2n_hmac_update(mac, header, 1));
+        GUARD(s2n_hmac_update(mac, header + 3, 2));
     }
 
     /* Compute non-payload parts of the MAC(seq num, type, proto vers, fragment length) for composite ciphers.
@@ -318,9 +403,18 @@ int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const s
     GUARD(s2n_increment_sequence_number(&seq));
 
     /* Write the plaintext data */
-    GUARD(s2n_stuffer_writev_bytes(&conn->out, in, in_count, offs, data_bytes_to_take));
-    void *orig_write_ptr = conn->out.blob.data + conn->out.write_cursor - data_bytes_to_take;
-    GUARD(s2n_hmac_update(mac, orig_write_ptr, data_bytes_to_take));
+    if (in) {
+        GUARD(s2n_stuffer_writev_bytes(&conn->out, in, in_count, offs, data_bytes_to_take));
+    } else {
+        eq_check(conn->out.write_cursor, record_start + s2n_record_write_payload_offset(conn));
+        GUARD(s2n_stuffer_skip_write(&conn->out, data_bytes_to_take));
+    }
+    uint8_t *orig_write_ptr = conn->out.blob.data + conn->out.write_cursor - data_bytes_to_take;
+    if (cipher_suite->record_alg->cipher->type == S2N_CBC) {
+        GUARD(s2n_record_write_cbc_stitched(cipher_suite->record_alg->cipher, session_key, mac, &iv, orig_write_ptr, data_bytes_to_take, &cbc_sealed));
+    } else {
+        GUARD(s2n_hmac_update(mac, orig_write_ptr, data_bytes_to_take));
+    }
 
     /* Write the digest */
     uint8_t *digest = s2n_stuffer_raw_write(&conn->out, mac_digest_size);
@@ -343,10 +437,8 @@ int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const s
         }
     }
 
-    /* Rewind to rewrite/encrypt the packet */
-    GUARD(s2n_stuffer_rewrite(&conn->out));
-
-    /* Skip the header */
+    /* Rewind to rewrite/encrypt the packet, skipping the header */
+    conn->out.write_cursor = record_start;
     GUARD(s2n_stuffer_skip_write(&conn->out, S2N_TLS_RECORD_HEADER_LENGTH));
 
     uint16_t encrypted_length = data_bytes_to_take + mac_digest_size;
@@ -364,6 +456,9 @@ int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const s
             /* Leave the IV alone and unencrypted */
             GUARD(s2n_stuffer_skip_write(&conn->out, iv.size));
         }
+        /* Skip the part of the payload that was encrypted alongside the MAC */
+        GUARD(s2n_stuffer_skip_write(&conn->out, cbc_sealed));
+        encrypted_length -= cbc_sealed;
         /* Encrypt the padding and the padding length byte too */
         encrypted_length += padding + 1;
         break;
@@ -386,10 +481,24 @@ int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const s
         conn->server = current_server_crypto;
     }
 
+    GUARD(s2n_perf_record_out(conn, cipher_suite, crypto_start, actual_fragment_length));
+
     conn->wire_bytes_out += actual_fragment_length + S2N_TLS_RECORD_HEADER_LENGTH;
     return data_bytes_to_take;
 }
 
+int s2n_record_writev(struct s2n_connection *conn, uint8_t content_type, const struct iovec *in, int in_count, size_t offs, size_t to_write)
+{
+    notnull_check(in);
+
+    return s2n_record_writev_internal(conn, content_type, in, in_count, offs, to_write);
+}
+
+int s2n_record_write_in_place(struct s2n_connection *conn, uint8_t content_type, size_t to_write)
+{
+    return s2n_record_writev_internal(conn, content_type, NULL, 0, 0, to_write);
+}
+
 int s2n_record_write(struct s2n_connection *conn, uint8_t content_type, struct s2n_blob *in)
 {
     struct iovec iov;
@@ -25,7 +25,10 @@
 #include "error/s2n_errno.h"
 
 #include "tls/s2n_connection.h"
+#include "tls/s2n_early_data.h"
 #include "tls/s2n_handshake.h"
+#include "tls/s2n_ktls.h"
+#include "tls/s2n_post_handshake.h"
 #include "tls/s2n_record.h"
 #include "tls/s2n_resume.h"
 #include "tls/s2n_alerts.h"
@@ -37,43 +40,100 @@
 #include "utils/s2n_safety.h"
 #include "utils/s2n_blob.h"
 
-int s2n_read_full_record(struct s2n_connection *conn, uint8_t * record_type, int *isSSLv2)
+static int s2n_read_in_bytes(struct s2n_connection *conn, struct s2n_stuffer *output, uint32_t length)
 {
-    int r;
-
-    *isSSLv2 = 0;
+    while (s2n_stuffer_data_available(output) < length) {
+        uint32_t remaining = length - s2n_stuffer_data_available(output);
 
-    /* If the record has already been decrypted, then leave it alone */
-    if (conn->in_status == PLAINTEXT) {
-        /* Only application data packets count as plaintext */
-        *record_type = TLS_APPLICATION_DATA;
-        return 0;
-    }
-
-    GUARD(s2n_stuffer_resize_if_empty(&conn->in, S2N_LARGE_FRAGMENT_LENGTH));
+        /* Serve the request from data we have already read ahead, if any */
+        if (s2n_stuffer_data_available(&conn->buffer_in)) {
+            GUARD(s2n_stuffer_copy(&conn->buffer_in, output, MIN(remaining, s2n_stuffer_data_available(&conn->buffer_in))));
+            continue;
+        }
 
-    /* Read the record until we at least have a header */
-    while (s2n_stuffer_data_available(&conn->header_in) < S2N_TLS_RECORD_HEADER_LENGTH) {
-        int remaining = S2N_TLS_RECORD_HEADER_LENGTH - s2n_stuffer_data_available(&conn->header_in);
+        struct s2n_stuffer *target = output;
+        uint32_t to_read = remaining;
+        if (conn->read_ahead_size) {
+            to_read = MAX(remaining, conn->read_ahead_size);
+
+            /* buffer_in is fully consumed, so it is safe to start over at the beginning. With dynamic buffers
+             * it comes from the pool, so it has to start out pool sized for the pool to take it back.
+             */
+            GUARD(s2n_connection_lease_buffer(conn, &conn->buffer_in, to_read));
+            GUARD(s2n_stuffer_rewrite(&conn->buffer_in));
+            target = &conn->buffer_in;
+        }
 
         if (s2n_connection_is_managed_corked(conn)) {
             GUARD(s2n_socket_set_read_size(conn, remaining));
         }
-        r = s2n_connection_recv_stuffer(&conn->header_in, conn, remaining);
 
+        int r = s2n_connection_recv_stuffer(target, conn, to_read);
         if (r == 0) {
             conn->closed = 1;
             S2N_ERROR(S2N_ERR_CLOSED);
         } else if (r < 0) {
             if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                S2N_ERROR(S2N_ERR_BLOCKED);
+                S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
             }
             S2N_ERROR(S2N_ERR_IO);
         }
         conn->wire_bytes_in += r;
     }
+
+    return 0;
+}
+
+static int s2n_buffered_record_is_complete(struct s2n_connection *conn)
+{
+    uint32_t available = s2n_stuffer_data_available(&conn->buffer_in);
+    if (available < S2N_TLS_RECORD_HEADER_LENGTH) {
+        return 0;
+    }
+
+    uint8_t *header = conn->buffer_in.blob.data + conn->buffer_in.read_cursor;
+    uint32_t fragment_length = (header[3] << 8) | header[4];
+
+    return available >= S2N_TLS_RECORD_HEADER_LENGTH + fragment_length;
+}
+
+/* Reads and decrypts the next record. If direct is not NULL and the record is application data
+ * that fits, it is decrypted straight into direct and direct->size is set to the plaintext length.
+ * Otherwise direct->size is set to 0 and the plaintext is left in conn->in as usual.
+ */
+static int s2n_read_full_record_into(struct s2n_connection *conn, uint8_t * record_type, int *isSSLv2, struct s2n_blob *direct)
+{
+    uint32_t direct_size = 0;
+    if (direct) {
+        direct_size = direct->size;
+        direct->size = 0;
+    }
+
+    *isSSLv2 = 0;
+
+    /* If the record has already been decrypted, then leave it alone */
+    if (conn->in_status == PLAINTEXT) {
+        /* Only application data packets count as plaintext */
+        *record_type = TLS_APPLICATION_DATA;
+        return 0;
+    }
+
+    /* The kernel has already decrypted whatever it hands us */
+    if (conn->ktls_recv_enabled) {
+        if (direct) {
+            direct->size = direct_size;
+        }
+        return s2n_ktls_read_full_record(conn, record_type, direct);
+    }
+
+    GUARD(s2n_connection_lease_buffer(conn, &conn->in, S2N_LARGE_FRAGMENT_LENGTH));
+
     uint16_t fragment_length;
 
+next_record:
+    /* Read the record until we at least have a header */
+    GUARD(s2n_read_in_bytes(conn, &conn->header_in, S2N_TLS_RECORD_HEADER_LENGTH));
+
     /* If the first bit is set then this is an SSLv2 record */
     if (conn->header_in.blob.data[0] & 0x80) {
         conn->header_in.blob.data[0] &= 0x7f;
@@ -91,28 +151,41 @@ int s2n_read_full_record(struct s2n_connection *conn, uint8_t * record_type, int
     }
 
     /* Read enough to have the whole record */
-    while (s2n_stuffer_data_available(&conn->in) < fragment_length) {
-        int remaining = fragment_length - s2n_stuffer_data_available(&conn->in);
+    GUARD(s2n_read_in_bytes(conn, &conn->in, fragment_length));
 
-        if (s2n_connection_is_managed_corked(conn)) {
-            GUARD(s2n_socket_set_read_size(conn, remaining));
-        }
-
-        r = s2n_connection_recv_stuffer(&conn->in, conn, remaining);
+    if (*isSSLv2) {
+        return 0;
+    }
 
-        if (r == 0) {
-            conn->closed = 1;
-            S2N_ERROR(S2N_ERR_CLOSED);
-        } else if (r < 0) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                S2N_ERROR(S2N_ERR_BLOCKED);
+    /* A server that rejected early data discards the records it can't decrypt until the client
+     * moves on to its handshake key.
+     */
+    if (s2n_early_data_is_skipping(conn, *record_type)) {
+        if (conn->client == conn->initial || s2n_record_parse(conn) < 0) {
+            if (s2n_early_data_skip_record(conn, fragment_length) < 0) {
+                GUARD(s2n_connection_kill(conn));
+                S2N_ERROR_PRESERVE_ERRNO();
             }
-            S2N_ERROR(S2N_ERR_IO);
+            GUARD(s2n_stuffer_wipe(&conn->header_in));
+            GUARD(s2n_stuffer_wipe(&conn->in));
+            conn->in_status = ENCRYPTED;
+            goto next_record;
         }
-        conn->wire_bytes_in += r;
+        goto parsed;
     }
 
-    if (*isSSLv2) {
+    int can_parse_into = 0;
+    if (direct_size) {
+        GUARD(can_parse_into = s2n_record_can_parse_into(conn, direct_size));
+    }
+
+    if (can_parse_into) {
+        direct->size = direct_size;
+        if (s2n_record_parse_into(conn, direct) < 0) {
+            direct->size = 0;
+            GUARD(s2n_connection_kill(conn));
+            S2N_ERROR_PRESERVE_ERRNO();
+        }
         return 0;
     }
 
@@ -122,10 +195,24 @@ int s2n_read_full_record(struct s2n_connection *conn, uint8_t * record_type, int
         S2N_ERROR_PRESERVE_ERRNO();
     }
 
+parsed:
+
+    /* In TLS 1.3, encrypted records all appear to be of record type TLS_APPLICATION_DATA.
+     * The actual record content type is found after the record is decrypted.
+     */
+    if (conn->actual_protocol_version >= S2N_TLS13 && *record_type == TLS_APPLICATION_DATA) {
+        GUARD(s2n_tls13_parse_record_type(&conn->in, record_type));
+    }
+
     return 0;
 }
 
-ssize_t s2n_recv(struct s2n_connection * conn, void *buf, ssize_t size, s2n_blocked_status * blocked)
+int s2n_read_full_record(struct s2n_connection *conn, uint8_t * record_type, int *isSSLv2)
+{
+    return s2n_read_full_record_into(conn, record_type, isSSLv2, NULL);
+}
+
+static ssize_t s2n_recv_records(struct s2n_connection * conn, void *buf, ssize_t size, s2n_blocked_status * blocked)
 {
     ssize_t bytes_read = 0;
     struct s2n_blob out = {.data = (uint8_t *) buf };
@@ -139,7 +226,10 @@ ssize_t s2n_recv(struct s2n_connection * conn, void *buf, ssize_t size, s2n_bloc
     while (size && !conn->closed) {
         int isSSLv2 = 0;
         uint8_t record_type;
-        int r = s2n_read_full_record(conn, &record_type, &isSSLv2);
+
+        /* AEAD records that fit in what's left of the caller's buffer are decrypted straight into it */
+        struct s2n_blob direct = {.data = out.data,.size = MIN(size, UINT32_MAX) };
+        int r = s2n_read_full_record_into(conn, &record_type, &isSSLv2, &direct);
         if (r < 0) {
             if (s2n_errno == S2N_ERR_CLOSED) {
                 *blocked = S2N_NOT_BLOCKED;
@@ -172,29 +262,43 @@ ssize_t s2n_recv(struct s2n_connection * conn, void *buf, ssize_t size, s2n_bloc
                 GUARD(s2n_flush(conn, blocked));
             }
 
+            /* A TLS1.3 server can send handshake messages, like a NewSessionTicket, after the handshake */
+            if (record_type == TLS_HANDSHAKE && conn->actual_protocol_version >= S2N_TLS13) {
+                GUARD(s2n_post_handshake_recv(conn));
+            }
+
             GUARD(s2n_stuffer_wipe(&conn->header_in));
             GUARD(s2n_stuffer_wipe(&conn->in));
             conn->in_status = ENCRYPTED;
             continue;
         }
 
-        out.size = MIN(size, s2n_stuffer_data_available(&conn->in));
-
-        GUARD(s2n_stuffer_erase_and_read(&conn->in, &out));
-        bytes_read += out.size;
-
-        out.data += out.size;
-        size -= out.size;
-
-        /* Are we ready for more encrypted data? */
-        if (s2n_stuffer_data_available(&conn->in) == 0) {
-            GUARD(s2n_stuffer_wipe(&conn->header_in));
-            GUARD(s2n_stuffer_wipe(&conn->in));
-            conn->in_status = ENCRYPTED;
+        if (direct.size) {
+            /* The record was decrypted into the caller's buffer and conn->in is ready for the next one */
+            bytes_read += direct.size;
+            out.data += direct.size;
+            size -= direct.size;
+        } else {
+            out.size = MIN(size, s2n_stuffer_data_available(&conn->in));
+
+            GUARD(s2n_stuffer_erase_and_read(&conn->in, &out));
+            bytes_read += out.size;
+
+            out.data += out.size;
+            size -= out.size;
+
+            /* Are we ready for more encrypted data? */
+            if (s2n_stuffer_data_available(&conn->in) == 0) {
+                GUARD(s2n_stuffer_wipe(&conn->header_in));
+                GUARD(s2n_stuffer_wipe(&conn->in));
+                conn->in_status = ENCRYPTED;
+            }
         }
 
-        /* If we've read some data, return it */
-        if (bytes_read) {
+        /* If we've read some data, return it. With read-ahead enabled keep going
+         * while the next record can be processed without touching the socket.
+         */
+        if (bytes_read && !(conn->in_status == ENCRYPTED && s2n_buffered_record_is_complete(conn))) {
             break;
         }
     }
@@ -206,10 +310,39 @@ ssize_t s2n_recv(struct s2n_connection * conn, void *buf, ssize_t size, s2n_bloc
     return bytes_read;
 }
 
+ssize_t s2n_recv(struct s2n_connection * conn, void *buf, ssize_t size, s2n_blocked_status * blocked)
+{
+    /* Early data the application didn't collect with s2n_recv_early_data() comes first */
+    if (s2n_stuffer_data_available(&conn->early_data.in)) {
+        *blocked = S2N_NOT_BLOCKED;
+        return s2n_early_data_read(conn, buf, size);
+    }
+
+    ssize_t bytes_read = s2n_recv_records(conn, buf, size, blocked);
+
+    /* Whether it read anything or blocked waiting for more, a connection with dynamic
+     * buffers only keeps the ones holding a partial record or unread plaintext.
+     */
+    GUARD(s2n_connection_return_buffers(conn));
+
+    return bytes_read;
+}
+
 uint32_t s2n_peek(struct s2n_connection *conn) {
     return s2n_stuffer_data_available(&conn->in);
 }
 
+uint32_t s2n_peek_buffered(struct s2n_connection *conn) {
+    uint32_t buffered = s2n_stuffer_data_available(&conn->buffer_in);
+
+    /* A partially read record that has not been decrypted yet */
+    if (conn->in_status == ENCRYPTED) {
+        buffered += s2n_stuffer_data_available(&conn->header_in) + s2n_stuffer_data_available(&conn->in);
+    }
+
+    return buffered;
+}
+
 int s2n_recv_close_notify(struct s2n_connection *conn, s2n_blocked_status * blocked)
 {
     uint8_t record_type;
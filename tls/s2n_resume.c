@@ -35,12 +35,26 @@ int s2n_allowed_to_cache_connection(struct s2n_connection *conn)
         return 0;
     }
 
+    /* The TLS1.3 legacy_session_id is only echoed back, it doesn't identify a cached session */
+    if (conn->actual_protocol_version >= S2N_TLS13) {
+        return 0;
+    }
+
     struct s2n_config *config = conn->config;
 
     /* Caching is enabled iff all of the caching callbacks are set */
     return config->cache_store && config->cache_retrieve && config->cache_delete;
 }
 
+static int s2n_tls13_psk_secret_size(struct s2n_cipher_suite *cipher_suite, uint8_t *size)
+{
+    s2n_hash_algorithm hash_alg;
+    GUARD(s2n_hmac_hash_alg(cipher_suite->tls12_prf_alg, &hash_alg));
+    GUARD(s2n_hash_digest_size(hash_alg, size));
+
+    return 0;
+}
+
 static int s2n_serialize_resumption_state(struct s2n_connection *conn, struct s2n_stuffer *to)
 {
     uint64_t now;
@@ -91,8 +105,39 @@ static int s2n_deserialize_resumption_state(struct s2n_connection *conn, struct
     return 0;
 }
 
+/* A TLS1.3 ticket is only usable together with the PSK it was issued for */
+static int s2n_client_has_tls13_ticket(struct s2n_connection *conn)
+{
+    return conn->config->use_tickets && conn->client_ticket.size > 0 && conn->tls13_psk.secret_size > 0;
+}
+
+static int s2n_client_serialize_tls13_ticket_state(struct s2n_connection *conn, struct s2n_stuffer *to)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+
+    GUARD(s2n_stuffer_write_uint8(to, S2N_STATE_WITH_TLS13_TICKET));
+    GUARD(s2n_stuffer_write_uint16(to, conn->client_ticket.size));
+    GUARD(s2n_stuffer_write(to, &conn->client_ticket));
+
+    GUARD(s2n_stuffer_write_uint8(to, S2N_SERIALIZED_FORMAT_VERSION));
+    GUARD(s2n_stuffer_write_uint8(to, S2N_TLS13));
+    GUARD(s2n_stuffer_write_bytes(to, psk->cipher_suite->iana_value, S2N_TLS_CIPHER_SUITE_LEN));
+    GUARD(s2n_stuffer_write_uint64(to, psk->ticket_issue_time));
+    GUARD(s2n_stuffer_write_uint32(to, psk->ticket_age_add));
+    GUARD(s2n_stuffer_write_uint32(to, psk->max_early_data_size));
+    GUARD(s2n_stuffer_write_uint32(to, conn->ticket_lifetime_hint));
+    GUARD(s2n_stuffer_write_bytes(to, psk->secret, S2N_TLS_SECRET_LEN));
+
+    return 0;
+}
+
 static int s2n_client_serialize_resumption_state(struct s2n_connection *conn, struct s2n_stuffer *to)
 {
+    if (s2n_client_has_tls13_ticket(conn)) {
+        GUARD(s2n_client_serialize_tls13_ticket_state(conn, to));
+        return 0;
+    }
+
     /* Serialize session ticket */
    if (conn->config->use_tickets && conn->client_ticket.size > 0) {
        GUARD(s2n_stuffer_write_uint8(to, S2N_STATE_WITH_SESSION_TICKET));
@@ -174,6 +219,47 @@ static int s2n_client_deserialize_with_session_ticket(struct s2n_connection *con
     return 0;
 }
 
+/* The protocol version is left alone: a TLS1.3 ticket is offered without committing to TLS1.3 */
+static int s2n_client_deserialize_with_tls13_ticket(struct s2n_connection *conn, struct s2n_stuffer *from)
+{
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+    uint16_t session_ticket_len;
+    GUARD(s2n_stuffer_read_uint16(from, &session_ticket_len));
+
+    if (session_ticket_len == 0 || session_ticket_len > s2n_stuffer_data_available(from)) {
+        S2N_ERROR(S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+    }
+
+    GUARD(s2n_realloc(&conn->client_ticket, session_ticket_len));
+    GUARD(s2n_stuffer_read(from, &conn->client_ticket));
+
+    S2N_ERROR_IF(s2n_stuffer_data_available(from) < S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    uint8_t format;
+    GUARD(s2n_stuffer_read_uint8(from, &format));
+    S2N_ERROR_IF(format != S2N_SERIALIZED_FORMAT_VERSION, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    uint8_t protocol_version;
+    GUARD(s2n_stuffer_read_uint8(from, &protocol_version));
+    S2N_ERROR_IF(protocol_version != S2N_TLS13, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    uint8_t *cipher_suite_wire = s2n_stuffer_raw_read(from, S2N_TLS_CIPHER_SUITE_LEN);
+    notnull_check(cipher_suite_wire);
+    psk->cipher_suite = s2n_cipher_suite_from_wire(cipher_suite_wire);
+    S2N_ERROR_IF(psk->cipher_suite == NULL || psk->cipher_suite->minimum_required_tls_version < S2N_TLS13,
+            S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    GUARD(s2n_stuffer_read_uint64(from, &psk->ticket_issue_time));
+    GUARD(s2n_stuffer_read_uint32(from, &psk->ticket_age_add));
+    GUARD(s2n_stuffer_read_uint32(from, &psk->max_early_data_size));
+    GUARD(s2n_stuffer_read_uint32(from, &conn->ticket_lifetime_hint));
+
+    GUARD(s2n_tls13_psk_secret_size(psk->cipher_suite, &psk->secret_size));
+    GUARD(s2n_stuffer_read_bytes(from, psk->secret, S2N_TLS_SECRET_LEN));
+
+    return 0;
+}
+
 static int s2n_client_deserialize_resumption_state(struct s2n_connection *conn, struct s2n_stuffer *from)
 {
     uint8_t format;
@@ -186,6 +272,9 @@ static int s2n_client_deserialize_resumption_state(struct s2n_connection *conn,
     case S2N_STATE_WITH_SESSION_TICKET:
         GUARD(s2n_client_deserialize_with_session_ticket(conn, from));
         break;
+    case S2N_STATE_WITH_TLS13_TICKET:
+        GUARD(s2n_client_deserialize_with_tls13_ticket(conn, from));
+        break;
     default:
         S2N_ERROR(S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
     }
@@ -288,6 +377,16 @@ int s2n_connection_get_session_ticket_lifetime_hint(struct s2n_connection *conn)
 
 int s2n_connection_get_session_length(struct s2n_connection *conn)
 {
+    /* TLS1.3 session resumption: "format (2) + session_ticket_len + session_ticket + ticket state" */
+    if (s2n_client_has_tls13_ticket(conn)) {
+        return S2N_STATE_FORMAT_LEN + S2N_SESSION_TICKET_SIZE_LEN + conn->client_ticket.size + S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES;
+    }
+
+    /* A TLS1.3 session without a ticket can't be resumed */
+    if (conn->actual_protocol_version >= S2N_TLS13) {
+        return 0;
+    }
+
     /* Session resumption using session ticket "format (1) + session_ticket_len + session_ticket + session state" */
     if (conn->config->use_tickets && conn->client_ticket.size > 0) {
         return S2N_STATE_FORMAT_LEN + S2N_SESSION_TICKET_SIZE_LEN + conn->client_ticket.size + S2N_STATE_SIZE_IN_BYTES;
@@ -437,11 +536,66 @@ struct s2n_ticket_key *s2n_find_ticket_key(struct s2n_config *config, const uint
     return NULL;
 }
 
-int s2n_encrypt_session_ticket(struct s2n_connection *conn, struct s2n_stuffer *to)
+/* On failure, the caller frees whatever was set up with s2n_ticket_key_free_session_keys() */
+int s2n_ticket_key_init_session_keys(struct s2n_ticket_key *key)
+{
+    struct s2n_blob aes_key_blob;
+
+    s2n_blob_init(&aes_key_blob, key->aes_key, S2N_AES256_KEY_LEN);
+
+    key->encrypt_key.evp_cipher_ctx = NULL;
+    key->decrypt_key.evp_cipher_ctx = NULL;
+
+    GUARD(s2n_session_key_alloc(&key->encrypt_key));
+    GUARD(s2n_aes256_gcm.init(&key->encrypt_key));
+    GUARD(s2n_aes256_gcm.set_encryption_key(&key->encrypt_key, &aes_key_blob));
+
+    GUARD(s2n_session_key_alloc(&key->decrypt_key));
+    GUARD(s2n_aes256_gcm.init(&key->decrypt_key));
+    GUARD(s2n_aes256_gcm.set_decryption_key(&key->decrypt_key, &aes_key_blob));
+
+    return 0;
+}
+
+int s2n_ticket_key_free_session_keys(struct s2n_ticket_key *key)
+{
+    notnull_check(key);
+
+    if (key->encrypt_key.evp_cipher_ctx) {
+        GUARD(s2n_aes256_gcm.destroy_key(&key->encrypt_key));
+        GUARD(s2n_session_key_free(&key->encrypt_key));
+    }
+
+    if (key->decrypt_key.evp_cipher_ctx) {
+        GUARD(s2n_aes256_gcm.destroy_key(&key->decrypt_key));
+        GUARD(s2n_session_key_free(&key->decrypt_key));
+    }
+
+    return 0;
+}
+
+/* Copying a context keeps its expanded key schedule, so this is much cheaper than setting the key again */
+static int s2n_ticket_key_copy_session_key(struct s2n_session_key *from, struct s2n_session_key *to)
+{
+    notnull_check(from->evp_cipher_ctx);
+
+    to->evp_cipher_ctx = NULL;
+    GUARD(s2n_session_key_alloc(to));
+    if (EVP_CIPHER_CTX_copy(to->evp_cipher_ctx, from->evp_cipher_ctx) != 1) {
+        GUARD(s2n_session_key_free(to));
+        S2N_ERROR(S2N_ERR_KEY_INIT);
+    }
+
+    return 0;
+}
+
+/* Writes the key name and IV, then encrypts the serialized state in place and writes it with its tag.
+ * state must be sized to hold the tag after the serialized state.
+ */
+static int s2n_ticket_seal_state(struct s2n_connection *conn, struct s2n_blob *state, struct s2n_stuffer *to)
 {
     struct s2n_ticket_key *key;
     struct s2n_session_key aes_ticket_key;
-    struct s2n_blob aes_key_blob;
 
     uint8_t iv_data[S2N_TLS_GCM_IV_LEN] = { 0 };
     struct s2n_blob iv = { .data = iv_data, .size = sizeof(iv_data) };
@@ -450,10 +604,6 @@ int s2n_encrypt_session_ticket(struct s2n_connection *conn, struct s2n_stuffer *
     struct s2n_blob aad_blob = { .data = aad_data, .size = sizeof(aad_data) };
     struct s2n_stuffer aad;
 
-    uint8_t s_data[S2N_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN] = { 0 };
-    struct s2n_blob state_blob = { .data = s_data, .size = sizeof(s_data) };
-    struct s2n_stuffer state;
-
     key = s2n_get_ticket_encrypt_decrypt_key(conn->config);
 
     /* No keys loaded by the user or the keys are either in decrypt-only or expired state */
@@ -464,21 +614,15 @@ int s2n_encrypt_session_ticket(struct s2n_connection *conn, struct s2n_stuffer *
     GUARD(s2n_get_public_random_data(&iv));
     GUARD(s2n_stuffer_write(to, &iv));
 
-    s2n_blob_init(&aes_key_blob, key->aes_key, S2N_AES256_KEY_LEN);
-    notnull_check(aes_ticket_key.evp_cipher_ctx = EVP_CIPHER_CTX_new());
-    GUARD(s2n_aes256_gcm.init(&aes_ticket_key));
-    GUARD(s2n_aes256_gcm.set_encryption_key(&aes_ticket_key, &aes_key_blob));
+    GUARD(s2n_ticket_key_copy_session_key(&key->encrypt_key, &aes_ticket_key));
 
     GUARD(s2n_stuffer_init(&aad, &aad_blob));
     GUARD(s2n_stuffer_write_bytes(&aad, key->implicit_aad, S2N_TICKET_AAD_IMPLICIT_LEN));
     GUARD(s2n_stuffer_write_bytes(&aad, key->key_name, S2N_TICKET_KEY_NAME_LEN));
 
-    GUARD(s2n_stuffer_init(&state, &state_blob));
-    GUARD(s2n_serialize_resumption_state(conn, &state));
-
-    GUARD(s2n_aes256_gcm.io.aead.encrypt(&aes_ticket_key, &iv, &aad_blob, &state_blob, &state_blob));
+    GUARD(s2n_aes256_gcm.io.aead.encrypt(&aes_ticket_key, &iv, &aad_blob, state, state));
 
-    GUARD(s2n_stuffer_write(to, &state_blob));
+    GUARD(s2n_stuffer_write(to, state));
 
     GUARD(s2n_aes256_gcm.destroy_key(&aes_ticket_key));
     GUARD(s2n_session_key_free(&aes_ticket_key));
@@ -486,12 +630,14 @@ int s2n_encrypt_session_ticket(struct s2n_connection *conn, struct s2n_stuffer *
     return 0;
 }
 
-int s2n_decrypt_session_ticket(struct s2n_connection *conn)
+/* Reverses s2n_ticket_seal_state(). en_blob is sized to the encrypted state and its tag,
+ * and holds the decrypted state on success.
+ */
+static int s2n_ticket_open_state(struct s2n_connection *conn, struct s2n_stuffer *from, struct s2n_blob *en_blob,
+        struct s2n_ticket_key **found_key)
 {
     struct s2n_ticket_key *key;
     struct s2n_session_key aes_ticket_key;
-    struct s2n_blob aes_key_blob;
-    struct s2n_stuffer *from;
 
     uint8_t key_name[S2N_TICKET_KEY_NAME_LEN];
 
@@ -502,14 +648,6 @@ int s2n_decrypt_session_ticket(struct s2n_connection *conn)
     struct s2n_blob aad_blob = { .data = aad_data, .size = sizeof(aad_data) };
     struct s2n_stuffer aad;
 
-    uint8_t s_data[S2N_STATE_SIZE_IN_BYTES] = { 0 };
-    struct s2n_blob state_blob = { .data = s_data, .size = sizeof(s_data) };
-    struct s2n_stuffer state;
-
-    uint8_t en_data[S2N_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN];
-    struct s2n_blob en_blob = { .data = en_data, .size = sizeof(en_data) };
-
-    from = &conn->client_ticket_to_decrypt;
     GUARD(s2n_stuffer_read_bytes(from, key_name, S2N_TICKET_KEY_NAME_LEN));
 
     key = s2n_find_ticket_key(conn->config, key_name);
@@ -519,27 +657,56 @@ int s2n_decrypt_session_ticket(struct s2n_connection *conn)
 
     GUARD(s2n_stuffer_read(from, &iv));
 
-    s2n_blob_init(&aes_key_blob, key->aes_key, S2N_AES256_KEY_LEN);
-    notnull_check(aes_ticket_key.evp_cipher_ctx = EVP_CIPHER_CTX_new());
-    GUARD(s2n_aes256_gcm.init(&aes_ticket_key));
-    GUARD(s2n_aes256_gcm.set_decryption_key(&aes_ticket_key, &aes_key_blob));
+    GUARD(s2n_ticket_key_copy_session_key(&key->decrypt_key, &aes_ticket_key));
 
     GUARD(s2n_stuffer_init(&aad, &aad_blob));
     GUARD(s2n_stuffer_write_bytes(&aad, key->implicit_aad, S2N_TICKET_AAD_IMPLICIT_LEN));
     GUARD(s2n_stuffer_write_bytes(&aad, key->key_name, S2N_TICKET_KEY_NAME_LEN));
 
-    GUARD(s2n_stuffer_read(from, &en_blob));
+    GUARD(s2n_stuffer_read(from, en_blob));
+
+    GUARD(s2n_aes256_gcm.io.aead.decrypt(&aes_ticket_key, &iv, &aad_blob, en_blob, en_blob));
 
-    GUARD(s2n_aes256_gcm.io.aead.decrypt(&aes_ticket_key, &iv, &aad_blob, &en_blob, &en_blob));
+    GUARD(s2n_aes256_gcm.destroy_key(&aes_ticket_key));
+    GUARD(s2n_session_key_free(&aes_ticket_key));
+
+    *found_key = key;
+
+    return 0;
+}
+
+int s2n_encrypt_session_ticket(struct s2n_connection *conn, struct s2n_stuffer *to)
+{
+    uint8_t s_data[S2N_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN] = { 0 };
+    struct s2n_blob state_blob = { .data = s_data, .size = sizeof(s_data) };
+    struct s2n_stuffer state;
+
+    GUARD(s2n_stuffer_init(&state, &state_blob));
+    GUARD(s2n_serialize_resumption_state(conn, &state));
+
+    GUARD(s2n_ticket_seal_state(conn, &state_blob, to));
+
+    return 0;
+}
+
+int s2n_decrypt_session_ticket(struct s2n_connection *conn)
+{
+    struct s2n_ticket_key *key;
+
+    uint8_t s_data[S2N_STATE_SIZE_IN_BYTES] = { 0 };
+    struct s2n_blob state_blob = { .data = s_data, .size = sizeof(s_data) };
+    struct s2n_stuffer state;
+
+    uint8_t en_data[S2N_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN];
+    struct s2n_blob en_blob = { .data = en_data, .size = sizeof(en_data) };
+
+    GUARD(s2n_ticket_open_state(conn, &conn->client_ticket_to_decrypt, &en_blob, &key));
 
     GUARD(s2n_stuffer_init(&state, &state_blob));
     GUARD(s2n_stuffer_write_bytes(&state, en_data, S2N_STATE_SIZE_IN_BYTES));
 
     GUARD(s2n_deserialize_resumption_state(conn, &state));
 
-    GUARD(s2n_aes256_gcm.destroy_key(&aes_ticket_key));
-    GUARD(s2n_session_key_free(&aes_ticket_key));
-
     uint64_t now;
     GUARD(conn->config->wall_clock(conn->config->sys_clock_ctx, &now));
 
@@ -559,6 +726,99 @@ int s2n_decrypt_session_ticket(struct s2n_connection *conn)
     return 0;
 }
 
+/* The TLS1.3 ticket state is the PSK itself rather than a master secret, padded to S2N_TLS_SECRET_LEN */
+static int s2n_tls13_serialize_ticket_state(const struct s2n_tls13_psk *psk, struct s2n_stuffer *to)
+{
+    S2N_ERROR_IF(s2n_stuffer_space_remaining(to) < S2N_TLS13_STATE_SIZE_IN_BYTES, S2N_ERR_STUFFER_IS_FULL);
+    notnull_check(psk->cipher_suite);
+    lte_check(psk->secret_size, S2N_TLS_SECRET_LEN);
+
+    GUARD(s2n_stuffer_write_uint8(to, S2N_SERIALIZED_FORMAT_VERSION));
+    GUARD(s2n_stuffer_write_uint8(to, S2N_TLS13));
+    GUARD(s2n_stuffer_write_bytes(to, psk->cipher_suite->iana_value, S2N_TLS_CIPHER_SUITE_LEN));
+    GUARD(s2n_stuffer_write_uint64(to, psk->ticket_issue_time));
+    GUARD(s2n_stuffer_write_uint32(to, psk->ticket_age_add));
+    GUARD(s2n_stuffer_write_uint32(to, psk->max_early_data_size));
+    GUARD(s2n_stuffer_write_bytes(to, psk->secret, S2N_TLS_SECRET_LEN));
+
+    return 0;
+}
+
+static int s2n_tls13_deserialize_ticket_state(struct s2n_connection *conn, struct s2n_stuffer *from, struct s2n_tls13_psk *psk)
+{
+    uint8_t format;
+    uint8_t protocol_version;
+    uint8_t cipher_suite[S2N_TLS_CIPHER_SUITE_LEN];
+
+    S2N_ERROR_IF(s2n_stuffer_data_available(from) < S2N_TLS13_STATE_SIZE_IN_BYTES, S2N_ERR_STUFFER_OUT_OF_DATA);
+
+    GUARD(s2n_stuffer_read_uint8(from, &format));
+    S2N_ERROR_IF(format != S2N_SERIALIZED_FORMAT_VERSION, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    GUARD(s2n_stuffer_read_uint8(from, &protocol_version));
+    S2N_ERROR_IF(protocol_version != S2N_TLS13, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    GUARD(s2n_stuffer_read_bytes(from, cipher_suite, S2N_TLS_CIPHER_SUITE_LEN));
+    psk->cipher_suite = s2n_cipher_suite_from_wire(cipher_suite);
+    S2N_ERROR_IF(psk->cipher_suite == NULL || psk->cipher_suite->minimum_required_tls_version < S2N_TLS13,
+            S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    uint64_t now;
+    GUARD(conn->config->wall_clock(conn->config->sys_clock_ctx, &now));
+
+    GUARD(s2n_stuffer_read_uint64(from, &psk->ticket_issue_time));
+    S2N_ERROR_IF(psk->ticket_issue_time > now, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+    S2N_ERROR_IF(now - psk->ticket_issue_time > conn->config->session_state_lifetime_in_nanos, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    GUARD(s2n_stuffer_read_uint32(from, &psk->ticket_age_add));
+    GUARD(s2n_stuffer_read_uint32(from, &psk->max_early_data_size));
+
+    GUARD(s2n_tls13_psk_secret_size(psk->cipher_suite, &psk->secret_size));
+    GUARD(s2n_stuffer_read_bytes(from, psk->secret, S2N_TLS_SECRET_LEN));
+
+    return 0;
+}
+
+int s2n_tls13_encrypt_session_ticket(struct s2n_connection *conn, const struct s2n_tls13_psk *psk, struct s2n_stuffer *to)
+{
+    uint8_t s_data[S2N_TLS13_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN] = { 0 };
+    struct s2n_blob state_blob = { .data = s_data, .size = sizeof(s_data) };
+    struct s2n_stuffer state;
+
+    GUARD(s2n_stuffer_init(&state, &state_blob));
+    GUARD(s2n_tls13_serialize_ticket_state(psk, &state));
+
+    GUARD(s2n_ticket_seal_state(conn, &state_blob, to));
+
+    return 0;
+}
+
+int s2n_tls13_decrypt_session_ticket(struct s2n_connection *conn, struct s2n_blob *ticket, struct s2n_tls13_psk *psk)
+{
+    struct s2n_ticket_key *key;
+    struct s2n_stuffer from = {0};
+
+    uint8_t s_data[S2N_TLS13_STATE_SIZE_IN_BYTES] = { 0 };
+    struct s2n_blob state_blob = { .data = s_data, .size = sizeof(s_data) };
+    struct s2n_stuffer state;
+
+    uint8_t en_data[S2N_TLS13_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN];
+    struct s2n_blob en_blob = { .data = en_data, .size = sizeof(en_data) };
+
+    S2N_ERROR_IF(ticket->size != S2N_TLS13_TICKET_SIZE_IN_BYTES, S2N_ERR_INVALID_SERIALIZED_SESSION_STATE);
+
+    GUARD(s2n_stuffer_init(&from, ticket));
+    GUARD(s2n_stuffer_write(&from, ticket));
+    GUARD(s2n_ticket_open_state(conn, &from, &en_blob, &key));
+
+    GUARD(s2n_stuffer_init(&state, &state_blob));
+    GUARD(s2n_stuffer_write_bytes(&state, en_data, S2N_TLS13_STATE_SIZE_IN_BYTES));
+
+    GUARD(s2n_tls13_deserialize_ticket_state(conn, &state, psk));
+
+    return 0;
+}
+
 /* This function is used to remove all or just one expired key from server config */
 int s2n_config_wipe_expired_ticket_crypto_keys(struct s2n_config *config, int8_t expired_key_index)
 {
@@ -585,6 +845,7 @@ int s2n_config_wipe_expired_ticket_crypto_keys(struct s2n_config *config, int8_t
 
 end:
     for (int j = 0; j < num_of_expired_keys; j++) {
+        GUARD(s2n_ticket_key_free_session_keys(s2n_set_get(config->ticket_keys, expired_keys_index[j] - j)));
         s2n_set_remove(config->ticket_keys, expired_keys_index[j] - j);
     }
 
@@ -595,6 +856,9 @@ end:
 int s2n_config_store_ticket_key(struct s2n_config *config, struct s2n_ticket_key *key)
 {
     /* Keys are stored from oldest to newest */
-    GUARD(s2n_set_add(config->ticket_keys, key));
+    if (s2n_ticket_key_init_session_keys(key) < 0 || s2n_set_add(config->ticket_keys, key) < 0) {
+        GUARD(s2n_ticket_key_free_session_keys(key));
+        S2N_ERROR_PRESERVE_ERRNO();
+    }
     return S2N_SUCCESS;
 }
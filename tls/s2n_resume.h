@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include "crypto/s2n_cipher.h"
+
 #include "utils/s2n_blob.h"
 
 #include "stuffer/s2n_stuffer.h"
@@ -29,6 +31,10 @@
 #define S2N_AES256_KEY_LEN              32
 #define ONE_SEC_IN_NANOS                1000000000
 #define S2N_TICKET_SIZE_IN_BYTES        (S2N_TICKET_KEY_NAME_LEN + S2N_TLS_GCM_IV_LEN + S2N_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN)
+#define S2N_TLS13_STATE_SIZE_IN_BYTES   (1 + 1 + S2N_TLS_CIPHER_SUITE_LEN + 8 + 4 + 4 + S2N_TLS_SECRET_LEN)
+#define S2N_TLS13_TICKET_SIZE_IN_BYTES  (S2N_TICKET_KEY_NAME_LEN + S2N_TLS_GCM_IV_LEN + S2N_TLS13_STATE_SIZE_IN_BYTES + S2N_TLS_GCM_TAG_LEN)
+#define S2N_TLS13_CLIENT_STATE_SIZE_IN_BYTES    (S2N_TLS13_STATE_SIZE_IN_BYTES + S2N_TICKET_LIFETIME_HINT_LEN)
+#define S2N_TLS13_MAX_TICKET_LIFETIME_IN_SECS   604800      /* 7 days, see RFC 8446 4.6.1 */
 #define S2N_TICKET_ENCRYPT_DECRYPT_KEY_LIFETIME_IN_NANOS        7200000000000     /* 2 hours */
 #define S2N_TICKET_DECRYPT_KEY_LIFETIME_IN_NANOS                46800000000000    /* 13 hours */
 #define S2N_STATE_FORMAT_LEN            1
@@ -39,12 +45,19 @@
 
 struct s2n_connection;
 struct s2n_config;
+struct s2n_tls13_psk;
 
 struct s2n_ticket_key {
     unsigned char key_name[S2N_TICKET_KEY_NAME_LEN];
     uint8_t aes_key[S2N_AES256_KEY_LEN];
     uint8_t implicit_aad[S2N_TICKET_AAD_IMPLICIT_LEN];
     uint64_t intro_timestamp;
+
+    /* Contexts with the AES key schedule already expanded. They are shared by every
+     * connection using the config, so each ticket works on a copy.
+     */
+    struct s2n_session_key encrypt_key;
+    struct s2n_session_key decrypt_key;
 };
 
 struct s2n_ticket_key_weight {
@@ -55,14 +68,19 @@ struct s2n_ticket_key_weight {
 extern struct s2n_ticket_key *s2n_find_ticket_key(struct s2n_config *config, const uint8_t *name);
 extern int s2n_encrypt_session_ticket(struct s2n_connection *conn, struct s2n_stuffer *to);
 extern int s2n_decrypt_session_ticket(struct s2n_connection *conn);
+extern int s2n_tls13_encrypt_session_ticket(struct s2n_connection *conn, const struct s2n_tls13_psk *psk, struct s2n_stuffer *to);
+extern int s2n_tls13_decrypt_session_ticket(struct s2n_connection *conn, struct s2n_blob *ticket, struct s2n_tls13_psk *psk);
 extern int s2n_config_is_encrypt_decrypt_key_available(struct s2n_config *config);
 extern int s2n_verify_unique_ticket_key(struct s2n_config *config, uint8_t *hash, uint16_t *insert_index);
 extern int s2n_config_wipe_expired_ticket_crypto_keys(struct s2n_config *config, int8_t expired_key_index);
 extern int s2n_config_store_ticket_key(struct s2n_config *config, struct s2n_ticket_key *key);
+extern int s2n_ticket_key_init_session_keys(struct s2n_ticket_key *key);
+extern int s2n_ticket_key_free_session_keys(struct s2n_ticket_key *key);
 
 typedef enum {
     S2N_STATE_WITH_SESSION_ID = 0,
-    S2N_STATE_WITH_SESSION_TICKET
+    S2N_STATE_WITH_SESSION_TICKET,
+    S2N_STATE_WITH_TLS13_TICKET
 } s2n_client_tls_session_state_format;
 
 extern int s2n_allowed_to_cache_connection(struct s2n_connection *conn);
@@ -15,13 +15,18 @@
 
 #include <sys/param.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
 #include <s2n.h>
 
 #include "error/s2n_errno.h"
 
+#include "tls/s2n_buffer_pool.h"
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_connection.h"
 #include "tls/s2n_handshake.h"
+#include "tls/s2n_ktls.h"
 #include "tls/s2n_record.h"
 
 #include "stuffer/s2n_stuffer.h"
@@ -35,6 +40,9 @@ int s2n_flush(struct s2n_connection *conn, s2n_blocked_status * blocked)
 {
     int w;
 
+    /* Flushing can reset or give back conn->out, which moves it out from under a s2n_send_reserve() buffer */
+    conn->send_reserved_size = 0;
+
     *blocked = S2N_BLOCKED_ON_WRITE;
 
     /* Write any data that's already pending */
@@ -43,7 +51,7 @@ int s2n_flush(struct s2n_connection *conn, s2n_blocked_status * blocked)
         w = s2n_connection_send_stuffer(&conn->out, conn, s2n_stuffer_data_available(&conn->out));
         if (w < 0) {
             if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                S2N_ERROR(S2N_ERR_BLOCKED);
+                S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED);
             }
             S2N_ERROR(S2N_ERR_IO);
         }
@@ -60,7 +68,11 @@ int s2n_flush(struct s2n_connection *conn, s2n_blocked_status * blocked)
         struct s2n_blob alert = {0};
         alert.data = conn->reader_alert_out.blob.data;
         alert.size = 2;
-        GUARD(s2n_record_write(conn, TLS_ALERT, &alert));
+        if (conn->ktls_send_enabled) {
+            GUARD(s2n_ktls_send_alert(conn, &alert));
+        } else {
+            GUARD(s2n_record_write(conn, TLS_ALERT, &alert));
+        }
         GUARD(s2n_stuffer_rewrite(&conn->reader_alert_out));
         conn->closing = 1;
 
@@ -73,7 +85,11 @@ int s2n_flush(struct s2n_connection *conn, s2n_blocked_status * blocked)
         struct s2n_blob alert = {0};
         alert.data = conn->writer_alert_out.blob.data;
         alert.size = 2;
-        GUARD(s2n_record_write(conn, TLS_ALERT, &alert));
+        if (conn->ktls_send_enabled) {
+            GUARD(s2n_ktls_send_alert(conn, &alert));
+        } else {
+            GUARD(s2n_record_write(conn, TLS_ALERT, &alert));
+        }
         GUARD(s2n_stuffer_rewrite(&conn->writer_alert_out));
         conn->closing = 1;
 
@@ -81,20 +97,61 @@ int s2n_flush(struct s2n_connection *conn, s2n_blocked_status * blocked)
         goto WRITE;
     }
 
+    /* Everything has gone out, so a connection with dynamic buffers can give conn->out back */
+    if (conn->dynamic_buffers) {
+        GUARD(s2n_buffer_pool_return(&conn->out));
+    }
+
     *blocked = S2N_NOT_BLOCKED;
 
     return 0;
 }
 
-ssize_t s2n_sendv_with_offset(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, ssize_t offs, s2n_blocked_status *blocked)
+/* Encrypts to_write bytes of user data, starting offs bytes in, into a new record in conn->out. The data
+ * comes from bufs, or if bufs is NULL, is read from fd straight into the record and sealed in place.
+ */
+static int s2n_write_user_data(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, int fd, off_t offs, ssize_t to_write)
 {
-    ssize_t user_data_sent, total_size = 0;
-    int max_payload_size;
+    if (bufs) {
+        GUARD(s2n_record_writev(conn, TLS_APPLICATION_DATA, bufs, count, offs, to_write));
+        return 0;
+    }
 
-    S2N_ERROR_IF(conn->closed, S2N_ERR_CLOSED);
+    /* conn->out is either empty or has room for a full record here, see s2n_send_user_data() */
+    GUARD(s2n_connection_lease_buffer(conn, &conn->out, S2N_LARGE_RECORD_LENGTH));
+    if (s2n_stuffer_space_remaining(&conn->out) < S2N_LARGE_RECORD_LENGTH) {
+        S2N_ERROR_IF(s2n_stuffer_data_available(&conn->out), S2N_ERR_SAFETY);
+        GUARD(s2n_stuffer_wipe(&conn->out));
+        GUARD(s2n_stuffer_resize(&conn->out, S2N_LARGE_RECORD_LENGTH));
+    }
 
-    /* Flush any pending I/O */
-    GUARD(s2n_flush(conn, blocked));
+    uint8_t *payload = conn->out.blob.data + conn->out.write_cursor + s2n_record_write_payload_offset(conn);
+    ssize_t bytes_read = 0;
+    while (bytes_read < to_write) {
+        ssize_t r = pread(fd, payload + bytes_read, to_write - bytes_read, offs + bytes_read);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        S2N_ERROR_IF(r < 0, S2N_ERR_IO);
+
+        /* The file is shorter than we were asked to send */
+        S2N_ERROR_IF(r == 0, S2N_ERR_SEND_SIZE);
+        bytes_read += r;
+    }
+
+    GUARD(s2n_record_write_in_place(conn, TLS_APPLICATION_DATA, to_write));
+
+    return 0;
+}
+
+/* Sends total_size bytes of user data, picking up after any data that was encrypted but not
+ * acknowledged by a previous call that blocked. See s2n_write_user_data() for bufs, fd and offs.
+ */
+static ssize_t s2n_send_user_data(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, int fd, off_t offs,
+                                  ssize_t total_size, s2n_blocked_status *blocked)
+{
+    ssize_t user_data_sent;
+    int max_payload_size;
 
     /* Acknowledge consumed and flushed user data as sent */
     user_data_sent = conn->current_user_data_consumed;
@@ -114,22 +171,6 @@ ssize_t s2n_sendv_with_offset(struct s2n_connection *conn, const struct iovec *b
         writer = conn->client;
     }
 
-    /* Defensive check against an invalid retry */
-    if (offs) {
-        const struct iovec* _bufs = bufs;
-        ssize_t _count = count;
-        while (offs >= _bufs->iov_len && _count > 0) {
-            offs -= _bufs->iov_len;
-            _bufs++;
-            _count--;
-        }
-        bufs = _bufs;
-        count = _count;
-    }
-    for (int i = 0; i < count; i++) {
-        total_size += bufs[i].iov_len;
-    }
-    total_size -= offs;
     S2N_ERROR_IF(conn->current_user_data_consumed > total_size, S2N_ERR_SEND_SIZE);
 
     if (conn->dynamic_record_timeout_threshold > 0) {
@@ -142,6 +183,16 @@ ssize_t s2n_sendv_with_offset(struct s2n_connection *conn, const struct iovec *b
         conn->last_write_elapsed = elapsed;
     }
 
+    /* If more than one record is needed, make room to coalesce several of them
+     * into conn->out so they can be flushed together. The larger buffer is kept for
+     * the sends that follow, until s2n_connection_release_buffers() or a wipe frees it.
+     */
+    if (total_size - conn->current_user_data_consumed > max_payload_size && conn->out.blob.size < S2N_MAX_COALESCED_SEND_LENGTH) {
+        /* conn->out was fully flushed above; wiping it clears the taint left by previous records */
+        GUARD(s2n_stuffer_wipe(&conn->out));
+        GUARD(s2n_stuffer_resize(&conn->out, S2N_MAX_COALESCED_SEND_LENGTH));
+    }
+
     /* Now write the data we were asked to send this round */
     while (total_size - conn->current_user_data_consumed) {
         ssize_t to_write = MIN(total_size - conn->current_user_data_consumed, max_payload_size);
@@ -167,12 +218,15 @@ ssize_t s2n_sendv_with_offset(struct s2n_connection *conn, const struct iovec *b
         }
 
         /* Write and encrypt the record */
-        GUARD(s2n_stuffer_rewrite(&conn->out));
-        GUARD(s2n_record_writev(conn, TLS_APPLICATION_DATA, bufs, count, 
-            conn->current_user_data_consumed + offs, to_write));
+        GUARD(s2n_write_user_data(conn, bufs, count, fd, conn->current_user_data_consumed + offs, to_write));
         conn->current_user_data_consumed += to_write;
         conn->active_application_bytes_consumed += to_write;
 
+        /* Keep appending records while there is more data and room for another full record */
+        if (total_size - conn->current_user_data_consumed && s2n_stuffer_space_remaining(&conn->out) >= S2N_LARGE_RECORD_LENGTH) {
+            continue;
+        }
+
         /* Send it */
         if (s2n_flush(conn, blocked) < 0) {
             if (s2n_errno == S2N_ERR_BLOCKED && user_data_sent > 0) {
@@ -198,6 +252,131 @@ ssize_t s2n_sendv_with_offset(struct s2n_connection *conn, const struct iovec *b
     return total_size;
 }
 
+ssize_t s2n_sendv_with_offset(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, ssize_t offs, s2n_blocked_status *blocked)
+{
+    ssize_t total_size = 0;
+
+    S2N_ERROR_IF(conn->closed, S2N_ERR_CLOSED);
+
+    /* Flush any pending I/O */
+    GUARD(s2n_flush(conn, blocked));
+
+    /* The kernel takes care of records once it has the keys */
+    if (conn->ktls_send_enabled) {
+        return s2n_ktls_sendv_with_offset(conn, bufs, count, offs, blocked);
+    }
+
+    /* Defensive check against an invalid retry */
+    if (offs) {
+        const struct iovec* _bufs = bufs;
+        ssize_t _count = count;
+        while (offs >= _bufs->iov_len && _count > 0) {
+            offs -= _bufs->iov_len;
+            _bufs++;
+            _count--;
+        }
+        bufs = _bufs;
+        count = _count;
+    }
+    for (int i = 0; i < count; i++) {
+        total_size += bufs[i].iov_len;
+    }
+    total_size -= offs;
+
+    return s2n_send_user_data(conn, bufs, count, -1, offs, total_size, blocked);
+}
+
+ssize_t s2n_sendfile(struct s2n_connection *conn, int fd, off_t offset, size_t count, s2n_blocked_status *blocked)
+{
+    notnull_check(conn);
+    notnull_check(blocked);
+    S2N_ERROR_IF(offset < 0 || count > SSIZE_MAX, S2N_ERR_SEND_SIZE);
+    S2N_ERROR_IF(conn->closed, S2N_ERR_CLOSED);
+
+    /* Flush any pending I/O */
+    GUARD(s2n_flush(conn, blocked));
+
+    /* The kernel can move the file to the socket itself */
+    if (conn->ktls_send_enabled) {
+        return s2n_ktls_sendfile(conn, fd, offset, count, blocked);
+    }
+
+    /* The file is read front to back, so let the kernel read ahead */
+    posix_fadvise(fd, offset, count, POSIX_FADV_SEQUENTIAL);
+
+    return s2n_send_user_data(conn, NULL, 0, fd, offset, count, blocked);
+}
+
+int s2n_send_reserve(struct s2n_connection *conn, uint8_t **buf, uint32_t *size, s2n_blocked_status *blocked)
+{
+    int max_payload_size;
+
+    notnull_check(conn);
+    notnull_check(buf);
+    notnull_check(size);
+    S2N_ERROR_IF(conn->closed, S2N_ERR_CLOSED);
+
+    /* A partial s2n_send() has to be completed before anything else can be sent */
+    S2N_ERROR_IF(conn->current_user_data_consumed, S2N_ERR_SEND_RESERVE);
+
+    /* There is no record to build in place once the kernel does the framing */
+    S2N_ERROR_IF(conn->ktls_send_enabled, S2N_ERR_SEND_RESERVE);
+
+    GUARD(s2n_flush(conn, blocked));
+
+    struct s2n_crypto_parameters *writer = conn->server;
+    if (conn->mode == S2N_CLIENT) {
+        writer = conn->client;
+    }
+
+    /* The 1/n-1 record split used by s2n_sendv() for TLS 1.0 CBC clients can't be done in place */
+    S2N_ERROR_IF(conn->actual_protocol_version < S2N_TLS11 && writer->cipher_suite->record_alg->cipher->type == S2N_CBC
+            && conn->mode != S2N_SERVER, S2N_ERR_SEND_RESERVE);
+
+    GUARD((max_payload_size = s2n_record_max_write_payload_size(conn)));
+    if (conn->active_application_bytes_consumed < (uint64_t) conn->dynamic_record_resize_threshold) {
+        max_payload_size = MIN(max_payload_size, s2n_record_min_write_payload_size(conn));
+    }
+
+    /* Make sure the whole record fits, so conn->out is never reallocated under the caller */
+    GUARD(s2n_connection_lease_buffer(conn, &conn->out, S2N_LARGE_RECORD_LENGTH));
+    if (conn->out.blob.size < S2N_LARGE_RECORD_LENGTH) {
+        GUARD(s2n_stuffer_wipe(&conn->out));
+        GUARD(s2n_stuffer_resize(&conn->out, S2N_LARGE_RECORD_LENGTH));
+    }
+
+    *buf = conn->out.blob.data + conn->out.write_cursor + s2n_record_write_payload_offset(conn);
+    *size = max_payload_size;
+    conn->send_reserved_size = max_payload_size;
+
+    return 0;
+}
+
+ssize_t s2n_send_commit(struct s2n_connection *conn, uint32_t size, s2n_blocked_status *blocked)
+{
+    notnull_check(conn);
+    S2N_ERROR_IF(conn->closed, S2N_ERR_CLOSED);
+    S2N_ERROR_IF(size == 0 || size > conn->send_reserved_size, S2N_ERR_SEND_RESERVE);
+
+    conn->send_reserved_size = 0;
+
+    /* Seal the plaintext where the caller wrote it */
+    GUARD(s2n_record_write_in_place(conn, TLS_APPLICATION_DATA, size));
+    conn->active_application_bytes_consumed += size;
+
+    /* The record is queued now, so it counts as sent even if the socket is full. Anything
+     * left in conn->out goes out with the next s2n_send() or s2n_send_reserve().
+     */
+    if (s2n_flush(conn, blocked) < 0) {
+        if (s2n_errno != S2N_ERR_BLOCKED) {
+            S2N_ERROR_PRESERVE_ERRNO();
+        }
+        s2n_errno = S2N_ERR_OK;
+    }
+
+    return size;
+}
+
 ssize_t s2n_sendv(struct s2n_connection *conn, const struct iovec *bufs, ssize_t count, s2n_blocked_status *blocked)
 {
     return s2n_sendv_with_offset(conn, bufs, count, 0, blocked);
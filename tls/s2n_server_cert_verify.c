@@ -16,13 +16,14 @@
 #include "tls/s2n_certificate_verify.h"
 #include "tls/s2n_connection.h"
 #include "crypto/s2n_hash.h"
+#include "crypto/s2n_ecdsa.h"
 
 #include "stuffer/s2n_stuffer.h"
 #include "error/s2n_errno.h"
 #include "utils/s2n_safety.h"
 
 static int s2n_server_write_cert_verify_signature(struct s2n_connection *conn, struct s2n_stuffer *out);
-static int s2n_server_generate_unsigned_cert_verify_content(struct s2n_connection *conn, struct s2n_stuffer *unsigned_content, s2n_hash_algorithm chosen_hash_alg);
+static int s2n_server_generate_unsigned_cert_verify_content(struct s2n_connection *conn, struct s2n_stuffer *unsigned_content);
 static uint8_t s2n_server_cert_verify_header_length();
 
 int s2n_server_cert_verify_send(struct s2n_connection *conn)
@@ -44,14 +45,18 @@ int s2n_server_cert_verify_recv(struct s2n_connection *conn)
     DEFER_CLEANUP(struct s2n_blob signed_content = {0}, s2n_free);
     DEFER_CLEANUP(struct s2n_stuffer unsigned_content = {0}, s2n_stuffer_free);
     DEFER_CLEANUP(struct s2n_hash_state message_hash = {0}, s2n_hash_free);
-    GUARD(s2n_hash_new(&message_hash));
-    GUARD(s2n_hash_init(&message_hash, conn->secure.conn_sig_scheme.hash_alg));
     uint16_t signature_size;
 
     /* Read the algorithm */
     struct s2n_signature_scheme chosen_sig_scheme = {0};
     GUARD(s2n_get_and_validate_negotiated_signature_scheme(conn, in, &chosen_sig_scheme));
 
+    /* TLS1.3 ECDSA SignatureSchemes fix the curve of the server key too */
+    S2N_ERROR_IF(chosen_sig_scheme.signature_curve != NULL &&
+            !s2n_ecdsa_pkey_matches_curve(&conn->secure.server_public_key, chosen_sig_scheme.signature_curve),
+            S2N_ERR_INVALID_SIGNATURE_SCHEME);
+    conn->secure.conn_sig_scheme = chosen_sig_scheme;
+
     /* Verify signature */
     GUARD(s2n_stuffer_read_uint16(in, &signature_size));
     S2N_ERROR_IF(signature_size > s2n_stuffer_data_available(in), S2N_ERR_BAD_MESSAGE);
@@ -60,9 +65,11 @@ int s2n_server_cert_verify_recv(struct s2n_connection *conn)
     signed_content.size = signature_size;
     GUARD(s2n_stuffer_read_bytes(in, signed_content.data, signature_size));
 
-    GUARD(s2n_server_generate_unsigned_cert_verify_content(conn, &unsigned_content, chosen_sig_scheme.hash_alg));
+    GUARD(s2n_hash_new(&message_hash));
+    GUARD(s2n_hash_init(&message_hash, chosen_sig_scheme.hash_alg));
+    GUARD(s2n_server_generate_unsigned_cert_verify_content(conn, &unsigned_content));
     GUARD(s2n_hash_update(&message_hash, unsigned_content.blob.data, s2n_stuffer_data_available(&unsigned_content)));
-    GUARD(s2n_pkey_verify(&conn->secure.server_public_key, &message_hash, &signed_content));
+    GUARD(s2n_pkey_verify_with_sig_alg(&conn->secure.server_public_key, chosen_sig_scheme.sig_alg, &message_hash, &signed_content));
 
     return 0;
 }
@@ -79,26 +86,31 @@ int s2n_server_write_cert_verify_signature(struct s2n_connection *conn, struct s
     GUARD(s2n_alloc(&signed_content, maximum_signature_length));
     signed_content.size = maximum_signature_length;
 
-    GUARD(s2n_server_generate_unsigned_cert_verify_content(conn, &unsigned_content, conn->secure.conn_sig_scheme.hash_alg));
+    GUARD(s2n_server_generate_unsigned_cert_verify_content(conn, &unsigned_content));
 
     GUARD(s2n_hash_update(&message_hash, unsigned_content.blob.data, s2n_stuffer_data_available(&unsigned_content)));
-    GUARD(s2n_pkey_sign(conn->handshake_params.our_chain_and_key->private_key, &message_hash, &signed_content));
-    
+    GUARD(s2n_pkey_sign_with_sig_alg(conn->handshake_params.our_chain_and_key->private_key, conn->secure.conn_sig_scheme.sig_alg,
+            &message_hash, &signed_content));
+
     GUARD(s2n_stuffer_write_uint16(out, signed_content.size));
     GUARD(s2n_stuffer_write_bytes(out, signed_content.data, signed_content.size));
 
     return 0;
 }
 
-int s2n_server_generate_unsigned_cert_verify_content(struct s2n_connection *conn, struct s2n_stuffer *unsigned_content, s2n_hash_algorithm chosen_hash_alg)
+int s2n_server_generate_unsigned_cert_verify_content(struct s2n_connection *conn, struct s2n_stuffer *unsigned_content)
 {
     struct s2n_hash_state hash_copy;
+    s2n_hash_algorithm transcript_hash_alg;
     uint8_t hash_digest_length;
     uint8_t digest_out[S2N_MAX_DIGEST_LEN];
 
+    /* The transcript hash is the cipher suite's hash, not the one the SignatureScheme signs with */
+    GUARD(s2n_hmac_hash_alg(conn->secure.cipher_suite->tls12_prf_alg, &transcript_hash_alg));
+
     /* Copy current hash content */
-    GUARD(s2n_handshake_get_hash_state(conn, chosen_hash_alg, &hash_copy));
-    GUARD(s2n_hash_digest_size(chosen_hash_alg, &hash_digest_length));
+    GUARD(s2n_handshake_get_hash_state(conn, transcript_hash_alg, &hash_copy));
+    GUARD(s2n_hash_digest_size(transcript_hash_alg, &hash_digest_length));
     GUARD(s2n_hash_digest(&hash_copy, digest_out, hash_digest_length));
 
     /* Concatenate the content to be signed/verified */
@@ -21,7 +21,6 @@
 #include "tls/s2n_tls_parameters.h"
 #include "tls/s2n_connection.h"
 #include "tls/s2n_tls.h"
-#include "tls/s2n_tls13.h"
 #include "tls/s2n_kex.h"
 #include "tls/s2n_cipher_suites.h"
 
@@ -34,6 +33,7 @@
 #include "tls/extensions/s2n_server_server_name.h"
 #include "tls/extensions/s2n_server_supported_versions.h"
 #include "tls/extensions/s2n_server_key_share.h"
+#include "tls/extensions/s2n_server_pre_shared_key.h"
 
 #include "stuffer/s2n_stuffer.h"
 
@@ -86,6 +86,7 @@ int s2n_server_extensions_send(struct s2n_connection *conn, struct s2n_stuffer *
     if (conn->actual_protocol_version >= S2N_TLS13) {
         total_size += s2n_extensions_server_supported_versions_size();
         total_size += s2n_extensions_server_key_share_send_size(conn);
+        total_size += s2n_extensions_server_pre_shared_key_size(conn);
     }
 
     if (total_size == 0) {
@@ -153,9 +154,10 @@ int s2n_server_extensions_send(struct s2n_connection *conn, struct s2n_stuffer *
         GUARD(s2n_stuffer_write_uint16(out, 0));
     }
 
-    /* Write key share extension */
+    /* Write key share and pre_shared_key extensions */
     if (conn->actual_protocol_version >= S2N_TLS13) {
         GUARD(s2n_extensions_server_key_share_send(conn, out));
+        GUARD(s2n_extensions_server_pre_shared_key_send(conn, out));
     }
 
     return 0;
@@ -206,15 +208,20 @@ int s2n_server_extensions_recv(struct s2n_connection *conn, struct s2n_blob *ext
             GUARD(s2n_recv_server_session_ticket_ext(conn, &extension));
             break;
         case TLS_EXTENSION_SUPPORTED_VERSIONS:
-            if (s2n_is_tls13_enabled()) {
+            if (conn->client_protocol_version >= S2N_TLS13) {
                 GUARD(s2n_extensions_server_supported_versions_recv(conn, &extension));
             }
             break;
         case TLS_EXTENSION_KEY_SHARE:
-            if (s2n_is_tls13_enabled()) {
+            if (conn->client_protocol_version >= S2N_TLS13) {
                 GUARD(s2n_extensions_server_key_share_recv(conn, &extension));
             }
             break;
+        case TLS_EXTENSION_PRE_SHARED_KEY:
+            if (conn->client_protocol_version >= S2N_TLS13) {
+                GUARD(s2n_extensions_server_pre_shared_key_recv(conn, &extension));
+            }
+            break;
         }
     }
 
@@ -16,6 +16,7 @@
 #include <sys/param.h>
 
 #include <s2n.h>
+#include <string.h>
 #include <time.h>
 
 #include "crypto/s2n_fips.h"
@@ -36,6 +37,36 @@
 /* From RFC5246 7.4.1.2. */
 #define S2N_TLS_COMPRESSION_METHOD_NULL 0
 
+/* From RFC8446 4.1.3. */
+#define S2N_DOWNGRADE_PROTECTION_SIZE   8
+static const uint8_t tls12_downgrade_protection_bytes[] = { 0x44, 0x4F, 0x57, 0x4E, 0x47, 0x52, 0x44, 0x01 };
+static const uint8_t tls11_downgrade_protection_bytes[] = { 0x44, 0x4F, 0x57, 0x4E, 0x47, 0x52, 0x44, 0x00 };
+
+static int s2n_server_random_is_downgrade(struct s2n_connection *conn)
+{
+    const uint8_t *downgrade_bytes = &conn->secure.server_random[S2N_TLS_RANDOM_DATA_LEN - S2N_DOWNGRADE_PROTECTION_SIZE];
+
+    return !memcmp(downgrade_bytes, tls12_downgrade_protection_bytes, S2N_DOWNGRADE_PROTECTION_SIZE)
+        || !memcmp(downgrade_bytes, tls11_downgrade_protection_bytes, S2N_DOWNGRADE_PROTECTION_SIZE);
+}
+
+static int s2n_server_add_downgrade_mechanism(struct s2n_connection *conn)
+{
+    /* A server that supports TLS1.3 tells the client when it negotiates a lower version */
+    if (conn->server_protocol_version < S2N_TLS13 || conn->actual_protocol_version >= S2N_TLS13) {
+        return 0;
+    }
+
+    uint8_t *downgrade_bytes = &conn->secure.server_random[S2N_TLS_RANDOM_DATA_LEN - S2N_DOWNGRADE_PROTECTION_SIZE];
+    if (conn->actual_protocol_version == S2N_TLS12) {
+        memcpy_check(downgrade_bytes, tls12_downgrade_protection_bytes, S2N_DOWNGRADE_PROTECTION_SIZE);
+    } else {
+        memcpy_check(downgrade_bytes, tls11_downgrade_protection_bytes, S2N_DOWNGRADE_PROTECTION_SIZE);
+    }
+
+    return 0;
+}
+
 int s2n_server_hello_recv(struct s2n_connection *conn)
 {
     struct s2n_stuffer *in = &conn->handshake.io;
@@ -48,6 +79,13 @@ int s2n_server_hello_recv(struct s2n_connection *conn)
     GUARD(s2n_stuffer_read_bytes(in, protocol_version, S2N_TLS_PROTOCOL_VERSION_LEN));
     GUARD(s2n_stuffer_read_bytes(in, conn->secure.server_random, S2N_TLS_RANDOM_DATA_LEN));
 
+    /* A TLS1.3 server can ask for another ClientHello once, before the handshake is negotiated */
+    if (conn->client_protocol_version >= S2N_TLS13 && s2n_server_hello_is_retry(conn)) {
+        S2N_ERROR_IF(IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type), S2N_ERR_BAD_MESSAGE);
+        conn->handshake.handshake_type = NEGOTIATED | FULL_HANDSHAKE | HELLO_RETRY_REQUEST;
+    }
+    uint8_t hello_retry = s2n_conn_get_current_message_type(conn) == HELLO_RETRY_MSG;
+
     GUARD(s2n_stuffer_read_uint8(in, &session_id_len));
     S2N_ERROR_IF(session_id_len > S2N_TLS_SESSION_ID_MAX_LEN, S2N_ERR_BAD_MESSAGE);
     GUARD(s2n_stuffer_read_bytes(in, session_id, session_id_len));
@@ -74,11 +112,37 @@ int s2n_server_hello_recv(struct s2n_connection *conn)
     if (conn->server_protocol_version >= S2N_TLS13) {
         /* Check echoed session ID matches */
         S2N_ERROR_IF(session_id_len != conn->session_id_len || memcmp(session_id, conn->session_id, session_id_len), S2N_ERR_BAD_MESSAGE);
+
+        /* The ServerHello after a HelloRetryRequest keeps the cipher suite the retry was sent for */
+        S2N_ERROR_IF(IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type) && !hello_retry
+                && memcmp(conn->secure.cipher_suite->iana_value, cipher_suite_wire, S2N_TLS_CIPHER_SUITE_LEN), S2N_ERR_BAD_MESSAGE);
+
         conn->actual_protocol_version = conn->server_protocol_version;
         GUARD(s2n_set_cipher_as_client(conn, cipher_suite_wire));
+
+        if (conn->tls13_psk.accepted) {
+            /* A resumed session keeps the hash of the suite its ticket was issued with */
+            S2N_ERROR_IF(conn->tls13_psk.cipher_suite->tls12_prf_alg != conn->secure.cipher_suite->tls12_prf_alg, S2N_ERR_BAD_MESSAGE);
+
+            /* Without a key share from the server, the PSK is used in psk_ke mode */
+            conn->tls13_psk.ke_mode = conn->secure.server_ecc_params.ec_key ? TLS_PSK_DHE_KE_MODE : TLS_PSK_KE_MODE;
+        } else if (!hello_retry) {
+            /* The server didn't take the ticket, so it is no use anymore */
+            conn->client_ticket.size = 0;
+            memset_check(&conn->tls13_psk, 0, sizeof(conn->tls13_psk));
+        }
     } else {
         uint8_t actual_protocol_version;
 
+        /* A TLS1.3 ticket can't resume a TLS1.2 session */
+        if (conn->tls13_psk.secret_size) {
+            conn->client_ticket.size = 0;
+        }
+        memset_check(&conn->tls13_psk, 0, sizeof(conn->tls13_psk));
+
+        /* A HelloRetryRequest is only sent when negotiating TLS1.3 */
+        S2N_ERROR_IF(IS_HELLO_RETRY_HANDSHAKE(conn->handshake.handshake_type), S2N_ERR_BAD_MESSAGE);
+
         conn->server_protocol_version = (uint8_t)(protocol_version[0] * 10) + protocol_version[1];
         const struct s2n_cipher_preferences *cipher_preferences;
         GUARD(s2n_connection_get_cipher_preferences(conn, &cipher_preferences));
@@ -91,6 +155,12 @@ int s2n_server_hello_recv(struct s2n_connection *conn)
 
         actual_protocol_version = MIN(conn->server_protocol_version, conn->client_protocol_version);
 
+        /* A server that supports TLS1.3 only picks a lower version for a client that doesn't offer TLS1.3 */
+        if (conn->client_protocol_version >= S2N_TLS13 && s2n_server_random_is_downgrade(conn)) {
+            GUARD(s2n_queue_reader_unsupported_protocol_version_alert(conn));
+            S2N_ERROR(S2N_ERR_PROTOCOL_DOWNGRADE_DETECTED);
+        }
+
         /* Use the session state if server sent same session id as client sent in client hello */
         if (session_id_len != 0  && session_id_len == conn->session_id_len
                 && !memcmp(session_id, conn->session_id, session_id_len)) {
@@ -115,15 +185,26 @@ int s2n_server_hello_recv(struct s2n_connection *conn)
 
     conn->actual_protocol_version_established = 1;
 
+    /* Early data can't survive a HelloRetryRequest or a downgrade */
+    if (hello_retry || conn->actual_protocol_version < S2N_TLS13) {
+        GUARD(s2n_early_data_client_reject(conn));
+    }
+
     GUARD(s2n_conn_set_handshake_type(conn));
 
-    if (IS_RESUMPTION_HANDSHAKE(conn->handshake.handshake_type)) {
+    /* TLS1.3 keys come from the key schedule, and the client may still be sending early data */
+    if (IS_RESUMPTION_HANDSHAKE(conn->handshake.handshake_type) && conn->actual_protocol_version < S2N_TLS13) {
         GUARD(s2n_prf_key_expansion(conn));
     }
 
     /* We've selected the cipher, update the required hashes for this connection */
     GUARD(s2n_conn_update_required_handshake_hashes(conn));
 
+    if (hello_retry) {
+        GUARD(s2n_server_hello_retry_recreate_transcript(conn));
+        return 0;
+    }
+
     /* Default our signature digest algorithm to SHA1. Will be used when verifying a client certificate. */
     conn->secure.conn_sig_scheme = s2n_rsa_pkcs1_sha1;
     if (conn->actual_protocol_version < S2N_TLS12 && !s2n_is_in_fips_mode()
@@ -153,9 +234,14 @@ int s2n_server_hello_send(struct s2n_connection *conn)
     notnull_check(r.data);
     GUARD(s2n_get_public_random_data(&r));
 
-    protocol_version[0] = (uint8_t)(conn->actual_protocol_version / 10);
-    protocol_version[1] = (uint8_t)(conn->actual_protocol_version % 10);
+    GUARD(s2n_server_add_downgrade_mechanism(conn));
 
+    /* TLS1.3 fixes legacy_version at TLS1.2 and negotiates the version with the supported_versions extension,
+     * see https://tools.ietf.org/html/rfc8446#section-4.1.3
+     */
+    uint8_t reported_protocol_version = MIN(conn->actual_protocol_version, S2N_TLS12);
+    protocol_version[0] = (uint8_t)(reported_protocol_version / 10);
+    protocol_version[1] = (uint8_t)(reported_protocol_version % 10);
 
     GUARD(s2n_stuffer_write_bytes(out, protocol_version, S2N_TLS_PROTOCOL_VERSION_LEN));
     GUARD(s2n_stuffer_write_bytes(out, conn->secure.server_random, S2N_TLS_RANDOM_DATA_LEN));
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <string.h>
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_connection.h"
+#include "tls/s2n_tls.h"
+#include "tls/s2n_tls13_handshake.h"
+#include "tls/extensions/s2n_server_key_share.h"
+#include "tls/extensions/s2n_server_supported_versions.h"
+
+#include "stuffer/s2n_stuffer.h"
+
+#include "utils/s2n_safety.h"
+
+/* From RFC5246 7.4.1.2. */
+#define S2N_TLS_COMPRESSION_METHOD_NULL 0
+
+/* A HelloRetryRequest is a ServerHello with this random, the SHA-256 of "HelloRetryRequest".
+ * See https://tools.ietf.org/html/rfc8446#section-4.1.3
+ */
+static const uint8_t hello_retry_req_random[S2N_TLS_RANDOM_DATA_LEN] = {
+    0xCF, 0x21, 0xAD, 0x74, 0xE5, 0x9A, 0x61, 0x11, 0xBE, 0x1D, 0x8C, 0x02, 0x1E, 0x65, 0xB8, 0x91,
+    0xC2, 0xA2, 0x11, 0x16, 0x7A, 0xBB, 0x8C, 0x5E, 0x07, 0x9E, 0x09, 0xE2, 0xC8, 0xA8, 0x33, 0x9C
+};
+
+int s2n_server_hello_is_retry(struct s2n_connection *conn)
+{
+    return !memcmp(conn->secure.server_random, hello_retry_req_random, S2N_TLS_RANDOM_DATA_LEN);
+}
+
+/* The first ClientHello is only hashed into the transcript as a message_hash message,
+ * see https://tools.ietf.org/html/rfc8446#section-4.4.1
+ */
+int s2n_server_hello_retry_recreate_transcript(struct s2n_connection *conn)
+{
+    notnull_check(conn->secure.cipher_suite);
+
+    s2n_tls13_connection_keys(keys, conn);
+    GUARD(s2n_handshake_hash_as_message_hash(&conn->handshake, keys.hash_algorithm));
+
+    return 0;
+}
+
+int s2n_server_hello_retry_send(struct s2n_connection *conn)
+{
+    struct s2n_stuffer *out = &conn->handshake.io;
+    uint8_t protocol_version[S2N_TLS_PROTOCOL_VERSION_LEN] = { S2N_TLS12 / 10, S2N_TLS12 % 10 };
+
+    /* The HelloRetryRequest is hashed after the first ClientHello has been replaced */
+    GUARD(s2n_server_hello_retry_recreate_transcript(conn));
+
+    GUARD(s2n_stuffer_write_bytes(out, protocol_version, S2N_TLS_PROTOCOL_VERSION_LEN));
+    GUARD(s2n_stuffer_write_bytes(out, hello_retry_req_random, S2N_TLS_RANDOM_DATA_LEN));
+    GUARD(s2n_stuffer_write_uint8(out, conn->session_id_len));
+    GUARD(s2n_stuffer_write_bytes(out, conn->session_id, conn->session_id_len));
+    GUARD(s2n_stuffer_write_bytes(out, conn->secure.cipher_suite->iana_value, S2N_TLS_CIPHER_SUITE_LEN));
+    GUARD(s2n_stuffer_write_uint8(out, S2N_TLS_COMPRESSION_METHOD_NULL));
+
+    /* Only the negotiated version and the group the client should send a key share for are needed */
+    GUARD(s2n_stuffer_write_uint16(out, s2n_extensions_server_supported_versions_size()
+            + s2n_extensions_server_key_share_retry_send_size(conn)));
+    GUARD(s2n_extensions_server_supported_versions_send(conn, out));
+    GUARD(s2n_extensions_server_key_share_retry_send(conn, out));
+
+    return 0;
+}
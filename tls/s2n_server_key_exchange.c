@@ -22,6 +22,7 @@
 #include "tls/s2n_kex.h"
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_connection.h"
+#include "tls/s2n_ephemeral_key_pool.h"
 #include "tls/s2n_signature_algorithms.h"
 
 #include "stuffer/s2n_stuffer.h"
@@ -31,7 +32,7 @@
 #include "utils/s2n_safety.h"
 #include "utils/s2n_random.h"
 
-static int s2n_write_signature_blob(struct s2n_stuffer *out, const struct s2n_pkey *priv_key, struct s2n_hash_state *digest);
+static int s2n_server_key_send_write_signature(struct s2n_connection *conn, struct s2n_blob *signature);
 
 int s2n_server_key_recv(struct s2n_connection *conn)
 {
@@ -45,14 +46,12 @@ int s2n_server_key_recv(struct s2n_connection *conn)
     GUARD(s2n_kex_server_key_recv_read_data(key_exchange, conn, &data_to_verify, &kex_data));
 
     /* Add common signature data */
+    struct s2n_signature_scheme negotiated_sig_scheme = conn->secure.conn_sig_scheme;
     if (conn->actual_protocol_version == S2N_TLS12) {
-        struct s2n_signature_scheme negotiated_sig_scheme;
         /* Verify the SigScheme picked by the Server was actually in the list we sent */
         GUARD(s2n_get_and_validate_negotiated_signature_scheme(conn, in, &negotiated_sig_scheme));
-        GUARD(s2n_hash_init(signature_hash, negotiated_sig_scheme.hash_alg));
-    } else {
-        GUARD(s2n_hash_init(signature_hash, conn->secure.conn_sig_scheme.hash_alg));
     }
+    GUARD(s2n_hash_init(signature_hash, negotiated_sig_scheme.hash_alg));
     GUARD(s2n_hash_update(signature_hash, conn->secure.client_random, S2N_TLS_RANDOM_DATA_LEN));
     GUARD(s2n_hash_update(signature_hash, conn->secure.server_random, S2N_TLS_RANDOM_DATA_LEN));
 
@@ -67,7 +66,8 @@ int s2n_server_key_recv(struct s2n_connection *conn)
     notnull_check(signature.data);
     gt_check(signature_length, 0);
 
-    S2N_ERROR_IF(s2n_pkey_verify(&conn->secure.server_public_key, signature_hash, &signature) < 0, S2N_ERR_BAD_MESSAGE);
+    S2N_ERROR_IF(s2n_pkey_verify_with_sig_alg(&conn->secure.server_public_key, negotiated_sig_scheme.sig_alg, signature_hash, &signature) < 0,
+            S2N_ERR_BAD_MESSAGE);
 
     /* We don't need the key any more, so free it */
     GUARD(s2n_pkey_free(&conn->secure.server_public_key));
@@ -220,6 +220,8 @@ int s2n_server_key_send(struct s2n_connection *conn)
     struct s2n_stuffer *out = &conn->handshake.io;
     struct s2n_blob data_to_sign = {0};
 
+    S2N_ASYNC_PKEY_GUARD(conn);
+
     /* Call the negotiated key exchange method to send it's data */
     GUARD(s2n_kex_server_key_send(key_exchange, conn, &data_to_sign));
 
@@ -236,8 +238,8 @@ int s2n_server_key_send(struct s2n_connection *conn)
     /* Add KEX specific data to the hash */
     GUARD(s2n_hash_update(signature_hash, data_to_sign.data, data_to_sign.size));
 
-    /* Sign and write the signature */
-    GUARD(s2n_write_signature_blob(out, conn->handshake_params.our_chain_and_key->private_key, signature_hash));
+    /* Sign and write the signature, possibly once an async private key operation completes */
+    GUARD(s2n_async_pkey_sign(conn, conn->secure.conn_sig_scheme.sig_alg, signature_hash, s2n_server_key_send_write_signature));
     return 0;
 }
 
@@ -245,8 +247,8 @@ int s2n_ecdhe_server_key_send(struct s2n_connection *conn, struct s2n_blob *data
 {
     struct s2n_stuffer *out = &conn->handshake.io;
 
-    /* Generate an ephemeral key and  */
-    GUARD(s2n_ecc_generate_ephemeral_key(&conn->secure.server_ecc_params));
+    /* Take an ephemeral key from the pool, or generate one */
+    GUARD(s2n_ephemeral_key_pool_take_ecc(&conn->secure.server_ecc_params));
 
     /* Write it out and calculate the data to sign later */
     GUARD(s2n_ecc_write_ecc_params(&conn->secure.server_ecc_params, out, data_to_sign));
@@ -257,11 +259,8 @@ int s2n_dhe_server_key_send(struct s2n_connection *conn, struct s2n_blob *data_t
 {
     struct s2n_stuffer *out = &conn->handshake.io;
 
-    /* Duplicate the DH key from the config */
-    GUARD(s2n_dh_params_copy(conn->config->dhparams, &conn->secure.server_dh_params));
-
-    /* Generate an ephemeral key */
-    GUARD(s2n_dh_generate_ephemeral_key(&conn->secure.server_dh_params));
+    /* Take an ephemeral key in the config's group from the pool, or generate one */
+    GUARD(s2n_ephemeral_key_pool_take_dh(conn->config->dhparams, &conn->secure.server_dh_params));
 
     /* Write it out and calculate the data to sign later */
     GUARD(s2n_dh_params_to_p_g_Ys(&conn->secure.server_dh_params, out, data_to_sign));
@@ -313,26 +312,11 @@ int s2n_hybrid_server_key_send(struct s2n_connection *conn, struct s2n_blob *tot
     return 0;
 }
 
-static int s2n_write_signature_blob(struct s2n_stuffer *out, const struct s2n_pkey *priv_key, struct s2n_hash_state *digest)
+static int s2n_server_key_send_write_signature(struct s2n_connection *conn, struct s2n_blob *signature)
 {
-    struct s2n_blob signature = {0};
-    
-    /* Leave signature length blank for now until we're done signing */
-    uint16_t sig_len = 0;
-    GUARD(s2n_stuffer_write_uint16(out, sig_len));
-    
-    int max_signature_size = s2n_pkey_size(priv_key);
-    signature.size = max_signature_size;
-    signature.data = s2n_stuffer_raw_write(out, signature.size);
-    notnull_check(signature.data);
-
-    S2N_ERROR_IF(s2n_pkey_sign(priv_key, digest, &signature) < 0, S2N_ERR_DH_FAILED_SIGNING);
-
-    /* Now that the signature has been created, write the actual size that was stored in the signature blob */
-    out->write_cursor -= max_signature_size;
-    out->write_cursor -= 2;
+    struct s2n_stuffer *out = &conn->handshake.io;
 
-    GUARD(s2n_stuffer_write_uint16(out, signature.size));
-    GUARD(s2n_stuffer_skip_write(out, signature.size));
+    GUARD(s2n_stuffer_write_uint16(out, signature->size));
+    GUARD(s2n_stuffer_write(out, signature));
     return 0;
 }
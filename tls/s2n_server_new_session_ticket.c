@@ -24,6 +24,7 @@
 #include "tls/s2n_alerts.h"
 #include "tls/s2n_tls.h"
 #include "tls/s2n_resume.h"
+#include "tls/s2n_tls13_handshake.h"
 
 #include "stuffer/s2n_stuffer.h"
 
@@ -74,3 +75,142 @@ int s2n_server_nst_send(struct s2n_connection *conn)
 
     return 0;
 }
+
+/* Every connection issues a single ticket, so a fixed nonce still gives each ticket its own PSK */
+static uint8_t s2n_tls13_ticket_nonce[] = { 0 };
+
+/* From https://tools.ietf.org/html/rfc8446#section-4.6.1 :
+ *
+ *  struct {
+ *      uint32 ticket_lifetime;
+ *      uint32 ticket_age_add;
+ *      opaque ticket_nonce<0..255>;
+ *      opaque ticket<1..2^16-1>;
+ *      Extension extensions<0..2^16-2>;
+ *  } NewSessionTicket;
+ */
+int s2n_tls13_server_nst_send(struct s2n_connection *conn)
+{
+    struct s2n_stuffer *out = &conn->handshake.io;
+    struct s2n_tls13_psk psk = {0};
+
+    uint8_t data[S2N_TLS13_TICKET_SIZE_IN_BYTES];
+    struct s2n_blob entry = { .data = data, .size = sizeof(data) };
+    struct s2n_stuffer to;
+
+    uint32_t lifetime_in_secs = MIN(conn->config->session_state_lifetime_in_nanos / ONE_SEC_IN_NANOS,
+            S2N_TLS13_MAX_TICKET_LIFETIME_IN_SECS);
+
+    psk.cipher_suite = conn->secure.cipher_suite;
+    psk.max_early_data_size = conn->config->max_early_data_size;
+    GUARD(conn->config->wall_clock(conn->config->sys_clock_ctx, &psk.ticket_issue_time));
+
+    struct s2n_blob age_add = { .data = (uint8_t *) &psk.ticket_age_add, .size = sizeof(psk.ticket_age_add) };
+    GUARD(s2n_get_public_random_data(&age_add));
+
+    /* The ticket carries the PSK itself, so resuming doesn't need anything from this connection */
+    s2n_tls13_connection_keys(keys, conn);
+    psk.secret_size = keys.size;
+    struct s2n_blob resumption_master_secret = { .data = conn->secure.resumption_master_secret, .size = keys.size };
+    struct s2n_blob nonce = { .data = s2n_tls13_ticket_nonce, .size = sizeof(s2n_tls13_ticket_nonce) };
+    struct s2n_blob psk_secret = { .data = psk.secret, .size = psk.secret_size };
+    GUARD(s2n_tls13_derive_resumption_psk(&keys, &resumption_master_secret, &nonce, &psk_secret));
+
+    GUARD(s2n_stuffer_init(&to, &entry));
+    GUARD(s2n_tls13_encrypt_session_ticket(conn, &psk, &to));
+
+    GUARD(s2n_stuffer_write_uint32(out, lifetime_in_secs));
+    GUARD(s2n_stuffer_write_uint32(out, psk.ticket_age_add));
+    GUARD(s2n_stuffer_write_uint8(out, nonce.size));
+    GUARD(s2n_stuffer_write(out, &nonce));
+    uint16_t ticket_size = s2n_stuffer_data_available(&to);
+    GUARD(s2n_stuffer_write_uint16(out, ticket_size));
+    GUARD(s2n_stuffer_write_bytes(out, to.blob.data, ticket_size));
+
+    /* The early_data extension tells the client how much early data the ticket allows */
+    if (psk.max_early_data_size > 0) {
+        GUARD(s2n_stuffer_write_uint16(out, 2 + 2 + 4));
+        GUARD(s2n_stuffer_write_uint16(out, TLS_EXTENSION_EARLY_DATA));
+        GUARD(s2n_stuffer_write_uint16(out, 4));
+        GUARD(s2n_stuffer_write_uint32(out, psk.max_early_data_size));
+    } else {
+        GUARD(s2n_stuffer_write_uint16(out, 0));
+    }
+
+    GUARD(s2n_blob_zero(&psk_secret));
+
+    return 0;
+}
+
+/*
+ * Client receives a ticket after the handshake, and keeps it with the PSK it resumes
+ * in place of any earlier one.
+ */
+int s2n_tls13_server_nst_recv(struct s2n_connection *conn)
+{
+    struct s2n_stuffer *in = &conn->handshake.io;
+
+    uint32_t lifetime_in_secs;
+    GUARD(s2n_stuffer_read_uint32(in, &lifetime_in_secs));
+    S2N_ERROR_IF(lifetime_in_secs > S2N_TLS13_MAX_TICKET_LIFETIME_IN_SECS, S2N_ERR_BAD_MESSAGE);
+
+    uint32_t ticket_age_add;
+    GUARD(s2n_stuffer_read_uint32(in, &ticket_age_add));
+
+    uint8_t nonce_size;
+    GUARD(s2n_stuffer_read_uint8(in, &nonce_size));
+    struct s2n_blob nonce = { .size = nonce_size };
+    nonce.data = s2n_stuffer_raw_read(in, nonce.size);
+    notnull_check(nonce.data);
+
+    uint16_t session_ticket_len;
+    GUARD(s2n_stuffer_read_uint16(in, &session_ticket_len));
+    S2N_ERROR_IF(session_ticket_len == 0, S2N_ERR_BAD_MESSAGE);
+    struct s2n_blob ticket = { .size = session_ticket_len };
+    ticket.data = s2n_stuffer_raw_read(in, ticket.size);
+    notnull_check(ticket.data);
+
+    /* Only the early_data extension is understood, any others are skipped */
+    uint16_t extensions_size;
+    GUARD(s2n_stuffer_read_uint16(in, &extensions_size));
+    S2N_ERROR_IF(s2n_stuffer_data_available(in) != extensions_size, S2N_ERR_BAD_MESSAGE);
+
+    uint32_t max_early_data_size = 0;
+    while (s2n_stuffer_data_available(in)) {
+        uint16_t extension_type;
+        uint16_t extension_size;
+        GUARD(s2n_stuffer_read_uint16(in, &extension_type));
+        GUARD(s2n_stuffer_read_uint16(in, &extension_size));
+        S2N_ERROR_IF(extension_size > s2n_stuffer_data_available(in), S2N_ERR_BAD_MESSAGE);
+
+        if (extension_type == TLS_EXTENSION_EARLY_DATA) {
+            S2N_ERROR_IF(extension_size != 4, S2N_ERR_BAD_MESSAGE);
+            GUARD(s2n_stuffer_read_uint32(in, &max_early_data_size));
+        } else {
+            GUARD(s2n_stuffer_skip_read(in, extension_size));
+        }
+    }
+
+    /* A lifetime of zero means the ticket must be discarded right away */
+    if (!conn->config->use_tickets || lifetime_in_secs == 0) {
+        return 0;
+    }
+
+    struct s2n_tls13_psk *psk = &conn->tls13_psk;
+    s2n_tls13_connection_keys(keys, conn);
+    struct s2n_blob resumption_master_secret = { .data = conn->secure.resumption_master_secret, .size = keys.size };
+    struct s2n_blob psk_secret = { .data = psk->secret, .size = keys.size };
+    GUARD(s2n_tls13_derive_resumption_psk(&keys, &resumption_master_secret, &nonce, &psk_secret));
+
+    psk->secret_size = keys.size;
+    psk->cipher_suite = conn->secure.cipher_suite;
+    psk->ticket_age_add = ticket_age_add;
+    psk->max_early_data_size = max_early_data_size;
+    GUARD(conn->config->wall_clock(conn->config->sys_clock_ctx, &psk->ticket_issue_time));
+    conn->ticket_lifetime_hint = lifetime_in_secs;
+
+    GUARD(s2n_realloc(&conn->client_ticket, ticket.size));
+    memcpy_check(conn->client_ticket.data, ticket.data, ticket.size);
+
+    return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_certificate.h"
+#include "crypto/s2n_ecdsa.h"
+
+#include "error/s2n_errno.h"
+
+#include "tls/s2n_async_pkey.h"
+#include "tls/s2n_config.h"
+#include "tls/s2n_connection.h"
+#include "tls/s2n_sign_engine.h"
+
+#include "utils/s2n_blob.h"
+#include "utils/s2n_mem.h"
+#include "utils/s2n_safety.h"
+
+static uint64_t s2n_sign_engine_now(void)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void s2n_sign_engine_append(struct s2n_async_pkey_op **head, struct s2n_async_pkey_op **tail,
+                                   struct s2n_async_pkey_op *first, struct s2n_async_pkey_op *last)
+{
+    if (*tail) {
+        (*tail)->next = first;
+    } else {
+        *head = first;
+    }
+    *tail = last;
+}
+
+/* Hands performed operations back to the event loop. Called without the lock held. */
+static void s2n_sign_engine_publish(struct s2n_sign_engine *engine, struct s2n_async_pkey_op *first, struct s2n_async_pkey_op *last)
+{
+    pthread_mutex_lock(&engine->lock);
+    int was_empty = engine->done_head == NULL;
+    s2n_sign_engine_append(&engine->done_head, &engine->done_tail, first, last);
+    pthread_mutex_unlock(&engine->lock);
+
+    /* If the pipe is full it is readable already, so a failed write loses nothing */
+    if (was_empty) {
+        uint8_t byte = 0;
+        if (write(engine->notify_fds[1], &byte, 1) < 0) {
+            return;
+        }
+    }
+}
+
+static void s2n_sign_engine_perform_batch(struct s2n_sign_engine *engine, struct s2n_async_pkey_op *batch)
+{
+    uint64_t start = s2n_sign_engine_now();
+    struct s2n_async_pkey_op *first = batch;
+
+    while (batch) {
+        struct s2n_async_pkey_op *op = batch;
+        batch = op->next;
+
+        /* A failed operation goes back like any other, applying it fails the handshake */
+        s2n_async_pkey_op_perform(op);
+
+        /* Once the batch has used up its latency budget, what is done so far goes back
+         * straight away, rather than making the first operations wait for the last.
+         */
+        uint64_t now = s2n_sign_engine_now();
+        if (batch == NULL || now - start >= engine->max_batch_latency_in_nanos) {
+            op->next = NULL;
+            s2n_sign_engine_publish(engine, first, op);
+            first = batch;
+            start = now;
+        }
+    }
+}
+
+/* Returns a key that is short of precomputed nonces. Called with the lock held. */
+static const struct s2n_pkey *s2n_sign_engine_key_to_refill(struct s2n_sign_engine *engine)
+{
+    for (uint32_t i = 0; i < engine->precompute_key_count; i++) {
+        uint32_t missing = 0;
+        if (s2n_ecdsa_nonces_missing(engine->precompute_keys[i], &missing) == 0 && missing > 0) {
+            return engine->precompute_keys[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Called with the lock held */
+static void s2n_sign_engine_forget_key(struct s2n_sign_engine *engine, const struct s2n_pkey *key)
+{
+    for (uint32_t i = 0; i < engine->precompute_key_count; i++) {
+        if (engine->precompute_keys[i] == key) {
+            engine->precompute_keys[i] = engine->precompute_keys[--engine->precompute_key_count];
+            return;
+        }
+    }
+}
+
+static void *s2n_sign_engine_worker(void *arg)
+{
+    struct s2n_sign_engine *engine = arg;
+
+    pthread_mutex_lock(&engine->lock);
+    while (!engine->stopping) {
+        if (engine->queue_head == NULL) {
+            const struct s2n_pkey *key = s2n_sign_engine_key_to_refill(engine);
+            if (key == NULL) {
+                pthread_cond_wait(&engine->wakeup, &engine->lock);
+                continue;
+            }
+
+            /* One nonce at a time, so that a new operation never waits for more than one */
+            pthread_mutex_unlock(&engine->lock);
+            int result = s2n_ecdsa_nonces_precompute(key, 1);
+            pthread_mutex_lock(&engine->lock);
+
+            /* Signing still works without them, just more slowly */
+            if (result < 0) {
+                s2n_sign_engine_forget_key(engine, key);
+            }
+            continue;
+        }
+
+        struct s2n_async_pkey_op *batch = engine->queue_head;
+        struct s2n_async_pkey_op *last = batch;
+        for (uint32_t size = 1; last->next && size < engine->max_batch_size; size++) {
+            last = last->next;
+        }
+
+        engine->queue_head = last->next;
+        if (engine->queue_head == NULL) {
+            engine->queue_tail = NULL;
+        }
+        last->next = NULL;
+
+        pthread_mutex_unlock(&engine->lock);
+        s2n_sign_engine_perform_batch(engine, batch);
+        pthread_mutex_lock(&engine->lock);
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    s2n_cleanup();
+
+    return NULL;
+}
+
+static int s2n_sign_engine_free_ops(struct s2n_async_pkey_op *op)
+{
+    while (op) {
+        struct s2n_async_pkey_op *next = op->next;
+        GUARD(s2n_async_pkey_op_free(op));
+        op = next;
+    }
+
+    return 0;
+}
+
+static int s2n_sign_engine_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    S2N_ERROR_IF(flags < 0, S2N_ERR_BAD_FD);
+    S2N_ERROR_IF(fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0, S2N_ERR_BAD_FD);
+    S2N_ERROR_IF(fcntl(fd, F_SETFD, FD_CLOEXEC) < 0, S2N_ERR_BAD_FD);
+
+    return 0;
+}
+
+static int s2n_sign_engine_init(struct s2n_sign_engine *engine)
+{
+    S2N_ERROR_IF(pipe(engine->notify_fds) < 0, S2N_ERR_BAD_FD);
+    GUARD(s2n_sign_engine_set_nonblocking(engine->notify_fds[0]));
+    GUARD(s2n_sign_engine_set_nonblocking(engine->notify_fds[1]));
+
+    S2N_ERROR_IF(pthread_create(&engine->worker, NULL, s2n_sign_engine_worker, engine) != 0, S2N_ERR_LOCK);
+
+    return 0;
+}
+
+struct s2n_sign_engine *s2n_sign_engine_new(uint32_t max_batch_size, uint32_t max_batch_latency_in_us)
+{
+    struct s2n_blob mem = {0};
+
+    S2N_ERROR_IF_PTR(max_batch_size == 0, S2N_ERR_INVALID_ARGUMENT);
+
+    GUARD_PTR(s2n_alloc(&mem, sizeof(struct s2n_sign_engine)));
+    GUARD_PTR(s2n_blob_zero(&mem));
+
+    struct s2n_sign_engine *engine = (struct s2n_sign_engine *)(void *) mem.data;
+    engine->max_batch_size = max_batch_size;
+    engine->max_batch_latency_in_nanos = (uint64_t) max_batch_latency_in_us * 1000;
+    engine->notify_fds[0] = -1;
+    engine->notify_fds[1] = -1;
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->wakeup, NULL);
+
+    if (s2n_sign_engine_init(engine) < 0) {
+        for (int i = 0; i < 2; i++) {
+            if (engine->notify_fds[i] >= 0) {
+                close(engine->notify_fds[i]);
+            }
+        }
+        pthread_cond_destroy(&engine->wakeup);
+        pthread_mutex_destroy(&engine->lock);
+        GUARD_PTR(s2n_free(&mem));
+        return NULL;
+    }
+
+    return engine;
+}
+
+int s2n_sign_engine_free(struct s2n_sign_engine *engine)
+{
+    notnull_check(engine);
+
+    S2N_ERROR_IF(pthread_mutex_lock(&engine->lock) != 0, S2N_ERR_LOCK);
+    engine->stopping = 1;
+    pthread_cond_signal(&engine->wakeup);
+    S2N_ERROR_IF(pthread_mutex_unlock(&engine->lock) != 0, S2N_ERR_LOCK);
+    S2N_ERROR_IF(pthread_join(engine->worker, NULL) != 0, S2N_ERR_LOCK);
+
+    GUARD(s2n_sign_engine_free_ops(engine->queue_head));
+    GUARD(s2n_sign_engine_free_ops(engine->done_head));
+
+    close(engine->notify_fds[0]);
+    close(engine->notify_fds[1]);
+    pthread_cond_destroy(&engine->wakeup);
+    pthread_mutex_destroy(&engine->lock);
+
+    GUARD(s2n_free_object((uint8_t **) &engine, sizeof(struct s2n_sign_engine)));
+
+    return 0;
+}
+
+int s2n_sign_engine_add_cert_chain_and_key(struct s2n_sign_engine *engine, struct s2n_cert_chain_and_key *chain_and_key,
+                                           uint32_t ecdsa_nonces)
+{
+    notnull_check(engine);
+    notnull_check(chain_and_key);
+    notnull_check(chain_and_key->cert_chain);
+    notnull_check(chain_and_key->cert_chain->head);
+    notnull_check(chain_and_key->private_key);
+
+    /* Only ECDSA signatures have work that can be done before the message is known */
+    if (chain_and_key->cert_chain->head->cert_type != S2N_CERT_TYPE_ECDSA_SIGN || ecdsa_nonces == 0) {
+        return 0;
+    }
+
+    GUARD(s2n_ecdsa_nonces_init(chain_and_key->private_key, ecdsa_nonces));
+
+    S2N_ERROR_IF(pthread_mutex_lock(&engine->lock) != 0, S2N_ERR_LOCK);
+    int full = engine->precompute_key_count == S2N_SIGN_ENGINE_MAX_KEYS;
+    if (!full) {
+        s2n_sign_engine_forget_key(engine, chain_and_key->private_key);
+        engine->precompute_keys[engine->precompute_key_count++] = chain_and_key->private_key;
+        pthread_cond_signal(&engine->wakeup);
+    }
+    S2N_ERROR_IF(pthread_mutex_unlock(&engine->lock) != 0, S2N_ERR_LOCK);
+    S2N_ERROR_IF(full, S2N_ERR_INVALID_ARGUMENT);
+
+    return 0;
+}
+
+int s2n_sign_engine_get_fd(struct s2n_sign_engine *engine)
+{
+    notnull_check(engine);
+
+    return engine->notify_fds[0];
+}
+
+int s2n_sign_engine_poll(struct s2n_sign_engine *engine, struct s2n_connection **conns, uint32_t max_conns, uint32_t *conn_count)
+{
+    notnull_check(engine);
+    notnull_check(conns);
+    notnull_check(conn_count);
+
+    *conn_count = 0;
+
+    /* Drain the notification before taking the list, so that one written in between isn't lost */
+    uint8_t drain[64];
+    while (read(engine->notify_fds[0], drain, sizeof(drain)) > 0);
+
+    S2N_ERROR_IF(pthread_mutex_lock(&engine->lock) != 0, S2N_ERR_LOCK);
+    struct s2n_async_pkey_op *done = engine->done_head;
+    struct s2n_async_pkey_op *last = NULL;
+    for (uint32_t taken = 0; engine->done_head && taken < max_conns; taken++) {
+        last = engine->done_head;
+        engine->done_head = last->next;
+    }
+    if (engine->done_head == NULL) {
+        engine->done_tail = NULL;
+    }
+    int more = engine->done_head != NULL;
+    S2N_ERROR_IF(pthread_mutex_unlock(&engine->lock) != 0, S2N_ERR_LOCK);
+
+    if (last == NULL) {
+        return 0;
+    }
+    last->next = NULL;
+
+    /* Keep the descriptor readable for whatever didn't fit */
+    if (more) {
+        uint8_t byte = 0;
+        S2N_ERROR_IF(write(engine->notify_fds[1], &byte, 1) < 0 && errno != EAGAIN, S2N_ERR_WRITE);
+    }
+
+    while (done) {
+        struct s2n_async_pkey_op *op = done;
+        struct s2n_connection *conn = op->conn;
+        done = op->next;
+
+        /* A connection that was wiped in the meantime doesn't want the result any more, even if it has
+         * started another handshake and is waiting on a new operation
+         */
+        if (s2n_async_pkey_op_apply(op, conn) == 0) {
+            conns[(*conn_count)++] = conn;
+        }
+        GUARD(s2n_async_pkey_op_free(op));
+    }
+
+    return 0;
+}
+
+int s2n_sign_engine_submit(struct s2n_connection *conn, struct s2n_async_pkey_op *op)
+{
+    struct s2n_sign_engine *engine = conn->config->sign_engine;
+    op->next = NULL;
+
+    if (engine == NULL) {
+        GUARD(s2n_async_pkey_op_free(op));
+        S2N_ERROR(S2N_ERR_NULL);
+    }
+
+    S2N_ERROR_IF(pthread_mutex_lock(&engine->lock) != 0, S2N_ERR_LOCK);
+    s2n_sign_engine_append(&engine->queue_head, &engine->queue_tail, op, op);
+    pthread_cond_signal(&engine->wakeup);
+    S2N_ERROR_IF(pthread_mutex_unlock(&engine->lock) != 0, S2N_ERR_LOCK);
+
+    return 0;
+}
+
+int s2n_config_set_sign_engine(struct s2n_config *config, struct s2n_sign_engine *engine)
+{
+    notnull_check(config);
+
+    config->sign_engine = engine;
+    config->async_pkey_cb = engine ? s2n_sign_engine_submit : NULL;
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <s2n.h>
+
+#include "crypto/s2n_pkey.h"
+
+#include "tls/s2n_async_pkey.h"
+
+#define S2N_SIGN_ENGINE_MAX_KEYS 16
+
+/* Private key operations from any number of connections are queued up for a
+ * worker thread, which performs them in batches and hands each batch back to
+ * the event loop in one go. While the queue is empty, the worker refills the
+ * precomputed ECDSA nonces of the keys it has been given.
+ */
+struct s2n_sign_engine {
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    uint32_t max_batch_size;
+    uint64_t max_batch_latency_in_nanos;
+
+    /* Waiting to be performed, oldest first */
+    struct s2n_async_pkey_op *queue_head;
+    struct s2n_async_pkey_op *queue_tail;
+    /* Performed and waiting for s2n_sign_engine_poll() */
+    struct s2n_async_pkey_op *done_head;
+    struct s2n_async_pkey_op *done_tail;
+
+    const struct s2n_pkey *precompute_keys[S2N_SIGN_ENGINE_MAX_KEYS];
+    uint32_t precompute_key_count;
+
+    /* A byte is written to notify_fds[1] whenever done goes from empty to not empty */
+    int notify_fds[2];
+    unsigned stopping:1;
+};
+
+extern int s2n_sign_engine_submit(struct s2n_connection *conn, struct s2n_async_pkey_op *op);
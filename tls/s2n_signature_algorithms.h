@@ -17,6 +17,7 @@
 
 #include <s2n.h>
 
+#include "crypto/s2n_certificate.h"
 #include "crypto/s2n_hash.h"
 #include "crypto/s2n_signature.h"
 
@@ -29,6 +30,8 @@ struct s2n_sig_scheme_list {
     uint8_t len;
 };
 
+extern int s2n_get_auth_method_from_sig_alg(s2n_signature_algorithm in, s2n_authentication_method *out);
+
 extern int s2n_get_signature_scheme_pref_list(struct s2n_connection *conn, const struct s2n_signature_scheme* const** pref_list_out,
                                               size_t *list_len_out);
 
@@ -145,10 +145,10 @@ const struct s2n_signature_scheme s2n_rsa_pss_rsae_sha512 = {
 /* All Supported SignatureSchemes (Both TLS 1.2 and 1.3) to send in the ClientHello to the Server. */
 /* No MD5 to avoid SLOTH Vulnerability */
 const struct s2n_signature_scheme* const s2n_supported_sig_scheme_pref_list[] = {
-        /* RSA PSS - Commented out until it is actually supported */
-        /* &s2n_rsa_pss_rsae_sha256, */
-        /* &s2n_rsa_pss_rsae_sha384, */
-        /* &s2n_rsa_pss_rsae_sha512, */
+        /* RSA PSS */
+        &s2n_rsa_pss_rsae_sha256,
+        &s2n_rsa_pss_rsae_sha384,
+        &s2n_rsa_pss_rsae_sha512,
 
         /* RSA PKCS1 */
         &s2n_rsa_pkcs1_sha256,
@@ -174,10 +174,10 @@ const struct s2n_signature_scheme* const s2n_supported_sig_scheme_pref_list[] =
 /* Signature Scheme Preference List to use when picking a <=TLS 1.2 SignatureAlgorithm/SignatureScheme */
 /* As per RFC: This list MUST NOT contain any s2n_signature_scheme's with a non-null signature_curve defined. */
 const struct s2n_signature_scheme* const s2n_legacy_sig_scheme_pref_list[] = {
-        /* RSA PSS - Commented out until it is actually supported */
-        /* &s2n_rsa_pss_rsae_sha256, */
-        /* &s2n_rsa_pss_rsae_sha384, */
-        /* &s2n_rsa_pss_rsae_sha512, */
+        /* RSA PSS */
+        &s2n_rsa_pss_rsae_sha256,
+        &s2n_rsa_pss_rsae_sha384,
+        &s2n_rsa_pss_rsae_sha512,
 
         /* RSA PKCS1 */
         &s2n_rsa_pkcs1_sha256,
@@ -195,25 +195,17 @@ const struct s2n_signature_scheme* const s2n_legacy_sig_scheme_pref_list[] = {
 };
 
 /* Signature Scheme Preference List:  TLS 1.3 */
-/* This list MUST NOT contain any ECDSA s2n_signature_scheme's with a NULL signature_curve (except ECDSA_SHA1). */
+/* This list MUST NOT contain any ECDSA s2n_signature_scheme's with a NULL signature_curve. RSA PKCS1 and SHA-1 can't be
+ * used to sign TLS 1.3 handshake messages, see https://tools.ietf.org/html/rfc8446#section-4.2.3 */
 const struct s2n_signature_scheme * const s2n_tls13_sig_scheme_pref_list[] = {
-        /* RSA PSS - Commented out until it is actually supported */
-        /* &s2n_rsa_pss_rsae_sha256, */
-        /* &s2n_rsa_pss_rsae_sha384, */
-        /* &s2n_rsa_pss_rsae_sha512, */
-
-        /* RSA PKCS1 */
-        &s2n_rsa_pkcs1_sha256,
-        &s2n_rsa_pkcs1_sha384,
-        &s2n_rsa_pkcs1_sha512,
+        /* RSA PSS */
+        &s2n_rsa_pss_rsae_sha256,
+        &s2n_rsa_pss_rsae_sha384,
+        &s2n_rsa_pss_rsae_sha512,
 
         /* ECDSA */
         &s2n_ecdsa_secp256r1_sha256,
         &s2n_ecdsa_secp384r1_sha384,
-
-        /* SHA-1 Legacy */
-        &s2n_rsa_pkcs1_sha1,
-        &s2n_ecdsa_sha1,
 };
 
 const size_t s2n_supported_sig_scheme_pref_list_len = s2n_array_len(s2n_supported_sig_scheme_pref_list);
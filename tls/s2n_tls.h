@@ -31,6 +31,9 @@ extern int s2n_client_hello_retry_send(struct s2n_connection *conn);
 extern int s2n_client_hello_retry_recv(struct s2n_connection *conn);
 extern int s2n_server_hello_send(struct s2n_connection *conn);
 extern int s2n_server_hello_recv(struct s2n_connection *conn);
+extern int s2n_server_hello_retry_send(struct s2n_connection *conn);
+extern int s2n_server_hello_retry_recreate_transcript(struct s2n_connection *conn);
+extern int s2n_server_hello_is_retry(struct s2n_connection *conn);
 extern int s2n_encrypted_extensions_send(struct s2n_connection *conn);
 extern int s2n_encrypted_extensions_recv(struct s2n_connection *conn);
 extern int s2n_server_cert_send(struct s2n_connection *conn);
@@ -53,6 +56,8 @@ extern int s2n_client_cert_verify_recv(struct s2n_connection *conn);
 extern int s2n_client_cert_verify_send(struct s2n_connection *conn);
 extern int s2n_server_nst_send(struct s2n_connection *conn);
 extern int s2n_server_nst_recv(struct s2n_connection *conn);
+extern int s2n_tls13_server_nst_send(struct s2n_connection *conn);
+extern int s2n_tls13_server_nst_recv(struct s2n_connection *conn);
 extern int s2n_ccs_send(struct s2n_connection *conn);
 extern int s2n_basic_ccs_recv(struct s2n_connection *conn);
 extern int s2n_server_ccs_recv(struct s2n_connection *conn);
@@ -63,6 +68,8 @@ extern int s2n_server_finished_send(struct s2n_connection *conn);
 extern int s2n_server_finished_recv(struct s2n_connection *conn);
 extern int s2n_tls13_client_finished_send(struct s2n_connection *conn);
 extern int s2n_tls13_client_finished_recv(struct s2n_connection *conn);
+extern int s2n_end_of_early_data_send(struct s2n_connection *conn);
+extern int s2n_end_of_early_data_recv(struct s2n_connection *conn);
 extern int s2n_tls13_server_finished_send(struct s2n_connection *conn);
 extern int s2n_tls13_server_finished_recv(struct s2n_connection *conn);
 extern int s2n_process_client_hello(struct s2n_connection *conn);
@@ -97,5 +104,10 @@ extern uint16_t mfl_code_to_length[5];
 #define s2n_server_sending_nst(conn) ((conn)->config->use_tickets && \
         (conn)->session_ticket_status == S2N_NEW_TICKET)
 
+/* A TLS1.3 client that didn't send psk_key_exchange_modes can't use a ticket */
+#define s2n_tls13_server_can_send_nst(conn) ((conn)->config->use_tickets && \
+        (conn)->tls13_psk.ke_modes && \
+        s2n_config_is_encrypt_decrypt_key_available((conn)->config) == 1)
+
 #define s2n_server_can_send_kex(conn) \
     ((conn)->secure.cipher_suite->key_exchange_alg)
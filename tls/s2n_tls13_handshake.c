@@ -88,12 +88,18 @@ int s2n_tls13_handle_handshake_secrets(struct s2n_connection *conn)
     /* get tls13 key context */
     s2n_tls13_connection_keys(secrets, conn);
 
-    /* get shared secret */
+    /* get shared secret. A psk_ke handshake has no key exchange, so a 0-filled secret is used instead */
     DEFER_CLEANUP(struct s2n_blob shared_secret = { 0 }, s2n_free);
-    GUARD(s2n_tls13_compute_shared_secret(conn, &shared_secret));
+    if (IS_PSK_KE_ONLY(conn)) {
+        GUARD(s2n_alloc(&shared_secret, secrets.size));
+        GUARD(s2n_blob_zero(&shared_secret));
+    } else {
+        GUARD(s2n_tls13_compute_shared_secret(conn, &shared_secret));
+    }
 
-    /* derive early secrets */
-    GUARD(s2n_tls13_derive_early_secrets(&secrets));
+    /* derive early secrets, from the resumption PSK if the server accepted one */
+    struct s2n_blob psk = { .data = conn->tls13_psk.secret, .size = conn->tls13_psk.secret_size };
+    GUARD(s2n_tls13_derive_early_secrets(&secrets, conn->tls13_psk.accepted ? &psk : NULL));
 
     /* produce handshake secrets */
     s2n_stack_blob(client_hs_secret, secrets.size, S2N_TLS13_SECRET_MAX_LEN);
@@ -108,15 +114,20 @@ int s2n_tls13_handle_handshake_secrets(struct s2n_connection *conn)
     struct s2n_blob server_hs_iv = { .data = conn->secure.server_implicit_iv, .size = S2N_TLS13_FIXED_IV_LEN };
     GUARD(s2n_tls13_derive_traffic_keys(&secrets, &server_hs_secret, &server_hs_key, &server_hs_iv));
 
-    s2n_tls13_key_blob(client_hs_key, conn->secure.cipher_suite->record_alg->cipher->key_material_size);
-    struct s2n_blob client_hs_iv = { .data = conn->secure.client_implicit_iv, .size = S2N_TLS13_FIXED_IV_LEN };
-    GUARD(s2n_tls13_derive_traffic_keys(&secrets, &client_hs_secret, &client_hs_key, &client_hs_iv));
-
     GUARD(conn->secure.cipher_suite->record_alg->cipher->init(&conn->secure.server_key));
-    GUARD(conn->secure.cipher_suite->record_alg->cipher->init(&conn->secure.client_key));
-
     GUARD(conn->secure.cipher_suite->record_alg->cipher->set_decryption_key(&conn->secure.server_key, &server_hs_key));
-    GUARD(conn->secure.cipher_suite->record_alg->cipher->set_encryption_key(&conn->secure.client_key, &client_hs_key));
+
+    /* The client keeps protecting its early data with the early traffic key until the EndOfEarlyData */
+    if (s2n_early_data_in_flight(conn)) {
+        memcpy_check(conn->early_data.client_handshake_secret, client_hs_secret.data, client_hs_secret.size);
+    } else {
+        s2n_tls13_key_blob(client_hs_key, conn->secure.cipher_suite->record_alg->cipher->key_material_size);
+        struct s2n_blob client_hs_iv = { .data = conn->secure.client_implicit_iv, .size = S2N_TLS13_FIXED_IV_LEN };
+        GUARD(s2n_tls13_derive_traffic_keys(&secrets, &client_hs_secret, &client_hs_key, &client_hs_iv));
+
+        GUARD(conn->secure.cipher_suite->record_alg->cipher->init(&conn->secure.client_key));
+        GUARD(conn->secure.cipher_suite->record_alg->cipher->set_encryption_key(&conn->secure.client_key, &client_hs_key));
+    }
 
     /* calculate server + client finished keys and store them in handshake struct */
     struct s2n_blob server_finished_key = { .data = conn->handshake.server_finished, .size = secrets.size };
@@ -133,6 +144,73 @@ int s2n_tls13_handle_handshake_secrets(struct s2n_connection *conn)
     return 0;
 }
 
+/*
+ * This function executes after the first ClientHello of a handshake with early data is
+ * processed. It derives the client early traffic key that protects the early data.
+ */
+int s2n_tls13_handle_early_traffic_secret(struct s2n_connection *conn)
+{
+    /* get tls13 key context */
+    s2n_tls13_connection_keys(keys, conn);
+
+    struct s2n_blob psk = { .data = conn->tls13_psk.secret, .size = conn->tls13_psk.secret_size };
+    GUARD(s2n_tls13_derive_early_secrets(&keys, &psk));
+
+    s2n_stack_blob(client_early_secret, keys.size, S2N_TLS13_SECRET_MAX_LEN);
+
+    struct s2n_hash_state hash_state = {0};
+    GUARD(s2n_handshake_get_hash_state(conn, keys.hash_algorithm, &hash_state));
+    GUARD(s2n_tls13_derive_client_early_traffic_secret(&keys, &hash_state, &client_early_secret));
+
+    s2n_tls13_key_blob(client_early_key, conn->secure.cipher_suite->record_alg->cipher->key_material_size);
+    struct s2n_blob client_early_iv = { .data = conn->secure.client_implicit_iv, .size = S2N_TLS13_FIXED_IV_LEN };
+    GUARD(s2n_tls13_derive_traffic_keys(&keys, &client_early_secret, &client_early_key, &client_early_iv));
+
+    GUARD(conn->secure.cipher_suite->record_alg->cipher->init(&conn->secure.client_key));
+    GUARD(conn->secure.cipher_suite->record_alg->cipher->set_encryption_key(&conn->secure.client_key, &client_early_key));
+
+    return 0;
+}
+
+/*
+ * Configures the client handshake traffic key that s2n_tls13_handle_handshake_secrets()
+ * put aside while early data was in flight
+ */
+int s2n_tls13_handle_client_handshake_secret(struct s2n_connection *conn)
+{
+    /* get tls13 key context */
+    s2n_tls13_connection_keys(keys, conn);
+
+    struct s2n_blob client_hs_secret = { .data = conn->early_data.client_handshake_secret, .size = keys.size };
+
+    s2n_tls13_key_blob(client_hs_key, conn->secure.cipher_suite->record_alg->cipher->key_material_size);
+    struct s2n_blob client_hs_iv = { .data = conn->secure.client_implicit_iv, .size = S2N_TLS13_FIXED_IV_LEN };
+    GUARD(s2n_tls13_derive_traffic_keys(&keys, &client_hs_secret, &client_hs_key, &client_hs_iv));
+
+    GUARD(conn->secure.cipher_suite->record_alg->cipher->init(&conn->secure.client_key));
+    GUARD(conn->secure.cipher_suite->record_alg->cipher->set_encryption_key(&conn->secure.client_key, &client_hs_key));
+
+    GUARD(s2n_blob_zero(&client_hs_secret));
+
+    return 0;
+}
+
+/*
+ * Saves the transcript up to the ServerFinished, for a handshake where the
+ * EndOfEarlyData comes between the ServerFinished and the ClientFinished
+ */
+int s2n_tls13_save_server_finished_hash(struct s2n_connection *conn)
+{
+    /* get tls13 key context */
+    s2n_tls13_connection_keys(keys, conn);
+
+    struct s2n_hash_state hash_state = {0};
+    GUARD(s2n_handshake_get_hash_state(conn, keys.hash_algorithm, &hash_state));
+    GUARD(s2n_hash_copy(&conn->handshake.hashes->server_finished_hash_copy, &hash_state));
+
+    return 0;
+}
+
 /*
  * This must be called after ServerFinished
  */
@@ -145,8 +223,13 @@ int s2n_tls13_handle_application_secrets(struct s2n_connection *conn)
     s2n_stack_blob(client_app_secret, keys.size, S2N_TLS13_SECRET_MAX_LEN);
     s2n_stack_blob(server_app_secret, keys.size, S2N_TLS13_SECRET_MAX_LEN);
 
+    /* The application secrets don't cover an EndOfEarlyData */
     struct s2n_hash_state hash_state = {0};
-    GUARD(s2n_handshake_get_hash_state(conn, keys.hash_algorithm, &hash_state));
+    if (IS_EARLY_DATA_HANDSHAKE(conn->handshake.handshake_type)) {
+        hash_state = conn->handshake.hashes->server_finished_hash_copy;
+    } else {
+        GUARD(s2n_handshake_get_hash_state(conn, keys.hash_algorithm, &hash_state));
+    }
     GUARD(s2n_tls13_derive_application_secrets(&keys, &hash_state, &client_app_secret, &server_app_secret));
 
     s2n_tls13_key_blob(s_app_key, conn->secure.cipher_suite->record_alg->cipher->key_material_size);
@@ -163,3 +246,57 @@ int s2n_tls13_handle_application_secrets(struct s2n_connection *conn)
 
     return 0;
 }
+
+/*
+ * This must be called after ClientFinished
+ */
+int s2n_tls13_handle_resumption_master_secret(struct s2n_connection *conn)
+{
+    /* get tls13 key context */
+    s2n_tls13_connection_keys(keys, conn);
+
+    struct s2n_blob resumption_master_secret = { .data = conn->secure.resumption_master_secret, .size = keys.size };
+
+    struct s2n_hash_state hash_state = {0};
+    GUARD(s2n_handshake_get_hash_state(conn, keys.hash_algorithm, &hash_state));
+    GUARD(s2n_tls13_derive_resumption_master_secret(&keys, &hash_state, &resumption_master_secret));
+
+    return 0;
+}
+
+/*
+ * Computes the binder for a PSK over the transcript so far followed by the
+ * ClientHello up to its binders list.
+ * See https://tools.ietf.org/html/rfc8446#section-4.2.11.2
+ */
+int s2n_tls13_compute_psk_binder(struct s2n_connection *conn, struct s2n_tls13_psk *psk,
+        struct s2n_blob *partial_client_hello, struct s2n_blob *binder)
+{
+    notnull_check(psk->cipher_suite);
+
+    DEFER_CLEANUP(struct s2n_tls13_keys keys = {0}, s2n_tls13_keys_free);
+    GUARD(s2n_tls13_keys_init(&keys, psk->cipher_suite->tls12_prf_alg));
+    eq_check(binder->size, keys.size);
+
+    struct s2n_blob psk_secret = { .data = psk->secret, .size = psk->secret_size };
+    GUARD(s2n_tls13_derive_early_secrets(&keys, &psk_secret));
+
+    s2n_tls13_key_blob(binder_key, keys.size);
+    GUARD(s2n_tls13_derive_binder_key(&keys, &binder_key));
+
+    s2n_tls13_key_blob(finished_key, keys.size);
+    GUARD(s2n_tls13_derive_finished_key(&keys, &binder_key, &finished_key));
+
+    /* the transcript hash is shared with the connection, so the truncated ClientHello goes into a copy */
+    struct s2n_hash_state transcript = {0};
+    GUARD(s2n_handshake_get_hash_state(conn, keys.hash_algorithm, &transcript));
+
+    DEFER_CLEANUP(struct s2n_hash_state hash_state = {0}, s2n_hash_free);
+    GUARD(s2n_hash_new(&hash_state));
+    GUARD(s2n_hash_copy(&hash_state, &transcript));
+    GUARD(s2n_hash_update(&hash_state, partial_client_hello->data, partial_client_hello->size));
+
+    GUARD(s2n_tls13_calculate_finished_mac(&keys, &finished_key, &hash_state, binder));
+
+    return 0;
+}
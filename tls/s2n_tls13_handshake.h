@@ -33,6 +33,12 @@ int s2n_tls13_mac_verify(struct s2n_tls13_keys *keys, struct s2n_blob *finished_
 
 int s2n_tls13_keys_from_conn(struct s2n_tls13_keys *keys, struct s2n_connection *conn);
 
+int s2n_tls13_handle_early_traffic_secret(struct s2n_connection *conn);
 int s2n_tls13_handle_handshake_secrets(struct s2n_connection *conn);
+int s2n_tls13_handle_client_handshake_secret(struct s2n_connection *conn);
+int s2n_tls13_save_server_finished_hash(struct s2n_connection *conn);
 int s2n_tls13_handle_application_secrets(struct s2n_connection *conn);
+int s2n_tls13_handle_resumption_master_secret(struct s2n_connection *conn);
+int s2n_tls13_compute_psk_binder(struct s2n_connection *conn, struct s2n_tls13_psk *psk,
+        struct s2n_blob *partial_client_hello, struct s2n_blob *binder);
 
@@ -89,9 +89,16 @@
 #define TLS_EXTENSION_RENEGOTIATION_INFO   65281
 
 /* TLS 1.3 extensions from https://tools.ietf.org/html/rfc8446#section-4.2 */
+#define TLS_EXTENSION_PRE_SHARED_KEY       41
+#define TLS_EXTENSION_EARLY_DATA           42
 #define TLS_EXTENSION_SUPPORTED_VERSIONS   43
+#define TLS_EXTENSION_PSK_KEY_EXCHANGE_MODES 45
 #define TLS_EXTENSION_KEY_SHARE            51
 
+/* PskKeyExchangeMode from https://tools.ietf.org/html/rfc8446#section-4.2.9 */
+#define TLS_PSK_KE_MODE                     0
+#define TLS_PSK_DHE_KE_MODE                 1
+
 /* TLS Signature Algorithms - RFC 5246 7.4.1.4.1 */
 /* https://www.iana.org/assignments/tls-parameters/tls-parameters.xhtml#tls-parameters-16 */
 #define TLS_SIGNATURE_ALGORITHM_ANONYMOUS   0
@@ -217,6 +224,18 @@
 #define S2N_LARGE_RECORD_LENGTH S2N_TLS_MAXIMUM_RECORD_LENGTH
 #define S2N_LARGE_FRAGMENT_LENGTH S2N_TLS_MAXIMUM_FRAGMENT_LENGTH
 
+/* When sending more than one record worth of data, s2n encrypts records back
+ * to back into a buffer of up to this size and hands them to the socket with a
+ * single write.
+ */
+#define S2N_MAX_COALESCED_SEND_LENGTH (4 * S2N_LARGE_RECORD_LENGTH)
+
+/* The most s2n_connection_set_read_ahead() lets a connection buffer from a
+ * single read. buffer_in grows to this size, so it bounds the memory a
+ * connection holds for records it hasn't processed yet.
+ */
+#define S2N_MAX_READ_AHEAD_LENGTH (4 * S2N_LARGE_RECORD_LENGTH)
+
 /* Cap dynamic record resize threshold to 8M */
 #define S2N_TLS_MAX_RESIZE_THRESHOLD (1024 * 1024 * 8)
 
@@ -229,5 +248,8 @@
 /* Handshake messages have their own header too */
 #define TLS_HANDSHAKE_HEADER_LENGTH   4
 
+/* Handshake type of the synthetic message that stands in for a ClientHello after a HelloRetryRequest */
+#define TLS_MESSAGE_HASH            254
+
 #define S2N_MAX_SERVER_NAME 255
 
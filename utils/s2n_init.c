@@ -19,6 +19,10 @@
 #include "tls/s2n_cipher_preferences.h"
 #include "tls/s2n_cipher_suites.h"
 #include "tls/s2n_client_extensions.h"
+#include "tls/s2n_buffer_pool.h"
+#include "tls/s2n_connection_pool.h"
+#include "tls/s2n_ephemeral_key_pool.h"
+#include "tls/s2n_perf.h"
 #include "tls/extensions/s2n_client_key_share.h"
 
 #include "utils/s2n_mem.h"
@@ -68,6 +72,9 @@ int s2n_init(void)
         TLS_EXTENSION_PQ_KEM_PARAMETERS,
         TLS_EXTENSION_RENEGOTIATION_INFO,
         TLS_EXTENSION_KEY_SHARE,
+        TLS_EXTENSION_PRE_SHARED_KEY,
+        TLS_EXTENSION_PSK_KEY_EXCHANGE_MODES,
+        TLS_EXTENSION_EARLY_DATA,
     };
     static const uint16_t  num_extensions = sizeof(extensions) / sizeof(uint16_t);
     for (uint16_t i = 0; i < num_extensions; i++) {
@@ -85,15 +92,24 @@ int s2n_cleanup(void)
 {
     /* s2n_cleanup is supposed to be called from each thread before exiting,
      * so ensure that whatever clean ups we have here are thread safe */
+    GUARD(s2n_connection_pool_cleanup_thread());
+    GUARD(s2n_buffer_pool_cleanup_thread());
+    GUARD(s2n_ephemeral_key_pool_cleanup_thread());
+    GUARD(s2n_perf_cleanup_thread());
     GUARD(s2n_rand_cleanup_thread());
     return 0;
 }
 
 static void s2n_cleanup_atexit(void)
 {
+    s2n_connection_pool_cleanup_thread();
+    s2n_buffer_pool_cleanup_thread();
+    s2n_ephemeral_key_pool_cleanup_thread();
     s2n_rand_cleanup_thread();
     s2n_rand_cleanup();
-    s2n_mem_cleanup();
+    s2n_perf_cleanup();
     s2n_wipe_static_configs();
+    /* Last, so that nothing is freed back to the slabs after they are gone */
+    s2n_mem_cleanup();
 }
 
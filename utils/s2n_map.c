@@ -18,40 +18,172 @@
 
 #include "error/s2n_errno.h"
 
-#include "crypto/s2n_hash.h"
-
 #include "utils/s2n_safety.h"
 #include "utils/s2n_blob.h"
 #include "utils/s2n_mem.h"
 #include "utils/s2n_map.h"
 #include "utils/s2n_map_internal.h"
+#include "utils/s2n_random.h"
 
 #include <s2n.h>
 
 #define S2N_INITIAL_TABLE_SIZE 1024
 
-static int s2n_map_slot(struct s2n_map *map, struct s2n_blob *key, uint32_t *slot)
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                      \
+    do {                                                              \
+        v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32); \
+        v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2;                      \
+        v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0;                      \
+        v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32); \
+    } while (0)
+
+/* SipHash-2-4. Keys are often chosen by peers (SNI names for example), so a
+ * keyed hash stops them from piling entries up in one run of slots.
+ */
+static uint64_t s2n_map_siphash(const uint64_t k[2], const uint8_t *in, uint32_t len)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ k[1];
+    uint64_t b = ((uint64_t) len) << 56;
+    const uint8_t *end = in + len - (len % 8);
+
+    for (; in != end; in += 8) {
+        uint64_t m = 0;
+        for (int i = 7; i >= 0; i--) {
+            m = (m << 8) | in[i];
+        }
+
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    for (int i = (len % 8) - 1; i >= 0; i--) {
+        b |= ((uint64_t) in[i]) << (8 * i);
+    }
+
+    v3 ^= b;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+static uint32_t s2n_map_hash(struct s2n_map *map, struct s2n_blob *key)
+{
+    return (uint32_t) s2n_map_siphash(map->hash_key, key->data, key->size);
+}
+
+static uint8_t *s2n_map_entry_data(struct s2n_map_entry *entry)
+{
+    if ((uint64_t) entry->key_size + entry->value_size <= S2N_MAP_INLINE_SIZE) {
+        return entry->data.bytes;
+    }
+
+    return entry->data.ptr;
+}
+
+static int s2n_map_entry_init(struct s2n_map_entry *entry, uint32_t hash, struct s2n_blob *key, struct s2n_blob *value)
 {
-    union {
-        uint8_t u8[32];
-        uint32_t u32[8];
-    } digest;
+    ne_check(key->size, 0);
+    ne_check(value->size, 0);
+    S2N_ERROR_IF((uint64_t) key->size + value->size > UINT32_MAX, S2N_ERR_INTEGER_OVERFLOW);
+
+    *entry = (struct s2n_map_entry) {.key_size = key->size, .value_size = value->size, .hash = hash};
+
+    if (key->size + value->size > S2N_MAP_INLINE_SIZE) {
+        struct s2n_blob mem = {0};
+        GUARD(s2n_alloc(&mem, key->size + value->size));
+        entry->data.ptr = mem.data;
+    }
+
+    uint8_t *data = s2n_map_entry_data(entry);
+    memcpy_check(data, value->data, value->size);
+    memcpy_check(data + value->size, key->data, key->size);
 
-    GUARD(s2n_hash_update(&map->sha256, key->data, key->size));
-    GUARD(s2n_hash_digest(&map->sha256, digest.u8, sizeof(digest)));
+    return 0;
+}
+
+static int s2n_map_entry_free(struct s2n_map_entry *entry)
+{
+    if (entry->key_size + entry->value_size > S2N_MAP_INLINE_SIZE) {
+        GUARD(s2n_free_object(&entry->data.ptr, entry->key_size + entry->value_size));
+    }
 
-    GUARD(s2n_hash_reset(&map->sha256));
+    *entry = (struct s2n_map_entry) {0};
 
-    *slot = digest.u32[0] % map->capacity;
     return 0;
 }
 
+/* Finds the entry for key, or sets *entry to NULL if there isn't one */
+static void s2n_map_find(struct s2n_map *map, uint32_t hash, struct s2n_blob *key, struct s2n_map_entry **entry)
+{
+    uint32_t mask = map->capacity - 1;
+    uint32_t slot = hash & mask;
+
+    for (uint32_t distance = 1;; distance++) {
+        struct s2n_map_entry *candidate = &map->table[slot];
+
+        /* Robin Hood insertion means that the key, if present, would have displaced any
+         * entry closer to its own slot than we are. This also stops at empty slots.
+         */
+        if (candidate->distance < distance) {
+            *entry = NULL;
+            return;
+        }
+
+        if (candidate->hash == hash && candidate->key_size == key->size &&
+            !memcmp(s2n_map_entry_data(candidate) + candidate->value_size, key->data, key->size)) {
+            *entry = candidate;
+            return;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+}
+
+/* Moves entry into the table, which must have a free slot and not already hold the key */
+static void s2n_map_place(struct s2n_map *map, struct s2n_map_entry entry)
+{
+    uint32_t mask = map->capacity - 1;
+    uint32_t slot = entry.hash & mask;
+
+    entry.distance = 1;
+    while (map->table[slot].distance) {
+        /* Take the slot from entries that are closer to home than we are */
+        if (map->table[slot].distance < entry.distance) {
+            struct s2n_map_entry displaced = map->table[slot];
+            map->table[slot] = entry;
+            entry = displaced;
+        }
+
+        slot = (slot + 1) & mask;
+        entry.distance++;
+    }
+
+    map->table[slot] = entry;
+    map->size++;
+}
+
 static int s2n_map_embiggen(struct s2n_map *map, uint32_t capacity)
 {
     struct s2n_blob mem = {0};
     struct s2n_map tmp = {0};
 
     S2N_ERROR_IF(map->immutable, S2N_ERR_MAP_IMMUTABLE);
+    S2N_ERROR_IF(capacity > (UINT32_MAX / sizeof(struct s2n_map_entry)), S2N_ERR_INTEGER_OVERFLOW);
 
     GUARD(s2n_alloc(&mem, (capacity * sizeof(struct s2n_map_entry))));
     GUARD(s2n_blob_zero(&mem));
@@ -59,24 +191,30 @@ static int s2n_map_embiggen(struct s2n_map *map, uint32_t capacity)
     tmp.capacity = capacity;
     tmp.size = 0;
     tmp.table = (void *) mem.data;
-    tmp.immutable = 0;
-    tmp.sha256 = map->sha256;
 
+    /* Entries move over as they are, their keys and values stay where they are */
     for (int i = 0; i < map->capacity; i++) {
-        if (map->table[i].key.size) {
-            GUARD(s2n_map_add(&tmp, &map->table[i].key, &map->table[i].value));
-            GUARD(s2n_free(&map->table[i].key));
-            GUARD(s2n_free(&map->table[i].value));
+        if (map->table[i].distance) {
+            s2n_map_place(&tmp, map->table[i]);
         }
     }
-    GUARD(s2n_free_object((uint8_t **)&map->table, map->capacity * sizeof(struct s2n_map_entry)));
+    if (map->table) {
+        GUARD(s2n_free_object((uint8_t **)&map->table, map->capacity * sizeof(struct s2n_map_entry)));
+    }
 
-    /* Clone the temporary map */
     map->capacity = tmp.capacity;
     map->size = tmp.size;
     map->table = tmp.table;
-    map->immutable = 0;
-    map->sha256 = tmp.sha256;
+
+    return 0;
+}
+
+/* Keeps the load factor at or below 3/4, so runs of full slots stay short */
+static int s2n_map_reserve_slot(struct s2n_map *map)
+{
+    if ((uint64_t) (map->size + 1) * 4 > (uint64_t) map->capacity * 3) {
+        GUARD(s2n_map_embiggen(map, map->capacity * 2));
+    }
 
     return 0;
 }
@@ -88,7 +226,7 @@ struct s2n_map *s2n_map_new()
 
 struct s2n_map *s2n_map_new_with_initial_capacity(uint32_t capacity)
 {
-    S2N_ERROR_IF_PTR(capacity == 0, S2N_ERR_MAP_INVALID_MAP_SIZE);
+    S2N_ERROR_IF_PTR(capacity == 0 || capacity > (1U << 31), S2N_ERR_MAP_INVALID_MAP_SIZE);
     struct s2n_blob mem = {0};
     struct s2n_map *map;
 
@@ -100,42 +238,58 @@ struct s2n_map *s2n_map_new_with_initial_capacity(uint32_t capacity)
     map->immutable = 0;
     map->table = NULL;
 
-    GUARD_PTR(s2n_hash_new(&map->sha256));
-    GUARD_PTR(s2n_hash_init(&map->sha256, S2N_HASH_SHA256));
+    struct s2n_blob hash_key = {.data = (uint8_t *) map->hash_key, .size = sizeof(map->hash_key)};
+    GUARD_PTR(s2n_get_public_random_data(&hash_key));
 
-    GUARD_PTR(s2n_map_embiggen(map, capacity));
+    /* Slots are picked by masking the hash, so the table size has to be a power of two */
+    uint32_t table_size = 1;
+    while (table_size < capacity) {
+        table_size <<= 1;
+    }
+
+    GUARD_PTR(s2n_map_embiggen(map, table_size));
 
     return map;
 }
 
-int s2n_map_add(struct s2n_map *map, struct s2n_blob *key, struct s2n_blob *value)
+/* Grows the table up front, so that count more entries can be added without it being rebuilt along the way */
+int s2n_map_reserve(struct s2n_map *map, uint32_t count)
 {
     S2N_ERROR_IF(map->immutable, S2N_ERR_MAP_IMMUTABLE);
 
-    if (map->capacity < (map->size * 2)) {
-        /* Embiggen the map */
-        GUARD(s2n_map_embiggen(map, map->capacity * 2));
+    uint64_t size = (uint64_t) map->size + count;
+    uint64_t capacity = map->capacity;
+    while (size * 4 > capacity * 3) {
+        capacity <<= 1;
+    }
+    S2N_ERROR_IF(capacity > (1U << 31), S2N_ERR_MAP_INVALID_MAP_SIZE);
+
+    if (capacity != map->capacity) {
+        GUARD(s2n_map_embiggen(map, capacity));
     }
 
-    uint32_t slot;
-    GUARD(s2n_map_slot(map, key, &slot));
+    return 0;
+}
 
-    /* Linear probing until we find an empty slot */
-    while(map->table[slot].key.size) {
-        if (key->size != map->table[slot].key.size ||
-            memcmp(key->data,  map->table[slot].key.data, key->size)) {
-            slot++;
-            slot %= map->capacity;
-            continue;
-        }
+int s2n_map_add(struct s2n_map *map, struct s2n_blob *key, struct s2n_blob *value)
+{
+    S2N_ERROR_IF(map->immutable, S2N_ERR_MAP_IMMUTABLE);
 
-        /* We found a duplicate key */
-        S2N_ERROR(S2N_ERR_MAP_DUPLICATE);
-    }
+    struct s2n_map_entry *existing;
+    uint32_t hash = s2n_map_hash(map, key);
+    s2n_map_find(map, hash, key, &existing);
 
-    GUARD(s2n_dup(key, &map->table[slot].key));
-    GUARD(s2n_dup(value, &map->table[slot].value));
-    map->size++;
+    /* We found a duplicate key */
+    S2N_ERROR_IF(existing, S2N_ERR_MAP_DUPLICATE);
+
+    struct s2n_map_entry entry;
+    GUARD(s2n_map_entry_init(&entry, hash, key, value));
+
+    if (s2n_map_reserve_slot(map) < 0) {
+        GUARD(s2n_map_entry_free(&entry));
+        S2N_ERROR_PRESERVE_ERRNO();
+    }
+    s2n_map_place(map, entry);
 
     return 0;
 }
@@ -144,33 +298,23 @@ int s2n_map_put(struct s2n_map *map, struct s2n_blob *key, struct s2n_blob *valu
 {
     S2N_ERROR_IF(map->immutable, S2N_ERR_MAP_IMMUTABLE);
 
-    if (map->capacity < (map->size * 2)) {
-        /* Embiggen the map */
-        GUARD(s2n_map_embiggen(map, map->capacity * 2));
-    }
+    struct s2n_map_entry *existing;
+    uint32_t hash = s2n_map_hash(map, key);
+    s2n_map_find(map, hash, key, &existing);
 
-    uint32_t slot;
-    GUARD(s2n_map_slot(map, key, &slot));
+    if (existing) {
+        /* We found a duplicate key that will be overwritten in place */
+        struct s2n_map_entry entry;
+        GUARD(s2n_map_entry_init(&entry, hash, key, value));
 
-    /* Linear probing until we find an empty slot */
-    while(map->table[slot].key.size) {
-        if (key->size != map->table[slot].key.size ||
-            memcmp(key->data,  map->table[slot].key.data, key->size)) {
-            slot++;
-            slot %= map->capacity;
-            continue;
-        }
+        entry.distance = existing->distance;
+        GUARD(s2n_map_entry_free(existing));
+        *existing = entry;
 
-        /* We found a duplicate key that will be overwritten */
-        GUARD(s2n_free(&map->table[slot].key));
-        GUARD(s2n_free(&map->table[slot].value));
-        map->size--;
-        break;
+        return 0;
     }
 
-    GUARD(s2n_dup(key, &map->table[slot].key));
-    GUARD(s2n_dup(value, &map->table[slot].value));
-    map->size++;
+    GUARD(s2n_map_add(map, key, value));
 
     return 0;
 }
@@ -193,44 +337,29 @@ int s2n_map_lookup(struct s2n_map *map, struct s2n_blob *key, struct s2n_blob *v
 {
     S2N_ERROR_IF(!map->immutable, S2N_ERR_MAP_MUTABLE);
 
-    uint32_t slot;
-    GUARD(s2n_map_slot(map, key, &slot));
-    const uint32_t initial_slot = slot;
-
-    while(map->table[slot].key.size) {
-        if (key->size != map->table[slot].key.size ||
-            memcmp(key->data,  map->table[slot].key.data, key->size)) {
-            slot++;
-            slot %= map->capacity;
-            /* We went over all the slots but found no match */
-            if (slot == initial_slot) {
-                break;
-            }
-            continue;
-        }
-
-        /* We found a match */
-        value->data = map->table[slot].value.data;
-        value->size = map->table[slot].value.size;
+    struct s2n_map_entry *entry;
+    s2n_map_find(map, s2n_map_hash(map, key), key, &entry);
 
-        return 1;
+    if (entry == NULL) {
+        return 0;
     }
 
-    return 0;
+    /* We found a match */
+    value->data = s2n_map_entry_data(entry);
+    value->size = entry->value_size;
+
+    return 1;
 }
 
 int s2n_map_free(struct s2n_map *map)
 {
     /* Free the keys and values */
     for (int i = 0; i < map->capacity; i++) {
-        if (map->table[i].key.size) {
-            GUARD(s2n_free(&map->table[i].key));
-            GUARD(s2n_free(&map->table[i].value));
+        if (map->table[i].distance) {
+            GUARD(s2n_map_entry_free(&map->table[i]));
         }
     }
 
-    GUARD(s2n_hash_free(&map->sha256));
-
     /* Free the table */
     GUARD(s2n_free_object((uint8_t **)&map->table, map->capacity * sizeof(struct s2n_map_entry)));
 
@@ -24,6 +24,7 @@ struct s2n_map;
 
 extern struct s2n_map *s2n_map_new();
 extern struct s2n_map *s2n_map_new_with_initial_capacity(uint32_t capacity);
+extern int s2n_map_reserve(struct s2n_map *map, uint32_t count);
 extern int s2n_map_add(struct s2n_map *map, struct s2n_blob *key, struct s2n_blob *value);
 extern int s2n_map_put(struct s2n_map *map, struct s2n_blob *key, struct s2n_blob *value);
 extern int s2n_map_complete(struct s2n_map *map);
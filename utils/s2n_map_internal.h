@@ -16,13 +16,25 @@
 
 #include "utils/s2n_map.h"
 
+/* Entries whose key and value fit in S2N_MAP_INLINE_SIZE bytes are stored in the table itself */
+#define S2N_MAP_INLINE_SIZE 24
+
 struct s2n_map_entry {
-    struct s2n_blob key;
-    struct s2n_blob value;
+    /* The value, followed by the key. The value comes first so that it is suitably aligned. */
+    union {
+        uint8_t bytes[S2N_MAP_INLINE_SIZE];
+        uint8_t *ptr;
+    } data;
+    uint32_t key_size;
+    uint32_t value_size;
+
+    /* The key's hash, and how far the entry is from the slot that hash points to, plus one. 0 for an empty slot. */
+    uint32_t hash;
+    uint32_t distance;
 };
 
 struct s2n_map {
-    /* The total capacity of the table, in number of elements. */
+    /* The total capacity of the table, in number of elements. Always a power of two. */
     uint32_t capacity;
 
     /* The total number of elements currently in the table. Used for measuring the load factor */
@@ -34,5 +46,6 @@ struct s2n_map {
     /* Pointer to the hash-table, should be capacity * sizeof(struct s2n_map_entry) */
     struct s2n_map_entry *table;
 
-    struct s2n_hash_state sha256;
+    /* Random key for SipHash, so that the slots keys land in can't be predicted */
+    uint64_t hash_key[2];
 };
@@ -22,28 +22,70 @@
 
 #include "utils/s2n_blob.h"
 #include "utils/s2n_mem.h"
+#include "utils/s2n_mem_slab.h"
 #include "utils/s2n_safety.h"
 
 static long page_size = 4096;
 static int use_mlock = 1;
+static int use_slab = 1;
+
+/* Bytes held by allocations that don't come from a slab, and mlock() failures for them */
+static uint64_t page_bytes_in_use = 0;
+static uint64_t page_mlock_failures = 0;
 
 int s2n_mem_init(void)
 {
     GUARD(page_size = sysconf(_SC_PAGESIZE));
-    if (getenv("S2N_DONT_MLOCK")) {
-        use_mlock = 0;
-    }
+    use_mlock = getenv("S2N_DONT_MLOCK") == NULL;
+    use_slab = getenv("S2N_DONT_SLAB") == NULL;
 
     return 0;
 }
 
 int s2n_mem_cleanup(void)
 {
+    /* use_mlock and use_slab are left alone, anything freed after this still has to go back
+     * to where it came from. s2n_mem_init() sets them again.
+     */
+    GUARD(s2n_slab_cleanup());
     page_size = 4096;
-    use_mlock = 1;
     return 0;
 }
 
+int s2n_mem_get_stats(struct s2n_mem_stats *stats)
+{
+    struct s2n_slab_stats slab_stats;
+
+    notnull_check(stats);
+    GUARD(s2n_slab_get_stats(&slab_stats));
+
+    stats->bytes_in_use = __atomic_load_n(&page_bytes_in_use, __ATOMIC_RELAXED) + slab_stats.bytes_in_use;
+    stats->slab_bytes_reserved = slab_stats.bytes_reserved;
+    stats->slab_bytes_in_use = slab_stats.bytes_in_use;
+    stats->mlock_failures = __atomic_load_n(&page_mlock_failures, __ATOMIC_RELAXED) + slab_stats.mlock_failures;
+
+    return 0;
+}
+
+/* Small locked allocations come from a slab. b->allocated is 0 for blobs built by s2n_free_object(),
+ * which are always freed with the size they were allocated with.
+ */
+static int s2n_mem_is_slab(const struct s2n_blob *b)
+{
+    uint32_t size = b->allocated ? b->allocated : b->size;
+
+    return use_slab && b->mlocked && size <= S2N_SLAB_MAX_CHUNK;
+}
+
+static uint32_t s2n_mem_page_allocated(const struct s2n_blob *b)
+{
+    if (b->allocated) {
+        return b->allocated;
+    }
+
+    return b->mlocked ? page_size * (((b->size - 1) / page_size) + 1) : b->size;
+}
+
 int s2n_alloc(struct s2n_blob *b, uint32_t size)
 {
     notnull_check(b);
@@ -61,17 +103,27 @@ bool s2n_blob_is_growable(const struct s2n_blob* b)
 
 static int s2n_get_memory(struct s2n_blob *b, uint32_t size)
 {
+    if (use_mlock && use_slab && size <= S2N_SLAB_MAX_CHUNK) {
+        return s2n_slab_alloc(b, size);
+    }
+
     if(use_mlock) {
         /* Page aligned allocation required for mlock */
         uint32_t allocate = page_size * (((size - 1) / page_size) + 1);
 	*b = (struct s2n_blob) {.data = NULL, .size = size, .allocated = allocate, .mlocked = 1, .growable = 1};
 	S2N_ERROR_IF(posix_memalign((void**) &b->data, page_size, allocate), S2N_ERR_ALLOC);
+	__atomic_add_fetch(&page_bytes_in_use, b->allocated, __ATOMIC_RELAXED);
 #ifdef MADV_DONTDUMP
 	S2N_ERROR_IF(madvise(b->data, b->size, MADV_DONTDUMP) < 0, S2N_ERR_MADVISE);
 #endif
-	S2N_ERROR_IF(mlock(b->data, b->size) < 0, S2N_ERR_MLOCK);
+	if (mlock(b->data, b->size) < 0) {
+	    __atomic_add_fetch(&page_mlock_failures, 1, __ATOMIC_RELAXED);
+	    S2N_ERROR(S2N_ERR_MLOCK);
+	}
     } else {
         *b = (struct s2n_blob) {.data = calloc(size, 1), .size = size, .allocated = size, .mlocked = 0, .growable = 1};
+        S2N_ERROR_IF(b->data == NULL, S2N_ERR_ALLOC);
+        __atomic_add_fetch(&page_bytes_in_use, b->allocated, __ATOMIC_RELAXED);
     }
     S2N_ERROR_IF(b->data == NULL, S2N_ERR_ALLOC);
     return S2N_SUCCESS;
@@ -113,6 +165,18 @@ int s2n_realloc(struct s2n_blob *b, uint32_t size)
 int s2n_free(struct s2n_blob *b)
 {
     S2N_ERROR_IF(!s2n_blob_is_growable(b), S2N_ERR_FREE_STATIC_BLOB);
+
+    if (b->data && s2n_mem_is_slab(b)) {
+        int slab_rc = s2n_slab_free(b);
+        *b = (struct s2n_blob) {0};
+        GUARD(slab_rc);
+        return S2N_SUCCESS;
+    }
+
+    if (b->data) {
+        __atomic_sub_fetch(&page_bytes_in_use, s2n_mem_page_allocated(b), __ATOMIC_RELAXED);
+    }
+
     /* To avoid memory leaks, still free the data even if we can't unlock / wipe it */
     int zero_rc = s2n_blob_zero(b);
     int munlock_rc = b->mlocked ? munlock(b->data, b->size) : 0;
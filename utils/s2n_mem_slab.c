@@ -0,0 +1,225 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "error/s2n_errno.h"
+
+#include "utils/s2n_blob.h"
+#include "utils/s2n_mem_slab.h"
+#include "utils/s2n_safety.h"
+
+/* Small mlocked allocations are carved out of slabs, so that the mlock(),
+ * munlock() and madvise() calls are made once per slab rather than once per
+ * allocation. Each size class has its own lock, free list and list of slabs.
+ * Free chunks are linked through their first bytes. Like other s2n_alloc()
+ * memory, chunks are not zeroed when handed out, but they are wiped when they
+ * are freed. Slabs are only given back by s2n_slab_cleanup().
+ */
+struct s2n_slab_chunk {
+    struct s2n_slab_chunk *next;
+};
+
+struct s2n_slab {
+    uint8_t *data;
+    struct s2n_slab *next;
+};
+
+struct s2n_slab_class {
+    pthread_mutex_t lock;
+    struct s2n_slab_chunk *free_list;
+    struct s2n_slab *slabs;
+    uint32_t slab_count;
+    uint32_t chunks_in_use;
+};
+
+#define S2N_SLAB_CLASS_INIT { .lock = PTHREAD_MUTEX_INITIALIZER }
+
+static struct s2n_slab_class slab_classes[S2N_SLAB_CLASSES] = {
+    S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT,
+    S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT,
+    S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT, S2N_SLAB_CLASS_INIT,
+};
+
+static uint64_t mlock_failures = 0;
+
+static int s2n_slab_class_index(uint32_t size)
+{
+    int index = 0;
+    uint32_t chunk_size = S2N_SLAB_MIN_CHUNK;
+
+    while (chunk_size < size) {
+        chunk_size <<= 1;
+        index++;
+    }
+
+    return index;
+}
+
+static uint32_t s2n_slab_chunk_size(int index)
+{
+    return S2N_SLAB_MIN_CHUNK << index;
+}
+
+/* Adds a slab to the class and threads all of its chunks on to the free list. Called with the class lock held. */
+static int s2n_slab_grow(struct s2n_slab_class *class, uint32_t chunk_size)
+{
+    struct s2n_slab *slab = malloc(sizeof(struct s2n_slab));
+    S2N_ERROR_IF(slab == NULL, S2N_ERR_ALLOC);
+
+    if (posix_memalign((void **) &slab->data, S2N_SLAB_SIZE, S2N_SLAB_SIZE)) {
+        free(slab);
+        S2N_ERROR(S2N_ERR_ALLOC);
+    }
+
+#ifdef MADV_DONTDUMP
+    if (madvise(slab->data, S2N_SLAB_SIZE, MADV_DONTDUMP) < 0) {
+        free(slab->data);
+        free(slab);
+        S2N_ERROR(S2N_ERR_MADVISE);
+    }
+#endif
+
+    if (mlock(slab->data, S2N_SLAB_SIZE) < 0) {
+        __atomic_add_fetch(&mlock_failures, 1, __ATOMIC_RELAXED);
+        free(slab->data);
+        free(slab);
+        S2N_ERROR(S2N_ERR_MLOCK);
+    }
+
+    for (uint32_t offset = S2N_SLAB_SIZE; offset > 0; offset -= chunk_size) {
+        struct s2n_slab_chunk *chunk = (struct s2n_slab_chunk *)(void *)(slab->data + offset - chunk_size);
+        chunk->next = class->free_list;
+        class->free_list = chunk;
+    }
+
+    slab->next = class->slabs;
+    class->slabs = slab;
+    class->slab_count++;
+
+    return 0;
+}
+
+static int s2n_slab_take_chunk(struct s2n_slab_class *class, uint32_t chunk_size, uint8_t **chunk)
+{
+    if (class->free_list == NULL) {
+        GUARD(s2n_slab_grow(class, chunk_size));
+    }
+
+    struct s2n_slab_chunk *free_chunk = class->free_list;
+    class->free_list = free_chunk->next;
+    free_chunk->next = NULL;
+    class->chunks_in_use++;
+
+    *chunk = (uint8_t *) free_chunk;
+
+    return 0;
+}
+
+int s2n_slab_alloc(struct s2n_blob *b, uint32_t size)
+{
+    notnull_check(b);
+    lte_check(size, S2N_SLAB_MAX_CHUNK);
+
+    int index = s2n_slab_class_index(size);
+    uint32_t chunk_size = s2n_slab_chunk_size(index);
+    struct s2n_slab_class *class = &slab_classes[index];
+    uint8_t *chunk = NULL;
+
+    S2N_ERROR_IF(pthread_mutex_lock(&class->lock) != 0, S2N_ERR_LOCK);
+    int rc = s2n_slab_take_chunk(class, chunk_size, &chunk);
+    S2N_ERROR_IF(pthread_mutex_unlock(&class->lock) != 0, S2N_ERR_LOCK);
+    GUARD(rc);
+
+    *b = (struct s2n_blob) {.data = chunk, .size = size, .allocated = chunk_size, .mlocked = 1, .growable = 1};
+
+    return 0;
+}
+
+int s2n_slab_free(struct s2n_blob *b)
+{
+    notnull_check(b);
+    notnull_check(b->data);
+
+    /* Blobs from s2n_free_object() only know the size they were allocated with */
+    uint32_t size = b->allocated ? b->allocated : b->size;
+    lte_check(size, S2N_SLAB_MAX_CHUNK);
+
+    int index = s2n_slab_class_index(size);
+    uint32_t chunk_size = s2n_slab_chunk_size(index);
+    struct s2n_slab_class *class = &slab_classes[index];
+
+    /* Wipe the whole chunk, not just the part the blob still covers */
+    memset(b->data, 0, chunk_size);
+
+    S2N_ERROR_IF(pthread_mutex_lock(&class->lock) != 0, S2N_ERR_LOCK);
+    struct s2n_slab_chunk *chunk = (struct s2n_slab_chunk *)(void *) b->data;
+    chunk->next = class->free_list;
+    class->free_list = chunk;
+    class->chunks_in_use--;
+    S2N_ERROR_IF(pthread_mutex_unlock(&class->lock) != 0, S2N_ERR_LOCK);
+
+    return 0;
+}
+
+int s2n_slab_get_stats(struct s2n_slab_stats *stats)
+{
+    notnull_check(stats);
+
+    *stats = (struct s2n_slab_stats) {0};
+
+    for (int i = 0; i < S2N_SLAB_CLASSES; i++) {
+        struct s2n_slab_class *class = &slab_classes[i];
+
+        S2N_ERROR_IF(pthread_mutex_lock(&class->lock) != 0, S2N_ERR_LOCK);
+        stats->bytes_reserved += (uint64_t) class->slab_count * S2N_SLAB_SIZE;
+        stats->bytes_in_use += (uint64_t) class->chunks_in_use * s2n_slab_chunk_size(i);
+        S2N_ERROR_IF(pthread_mutex_unlock(&class->lock) != 0, S2N_ERR_LOCK);
+    }
+
+    stats->mlock_failures = __atomic_load_n(&mlock_failures, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int s2n_slab_cleanup(void)
+{
+    for (int i = 0; i < S2N_SLAB_CLASSES; i++) {
+        struct s2n_slab_class *class = &slab_classes[i];
+
+        S2N_ERROR_IF(pthread_mutex_lock(&class->lock) != 0, S2N_ERR_LOCK);
+
+        /* Slabs with chunks still handed out have to stay, whoever holds those will free them later */
+        if (class->chunks_in_use == 0) {
+            while (class->slabs) {
+                struct s2n_slab *slab = class->slabs;
+                class->slabs = slab->next;
+
+                munlock(slab->data, S2N_SLAB_SIZE);
+                free(slab->data);
+                free(slab);
+            }
+            class->free_list = NULL;
+            class->slab_count = 0;
+        }
+
+        S2N_ERROR_IF(pthread_mutex_unlock(&class->lock) != 0, S2N_ERR_LOCK);
+    }
+
+    return 0;
+}
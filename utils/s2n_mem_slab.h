@@ -0,0 +1,39 @@
+/*
+ * Copyright 2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "utils/s2n_blob.h"
+
+/* Size classes run from S2N_SLAB_MIN_CHUNK to S2N_SLAB_MAX_CHUNK in powers of two.
+ * Each slab is S2N_SLAB_SIZE bytes, locked and excluded from core dumps as a whole.
+ */
+#define S2N_SLAB_MIN_CHUNK  16
+#define S2N_SLAB_MAX_CHUNK  16384
+#define S2N_SLAB_SIZE       65536
+#define S2N_SLAB_CLASSES    11
+
+struct s2n_slab_stats {
+    uint64_t bytes_reserved;
+    uint64_t bytes_in_use;
+    uint64_t mlock_failures;
+};
+
+extern int s2n_slab_alloc(struct s2n_blob *b, uint32_t size);
+extern int s2n_slab_free(struct s2n_blob *b);
+extern int s2n_slab_get_stats(struct s2n_slab_stats *stats);
+extern int s2n_slab_cleanup(void);
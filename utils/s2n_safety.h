@@ -99,7 +99,7 @@ static inline void* trace_memcpy_check(void *restrict to, const void *restrict f
 #define GUARD_NONNULL_PTR( x )          do {if ( (x) == NULL ) return NULL;} while (0)
 
 /* Check the return value from caller. If this value is -2, S2N_ERR_BLOCKED is marked*/
-#define GUARD_AGAIN( x )  do {if ( (x) == -2 ) { S2N_ERROR(S2N_ERR_BLOCKED); } GUARD( x );} while(0)
+#define GUARD_AGAIN( x )  do {if ( (x) == -2 ) { S2N_ERROR_BLOCKED(S2N_ERR_BLOCKED); } GUARD( x );} while(0)
 
 /* Returns true if s2n is in unit test mode, false otherwise */
 bool s2n_in_unit_test();